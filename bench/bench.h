@@ -0,0 +1,21 @@
+// What the benchmarks have in common
+#ifndef GUARD_BENCH_H
+#define GUARD_BENCH_H
+#include "../src/debugger.h"
+#include <time.h>
+
+// Seconds on the monotonic clock
+static inline double now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+// For qsort, to take percentiles
+static inline int compare_doubles(const void *a, const void *b) {
+    double x = *(const double *)a;
+    double y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+#endif
@@ -0,0 +1,94 @@
+// Compares the breakpoint index with the old parallel arrays + linear scan
+#include "bench.h"
+
+#define LOOKUPS 100000
+#define MAX_LINEAR_REMOVES 1000  // removing from the arrays is quadratic, don't wait forever
+
+// what the process manager used to do
+typedef struct {
+    uintptr_t *breakpoint_positions;
+    TinyDbg_Breakpoint *breakpoints;
+    size_t breakpoints_len;
+} linear_breakpoints;
+
+static void linear_insert(linear_breakpoints *l, TinyDbg_Breakpoint breakpoint) {
+    l->breakpoints_len++;
+    l->breakpoint_positions = realloc(l->breakpoint_positions, sizeof(uintptr_t) * l->breakpoints_len);
+    l->breakpoint_positions[l->breakpoints_len - 1] = breakpoint.position;
+    l->breakpoints = realloc(l->breakpoints, sizeof(TinyDbg_Breakpoint) * l->breakpoints_len);
+    l->breakpoints[l->breakpoints_len - 1] = breakpoint;
+}
+
+static TinyDbg_Breakpoint *linear_find(linear_breakpoints *l, uintptr_t position) {
+    for (size_t i = 0; i < l->breakpoints_len; i++) {
+        if (l->breakpoint_positions[i] == position) return &l->breakpoints[i];
+    }
+    return NULL;
+}
+
+static void linear_remove(linear_breakpoints *l, uintptr_t position) {
+    size_t i = 0;
+    for (; i < l->breakpoints_len; i++) {
+        if (l->breakpoint_positions[i] == position) break;
+    }
+    for (size_t j = i; j < l->breakpoints_len - 1; j++) {
+        l->breakpoint_positions[j] = l->breakpoint_positions[j + 1];
+    }
+    for (size_t j = i; j < l->breakpoints_len - 1; j++) {
+        l->breakpoints[j] = l->breakpoints[j + 1];
+    }
+    l->breakpoints_len--;
+}
+
+static void run(size_t n) {
+    // basic block addresses in a text segment, a few bytes apart
+    uintptr_t *positions = malloc(n * sizeof(uintptr_t));
+    uintptr_t position = 0x555555554000;
+    for (size_t i = 0; i < n; i++) {
+        position += 1 + rand() % 24;
+        positions[i] = position;
+    }
+    size_t removes = n < MAX_LINEAR_REMOVES ? n : MAX_LINEAR_REMOVES;
+    volatile uintptr_t sink = 0;
+
+    linear_breakpoints l = { NULL, NULL, 0 };
+    double t = now();
+    for (size_t i = 0; i < n; i++) linear_insert(&l, (TinyDbg_Breakpoint){ positions[i], false, 0 });
+    double linear_insert_time = now() - t;
+    t = now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += linear_find(&l, positions[rand() % n])->position;
+    double linear_find_time = now() - t;
+    t = now();
+    for (size_t i = 0; i < removes; i++) linear_remove(&l, positions[i]);
+    double linear_remove_time = now() - t;
+
+    TinyDbg_BreakpointIndex index;
+    TinyDbg_BreakpointIndex_init(&index);
+    t = now();
+    for (size_t i = 0; i < n; i++) TinyDbg_BreakpointIndex_insert(&index, (TinyDbg_Breakpoint){ positions[i], false, 0 });
+    double index_insert_time = now() - t;
+    t = now();
+    for (size_t i = 0; i < LOOKUPS; i++) sink += TinyDbg_BreakpointIndex_find(&index, positions[rand() % n])->position;
+    double index_find_time = now() - t;
+    t = now();
+    for (size_t i = 0; i < removes; i++) TinyDbg_BreakpointIndex_remove(&index, positions[i], NULL);
+    double index_remove_time = now() - t;
+
+    printf("%7zu breakpoints | insert ns/op: linear %10.1f index %6.1f | find ns/op: linear %10.1f index %6.1f | remove ns/op: linear %10.1f index %6.1f\n", n,
+           linear_insert_time * 1e9 / n, index_insert_time * 1e9 / n,
+           linear_find_time * 1e9 / LOOKUPS, index_find_time * 1e9 / LOOKUPS,
+           linear_remove_time * 1e9 / removes, index_remove_time * 1e9 / removes);
+
+    free(l.breakpoint_positions);
+    free(l.breakpoints);
+    TinyDbg_BreakpointIndex_destroy(&index);
+    free(positions);
+}
+
+int main() {
+    srand(1);
+    run(10);
+    run(1000);
+    run(100000);
+    return 0;
+}
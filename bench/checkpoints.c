@@ -0,0 +1,96 @@
+// How many inputs a fuzz loop runs per second when every run starts the process again from execve, and when every run
+// restores a checkpoint made once the process was done initializing. The input goes in a global before each run, and the
+// process has 50ms of initialization before it reads it, and exits with 1 for some inputs.
+#include "bench.h"
+
+#define RUNS 200
+#define RESTARTS 10
+#define INIT_MS 50
+
+volatile long input;
+
+__attribute__((noinline)) void initialized(void) {
+    asm volatile("");
+}
+
+static int wait_exit(EventQueue_Consumer *consumer) {
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        int code = event->content.stop_code;
+        TinyDbg_Event_free(event);
+        if (exited) return code;
+    }
+}
+
+static void fuzz_input(TinyDbg *handle, long value) {
+    uintptr_t input_at = TinyDbg_lookup_symbol(handle, "input");
+    EventQueue_join(TinyDbg_set_memory(handle, (struct iovec){ &value, sizeof(value) }, (struct iovec){ (void *)input_at, sizeof(value) }));
+}
+
+// Stops at initialized(), where the input is read next
+static TinyDbg *start_initialized(char *self, char **envp, EventQueue_Consumer **consumer) {
+    char *child_argv[] = { self, "child", NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    EventQueue_join(TinyDbg_set_breakpoint(handle, TinyDbg_lookup_symbol(handle, "initialized"), true));
+    EventQueue_join(TinyDbg_continue(handle));
+    TinyDbg_Event *event;
+    EventQueue_consume(*consumer, (void **)&event);
+    TinyDbg_Event_free(event);
+    return handle;
+}
+
+static void restart(char *self, char **envp) {
+    double start = now();
+    int found = 0;
+    for (long i = 0; i < RESTARTS; i++) {
+        EventQueue_Consumer *consumer;
+        TinyDbg *handle = start_initialized(self, envp, &consumer);
+        fuzz_input(handle, i);
+        EventQueue_join(TinyDbg_continue(handle));
+        found += wait_exit(consumer) != 0;
+        EventQueue_destroy_consumer(consumer);
+        TinyDbg_free(handle);
+    }
+    double elapsed = now() - start;
+    printf("restart from execve    %4d runs, %3d exit 1, %8.1f runs/s\n", RESTARTS, found, RESTARTS / elapsed);
+}
+
+static void restore(char *self, char **envp) {
+    EventQueue_Consumer *consumer;
+    TinyDbg *handle = start_initialized(self, envp, &consumer);
+    TinyDbg_Checkpoint *checkpoint;
+    EventQueue_join(TinyDbg_checkpoint(handle, &checkpoint));
+
+    double start = now();
+    int found = 0;
+    for (long i = 0; i < RUNS; i++) {
+        bool restored;
+        EventQueue_join(TinyDbg_restore(handle, checkpoint, &restored));
+        fuzz_input(handle, i);
+        EventQueue_join(TinyDbg_continue(handle));
+        found += wait_exit(consumer) != 0;
+    }
+    double elapsed = now() - start;
+    printf("restore a checkpoint   %4d runs, %3d exit 1, %8.1f runs/s\n", RUNS, found, RUNS / elapsed);
+
+    EventQueue_join(TinyDbg_free_checkpoint(handle, checkpoint));
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        double start = now();
+        while (now() - start < INIT_MS / 1e3);
+        initialized();
+        return input % 7 == 3;
+    }
+
+    restart(argv[0], envp);
+    restore(argv[0], envp);
+    return 0;
+}
@@ -0,0 +1,60 @@
+// How long a process that calls a function many times takes with a breakpoint on it that should only stop once, for
+// rdi == 4242: the client gets every hit and checks the register itself, or the process manager evaluates the condition.
+// The events are consumed on another thread, which is how a client waits for them.
+#include "bench.h"
+
+#define CALLS 20000
+
+__attribute__((noinline)) void hot(long i) {
+    asm volatile("" :: "r"(i));
+}
+
+static void run(char *self, char **envp, const char *condition) {
+    char *child_argv[] = { self, "child", NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    uintptr_t position = TinyDbg_lookup_symbol(handle, "hot");
+    if (condition == NULL) {
+        EventQueue_join(TinyDbg_set_breakpoint(handle, position, false));
+    } else {
+        EventQueue_join(TinyDbg_set_conditional_breakpoint(handle, position, false, TinyDbg_Condition_compile(condition, NULL), 0));
+    }
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    size_t events = 0, stops = 0;
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        pid_t tid = event->tid;
+        if (event->type == TinyDbg_event_type_breakpoint) {
+            events++;
+            struct user_regs_struct regs;
+            EventQueue_join(TinyDbg_thread_get_registers(handle, tid, &regs));
+            if (regs.rdi == 4242) stops++;
+        }
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+    printf("%-32s %6zu events, %zu real stops, %7.3f s, %6.1f us per call\n", condition == NULL ? "checked by the client" : condition,
+           events, stops, elapsed, elapsed / CALLS * 1e6);
+
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        for (long i = 0; i < CALLS; i++) hot(i);
+        return 0;
+    }
+
+    run(argv[0], envp, NULL);
+    run(argv[0], envp, "rdi == 4242");
+    run(argv[0], envp, "u64[rsp] != 0 && rdi == 4242");
+    return 0;
+}
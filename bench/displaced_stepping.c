@@ -0,0 +1,67 @@
+// What a breakpoint that stays in costs per hit, from one thread and from four. With a condition that's never true the
+// process manager steps over every hit by itself, and with none every hit is an event that the client continues
+// in non-stop mode - a hit another thread ran past while the breakpoint was out would be missing from the events.
+#include "bench.h"
+
+#define CALLS 20000
+
+__attribute__((noinline)) void hot(long i) {
+    asm volatile("" :: "r"(i));
+}
+
+static void *calls(void *arg) {
+    (void)arg;
+    for (long i = 0; i < CALLS; i++) hot(i);
+    return NULL;
+}
+
+static void run(char *self, char **envp, int threads, bool report) {
+    char threads_str[8];
+    sprintf(threads_str, "%d", threads);
+    char *child_argv[] = { self, threads_str, NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, TINYDBG_FLAG_NON_STOP);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    uintptr_t position = TinyDbg_lookup_symbol(handle, "hot");
+    if (report) {
+        EventQueue_join(TinyDbg_set_breakpoint(handle, position, false));
+    } else {
+        EventQueue_join(TinyDbg_set_conditional_breakpoint(handle, position, false, TinyDbg_Condition_compile("0", NULL), 0));
+    }
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    size_t events = 0;
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        pid_t tid = event->tid;
+        if (event->type == TinyDbg_event_type_breakpoint) events++;
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_thread_continue(handle, tid));
+    }
+    double elapsed = now() - start;
+    printf("%d thread%s, %-8s %6zu events of %6d hits, %7.3f s, %6.1f us per hit\n", threads, threads == 1 ? " " : "s",
+           report ? "reported" : "skipped", events, threads * CALLS, elapsed, elapsed / (threads * CALLS) * 1e6);
+
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        int threads = atoi(argv[1]);
+        pthread_t thread_ids[threads];
+        for (int i = 0; i < threads; i++) pthread_create(&thread_ids[i], NULL, calls, NULL);
+        for (int i = 0; i < threads; i++) pthread_join(thread_ids[i], NULL);
+        return 0;
+    }
+
+    run(argv[0], envp, 1, false);
+    run(argv[0], envp, 4, false);
+    run(argv[0], envp, 1, true);
+    run(argv[0], envp, 4, true);
+    return 0;
+}
@@ -0,0 +1,150 @@
+// Events per second through eq_debugger_events (an allocation, an EventQueue_add and a free for each) and through the
+// preallocated event ring, first only moving events from a producer thread to consumers, then tracing the syscalls of a
+// process that calls getppid in a loop, which stops it for each one.
+#include "bench.h"
+
+#define TRANSPORT_EVENTS 10000000
+#define TRACED_SYSCALLS 100000
+#define BATCH 64
+
+struct transport_args {
+    EventQueue *eq;
+    TinyDbg_EventRing *ring;
+    long taken;
+};
+
+// The last event has tid -1
+static void *consume_queue(void *arg) {
+    struct transport_args *args = arg;
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(args->eq);
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool last = event->tid == -1;
+        TinyDbg_Event_free(event);
+        args->taken++;
+        if (last) break;
+    }
+    EventQueue_destroy_consumer(consumer);
+    return NULL;
+}
+
+// Every consumer gets one of the last events, which have tid -1
+static void *consume_ring(void *arg) {
+    struct transport_args *args = arg;
+    TinyDbg_Event events[BATCH];
+    while (true) {
+        size_t len = TinyDbg_EventRing_wait(args->ring, events, BATCH, -1);
+        args->taken += len;
+        bool last = false;
+        for (size_t i = 0; i < len; i++) {
+            if (events[i].tid == -1) last = true;
+        }
+        // a batch can't have two last events, the producer waits for all of them to be taken before it's done
+        if (last) break;
+    }
+    return NULL;
+}
+
+static void transport_queue(void) {
+    struct transport_args args = { EventQueue_new(), NULL, 0 };
+    pthread_t consumer;
+    pthread_create(&consumer, NULL, consume_queue, &args);
+    double start = now();
+    for (long i = 0; i < TRANSPORT_EVENTS; i++) {
+        TinyDbg_Event *event = malloc(sizeof(TinyDbg_Event));
+        event->type = TinyDbg_event_type_syscall;
+        event->tid = i == TRANSPORT_EVENTS - 1 ? -1 : 1;
+        event->content.syscall.id = i;
+        event->content.syscall.is_exit = false;
+        EventQueue_add(args.eq, event);
+    }
+    pthread_join(consumer, NULL);
+    double elapsed = now() - start;
+    printf("%-28s: %9ld events in %6.3f s, %12.0f events/s\n", "EventQueue, 1 consumer", args.taken, elapsed, args.taken / elapsed);
+    EventQueue_free(args.eq);
+}
+
+static void transport_ring(int consumers_len) {
+    TinyDbg_EventRing ring;
+    TinyDbg_EventRing_init(&ring, TINYDBG_EVENT_RING_LEN);
+    struct transport_args args[consumers_len];
+    pthread_t consumers[consumers_len];
+    for (int i = 0; i < consumers_len; i++) {
+        args[i] = (struct transport_args){ NULL, &ring, 0 };
+        pthread_create(&consumers[i], NULL, consume_ring, &args[i]);
+    }
+    double start = now();
+    TinyDbg_Event event = { .type = TinyDbg_event_type_syscall, .tid = 1 };
+    for (long i = 0; i < TRANSPORT_EVENTS - consumers_len; i++) {
+        event.content.syscall.id = i;
+        TinyDbg_EventRing_push(&ring, &event);
+    }
+    // one last event per consumer, only after everything else was taken so no batch has two of them
+    while (__atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) != ring.head) sched_yield();
+    event.tid = -1;
+    for (int i = 0; i < consumers_len; i++) {
+        TinyDbg_EventRing_push(&ring, &event);
+        while (__atomic_load_n(&ring.tail, __ATOMIC_ACQUIRE) != ring.head) sched_yield();
+    }
+    long taken = 0;
+    for (int i = 0; i < consumers_len; i++) {
+        pthread_join(consumers[i], NULL);
+        taken += args[i].taken;
+    }
+    double elapsed = now() - start;
+    char name[32];
+    sprintf(name, "event ring, %d consumer%s", consumers_len, consumers_len == 1 ? "" : "s");
+    printf("%-28s: %9ld events in %6.3f s, %12.0f events/s\n", name, taken, elapsed, taken / elapsed);
+    TinyDbg_EventRing_destroy(&ring);
+}
+
+static void traced(char *self, char **envp, bool use_ring) {
+    char calls_str[32];
+    sprintf(calls_str, "%d", TRACED_SYSCALLS);
+    char *child_argv[] = { self, calls_str, NULL };
+    int syscalls[] = { SYS_getppid };
+    TinyDbg *handle = TinyDbg_start_syscall_filtered("/proc/self/exe", child_argv, envp,
+                                                     use_ring ? TINYDBG_FLAG_EVENT_RING : 0, syscalls, 1);
+    EventQueue_Consumer *consumer = use_ring ? NULL : EventQueue_new_consumer(handle->eq_debugger_events);
+    EventQueue_join(TinyDbg_stop_on_syscall(handle));
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    long events = 0;
+    while (true) {
+        TinyDbg_Event event;
+        if (use_ring) {
+            TinyDbg_wait_events(handle, &event, 1, -1);
+        } else {
+            TinyDbg_Event *queued;
+            EventQueue_consume(consumer, (void **)&queued);
+            event = *queued;
+            TinyDbg_Event_free(queued);
+        }
+        events++;
+        if (event.type == TinyDbg_event_type_exit) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+    printf("%-28s: %9ld events in %6.3f s, %12.0f events/s\n", use_ring ? "traced, event ring" : "traced, EventQueue",
+           events, elapsed, events / elapsed);
+    if (consumer != NULL) EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        long calls = atol(argv[1]);
+        for (long i = 0; i < calls; i++) getppid();
+        return 0;
+    }
+
+    transport_queue();
+    transport_ring(1);
+    transport_ring(4);
+    traced(argv[0], envp, false);
+    traced(argv[0], envp, true);
+    return 0;
+}
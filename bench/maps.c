@@ -0,0 +1,90 @@
+// How long it takes to get the mappings of a stopped process with a few thousand of them: parsed with getline and sscanf
+// into a realloc'd array with a malloc'd pathname each (how TinyDbg_get_memory_maps used to do it), read again into the
+// map table, and looked up in the table when nothing changed since it was read.
+#include "bench.h"
+
+#define MAPPINGS 2000
+#define READS 200
+#define LOOKUPS 1000000
+
+static TinyDbg_memory_map *read_with_sscanf(pid_t pid, size_t *maps_len) {
+    TinyDbg_memory_map *mem_maps = NULL;
+    *maps_len = 0;
+    char path_str[32];
+    sprintf(path_str, "/proc/%d/maps", pid);
+    FILE *fp = fopen(path_str, "r");
+    if (fp == NULL) return NULL;
+    char *line = NULL;
+    ssize_t line_len;
+    size_t line_capacity = 0;
+    while ((line_len = getline(&line, &line_capacity, fp)) != -1) {
+        TinyDbg_memory_map map;
+        map.pathname = malloc(line_len);
+        map.pathname[0] = '\0';
+        char perm[5];
+        char dev[6];
+        long inode;
+        sscanf(line, "%lx-%lx%c%c%c%c%c %lx %5s %ld %s", &map.begin, &map.end, &perm[0], &perm[1], &perm[2], &perm[3], &perm[4],
+               &map.page_offset, dev, &inode, map.pathname);
+        map.perm_read = perm[1] == 'r';
+        map.perm_write = perm[2] == 'w';
+        map.perm_execute = perm[3] == 'x';
+        map.perm_mayshare = perm[4] == 's';
+        mem_maps = realloc(mem_maps, (++(*maps_len)) * sizeof(TinyDbg_memory_map));
+        mem_maps[*maps_len - 1] = map;
+    }
+    free(line);
+    fclose(fp);
+    return mem_maps;
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process, with mappings that can't be merged since every other one is writable
+        char *area = mmap(NULL, MAPPINGS * 4096l, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        for (long i = 0; i < MAPPINGS; i += 2) mprotect(area + i * 4096, 4096, PROT_READ | PROT_WRITE);
+        while (true) usleep(1000);
+    }
+
+    char *child_argv[] = { argv[0], "child", NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    EventQueue_join(TinyDbg_continue(handle));
+    usleep(100000);
+    EventQueue_join(TinyDbg_stop(handle));
+
+    size_t maps_len = 0;
+    double start = now();
+    for (int i = 0; i < READS; i++) {
+        TinyDbg_memory_map *maps = read_with_sscanf(handle->pid, &maps_len);
+        for (size_t j = 0; j < maps_len; j++) free(maps[j].pathname);
+        free(maps);
+    }
+    double elapsed = now() - start;
+    printf("getline and sscanf:   %5zu mappings, %8.1f us each read\n", maps_len, elapsed / READS * 1e6);
+
+    TinyDbg_memory_map map;
+    start = now();
+    for (int i = 0; i < READS; i++) {
+        TinyDbg_MapTable_invalidate(&handle->maps);
+        TinyDbg_find_map(handle, 0, &map);
+    }
+    elapsed = now() - start;
+    printf("map table, read again: %5zu mappings, %8.1f us each read\n", handle->maps.len, elapsed / READS * 1e6);
+
+    unsigned long reads = handle->maps.reads;
+    unsigned int seed = 1;
+    size_t found = 0;
+    start = now();
+    for (int i = 0; i < LOOKUPS; i++) {
+        const TinyDbg_memory_map *in = &handle->maps.maps[rand_r(&seed) % handle->maps.len];
+        uintptr_t address = in->begin + rand_r(&seed) % (in->end - in->begin);
+        found += TinyDbg_find_map(handle, address, &map);
+    }
+    elapsed = now() - start;
+    printf("map table, cached:     %d lookups, %8.1f ns each, %zu mapped, read %lu times meanwhile\n",
+           LOOKUPS, elapsed / LOOKUPS * 1e9, found, handle->maps.reads - reads);
+
+    kill(handle->pid, SIGKILL);
+    TinyDbg_free(handle);
+    return 0;
+}
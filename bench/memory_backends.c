@@ -0,0 +1,74 @@
+// Bytes per second of each memory backend, reading and writing a stopped child
+#include <signal.h>
+#include "bench.h"
+
+#define BUFFER_SIZE (64 * 1024 * 1024)
+#define BYTES_PER_RUN (256 * 1024 * 1024)
+#define PTRACE_BYTES_PER_RUN (16 * 1024 * 1024)  // a syscall per word, don't wait forever
+#define MAX_OPERATIONS_PER_RUN 100000
+
+static const char *backend_names[] = { "any", "proc_mem", "process_vm", "ptrace" };
+
+static void run(pid_t pid, int mem_fd, TinyDbg_memory_backend backend, char *buffer, size_t chunk, bool write) {
+    size_t total = backend == TinyDbg_memory_backend_ptrace ? PTRACE_BYTES_PER_RUN : BYTES_PER_RUN;
+    if (total > chunk * MAX_OPERATIONS_PER_RUN) total = chunk * MAX_OPERATIONS_PER_RUN;
+    size_t copied = 0;
+    bool failed = false;
+
+    double t = now();
+    for (size_t offset = 0; offset < total; offset += chunk) {
+        uintptr_t remote = (uintptr_t)buffer + offset % BUFFER_SIZE;
+        ssize_t result = write ? TinyDbg_memory_write(backend, pid, mem_fd, buffer, remote, chunk)
+                               : TinyDbg_memory_read(backend, pid, mem_fd, buffer, remote, chunk);
+        if (result != (ssize_t)chunk) {
+            failed = true;
+            break;
+        }
+        copied += chunk;
+    }
+    t = now() - t;
+
+    if (failed) {
+        printf("%-10s %-5s chunk %8zu: failed\n", backend_names[backend], write ? "write" : "read", chunk);
+    } else {
+        printf("%-10s %-5s chunk %8zu: %10.1f MB/s\n", backend_names[backend], write ? "write" : "read", chunk, copied / t / 1e6);
+    }
+}
+
+int main() {
+    // the child is a fork, so the buffer is at the same address in both processes
+    char *buffer = malloc(BUFFER_SIZE);
+    memset(buffer, 1, BUFFER_SIZE);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+        ptrace(PTRACE_TRACEME, 0, 0, 0);
+        raise(SIGSTOP);
+        _exit(0);
+    }
+    waitpid(pid, NULL, 0);
+    ptrace(PTRACE_SETOPTIONS, pid, NULL, PTRACE_O_EXITKILL);
+    int mem_fd = TinyDbg_memory_open(pid);
+
+    size_t chunks[] = { 8, 4096, 1024 * 1024 };
+    for (int backend = TinyDbg_memory_backend_proc_mem; backend <= TinyDbg_memory_backend_ptrace; backend++) {
+        for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+            run(pid, mem_fd, backend, buffer, chunks[i], false);
+            run(pid, mem_fd, backend, buffer, chunks[i], true);
+        }
+    }
+
+    // writing to read-only text is what breakpoints need
+    for (int backend = TinyDbg_memory_backend_proc_mem; backend <= TinyDbg_memory_backend_ptrace; backend++) {
+        char original;
+        TinyDbg_memory_read(backend, pid, mem_fd, &original, (uintptr_t)&main, 1);
+        bool writable = TinyDbg_memory_write(backend, pid, mem_fd, &original, (uintptr_t)&main, 1) == 1;
+        printf("%-10s write to text: %s\n", backend_names[backend], writable ? "ok" : "failed");
+    }
+
+    close(mem_fd);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+    free(buffer);
+    return 0;
+}
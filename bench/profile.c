@@ -0,0 +1,90 @@
+// How much slower a busy process gets while it's profiled, at a few sampling rates. The process reports how long its
+// work took, which is compared with a run that isn't profiled, and the pauses the samples caused are shown with the
+// stacks that were found. It has to be built with frame pointers for the stacks to have more than one frame.
+#include "bench.h"
+
+#define WORK 300000000l
+
+__attribute__((noinline)) long inner(long i) {
+    return i * 7 + (i >> 3);
+}
+
+__attribute__((noinline)) long outer_a(long n) {
+    long sum = 0;
+    for (long i = 0; i < n; i++) sum += inner(i);
+    return sum;
+}
+
+__attribute__((noinline)) long outer_b(long n) {
+    long sum = 0;
+    for (long i = 0; i < n; i++) sum ^= inner(i) + i;
+    return sum;
+}
+
+// How long the process took for its work, as it measured it
+static double run(char *self, char **envp, unsigned int hz, bool show_stacks) {
+    int report[2];
+    pipe(report);
+    char fd_str[16];
+    sprintf(fd_str, "%d", report[1]);
+    char *child_argv[] = { self, fd_str, NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    close(report[1]);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    if (hz != 0) TinyDbg_profile_start(handle, hz);
+    EventQueue_join(TinyDbg_continue(handle));
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    TinyDbg_profile_stop(handle);
+    double elapsed = 0;
+    read(report[0], &elapsed, sizeof(elapsed));
+    close(report[0]);
+
+    if (hz != 0) {
+        TinyDbg_ProfileStats stats;
+        TinyDbg_profile_stats(handle, &stats);
+        printf("%5u Hz: %6.3f s, %6lu samples, %4lu missed, pause %6.1f us avg %6.1f us max, paused %5.2f%% of the time\n",
+               hz, elapsed, stats.samples, stats.missed, stats.samples != 0 ? stats.pause_total_ns / 1e3 / stats.samples : 0.0,
+               stats.pause_max_ns / 1e3, stats.elapsed_ns != 0 ? 100.0 * stats.pause_total_ns / stats.elapsed_ns : 0.0);
+    }
+    if (show_stacks) {
+        char *folded = TinyDbg_profile_folded(handle);
+        printf("%s", folded);
+        free(folded);
+    }
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+    return elapsed;
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process, which writes how long its work took to the pipe
+        double start = now();
+        volatile long sink = outer_a(WORK / 2) + outer_b(WORK / 2);
+        (void)sink;
+        double elapsed = now() - start;
+        write(atoi(argv[1]), &elapsed, sizeof(elapsed));
+        return 0;
+    }
+
+    // the best of a few, the first run is usually slower
+    double base = run(argv[0], envp, 0, false);
+    for (int i = 0; i < 2; i++) {
+        double elapsed = run(argv[0], envp, 0, false);
+        if (elapsed < base) base = elapsed;
+    }
+    printf("not profiled: %6.3f s\n", base);
+    unsigned int rates[] = { 100, 1000, 4000 };
+    for (size_t i = 0; i < sizeof(rates) / sizeof(rates[0]); i++) {
+        double elapsed = run(argv[0], envp, rates[i], i == 0);
+        printf("         %+6.2f%% slower\n", 100 * (elapsed - base) / base);
+    }
+    return 0;
+}
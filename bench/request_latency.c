@@ -0,0 +1,102 @@
+// Latency of reading the registers while the process runs - it has to be stopped and continued for every request.
+// The process either spins, competing for the CPU with the debugger, or sleeps in a loop.
+// It's stopped either with SIGSTOP, or with PTRACE_INTERRUPT (TINYDBG_FLAG_SEIZE).
+// Then the same for an inspection of 40 requests (the registers and 39 words of the stack), one request at a time,
+// or all of them in one batch that stops the process once.
+#include "bench.h"
+
+#define REQUESTS 2000
+#define INSPECTIONS 200
+#define INSPECTION_WORDS 39
+
+// CPU time the process got, in seconds
+static double process_cpu_time(pid_t pid) {
+    char path_str[32];
+    sprintf(path_str, "/proc/%d/stat", pid);
+    FILE *fp = fopen(path_str, "r");
+    unsigned long utime = 0, stime = 0;
+    if (fp != NULL) {
+        if (fscanf(fp, "%*d %*s %*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu", &utime, &stime) != 2) utime = stime = 0;
+        fclose(fp);
+    }
+    return (double)(utime + stime) / sysconf(_SC_CLK_TCK);
+}
+
+static void run(char *self, char *mode, char **envp, unsigned int flags) {
+    char *child_argv[] = { self, mode, NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, flags);
+    EventQueue_join(TinyDbg_continue(handle));
+
+    double *latencies = malloc(REQUESTS * sizeof(double));
+    struct user_regs_struct regs;
+    double start = now();
+    for (size_t i = 0; i < REQUESTS; i++) {
+        double t = now();
+        EventQueue_join(TinyDbg_get_registers(handle, &regs));
+        latencies[i] = now() - t;
+    }
+    double wall = now() - start;
+    double cpu = process_cpu_time(handle->pid);
+
+    double total = 0;
+    for (size_t i = 0; i < REQUESTS; i++) total += latencies[i];
+    qsort(latencies, REQUESTS, sizeof(double), compare_doubles);
+    printf("get registers while running (%-5s, %-7s), %d requests: mean %7.1f us, p50 %6.1f us, p99 %7.1f us, max %8.1f us, process got %3.0f%% of the time\n",
+           mode, flags & TINYDBG_FLAG_SEIZE ? "seize" : "sigstop", REQUESTS, total / REQUESTS * 1e6, latencies[REQUESTS / 2] * 1e6, latencies[REQUESTS * 99 / 100] * 1e6,
+           latencies[REQUESTS - 1] * 1e6, cpu / wall * 100);
+
+    free(latencies);
+    TinyDbg_free(handle);
+}
+
+static void run_inspections(char *self, char *mode, char **envp, unsigned int flags, bool batched) {
+    char *child_argv[] = { self, mode, NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, flags);
+    struct user_regs_struct regs;
+    EventQueue_join(TinyDbg_get_registers(handle, &regs));
+    uintptr_t stack = regs.rsp;
+    EventQueue_join(TinyDbg_continue(handle));
+
+    uint64_t words[INSPECTION_WORDS];
+    double start = now();
+    for (size_t i = 0; i < INSPECTIONS; i++) {
+        if (batched) TinyDbg_batch_begin(handle);
+        EventQueue_JoinHandle *joined = TinyDbg_get_registers(handle, &regs);
+        if (!batched) EventQueue_join(joined);
+        for (size_t j = 0; j < INSPECTION_WORDS; j++) {
+            struct iovec local = { &words[j], sizeof(uint64_t) };
+            struct iovec remote = { (void *)(stack + j * sizeof(uint64_t)), sizeof(uint64_t) };
+            joined = TinyDbg_get_memory(handle, local, remote);
+            if (!batched) EventQueue_join(joined);
+        }
+        if (batched) EventQueue_join(TinyDbg_batch_submit(handle));
+    }
+    double wall = now() - start;
+
+    printf("inspect while running  (%-5s, %-7s), %-10s: mean %8.1f us per %d requests\n", mode, flags & TINYDBG_FLAG_SEIZE ? "seize" : "sigstop",
+           batched ? "batched" : "one by one", wall / INSPECTIONS * 1e6, INSPECTION_WORDS + 1);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process, it runs until it's killed
+        if (strcmp(argv[1], "spin") == 0) {
+            volatile unsigned long counter = 0;
+            while (true) counter++;
+        }
+        while (true) usleep(1000);
+    }
+
+    run(argv[0], "spin", envp, 0);
+    run(argv[0], "spin", envp, TINYDBG_FLAG_SEIZE);
+    run(argv[0], "sleep", envp, 0);
+    run(argv[0], "sleep", envp, TINYDBG_FLAG_SEIZE);
+    for (int batched = 0; batched < 2; batched++) {
+        run_inspections(argv[0], "spin", envp, 0, batched);
+        run_inspections(argv[0], "spin", envp, TINYDBG_FLAG_SEIZE, batched);
+        run_inspections(argv[0], "sleep", envp, 0, batched);
+        run_inspections(argv[0], "sleep", envp, TINYDBG_FLAG_SEIZE, batched);
+    }
+    return 0;
+}
@@ -0,0 +1,79 @@
+// Where the debugger's time goes while a client stops on a breakpoint many times and reads the registers and some memory
+// at each stop, from the stats the process manager keeps - and how much keeping them costs compared to the whole run.
+#include "bench.h"
+
+#define CALLS 20000
+
+__attribute__((noinline)) void hot(long i) {
+    asm volatile("" :: "r"(i));
+}
+
+static void print_histogram(const char *name, const TinyDbg_Histogram *histogram) {
+    printf("%-20s %8lu samples, mean %7.1f us, p50 %7.1f us, p99 %7.1f us, max %8.1f us\n", name, histogram->count,
+           histogram->count == 0 ? 0 : (double)histogram->sum / histogram->count / 1e3,
+           TinyDbg_Histogram_percentile(histogram, 50) / 1e3, TinyDbg_Histogram_percentile(histogram, 99) / 1e3,
+           histogram->max / 1e3);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        for (long i = 0; i < CALLS; i++) hot(i);
+        return 0;
+    }
+
+    char *child_argv[] = { argv[0], "child", NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    uintptr_t position = TinyDbg_lookup_symbol(handle, "hot");
+    EventQueue_join(TinyDbg_set_breakpoint(handle, position, false));
+    EventQueue_join(TinyDbg_reset_stats(handle));
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        if (event->type == TinyDbg_event_type_breakpoint) {
+            struct user_regs_struct regs;
+            uint64_t word;
+            EventQueue_join(TinyDbg_thread_get_registers(handle, event->tid, &regs));
+            struct iovec local = { &word, sizeof(word) }, remote = { (void *)regs.rsp, sizeof(word) };
+            EventQueue_join(TinyDbg_get_memory(handle, local, remote));
+        }
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+
+    TinyDbg_Stats *stats = malloc(sizeof(TinyDbg_Stats));
+    TinyDbg_get_stats(handle, stats);
+    printf("%d calls in %.3f s\n", CALLS, elapsed);
+    print_histogram("queue wait", &stats->queue_wait);
+    print_histogram("stop", &stats->stop);
+    print_histogram("ptrace call", &stats->ptrace_call);
+    print_histogram("hit to event", &stats->hit_to_event);
+    print_histogram("event to continue", &stats->event_to_continue);
+    for (size_t i = 0; i <= TINYDBG_REQUEST_TYPES; i++) {
+        if (i < TINYDBG_REQUEST_TYPES && stats->requests[i] == 0 && stats->ptrace_calls[i] == 0) continue;
+        if (i == TINYDBG_REQUEST_TYPES) {
+            printf("handling stops       %8lu ptrace calls\n", stats->ptrace_calls[i]);
+        } else {
+            printf("request type %-7zu %8lu requests, %8lu ptrace calls\n", i, stats->requests[i], stats->ptrace_calls[i]);
+        }
+    }
+
+    // the clock is read twice per ptrace call and a few times per request
+    uint64_t clock_reads = 2 * stats->ptrace_call.count + 4 * stats->queue_wait.count;
+    double clock_start = now();
+    for (uint64_t i = 0; i < clock_reads; i++) now();
+    printf("%lu clock reads take %.3f ms, %.3f%% of the run\n", clock_reads, (now() - clock_start) * 1e3,
+           (now() - clock_start) / elapsed * 100);
+
+    free(stats);
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+    return 0;
+}
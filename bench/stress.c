@@ -0,0 +1,285 @@
+// The debugger under load, to tell when a change makes it slower: breakpoint hits and syscall stops per second, the
+// latency of reading registers and memory while the process runs and while it's stopped, how long arming and disarming
+// N breakpoints takes, and how long the mappings take to parse. The debugged process is this program, and does the same
+// work every run. Every result is a line of JSON on stdout, e.g.
+//   {"bench": "breakpoint_hits", "threads": 4, "mode": "all_stop", "hits": 20000, "seconds": 0.812, "per_second": 24630}
+// Run only some of them by name: bench_stress hits syscalls latency arm maps
+#include "bench.h"
+
+#define CALLS 20000                     // hits of the breakpoint, split between the threads
+#define SYSCALLS 20000                  // getppid calls, each one stops at its entry and exit
+#define REQUESTS 2000                   // of each kind, for the latencies
+#define HEAP_ADDRESS 0x200000000000ul   // the same in every run, so the breakpoints and reads are at the same places
+#define HEAP_BYTES (64l << 20)
+#define MAPPINGS 2000                   // that can't be merged, since every other one is writable
+#define MAP_READS 200
+#define ARM_SPACING 64                  // bytes between the breakpoints that are armed, in the heap
+#define ARM_MAX 100000
+
+/* the debugged process */
+
+__attribute__((noinline)) void hot(long i) {
+    asm volatile("" :: "r"(i));
+}
+
+// Called once the process is set up - the debugger stops it here before measuring
+__attribute__((noinline)) void ready(void) {
+    asm volatile("");
+}
+
+static void *calls(void *arg) {
+    long len = (long)arg;
+    for (long i = 0; i < len; i++) hot(i);
+    return NULL;
+}
+
+static void *spin(void *arg) {
+    volatile uint64_t *counter = arg;
+    while (true) (*counter)++;
+    return NULL;
+}
+
+static void tracee(char **argv) {
+    if (strcmp(argv[0], "hot") == 0) {
+        int threads = atoi(argv[1]);
+        pthread_t thread_ids[threads];
+        for (int i = 0; i < threads; i++) pthread_create(&thread_ids[i], NULL, calls, (void *)(long)(CALLS / threads));
+        for (int i = 0; i < threads; i++) pthread_join(thread_ids[i], NULL);
+    } else if (strcmp(argv[0], "syscalls") == 0) {
+        for (long i = 0; i < SYSCALLS; i++) getppid();
+    } else if (strcmp(argv[0], "workers") == 0) {
+        // a large heap that's all in memory, a lot of mappings, and worker threads that spin while the main one sleeps
+        char *heap = mmap((void *)HEAP_ADDRESS, HEAP_BYTES, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+        if (heap == MAP_FAILED) exit(1);
+        for (long i = 0; i < HEAP_BYTES; i += 8) *(uint64_t *)(heap + i) = i;
+        char *area = mmap(NULL, MAPPINGS * 4096l, PROT_READ, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        for (long i = 0; i < MAPPINGS; i += 2) mprotect(area + i * 4096, 4096, PROT_READ | PROT_WRITE);
+        int workers = atoi(argv[1]);
+        pthread_t thread_id;
+        for (int i = 0; i < workers; i++) pthread_create(&thread_id, NULL, spin, heap + i * 4096);
+        ready();
+        while (true) usleep(1000);
+    }
+}
+
+/* the debugger */
+
+static TinyDbg *start(char *self, char **envp, const char *mode, int threads, unsigned int flags) {
+    char threads_str[8];
+    sprintf(threads_str, "%d", threads);
+    char *child_argv[] = { self, "tracee", (char *)mode, threads_str, NULL };
+    return TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, flags);
+}
+
+// Continues until the workers are set up, and leaves them stopped
+static TinyDbg *start_workers(char *self, char **envp, int workers) {
+    TinyDbg *handle = start(self, envp, "workers", workers, 0);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    EventQueue_join(TinyDbg_set_breakpoint(handle, TinyDbg_lookup_symbol(handle, "ready"), true));
+    EventQueue_join(TinyDbg_continue(handle));
+    TinyDbg_Event *event;
+    EventQueue_consume(consumer, (void **)&event);
+    if (event->type != TinyDbg_event_type_breakpoint) {
+        fprintf(stderr, "the workers didn't get ready, event %d\n", event->type);
+        exit(1);
+    }
+    TinyDbg_Event_free(event);
+    EventQueue_destroy_consumer(consumer);
+    return handle;
+}
+
+static void hits(char *self, char **envp, int threads, bool non_stop) {
+    TinyDbg *handle = start(self, envp, "hot", threads, non_stop ? TINYDBG_FLAG_NON_STOP : 0);
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    EventQueue_join(TinyDbg_set_breakpoint(handle, TinyDbg_lookup_symbol(handle, "hot"), false));
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    size_t events = 0;
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        pid_t tid = event->tid;
+        if (event->type == TinyDbg_event_type_breakpoint) events++;
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(non_stop ? TinyDbg_thread_continue(handle, tid) : TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+    printf("{\"bench\": \"breakpoint_hits\", \"threads\": %d, \"mode\": \"%s\", \"hits\": %zu, \"seconds\": %.6f, \"per_second\": %.0f}\n",
+           threads, non_stop ? "non_stop" : "all_stop", events, elapsed, events / elapsed);
+
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+static void syscall_stops(char *self, char **envp, bool filtered) {
+    char *child_argv[] = { self, "tracee", "syscalls", NULL };
+    int syscalls[] = { SYS_getppid };
+    TinyDbg *handle;
+    if (filtered) {
+        handle = TinyDbg_start_syscall_filtered("/proc/self/exe", child_argv, envp, 0, syscalls, 1);
+        EventQueue_join(TinyDbg_stop_on_syscall(handle));
+    } else {
+        handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+        EventQueue_join(TinyDbg_stop_on_syscalls(handle, syscalls, 1));
+    }
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    size_t stops = 0;
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        if (event->type == TinyDbg_event_type_syscall) stops++;
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+    printf("{\"bench\": \"syscall_stops\", \"filter\": \"%s\", \"stops\": %zu, \"seconds\": %.6f, \"per_second\": %.0f}\n",
+           filtered ? "seccomp" : "ptrace", stops, elapsed, stops / elapsed);
+
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+static void print_latency(const char *request, size_t bytes, int workers, bool running, double *latencies) {
+    double total = 0;
+    for (size_t i = 0; i < REQUESTS; i++) total += latencies[i];
+    qsort(latencies, REQUESTS, sizeof(double), compare_doubles);
+    printf("{\"bench\": \"latency\", \"request\": \"%s\", \"bytes\": %zu, \"workers\": %d, \"process\": \"%s\", \"requests\": %d, "
+           "\"mean_ns\": %.0f, \"p50_ns\": %.0f, \"p99_ns\": %.0f, \"max_ns\": %.0f}\n", request, bytes, workers,
+           running ? "running" : "stopped", REQUESTS, total / REQUESTS * 1e9, latencies[REQUESTS / 2] * 1e9,
+           latencies[REQUESTS * 99 / 100] * 1e9, latencies[REQUESTS - 1] * 1e9);
+}
+
+// Requests one at a time, each of them stops the process first if it's running and continues it after
+static void latency(char *self, char **envp, int workers, bool running) {
+    TinyDbg *handle = start_workers(self, envp, workers);
+    if (running) EventQueue_join(TinyDbg_continue(handle));
+
+    double *latencies = malloc(REQUESTS * sizeof(double));
+    struct user_regs_struct regs;
+    for (size_t i = 0; i < REQUESTS; i++) {
+        double t = now();
+        EventQueue_join(TinyDbg_get_registers(handle, &regs));
+        latencies[i] = now() - t;
+    }
+    print_latency("get_regs", sizeof(regs), workers, running, latencies);
+
+    size_t sizes[] = { 8, 4096, 1 << 20 };
+    char *buffer = malloc(1 << 20);
+    for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+        for (size_t j = 0; j < REQUESTS; j++) {
+            // a different page every time, so no cache has it
+            uintptr_t address = HEAP_ADDRESS + (j * 4096 * 17) % (HEAP_BYTES - sizes[i]);
+            struct iovec local = { buffer, sizes[i] }, remote = { (void *)address, sizes[i] };
+            double t = now();
+            EventQueue_join(TinyDbg_get_memory(handle, local, remote));
+            latencies[j] = now() - t;
+        }
+        print_latency("get_mem", sizes[i], workers, running, latencies);
+    }
+
+    free(buffer);
+    free(latencies);
+    TinyDbg_free(handle);
+}
+
+// Arming breakpoints in a stopped process, all in one request and one request each (which goes up to 10000)
+static void arm(char *self, char **envp) {
+    TinyDbg *handle = start_workers(self, envp, 1);
+    uintptr_t *positions = malloc(ARM_MAX * sizeof(uintptr_t));
+    for (size_t i = 0; i < ARM_MAX; i++) positions[i] = HEAP_ADDRESS + i * ARM_SPACING;
+    // the first write to the process opens its memory, which isn't what's measured
+    EventQueue_join(TinyDbg_set_breakpoint(handle, positions[0], false));
+    EventQueue_join(TinyDbg_unset_breakpoint(handle, positions[0]));
+
+    for (size_t n = 10; n <= ARM_MAX; n *= 10) {
+        double start = now();
+        EventQueue_join(TinyDbg_set_breakpoints(handle, positions, n, false, NULL));
+        double armed = now() - start;
+        start = now();
+        EventQueue_join(TinyDbg_unset_breakpoints(handle, positions, n));
+        double disarmed = now() - start;
+        printf("{\"bench\": \"arm\", \"requests\": \"one\", \"breakpoints\": %zu, \"arm_seconds\": %.6f, \"disarm_seconds\": %.6f, "
+               "\"arm_ns_each\": %.0f}\n", n, armed, disarmed, armed / n * 1e9);
+
+        if (n > 10000) continue;
+        start = now();
+        for (size_t i = 0; i < n; i++) EventQueue_detach(TinyDbg_set_breakpoint(handle, positions[i], false));
+        EventQueue_join(TinyDbg_stop(handle));  // done after all of them
+        armed = now() - start;
+        start = now();
+        for (size_t i = 0; i < n; i++) EventQueue_detach(TinyDbg_unset_breakpoint(handle, positions[i]));
+        EventQueue_join(TinyDbg_stop(handle));
+        disarmed = now() - start;
+        printf("{\"bench\": \"arm\", \"requests\": \"each\", \"breakpoints\": %zu, \"arm_seconds\": %.6f, \"disarm_seconds\": %.6f, "
+               "\"arm_ns_each\": %.0f}\n", n, armed, disarmed, armed / n * 1e9);
+    }
+
+    free(positions);
+    TinyDbg_free(handle);
+}
+
+// Parsing /proc/pid/maps into the map table again, and copying the mappings out of it
+static void maps(char *self, char **envp) {
+    TinyDbg *handle = start_workers(self, envp, 1);
+    TinyDbg_memory_map map;
+    double start = now();
+    for (int i = 0; i < MAP_READS; i++) {
+        TinyDbg_MapTable_invalidate(&handle->maps);
+        TinyDbg_find_map(handle, 0, &map);
+    }
+    double parsed = now() - start;
+
+    size_t len = 0;
+    start = now();
+    for (int i = 0; i < MAP_READS; i++) {
+        TinyDbg_MapTable_invalidate(&handle->maps);
+        free(TinyDbg_get_memory_maps(handle, &len));
+    }
+    double copied = now() - start;
+    printf("{\"bench\": \"maps\", \"mappings\": %zu, \"reads\": %d, \"parse_ns\": %.0f, \"get_memory_maps_ns\": %.0f}\n",
+           len, MAP_READS, parsed / MAP_READS * 1e9, copied / MAP_READS * 1e9);
+    TinyDbg_free(handle);
+}
+
+static bool selected(int argc, char **argv, const char *name) {
+    if (argc == 1) return true;
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], name) == 0) return true;
+    }
+    return false;
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 2 && strcmp(argv[1], "tracee") == 0) {
+        tracee(argv + 2);
+        return 0;
+    }
+
+    if (selected(argc, argv, "hits")) {
+        hits(argv[0], envp, 1, false);
+        hits(argv[0], envp, 4, false);
+        hits(argv[0], envp, 1, true);
+        hits(argv[0], envp, 4, true);
+    }
+    if (selected(argc, argv, "syscalls")) {
+        syscall_stops(argv[0], envp, false);
+        syscall_stops(argv[0], envp, true);
+    }
+    if (selected(argc, argv, "latency")) {
+        latency(argv[0], envp, 1, false);
+        latency(argv[0], envp, 1, true);
+        latency(argv[0], envp, 4, false);
+        latency(argv[0], envp, 4, true);
+    }
+    if (selected(argc, argv, "arm")) arm(argv[0], envp);
+    if (selected(argc, argv, "maps")) maps(argv[0], envp);
+    return 0;
+}
@@ -0,0 +1,68 @@
+// How long it takes to read the symbols of libc the first time, and then how fast addresses in the mapped files of a
+// running process are symbolized and names are looked up.
+#include "bench.h"
+
+#define SAMPLES 1000000
+#define LOOKUPS 100000
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process, it runs until it's killed
+        while (true) usleep(1000);
+    }
+
+    char *child_argv[] = { argv[0], "child", NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    EventQueue_join(TinyDbg_continue(handle));
+    usleep(100000);  // until the libraries are loaded
+
+    double start = now();
+    uintptr_t write_address = TinyDbg_lookup_symbol(handle, "write");
+    double first_lookup = now() - start;
+    TinyDbg_Symbol symbol;
+    if (write_address == 0 || !TinyDbg_symbolize(handle, write_address, &symbol)) {
+        printf("can't find write in the process\n");
+        return 1;
+    }
+    printf("first lookup (reads the maps and the symbols of every file): %8.3f ms, %zu symbols in the file of write\n",
+           first_lookup * 1e3, symbol.file->symbols_len);
+
+    // addresses all over the mapped files
+    uintptr_t *samples = malloc(SAMPLES * sizeof(uintptr_t));
+    size_t files_len = 0;
+    for (size_t i = 0; i < handle->modules_len; i++) files_len += handle->modules[i].file != NULL;
+    unsigned int seed = 1;
+    for (size_t i = 0; i < SAMPLES; i++) {
+        size_t which = rand_r(&seed) % files_len;
+        TinyDbg_Module *module = NULL;
+        for (size_t j = 0; j < handle->modules_len; j++) {
+            if (handle->modules[j].file != NULL && which-- == 0) module = &handle->modules[j];
+        }
+        samples[i] = module->begin + rand_r(&seed) % (module->end - module->begin);
+    }
+
+    start = now();
+    size_t found = 0;
+    for (size_t i = 0; i < SAMPLES; i++) found += TinyDbg_symbolize(handle, samples[i], &symbol);
+    double elapsed = now() - start;
+    printf("symbolize: %d addresses in %6.3f s, %8.1f ns each, %zu in a symbol\n", SAMPLES, elapsed, elapsed / SAMPLES * 1e9, found);
+
+    const char *names[] = { "write", "read", "malloc", "printf", "main", "pthread_create" };
+    size_t names_len = sizeof(names) / sizeof(names[0]);
+    start = now();
+    found = 0;
+    for (size_t i = 0; i < LOOKUPS; i++) found += TinyDbg_lookup_symbol(handle, names[i % names_len]) != 0;
+    elapsed = now() - start;
+    printf("lookup:    %d names in %6.3f s, %8.1f ns each, %zu found\n", LOOKUPS, elapsed, elapsed / LOOKUPS * 1e9, found);
+
+    // a name that isn't found reads the maps again, in case a library with it was loaded
+    start = now();
+    for (size_t i = 0; i < LOOKUPS / 100; i++) TinyDbg_lookup_symbol(handle, "no_such_symbol");
+    elapsed = now() - start;
+    printf("lookup of a name that isn't there: %8.1f ns each\n", elapsed / (LOOKUPS / 100) * 1e9);
+
+    free(samples);
+    kill(handle->pid, SIGKILL);
+    TinyDbg_free(handle);
+    return 0;
+}
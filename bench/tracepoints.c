@@ -0,0 +1,115 @@
+// Hits per second of a probe on a function that's called in a loop. A breakpoint stops the process and sends an event for
+// every hit, while a tracepoint runs a trampoline in the process, which only counts the hit or records it in the ring.
+#include "bench.h"
+
+#define CALLS_BREAKPOINT 20000
+#define CALLS_TRACEPOINT 20000000
+
+typedef enum { probe_none, probe_breakpoint, probe_tracepoint_count, probe_tracepoint_record } probe_kind;
+static const char *probe_names[] = { "no probe", "breakpoint", "tracepoint, counting", "tracepoint, recording" };
+
+__attribute__((noinline)) long probe(long a, long b) {
+    return a * 3 + b;
+}
+
+// Where the executable is mapped, it's the first mapping
+static uintptr_t load_base(pid_t pid) {
+    char path_str[32];
+    sprintf(path_str, "/proc/%d/maps", pid);
+    FILE *fp = fopen(path_str, "r");
+    uintptr_t base = 0;
+    if (fp != NULL) {
+        if (fscanf(fp, "%lx", &base) != 1) base = 0;
+        fclose(fp);
+    }
+    return base;
+}
+
+struct reader_args {
+    TinyDbg *handle;
+    volatile bool done;
+    uint64_t read;
+    uint64_t lost;
+};
+
+static void *read_hits(void *arg) {
+    struct reader_args *args = arg;
+    TinyDbg_TracepointHit *hits = malloc(4096 * sizeof(TinyDbg_TracepointHit));
+    while (true) {
+        bool last = args->done;
+        size_t len = TinyDbg_read_tracepoint_hits(args->handle, hits, 4096, &args->lost);
+        args->read += len;
+        if (len == 0) {
+            if (last) break;
+            usleep(100);
+        }
+    }
+    free(hits);
+    return NULL;
+}
+
+static void run(char *self, char **envp, probe_kind kind) {
+    long calls = kind == probe_breakpoint ? CALLS_BREAKPOINT : CALLS_TRACEPOINT;
+    char calls_str[32];
+    sprintf(calls_str, "%ld", calls);
+    char *child_argv[] = { self, calls_str, NULL };
+    TinyDbg *handle = TinyDbg_start_advanced("/proc/self/exe", child_argv, envp, 0);
+    uintptr_t position = load_base(handle->pid) + ((uintptr_t)&probe - load_base(getpid()));
+
+    if (kind == probe_breakpoint) EventQueue_join(TinyDbg_set_breakpoint(handle, position, false));
+    if (kind == probe_tracepoint_count || kind == probe_tracepoint_record) {
+        bool placed = false;
+        EventQueue_join(TinyDbg_set_tracepoint(handle, position, kind == probe_tracepoint_record, &placed));
+        if (!placed) {
+            printf("%-22s: can't be placed on probe()\n", probe_names[kind]);
+            TinyDbg_free(handle);
+            return;
+        }
+    }
+    struct reader_args reader = { handle, false, 0, 0 };
+    pthread_t reader_thread;
+    if (kind == probe_tracepoint_record) pthread_create(&reader_thread, NULL, read_hits, &reader);
+
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    double start = now();
+    EventQueue_join(TinyDbg_continue(handle));
+    long hits = 0;
+    while (true) {
+        TinyDbg_Event *event;
+        EventQueue_consume(consumer, (void **)&event);
+        bool exited = event->type == TinyDbg_event_type_exit;
+        if (event->type == TinyDbg_event_type_breakpoint) hits++;
+        TinyDbg_Event_free(event);
+        if (exited) break;
+        EventQueue_join(TinyDbg_continue(handle));
+    }
+    double elapsed = now() - start;
+    if (kind == probe_tracepoint_count || kind == probe_tracepoint_record) hits = TinyDbg_tracepoint_hit_count(handle, position);
+
+    printf("%-22s: %9ld calls in %6.3f s, %12.0f calls/s", probe_names[kind], calls, elapsed, calls / elapsed);
+    if (kind != probe_none) printf(", %9ld hits", hits);
+    if (kind == probe_tracepoint_record) {
+        reader.done = true;
+        pthread_join(reader_thread, NULL);
+        printf(", %9lu read, %9lu lost", reader.read, reader.lost);
+    }
+    printf("\n");
+    EventQueue_destroy_consumer(consumer);
+    TinyDbg_free(handle);
+}
+
+int main(int argc, char **argv, char **envp) {
+    if (argc > 1) {
+        // the debugged process
+        volatile long sink = 0;
+        long calls = atol(argv[1]);
+        for (long i = 0; i < calls; i++) sink += probe(i, 1);
+        return 0;
+    }
+
+    run(argv[0], envp, probe_none);
+    run(argv[0], envp, probe_breakpoint);
+    run(argv[0], envp, probe_tracepoint_count);
+    run(argv[0], envp, probe_tracepoint_record);
+    return 0;
+}
@@ -1 +0,0 @@
-gcc -pthread -g src/debugger.c src/main.c event_queue_c/event_queue.c -o main
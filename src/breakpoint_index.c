@@ -0,0 +1,111 @@
+#include "debugger.h"
+
+#define INITIAL_SLOTS 16
+
+static size_t home_slot(TinyDbg_BreakpointIndex *index, uintptr_t position) {
+    // fibonacci hashing, breakpoint positions are often close together so they need to be spread out
+    return (size_t)(((uint64_t)position * 0x9E3779B97F4A7C15ull) >> 32) & index->slots_mask;
+}
+
+// returns the slot holding position, or the empty slot where it would go
+static TinyDbg_BreakpointIndex_slot *find_slot(TinyDbg_BreakpointIndex *index, uintptr_t position) {
+    size_t i = home_slot(index, position);
+    while (index->slots[i].position != 0 && index->slots[i].position != position) {
+        i = (i + 1) & index->slots_mask;
+    }
+    return &index->slots[i];
+}
+
+static void grow_slots(TinyDbg_BreakpointIndex *index) {
+    size_t slots_len = (index->slots_mask + 1) * 2;
+    free(index->slots);
+    index->slots = calloc(slots_len, sizeof(TinyDbg_BreakpointIndex_slot));
+    index->slots_mask = slots_len - 1;
+
+    // rehash everything from the dense array
+    for (size_t i = 0; i < index->len; i++) {
+        TinyDbg_BreakpointIndex_slot *slot = find_slot(index, index->breakpoints[i].position);
+        slot->position = index->breakpoints[i].position;
+        slot->index = i;
+    }
+}
+
+void TinyDbg_BreakpointIndex_init(TinyDbg_BreakpointIndex *index) {
+    index->breakpoints = NULL;
+    index->len = 0;
+    index->capacity = 0;
+    index->slots = calloc(INITIAL_SLOTS, sizeof(TinyDbg_BreakpointIndex_slot));
+    index->slots_mask = INITIAL_SLOTS - 1;
+}
+
+void TinyDbg_BreakpointIndex_destroy(TinyDbg_BreakpointIndex *index) {
+    for (size_t i = 0; i < index->len; i++) TinyDbg_Condition_free(index->breakpoints[i].condition);
+    free(index->breakpoints);
+    free(index->slots);
+}
+
+TinyDbg_Breakpoint *TinyDbg_BreakpointIndex_find(TinyDbg_BreakpointIndex *index, uintptr_t position) {
+    TinyDbg_BreakpointIndex_slot *slot = find_slot(index, position);
+    if (slot->position == 0) return NULL;
+    return &index->breakpoints[slot->index];
+}
+
+void TinyDbg_BreakpointIndex_insert(TinyDbg_BreakpointIndex *index, TinyDbg_Breakpoint breakpoint) {
+    TinyDbg_BreakpointIndex_slot *slot = find_slot(index, breakpoint.position);
+    if (slot->position != 0) {
+        if (index->breakpoints[slot->index].condition != breakpoint.condition) {
+            TinyDbg_Condition_free(index->breakpoints[slot->index].condition);
+        }
+        index->breakpoints[slot->index] = breakpoint;
+        return;
+    }
+
+    // keep the load factor under 3/4
+    if ((index->len + 1) * 4 > (index->slots_mask + 1) * 3) {
+        grow_slots(index);
+        slot = find_slot(index, breakpoint.position);
+    }
+    if (index->len == index->capacity) {
+        index->capacity = index->capacity == 0 ? INITIAL_SLOTS : index->capacity * 2;
+        index->breakpoints = realloc(index->breakpoints, index->capacity * sizeof(TinyDbg_Breakpoint));
+    }
+
+    slot->position = breakpoint.position;
+    slot->index = index->len;
+    index->breakpoints[index->len++] = breakpoint;
+}
+
+bool TinyDbg_BreakpointIndex_remove(TinyDbg_BreakpointIndex *index, uintptr_t position, TinyDbg_Breakpoint *removed) {
+    TinyDbg_BreakpointIndex_slot *slot = find_slot(index, position);
+    if (slot->position == 0) return false;
+
+    size_t removed_index = slot->index;
+    if (removed != NULL) {
+        *removed = index->breakpoints[removed_index];
+    } else {
+        TinyDbg_Condition_free(index->breakpoints[removed_index].condition);
+    }
+
+    // backward shift deletion, so there's no need for tombstones
+    size_t hole = slot - index->slots;
+    size_t i = hole;
+    while (true) {
+        i = (i + 1) & index->slots_mask;
+        if (index->slots[i].position == 0) break;
+        size_t home = home_slot(index, index->slots[i].position);
+        // move the entry back if the hole is between its home slot and where it is now
+        if (((i - home) & index->slots_mask) >= ((i - hole) & index->slots_mask)) {
+            index->slots[hole] = index->slots[i];
+            hole = i;
+        }
+    }
+    index->slots[hole].position = 0;
+
+    // move the last breakpoint into the hole in the dense array
+    size_t last = --index->len;
+    if (removed_index != last) {
+        index->breakpoints[removed_index] = index->breakpoints[last];
+        find_slot(index, index->breakpoints[removed_index].position)->index = removed_index;
+    }
+    return true;
+}
@@ -0,0 +1,326 @@
+#include "debugger.h"
+
+#define REGISTER(name) { #name, offsetof(struct user_regs_struct, name), false }
+#define LOW_REGISTER(name, of) { name, offsetof(struct user_regs_struct, of), true }
+
+static const struct {
+    const char *name;
+    size_t offset;
+    bool low;                   // only the low 32 bits
+} registers[] = {
+    REGISTER(r15), REGISTER(r14), REGISTER(r13), REGISTER(r12), REGISTER(rbp), REGISTER(rbx), REGISTER(r11),
+    REGISTER(r10), REGISTER(r9), REGISTER(r8), REGISTER(rax), REGISTER(rcx), REGISTER(rdx), REGISTER(rsi),
+    REGISTER(rdi), REGISTER(orig_rax), REGISTER(rip), REGISTER(cs), REGISTER(eflags), REGISTER(rsp), REGISTER(ss),
+    REGISTER(fs_base), REGISTER(gs_base), REGISTER(ds), REGISTER(es), REGISTER(fs), REGISTER(gs),
+    LOW_REGISTER("eax", rax), LOW_REGISTER("ebx", rbx), LOW_REGISTER("ecx", rcx), LOW_REGISTER("edx", rdx),
+    LOW_REGISTER("esi", rsi), LOW_REGISTER("edi", rdi), LOW_REGISTER("ebp", rbp), LOW_REGISTER("esp", rsp),
+    LOW_REGISTER("r8d", r8), LOW_REGISTER("r9d", r9), LOW_REGISTER("r10d", r10), LOW_REGISTER("r11d", r11),
+    LOW_REGISTER("r12d", r12), LOW_REGISTER("r13d", r13), LOW_REGISTER("r14d", r14), LOW_REGISTER("r15d", r15),
+};
+
+// Longer ones first, so that "<" doesn't match the start of "<<"
+static const struct {
+    const char *text;
+    int precedence;
+    TinyDbg_condition_op op;    // the jumps for || and &&
+} binary_ops[] = {
+    { "||", 1, TinyDbg_condition_op_jump_if_not_zero }, { "&&", 2, TinyDbg_condition_op_jump_if_zero },
+    { "==", 6, TinyDbg_condition_op_eq }, { "!=", 6, TinyDbg_condition_op_ne },
+    { "<<", 8, TinyDbg_condition_op_shl }, { ">>", 8, TinyDbg_condition_op_shr },
+    { "<=", 7, TinyDbg_condition_op_le }, { ">=", 7, TinyDbg_condition_op_ge },
+    { "|", 3, TinyDbg_condition_op_or }, { "^", 4, TinyDbg_condition_op_xor }, { "&", 5, TinyDbg_condition_op_and },
+    { "<", 7, TinyDbg_condition_op_lt }, { ">", 7, TinyDbg_condition_op_gt },
+    { "+", 9, TinyDbg_condition_op_add }, { "-", 9, TinyDbg_condition_op_sub }, { "*", 10, TinyDbg_condition_op_mul },
+};
+
+#define UNARY_PRECEDENCE 11        // higher than any binary operator
+
+struct compiler {
+    const char *p;
+    const char *error;          // where it went wrong, NULL until then
+    TinyDbg_ConditionInstruction code[TINYDBG_CONDITION_MAX_CODE];
+    size_t len;
+    int depth;                  // of the stack after the code so far, when the jumps aren't taken
+};
+
+static void fail(struct compiler *c, const char *at) {
+    if (c->error == NULL) c->error = at;
+}
+
+static size_t emit(struct compiler *c, TinyDbg_condition_op op, uint64_t operand) {
+    if (c->len == TINYDBG_CONDITION_MAX_CODE) {
+        fail(c, c->p);
+        return 0;
+    }
+    c->code[c->len].op = op;
+    c->code[c->len].operand = operand;
+    if (op == TinyDbg_condition_op_const || op == TinyDbg_condition_op_reg) {
+        if (++c->depth > TINYDBG_CONDITION_MAX_STACK) fail(c, c->p);
+    } else if (op != TinyDbg_condition_op_load && op != TinyDbg_condition_op_sext && op != TinyDbg_condition_op_not
+               && op != TinyDbg_condition_op_neg && op != TinyDbg_condition_op_bit_not) {
+        c->depth--;
+    }
+    return c->len++;
+}
+
+static void skip_spaces(struct compiler *c) {
+    while (*c->p == ' ' || *c->p == '\t' || *c->p == '\n') c->p++;
+}
+
+static bool accept(struct compiler *c, char token) {
+    skip_spaces(c);
+    if (*c->p != token) return false;
+    c->p++;
+    return true;
+}
+
+static void expect(struct compiler *c, char token) {
+    if (!accept(c, token)) fail(c, c->p);
+}
+
+static bool is_name_char(char x) {
+    return (x >= 'a' && x <= 'z') || (x >= '0' && x <= '9') || x == '_';
+}
+
+// How many bits u8, s16, ... are, 0 if it's not one of them
+static int width_of(const char *name, size_t len, bool *is_signed) {
+    if (len < 2 || (name[0] != 'u' && name[0] != 's')) return 0;
+    *is_signed = name[0] == 's';
+    if (len == 2 && name[1] == '8') return 8;
+    if (len == 3 && strncmp(name + 1, "16", 2) == 0) return 16;
+    if (len == 3 && strncmp(name + 1, "32", 2) == 0) return 32;
+    if (len == 3 && strncmp(name + 1, "64", 2) == 0) return 64;
+    return 0;
+}
+
+// An operand, which is a value, a unary operator on an operand or an expression in brackets - then the binary operators
+// with at least this precedence, by precedence climbing. Every binary operator is left associative.
+static void parse(struct compiler *c, int min_precedence) {
+    skip_spaces(c);
+    const char *start = c->p;
+    if (accept(c, '!')) {
+        parse(c, UNARY_PRECEDENCE);
+        emit(c, TinyDbg_condition_op_not, 0);
+    } else if (accept(c, '-')) {
+        parse(c, UNARY_PRECEDENCE);
+        emit(c, TinyDbg_condition_op_neg, 0);
+    } else if (accept(c, '~')) {
+        parse(c, UNARY_PRECEDENCE);
+        emit(c, TinyDbg_condition_op_bit_not, 0);
+    } else if (accept(c, '(')) {
+        parse(c, 1);
+        expect(c, ')');
+    } else if (*c->p >= '0' && *c->p <= '9') {
+        char *end;
+        errno = 0;
+        unsigned long long value = strtoull(c->p, &end, 0);
+        if (errno != 0 || is_name_char(*end)) fail(c, start);
+        c->p = end;
+        emit(c, TinyDbg_condition_op_const, value);
+    } else if (is_name_char(*c->p)) {
+        while (is_name_char(*c->p)) c->p++;
+        size_t len = c->p - start;
+        bool is_signed = false;
+        int width = width_of(start, len, &is_signed);
+        size_t i = 0;
+        size_t registers_len = sizeof(registers) / sizeof(registers[0]);
+        if (width != 0 && accept(c, '[')) {
+            parse(c, 1);
+            expect(c, ']');
+            emit(c, TinyDbg_condition_op_load, width / 8);
+            if (is_signed && width != 64) emit(c, TinyDbg_condition_op_sext, width);
+        } else if (width != 0 && width != 64 && is_signed && accept(c, '(')) {
+            parse(c, 1);
+            expect(c, ')');
+            emit(c, TinyDbg_condition_op_sext, width);
+        } else {
+            while (i < registers_len && (strlen(registers[i].name) != len || strncmp(registers[i].name, start, len) != 0)) i++;
+            if (i == registers_len) {
+                fail(c, start);
+                return;
+            }
+            emit(c, TinyDbg_condition_op_reg, registers[i].offset);
+            if (registers[i].low) {
+                emit(c, TinyDbg_condition_op_const, 0xffffffff);
+                emit(c, TinyDbg_condition_op_and, 0);
+            }
+        }
+    } else {
+        fail(c, start);
+    }
+
+    while (c->error == NULL) {
+        skip_spaces(c);
+        size_t i = 0;
+        size_t ops_len = sizeof(binary_ops) / sizeof(binary_ops[0]);
+        while (i < ops_len && strncmp(c->p, binary_ops[i].text, strlen(binary_ops[i].text)) != 0) i++;
+        if (i == ops_len || binary_ops[i].precedence < min_precedence) return;
+        c->p += strlen(binary_ops[i].text);
+
+        TinyDbg_condition_op op = binary_ops[i].op;
+        if (op == TinyDbg_condition_op_jump_if_zero || op == TinyDbg_condition_op_jump_if_not_zero) {
+            // the right side only runs when it matters, so it can read memory that the left side checked.
+            // The result is 0 or 1, like in C.
+            if (op == TinyDbg_condition_op_jump_if_not_zero) {
+                emit(c, TinyDbg_condition_op_not, 0);
+                emit(c, TinyDbg_condition_op_not, 0);
+            }
+            size_t jump = emit(c, op, 0);
+            parse(c, binary_ops[i].precedence + 1);
+            emit(c, TinyDbg_condition_op_not, 0);
+            emit(c, TinyDbg_condition_op_not, 0);
+            c->code[jump].operand = c->len - jump - 1;
+        } else {
+            parse(c, binary_ops[i].precedence + 1);
+            emit(c, op, 0);
+        }
+    }
+}
+
+TinyDbg_Condition *TinyDbg_Condition_compile(const char *source, size_t *error_at) {
+    struct compiler *c = malloc(sizeof(struct compiler));
+    c->p = source;
+    c->error = NULL;
+    c->len = 0;
+    c->depth = 0;
+    parse(c, 1);
+    skip_spaces(c);
+    if (*c->p != '\0') fail(c, c->p);
+
+    TinyDbg_Condition *condition = NULL;
+    if (c->error == NULL) {
+        condition = malloc(sizeof(TinyDbg_Condition) + c->len * sizeof(TinyDbg_ConditionInstruction));
+        condition->len = c->len;
+        memcpy(condition->code, c->code, c->len * sizeof(TinyDbg_ConditionInstruction));
+    }
+    if (condition == NULL && error_at != NULL) *error_at = c->error - source;
+    free(c);
+    return condition;
+}
+
+bool TinyDbg_Condition_verify(const TinyDbg_Condition *condition) {
+    if (condition->len == 0 || condition->len > TINYDBG_CONDITION_MAX_CODE) return false;
+    // there are only forward jumps, so every instruction is reached from the one before it and maybe from jumps -
+    // the depth has to be the same whichever way it's reached
+    int depth_at[TINYDBG_CONDITION_MAX_CODE + 1];
+    for (size_t i = 0; i <= condition->len; i++) depth_at[i] = -1;
+    int depth = 0;
+    for (size_t i = 0; i < condition->len; i++) {
+        if (depth_at[i] != -1 && depth_at[i] != depth) return false;
+        const TinyDbg_ConditionInstruction *instruction = &condition->code[i];
+        uint64_t operand = instruction->operand;
+        switch (instruction->op) {
+        case TinyDbg_condition_op_const:
+            depth++;
+            break;
+        case TinyDbg_condition_op_reg:
+            if (operand % sizeof(unsigned long long) != 0 || operand >= sizeof(struct user_regs_struct)) return false;
+            depth++;
+            break;
+        case TinyDbg_condition_op_load:
+            if (depth < 1 || (operand != 1 && operand != 2 && operand != 4 && operand != 8)) return false;
+            break;
+        case TinyDbg_condition_op_sext:
+            if (depth < 1 || operand == 0 || operand >= 64) return false;
+            break;
+        case TinyDbg_condition_op_not:
+        case TinyDbg_condition_op_neg:
+        case TinyDbg_condition_op_bit_not:
+            if (depth < 1) return false;
+            break;
+        case TinyDbg_condition_op_jump_if_zero:
+        case TinyDbg_condition_op_jump_if_not_zero:
+            if (depth < 1 || operand > condition->len - i - 1) return false;
+            if (depth_at[i + 1 + operand] != -1 && depth_at[i + 1 + operand] != depth) return false;
+            depth_at[i + 1 + operand] = depth;
+            depth--;
+            break;
+        default:
+            if (instruction->op < TinyDbg_condition_op_add || instruction->op > TinyDbg_condition_op_ge || depth < 2) return false;
+            depth--;
+        }
+        if (depth > TINYDBG_CONDITION_MAX_STACK) return false;
+    }
+    return (depth_at[condition->len] == -1 || depth_at[condition->len] == depth) && depth == 1;
+}
+
+TinyDbg_Condition *TinyDbg_Condition_copy(const TinyDbg_Condition *condition) {
+    if (condition == NULL) return NULL;
+    size_t size = sizeof(TinyDbg_Condition) + condition->len * sizeof(TinyDbg_ConditionInstruction);
+    TinyDbg_Condition *copy = malloc(size);
+    memcpy(copy, condition, size);
+    return copy;
+}
+
+void TinyDbg_Condition_free(TinyDbg_Condition *condition) {
+    free(condition);
+}
+
+static uint64_t binary(TinyDbg_condition_op op, uint64_t a, uint64_t b) {
+    switch (op) {
+    case TinyDbg_condition_op_add: return a + b;
+    case TinyDbg_condition_op_sub: return a - b;
+    case TinyDbg_condition_op_mul: return a * b;
+    case TinyDbg_condition_op_and: return a & b;
+    case TinyDbg_condition_op_or: return a | b;
+    case TinyDbg_condition_op_xor: return a ^ b;
+    case TinyDbg_condition_op_shl: return a << (b & 63);
+    case TinyDbg_condition_op_shr: return a >> (b & 63);
+    case TinyDbg_condition_op_eq: return a == b;
+    case TinyDbg_condition_op_ne: return a != b;
+    case TinyDbg_condition_op_lt: return (int64_t)a < (int64_t)b;
+    case TinyDbg_condition_op_le: return (int64_t)a <= (int64_t)b;
+    case TinyDbg_condition_op_gt: return (int64_t)a > (int64_t)b;
+    default: return (int64_t)a >= (int64_t)b;
+    }
+}
+
+int TinyDbg_Condition_eval(const TinyDbg_Condition *condition, const struct user_regs_struct *regs,
+                           TinyDbg_Condition_reader read, void *arg) {
+    // it was verified, so the stack is never indexed out of bounds
+    uint64_t stack[TINYDBG_CONDITION_MAX_STACK];
+    size_t top = 0;
+    for (size_t i = 0; i < condition->len; i++) {
+        const TinyDbg_ConditionInstruction *instruction = &condition->code[i];
+        switch (instruction->op) {
+        case TinyDbg_condition_op_const:
+            stack[top++] = instruction->operand;
+            break;
+        case TinyDbg_condition_op_reg:
+            stack[top++] = *(const unsigned long long *)((const char *)regs + instruction->operand);
+            break;
+        case TinyDbg_condition_op_load: {
+            uint64_t value = 0;  // little endian, so the bytes that are read are the low ones
+            if (!read(arg, &value, stack[top - 1], instruction->operand)) return -1;
+            stack[top - 1] = value;
+            break;
+        }
+        case TinyDbg_condition_op_sext: {
+            int shift = 64 - instruction->operand;
+            stack[top - 1] = (uint64_t)((int64_t)(stack[top - 1] << shift) >> shift);
+            break;
+        }
+        case TinyDbg_condition_op_not:
+            stack[top - 1] = stack[top - 1] == 0;
+            break;
+        case TinyDbg_condition_op_neg:
+            stack[top - 1] = -stack[top - 1];
+            break;
+        case TinyDbg_condition_op_bit_not:
+            stack[top - 1] = ~stack[top - 1];
+            break;
+        case TinyDbg_condition_op_jump_if_zero:
+        case TinyDbg_condition_op_jump_if_not_zero:
+            if ((stack[top - 1] == 0) == (instruction->op == TinyDbg_condition_op_jump_if_zero)) {
+                i += instruction->operand;
+            } else {
+                top--;
+            }
+            break;
+        default:
+            top--;
+            stack[top - 1] = binary(instruction->op, stack[top - 1], stack[top]);
+        }
+    }
+    return stack[0] != 0;
+}
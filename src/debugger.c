@@ -1,316 +1,2752 @@
 #include "debugger.h"
 
-static void unlock_mutex(pthread_mutex_t *mutex) {
-    pthread_mutex_unlock(mutex);
+static uint64_t monotonic_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ull + ts.tv_nsec;
 }
 
-static void waitpid_thread(TinyDbg *handle) {
-    bool first_time = true;
+// The stats of the debugger this thread is the process manager of, and the type of the request it's running -
+// TINYDBG_REQUEST_TYPES while it handles stops
+static __thread TinyDbg_Stats *thread_stats;
+static __thread size_t thread_request = TINYDBG_REQUEST_TYPES;
 
-    pid_t my_pid = handle->pid;
-    pthread_cleanup_push((void (*)(void *))unlock_mutex, &handle->process_continued);
+static void stats_add(uint64_t *counter, uint64_t value) {
+    __atomic_store_n(counter, *counter + value, __ATOMIC_RELAXED);  // only the process manager writes them
+}
+
+static long timed_ptrace(enum __ptrace_request request, pid_t pid, void *addr, void *data) {
+    if (thread_stats == NULL) return ptrace(request, pid, addr, data);
+    uint64_t begin = monotonic_ns();
+    long result = ptrace(request, pid, addr, data);
+    TinyDbg_Histogram_record(&thread_stats->ptrace_call, monotonic_ns() - begin);
+    stats_add(&thread_stats->ptrace_calls[thread_request], 1);
+    return result;
+}
+// Every ptrace call from here on is timed, and counted with the request it was made for
+#define ptrace(request, pid, addr, data) timed_ptrace(request, pid, (void *)(uintptr_t)(addr), (void *)(uintptr_t)(data))
+
+static ssize_t read_mem(TinyDbg *handle, void *local, uintptr_t remote, size_t len) {
+    return TinyDbg_memory_read(TinyDbg_memory_backend_any, handle->pid, handle->mem_fd, local, remote, len);
+}
+
+static ssize_t write_mem(TinyDbg *handle, const void *local, uintptr_t remote, size_t len) {
+    return TinyDbg_memory_write(TinyDbg_memory_backend_any, handle->pid, handle->mem_fd, local, remote, len);
+}
+
+// Replaces the \xcc of breakpoints and the jumps of tracepoints in memory that was read from the process with the original bytes
+static void hide_breakpoints(TinyDbg *handle, char *local, uintptr_t remote, size_t len) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    if (handle->breakpoints.len != 0) {
+        for (size_t i = 0; i < len; i++) {
+            if (local[i] != '\xcc') continue;
+            TinyDbg_Breakpoint *breakpoint = TinyDbg_BreakpointIndex_find(&handle->breakpoints, remote + i);
+            if (breakpoint != NULL) local[i] = breakpoint->original;
+        }
+    }
+    for (size_t i = 0; i < handle->tracepoints_len; i++) {
+        TinyDbg_Tracepoint *tracepoint = &handle->tracepoints[i];
+        uintptr_t begin = tracepoint->position < remote ? remote : tracepoint->position;
+        uintptr_t end = tracepoint->position + tracepoint->len < remote + len ? tracepoint->position + tracepoint->len : remote + len;
+        if (begin < end) memcpy(local + (begin - remote), tracepoint->original + (begin - tracepoint->position), end - begin);
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+}
+
+// The cached pages aren't valid after TinyDbg_set_memory_v wrote to the process from another thread
+static void check_page_cache(TinyDbg *handle) {
+    if (handle->page_cache.slots == NULL) return;
+    if (__atomic_exchange_n(&handle->page_cache_stale, false, __ATOMIC_ACQ_REL)) TinyDbg_PageCache_invalidate(&handle->page_cache);
+}
+
+// Reads memory the way the client sees it - with breakpoints hidden, and through the page cache if it's enabled
+static ssize_t read_client_mem(TinyDbg *handle, char *local, uintptr_t remote, size_t len) {
+    if (handle->page_cache.slots == NULL) {
+        ssize_t result = read_mem(handle, local, remote, len);
+        if (result > 0) hide_breakpoints(handle, local, remote, result);
+        return result;
+    }
+
+    check_page_cache(handle);
+    size_t done = 0;
+    while (done < len) {
+        uintptr_t page = (remote + done) & PAGE_MASK;
+        size_t offset = remote + done - page;
+        size_t size = PAGE_SIZE - offset;
+        if (size > len - done) size = len - done;
+
+        char *data = TinyDbg_PageCache_find(&handle->page_cache, page);
+        if (data == NULL) {
+            char page_data[PAGE_SIZE];
+            if (read_mem(handle, page_data, page, PAGE_SIZE) != (ssize_t)PAGE_SIZE) {
+                // part of the page isn't mapped, don't cache it and just read what's there
+                ssize_t result = read_mem(handle, local + done, remote + done, len - done);
+                if (result > 0) {
+                    hide_breakpoints(handle, local + done, remote + done, result);
+                    done += result;
+                }
+                break;
+            }
+            hide_breakpoints(handle, page_data, page, PAGE_SIZE);
+            data = TinyDbg_PageCache_insert(&handle->page_cache, page, page_data);
+        }
+        memcpy(local + done, data + offset, size);
+        done += size;
+    }
+    return done == 0 && len != 0 ? -1 : (ssize_t)done;
+}
+
+static void cover_breakpoint(TinyDbg_Breakpoint *breakpoint, const char *local, char **data, uintptr_t remote, size_t len,
+                             TinyDbg_Breakpoint ***found, size_t *found_len) {
+    breakpoint->displaced.kind = TinyDbg_displaced_unknown;
+    if (breakpoint->position < remote) return;
+    if (*data == NULL) {
+        *data = malloc(len);
+        memcpy(*data, local, len);
+    }
+    (*data)[breakpoint->position - remote] = '\xcc';
+    if ((*found_len & (*found_len - 1)) == 0) *found = realloc(*found, (*found_len == 0 ? 1 : *found_len * 2) * sizeof(TinyDbg_Breakpoint *));
+    (*found)[(*found_len)++] = breakpoint;
+}
+
+// With breakpoint_lock held, for a write of the client to [remote, remote + len) - the breakpoints in it stay in the
+// process, so their \xcc goes into a copy of local that's made in *data once there's one. The instruction under a
+// breakpoint up to 14 bytes before the range may reach into it, and its copy is made again. Returns the breakpoints in
+// the range, whose original bytes are set by commit_originals once it's known what was written.
+static TinyDbg_Breakpoint **cover_breakpoints(TinyDbg *handle, const char *local, char **data, uintptr_t remote, size_t len,
+                                              size_t *found_len) {
+    TinyDbg_Breakpoint **found = NULL;
+    *found_len = 0;
+    uintptr_t from = remote > 14 ? remote - 14 : 0;
+    if (handle->breakpoints.len < len + 14) {
+        for (size_t i = 0; i < handle->breakpoints.len; i++) {
+            TinyDbg_Breakpoint *breakpoint = &handle->breakpoints.breakpoints[i];
+            if (breakpoint->position < from || breakpoint->position >= remote + len) continue;
+            cover_breakpoint(breakpoint, local, data, remote, len, &found, found_len);
+        }
+    } else {
+        for (uintptr_t position = from; position < remote + len; position++) {
+            TinyDbg_Breakpoint *breakpoint = TinyDbg_BreakpointIndex_find(&handle->breakpoints, position);
+            if (breakpoint != NULL) cover_breakpoint(breakpoint, local, data, remote, len, &found, found_len);
+        }
+    }
+    return found;
+}
+
+// With breakpoint_lock held - the bytes that were written under breakpoints are the ones they restore
+static void commit_originals(TinyDbg_Breakpoint **found, size_t found_len, const char *local, uintptr_t remote, size_t written) {
+    for (size_t i = 0; i < found_len; i++) {
+        if (found[i]->position < remote + written) found[i]->original = local[found[i]->position - remote];
+    }
+}
+
+// Writes memory the way the client sees it - breakpoints stay in the process with a new original byte,
+// and cached pages are updated
+static ssize_t write_client_mem(TinyDbg *handle, const char *local, uintptr_t remote, size_t len) {
+    char *data = NULL;
+    size_t found_len;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_Breakpoint **found = cover_breakpoints(handle, local, &data, remote, len, &found_len);
+    ssize_t result = write_mem(handle, data != NULL ? data : local, remote, len);
+    if (result > 0) commit_originals(found, found_len, local, remote, result);
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    free(found);
+    free(data);
+
+    check_page_cache(handle);
+    if (handle->page_cache.slots != NULL && result > 0) {
+        for (uintptr_t page = remote & PAGE_MASK; page < remote + result; page += PAGE_SIZE) {
+            char *cached = TinyDbg_PageCache_find(&handle->page_cache, page);
+            if (cached == NULL) continue;
+            uintptr_t begin = page < remote ? remote : page;
+            uintptr_t end = page + PAGE_SIZE < remote + result ? page + PAGE_SIZE : remote + result;
+            memcpy(cached + (begin - page), local + (begin - remote), end - begin);
+        }
+    }
+    return result;
+}
+
+// Writes one byte to the text of the process, after reading the byte that was there into *original unless it's NULL.
+// False if either can't be done - then nothing is written, e.g. where nothing is mapped yet.
+static bool poke_byte(TinyDbg *handle, uintptr_t position, char byte, char *original) {
+    if (original != NULL && read_mem(handle, original, position, 1) != 1) return false;
+    return write_mem(handle, &byte, position, 1) == 1;
+}
+
+static int compare_positions(const void *a, const void *b) {
+    uintptr_t x = *(const uintptr_t *)a;
+    uintptr_t y = *(const uintptr_t *)b;
+    return (x > y) - (x < y);
+}
+
+// Where the region of sorted positions that starts at begin ends - it goes on while the next position is on the same
+// page or the one after it
+static size_t region_end_of(const uintptr_t *positions, size_t begin, size_t len) {
+    size_t end = begin + 1;
+    while (end < len && (positions[end] & PAGE_MASK) <= (positions[end - 1] & PAGE_MASK) + PAGE_SIZE) end++;
+    return end;
+}
+
+// Sets or unsets many breakpoints. Positions are sorted and split into regions of neighbouring pages,
+// and each region is read once, patched and written back once. The process has to be stopped. A breakpoint whose byte
+// can't be read or written isn't set, and set_at[i] (unless it's NULL) is whether positions[i] has one.
+static void patch_breakpoints(TinyDbg *handle, const uintptr_t *given_positions, size_t len, bool set, bool is_once, bool *set_at) {
+    uintptr_t *positions = malloc((len + 1) * sizeof(uintptr_t));
+    memcpy(positions, given_positions, len * sizeof(uintptr_t));
+    qsort(positions, len, sizeof(uintptr_t), compare_positions);
+    bool *inserted = calloc(len + 1, sizeof(bool));
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    size_t region_begin = 0;
+    while (region_begin < len) {
+        size_t region_end = region_end_of(positions, region_begin, len);
+
+        uintptr_t start = positions[region_begin];
+        size_t size = positions[region_end - 1] + 1 - start;
+        char *region = malloc(size);
+        bool whole_region = read_mem(handle, region, start, size) == (ssize_t)size;
+
+        for (size_t i = region_begin; i < region_end; i++) {
+            uintptr_t position = positions[i];
+            if (set) {
+                TinyDbg_Breakpoint *existing = TinyDbg_BreakpointIndex_find(&handle->breakpoints, position);
+                if (existing != NULL) {
+                    existing->is_once = is_once;
+                    continue;
+                }
+                TinyDbg_Breakpoint my_breakpoint;
+                my_breakpoint.position = position;
+                my_breakpoint.is_once = is_once;
+                my_breakpoint.condition = NULL;
+                my_breakpoint.hits = 0;
+                my_breakpoint.ignore_count = 0;
+                my_breakpoint.displaced = (TinyDbg_Displaced){ TinyDbg_displaced_unknown };
+                if (whole_region) {
+                    my_breakpoint.original = region[position - start];
+                    region[position - start] = '\xcc';
+                } else if (!poke_byte(handle, position, '\xcc', &my_breakpoint.original)) {
+                    continue;
+                }
+                TinyDbg_BreakpointIndex_insert(&handle->breakpoints, my_breakpoint);
+                inserted[i] = true;
+            } else {
+                TinyDbg_Breakpoint deleted_breakpoint;
+                if (!TinyDbg_BreakpointIndex_remove(&handle->breakpoints, position, &deleted_breakpoint)) continue;
+                TinyDbg_Condition_free(deleted_breakpoint.condition);
+                if (whole_region) {
+                    region[position - start] = deleted_breakpoint.original;
+                } else {
+                    poke_byte(handle, position, deleted_breakpoint.original, NULL);
+                }
+            }
+        }
+
+        if (whole_region && write_mem(handle, region, start, size) != (ssize_t)size) {
+            // part of it may not be written, so every patched byte is written again by itself, and a new breakpoint
+            // whose \xcc can't be isn't kept
+            for (size_t i = region_begin; i < region_end; i++) {
+                bool written = write_mem(handle, &region[positions[i] - start], positions[i], 1) == 1;
+                if (!written && inserted[i]) TinyDbg_BreakpointIndex_remove(&handle->breakpoints, positions[i], NULL);
+            }
+        }
+        free(region);
+        region_begin = region_end;
+    }
+    for (size_t i = 0; set_at != NULL && i < len; i++) {
+        set_at[i] = TinyDbg_BreakpointIndex_find(&handle->breakpoints, given_positions[i]) != NULL;
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    free(inserted);
+    free(positions);
+}
+
+// Writes the \xcc of every breakpoint, or the byte it replaced, to the memory of a process - this one, or the copy a forked
+// child has. The breakpoints stay as they are. Each region of neighbouring pages is read and written back once.
+static void write_breakpoint_bytes(TinyDbg *handle, pid_t pid, int mem_fd, bool inserted) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    size_t len = handle->breakpoints.len;
+    uintptr_t *positions = malloc(len * sizeof(uintptr_t));
+    for (size_t i = 0; i < len; i++) positions[i] = handle->breakpoints.breakpoints[i].position;
+    qsort(positions, len, sizeof(uintptr_t), compare_positions);
+
+    size_t region_begin = 0;
+    while (region_begin < len) {
+        size_t region_end = region_end_of(positions, region_begin, len);
+        uintptr_t start = positions[region_begin];
+        size_t size = positions[region_end - 1] + 1 - start;
+        char *region = malloc(size);
+        bool whole_region = TinyDbg_memory_read(TinyDbg_memory_backend_any, pid, mem_fd, region, start, size) == (ssize_t)size;
+        for (size_t i = region_begin; i < region_end; i++) {
+            char byte = inserted ? '\xcc' : TinyDbg_BreakpointIndex_find(&handle->breakpoints, positions[i])->original;
+            if (whole_region) {
+                region[positions[i] - start] = byte;
+            } else {
+                TinyDbg_memory_write(TinyDbg_memory_backend_any, pid, mem_fd, &byte, positions[i], 1);
+            }
+        }
+        if (whole_region) TinyDbg_memory_write(TinyDbg_memory_backend_any, pid, mem_fd, region, start, size);
+        free(region);
+        region_begin = region_end;
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    free(positions);
+}
+
+// DR0-DR3 hold the addresses, DR6 says which of them was hit, and DR7 enables them
+static long debug_register_offset(int i) {
+    return offsetof(struct user, u_debugreg) + i * sizeof(long);
+}
+
+static bool any_watchpoints(TinyDbg *handle) {
+    bool found = false;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX; i++) {
+        if (handle->watchpoints[i].len != 0) found = true;
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return found;
+}
+
+// Writes the watchpoints to the debug registers of a stopped thread
+static void write_debug_registers(TinyDbg *handle, pid_t tid) {
+    // an address can't change under an enabled watchpoint with a different alignment, so they're all disabled first
+    ptrace(PTRACE_POKEUSER, tid, debug_register_offset(7), 0);
+    unsigned long dr7 = 0;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX; i++) {
+        TinyDbg_Watchpoint *watchpoint = &handle->watchpoints[i];
+        if (watchpoint->len == 0) continue;
+        ptrace(PTRACE_POKEUSER, tid, debug_register_offset(i), watchpoint->address);
+        unsigned long condition = watchpoint->kind == TinyDbg_watchpoint_kind_execute ? 0b00
+                                  : watchpoint->kind == TinyDbg_watchpoint_kind_write ? 0b01 : 0b11;
+        unsigned long len = watchpoint->len == 8 ? 0b10 : watchpoint->len - 1;  // 1, 2 and 4 are 0b00, 0b01 and 0b11
+        dr7 |= 1ul << (i * 2);  // local enable
+        dr7 |= (condition | len << 2) << (16 + i * 4);
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    if (dr7 != 0) ptrace(PTRACE_POKEUSER, tid, debug_register_offset(7), dr7);
+}
+
+// Whether a SIGTRAP came from a watchpoint. DR6 keeps the bits of every hit until it's cleared, so it's cleared here.
+static bool watchpoint_hit(TinyDbg *handle, pid_t tid, TinyDbg_Watchpoint *hit) {
+    if (!any_watchpoints(handle)) return false;
+    unsigned long dr6 = ptrace(PTRACE_PEEKUSER, tid, debug_register_offset(6), NULL);
+    if ((dr6 & 0b1111) == 0 || dr6 == (unsigned long)-1) return false;
+    ptrace(PTRACE_POKEUSER, tid, debug_register_offset(6), 0);
+
+    bool found = false;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX && !found; i++) {
+        if ((dr6 & (1ul << i)) && handle->watchpoints[i].len != 0) {
+            *hit = handle->watchpoints[i];
+            found = true;
+        }
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return found;
+}
+
+#define SYSCALL_SET_WORDS (TINYDBG_SYSCALLS_MAX / 64)
+
+// Bitmap of syscall numbers, free it with free()
+static uint64_t *syscall_set_new(const int *syscalls, size_t syscalls_len) {
+    uint64_t *set = calloc(SYSCALL_SET_WORDS, sizeof(uint64_t));
+    for (size_t i = 0; i < syscalls_len; i++) {
+        if (syscalls[i] >= 0 && syscalls[i] < TINYDBG_SYSCALLS_MAX) set[syscalls[i] / 64] |= 1ull << (syscalls[i] % 64);
+    }
+    return set;
+}
+
+static bool syscall_set_has(const uint64_t *set, long syscall) {
+    return syscall >= 0 && syscall < TINYDBG_SYSCALLS_MAX && (set[syscall / 64] & (1ull << (syscall % 64)));
+}
+
+// Seccomp program that traps the syscalls in the set to the tracer and allows everything else
+static struct sock_fprog *seccomp_filter_new(const uint64_t *set) {
+    struct sock_fprog *prog = malloc(sizeof(struct sock_fprog));
+    prog->filter = malloc((5 + 2 * TINYDBG_SYSCALLS_MAX) * sizeof(struct sock_filter));
+    struct sock_filter *f = prog->filter;
+    size_t i = 0;
+
+    f[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, arch));
+    f[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, AUDIT_ARCH_X86_64, 1, 0);
+    f[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+    f[i++] = (struct sock_filter)BPF_STMT(BPF_LD | BPF_W | BPF_ABS, offsetof(struct seccomp_data, nr));
+    for (int syscall = 0; syscall < TINYDBG_SYSCALLS_MAX; syscall++) {
+        if (!syscall_set_has(set, syscall)) continue;
+        // every comparison is followed by its own return, so no jump is longer than one instruction
+        f[i++] = (struct sock_filter)BPF_JUMP(BPF_JMP | BPF_JEQ | BPF_K, syscall, 0, 1);
+        f[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_TRACE);
+    }
+    f[i++] = (struct sock_filter)BPF_STMT(BPF_RET | BPF_K, SECCOMP_RET_ALLOW);
+
+    prog->len = i;
+    return prog;
+}
+
+// Syscall stops, only touched by the process manager
+struct syscall_tracing {
+    bool enabled;           // whether syscalls are reported at all
+    uint64_t *set;          // which syscalls are reported, NULL for all of them
+    uint64_t *filter;       // which syscalls the seccomp filter traps, NULL if there's no filter
+    bool kernel_filtered;   // the filter traps every syscall in the set, so there's no need for PTRACE_SYSCALL
+};
+
+// How to continue a thread so that it stops on the syscalls we want
+static enum __ptrace_request continue_request(struct syscall_tracing *tracing, TinyDbg_Thread *thread) {
+    if (!tracing->enabled) {
+        thread->in_syscall = false;  // the exit won't be seen
+        return PTRACE_CONT;
+    }
+    if (tracing->kernel_filtered && !thread->in_syscall) return PTRACE_CONT;  // the filter stops at the next entry
+    return PTRACE_SYSCALL;
+}
+
+// Syscalls after which the maps have to be read again
+static const int map_syscalls[] = { SYS_mmap, SYS_munmap, SYS_mprotect, SYS_pkey_mprotect, SYS_mremap, SYS_brk,
+                                    SYS_shmat, SYS_shmdt, SYS_execve, SYS_execveat };
+
+static bool changes_maps(long syscall) {
+    for (size_t i = 0; i < sizeof(map_syscalls) / sizeof(map_syscalls[0]); i++) {
+        if (map_syscalls[i] == syscall) return true;
+    }
+    return false;
+}
+
+// Whether a thread resumed like this stops at the exit of every syscall that changes the mappings. A single step may
+// run one without a syscall stop.
+static bool maps_watched(struct syscall_tracing *tracing, enum __ptrace_request request) {
+    if (request == PTRACE_LISTEN || request == PTRACE_SYSCALL) return true;
+    // continued with the seccomp filter, which stops it at the entry of the syscalls it traps, and then at the exit
+    if (request != PTRACE_CONT || !tracing->enabled || tracing->filter == NULL) return false;
+    for (size_t i = 0; i < sizeof(map_syscalls) / sizeof(map_syscalls[0]); i++) {
+        if (!syscall_set_has(tracing->filter, map_syscalls[i])) return false;
+    }
+    return true;
+}
+
+static void set_syscall_tracing(struct syscall_tracing *tracing, bool enabled, uint64_t *set) {
+    free(tracing->set);
+    tracing->enabled = enabled;
+    tracing->set = set;
+    tracing->kernel_filtered = false;
+    if (enabled && set != NULL && tracing->filter != NULL) {
+        tracing->kernel_filtered = true;
+        for (size_t i = 0; i < SYSCALL_SET_WORDS; i++) {
+            if (set[i] & ~tracing->filter[i]) tracing->kernel_filtered = false;
+        }
+    }
+}
+
+static TinyDbg_Thread *find_thread(TinyDbg *handle, pid_t tid) {
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        if (handle->threads[i].tid == tid) return &handle->threads[i];
+    }
+    return NULL;
+}
+
+// Adds a thread that isn't stopped yet. Pointers to the other threads aren't valid after this.
+static TinyDbg_Thread *add_thread(TinyDbg *handle, pid_t tid) {
+    pthread_mutex_lock(&handle->thread_lock);
+    if (handle->threads_len == handle->threads_capacity) {
+        handle->threads_capacity = handle->threads_capacity == 0 ? 8 : handle->threads_capacity * 2;
+        handle->threads = realloc(handle->threads, handle->threads_capacity * sizeof(TinyDbg_Thread));
+    }
+    TinyDbg_Thread *thread = &handle->threads[handle->threads_len++];
+    memset(thread, 0, sizeof(TinyDbg_Thread));
+    thread->tid = tid;
+    pthread_mutex_unlock(&handle->thread_lock);
+    return thread;
+}
+
+// A thread that runs without a stop for every syscall that changes the mappings keeps them from being cached until
+// it stops again, and then they're read again
+static void set_maps_unwatched(TinyDbg *handle, TinyDbg_Thread *thread, bool unwatched) {
+    if (thread->maps_unwatched == unwatched) return;
+    thread->maps_unwatched = unwatched;
+    if (unwatched) {
+        __atomic_add_fetch(&handle->maps.unwatched_threads, 1, __ATOMIC_SEQ_CST);
+    } else {
+        __atomic_sub_fetch(&handle->maps.unwatched_threads, 1, __ATOMIC_SEQ_CST);
+    }
+    TinyDbg_MapTable_invalidate(&handle->maps);
+}
+
+static void remove_thread(TinyDbg *handle, pid_t tid) {
+    pthread_mutex_lock(&handle->thread_lock);
+    TinyDbg_Thread *thread = find_thread(handle, tid);
+    if (thread != NULL) {
+        set_maps_unwatched(handle, thread, false);
+        size_t i = thread - handle->threads;
+        memmove(thread, thread + 1, (handle->threads_len - i - 1) * sizeof(TinyDbg_Thread));
+        handle->threads_len--;
+    }
+    pthread_mutex_unlock(&handle->thread_lock);
+}
+
+// Returns whether the process manager was waiting for it, otherwise it has to be woken up with a request
+static bool push_status(TinyDbg *handle, TinyDbg_wait_status status) {
+    pthread_mutex_lock(&handle->status_lock);
+    if (handle->statuses_len == handle->statuses_capacity) {
+        handle->statuses_capacity = handle->statuses_capacity == 0 ? 8 : handle->statuses_capacity * 2;
+        handle->statuses = realloc(handle->statuses, handle->statuses_capacity * sizeof(TinyDbg_wait_status));
+    }
+    handle->statuses[handle->statuses_len++] = status;
+    bool was_waiting = handle->procman_waiting;
+    if (was_waiting) pthread_cond_signal(&handle->status_added);
+    pthread_mutex_unlock(&handle->status_lock);
+    return was_waiting;
+}
+
+// Puts statuses back in front of the others, in the same order
+static void put_back_statuses(TinyDbg *handle, TinyDbg_wait_status *statuses, size_t len) {
+    if (len == 0) return;
+    pthread_mutex_lock(&handle->status_lock);
+    if (handle->statuses_len + len > handle->statuses_capacity) {
+        handle->statuses_capacity = handle->statuses_len + len;
+        handle->statuses = realloc(handle->statuses, handle->statuses_capacity * sizeof(TinyDbg_wait_status));
+    }
+    memmove(handle->statuses + len, handle->statuses, handle->statuses_len * sizeof(TinyDbg_wait_status));
+    memcpy(handle->statuses, statuses, len * sizeof(TinyDbg_wait_status));
+    handle->statuses_len += len;
+    pthread_mutex_unlock(&handle->status_lock);
+}
+
+static bool take_status(TinyDbg *handle, TinyDbg_wait_status *status) {
+    pthread_mutex_lock(&handle->status_lock);
+    bool found = handle->statuses_len != 0;
+    if (found) {
+        *status = handle->statuses[0];
+        memmove(handle->statuses, handle->statuses + 1, (handle->statuses_len - 1) * sizeof(TinyDbg_wait_status));
+        handle->statuses_len--;
+    }
+    pthread_mutex_unlock(&handle->status_lock);
+    return found;
+}
+
+// Like take_status, but waits for the waiter thread if there's nothing yet. Returns false once the process is gone.
+static bool wait_status(TinyDbg *handle, TinyDbg_wait_status *status) {
+    pthread_mutex_lock(&handle->status_lock);
+    handle->procman_waiting = true;
+    while (handle->statuses_len == 0 && !handle->process_gone) pthread_cond_wait(&handle->status_added, &handle->status_lock);
+    handle->procman_waiting = false;
+    pthread_mutex_unlock(&handle->status_lock);
+    return take_status(handle, status);
+}
+
+// A single thread waits for the children of every debugger in this process, because waitpid(-1) would take the stops
+// of the other debuggers' processes otherwise. It hands each status to the debugger of the thread, and wakes its process
+// manager up. The process manager takes the stops it needs from its list, so the kernel can report a stop at any time
+// without it being missed, and nothing has to be stopped or restarted around a request. Only the threads it knows of are
+// reaped, the other children of this process are left to whoever started them. While one of those has a status that
+// isn't taken, it's the one waitid(P_ALL) reports, so the waiter can't block on it: it blocks on the thread it watches if
+// there's only one, and otherwise looks at the watched threads one by one every millisecond until it's taken.
+struct watched_thread {
+    pid_t tid;
+    TinyDbg *handle;        // NULL once its debugger is freed, it's only reaped then
+    bool is_child;          // a child process of the debugged one, until it's let go or has a debugger of its own
+};
+static pthread_mutex_t waiter_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t waiter_watching = PTHREAD_COND_INITIALIZER;  // signalled when the watched threads change
+static struct watched_thread *watched_threads;  // every thread of every debugged process that was seen, guarded by waiter_lock
+static size_t watched_threads_len;
+static size_t watched_threads_capacity;
+static unsigned long watch_generation;  // changes whenever a process is watched or let go
+static unsigned int waiters;            // they're gone once nothing is left to reap
+static unsigned int waiters_blocked;    // the ones waiting on a single thread, which won't see the others' statuses
+
+static struct watched_thread *find_watched(pid_t tid) {
+    for (size_t i = 0; i < watched_threads_len; i++) {
+        if (watched_threads[i].tid == tid) return &watched_threads[i];
+    }
+    return NULL;
+}
+
+static void add_watched(pid_t tid, TinyDbg *handle, bool is_child) {
+    if (watched_threads_len == watched_threads_capacity) {
+        watched_threads_capacity = watched_threads_capacity == 0 ? 16 : watched_threads_capacity * 2;
+        watched_threads = realloc(watched_threads, watched_threads_capacity * sizeof(struct watched_thread));
+    }
+    watched_threads[watched_threads_len++] = (struct watched_thread){ tid, handle, is_child };
+}
+
+// Removes the threads of a debugger, or only one of them
+static void remove_watched(TinyDbg *handle, pid_t tid) {
+    size_t kept = 0;
+    for (size_t i = 0; i < watched_threads_len; i++) {
+        if (watched_threads[i].handle == handle && (tid == 0 || watched_threads[i].tid == tid)) continue;
+        watched_threads[kept++] = watched_threads[i];
+    }
+    watched_threads_len = kept;
+}
+
+// Removes the threads of a debugger's process, but not the children - a checkpoint's copy outlives the process
+static void remove_watched_process(TinyDbg *handle) {
+    size_t kept = 0;
+    for (size_t i = 0; i < watched_threads_len; i++) {
+        if (watched_threads[i].handle == handle && !watched_threads[i].is_child) continue;
+        watched_threads[kept++] = watched_threads[i];
+    }
+    watched_threads_len = kept;
+}
+
+// Whether a thread that wasn't seen yet is ours, from the thread group it's in - or a process that was just forked, from
+// its tracer. That's the process manager that traces its parent, or the copy of a checkpoint it was forked from, whose
+// parent isn't ours. *handle is its debugger, if it still has one. Only works while it's not reaped.
+static bool find_watched_process(pid_t tid, TinyDbg **handle, bool *is_child) {
+    char path_str[32];
+    sprintf(path_str, "/proc/%d/status", tid);
+    FILE *fp = fopen(path_str, "r");
+    if (fp == NULL) return false;
+
+    pid_t tgid = 0;
+    pid_t tracer = 0;
+    char line[128];
+    while (fgets(line, sizeof(line), fp) != NULL) {
+        sscanf(line, "Tgid: %d", &tgid);
+        if (sscanf(line, "TracerPid: %d", &tracer) == 1) break;  // it comes after Tgid
+    }
+    fclose(fp);
+
+    struct watched_thread *leader = find_watched(tgid);
+    *is_child = leader == NULL;
+    if (leader != NULL) {
+        *handle = !leader->is_child ? leader->handle : NULL;
+        return true;
+    }
+    for (size_t i = 0; i < watched_threads_len && tracer != 0; i++) {
+        if (watched_threads[i].handle != NULL && watched_threads[i].handle->tracer_tid == tracer) {
+            *handle = watched_threads[i].handle;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void process_gone(TinyDbg *handle) {
+    pthread_mutex_lock(&handle->status_lock);
+    handle->process_gone = true;
+    pthread_cond_broadcast(&handle->status_added);
+    pthread_mutex_unlock(&handle->status_lock);
+}
+
+// Takes the status of a watched thread if it has one, and hands it to its debugger. A thread without a debugger that
+// can't have a status anymore is forgotten. Returns whether there was one.
+static bool reap_watched(pid_t tid) {
+    TinyDbg_wait_status status;
+    status.tid = waitpid(tid, &status.wstatus, __WALL | WNOHANG);
+    struct watched_thread *watched = find_watched(tid);
+    if (status.tid <= 0) {
+        if (status.tid == -1 && errno == ECHILD && watched->handle == NULL) remove_watched(NULL, tid);
+        return false;
+    }
+    status.waited_ns = monotonic_ns();
+    status.is_child = watched->is_child;
+    TinyDbg *handle = watched->handle;
+    bool exited = WIFEXITED(status.wstatus) || WIFSIGNALED(status.wstatus);
+    if (handle == NULL) {
+        if (exited) remove_watched(NULL, tid);
+        return true;
+    }
+
+    if (!push_status(handle, status)) {
+        TinyDbg_procman_request *event = calloc(1, sizeof(TinyDbg_procman_request));
+        event->type = TinyDbg_INTERNAL_procman_request_type_waitpid;
+        EventQueue_add(handle->eq_process_manager, event);
+    }
+    if (exited) {
+        if (tid == handle->pid) {
+            remove_watched_process(handle);
+            process_gone(handle);  // the main thread is reported last
+        } else {
+            remove_watched(handle, tid);
+        }
+    }
+    return true;
+}
+
+// Tries to reap each watched thread (only the ones without a debugger if released_only), returns whether any had a status
+static bool reap_all_watched(bool released_only) {
+    pid_t *tids = malloc((watched_threads_len + 1) * sizeof(pid_t));
+    size_t tids_len = 0;
+    for (size_t i = 0; i < watched_threads_len; i++) {
+        if (!released_only || watched_threads[i].handle == NULL) tids[tids_len++] = watched_threads[i].tid;
+    }
+    bool any = false;
+    for (size_t i = 0; i < tids_len; i++) {
+        if (find_watched(tids[i]) != NULL && reap_watched(tids[i])) any = true;  // reaping one may forget others
+    }
+    free(tids);
+    return any;
+}
+
+static void waitpid_thread(void *arg) {
+    (void)arg;
+    unsigned long generation = 0;
+    pthread_mutex_lock(&waiter_lock);
+    while (watched_threads_len != 0) {
+        pthread_mutex_unlock(&waiter_lock);
+        // only looks at whose the next status is, without taking it
+        siginfo_t info;
+        info.si_pid = 0;
+        int result = waitid(P_ALL, 0, &info, WEXITED | WNOWAIT | __WALL);
+        pthread_mutex_lock(&waiter_lock);
+        if (result == -1) {
+            if (errno == ECHILD) {
+                // no children, the ones without a debugger are gone. Wait for the next debugger to start.
+                remove_watched(NULL, 0);
+                while (generation == watch_generation && watched_threads_len != 0) pthread_cond_wait(&waiter_watching, &waiter_lock);
+            }
+            generation = watch_generation;
+            continue;
+        }
+        generation = watch_generation;
+
+        pid_t tid = info.si_pid;
+        struct watched_thread *watched = find_watched(tid);
+        TinyDbg *handle;
+        bool is_child;
+        if (watched == NULL && find_watched_process(tid, &handle, &is_child)) {
+            // a new thread or child process, which can stop before its PTRACE_EVENT_CLONE or PTRACE_EVENT_FORK is seen
+            add_watched(tid, handle, is_child);
+            watched = find_watched(tid);
+        }
+        if (watched != NULL) {
+            bool released = watched->handle == NULL;
+            reap_watched(tid);
+            // the threads of a freed debugger's process that aren't reported anymore are forgotten along with it
+            if (released) reap_all_watched(true);
+            continue;
+        }
+
+        // it's a child of someone else in this process, which is the next status until they reap it. Meanwhile the
+        // watched threads are looked at one by one.
+        if (reap_all_watched(false)) continue;
+        if (watched_threads_len == 1) {
+            // anything watched meanwhile gets a waiter of its own
+            pid_t only_tid = watched_threads[0].tid;
+            waiters_blocked++;
+            pthread_mutex_unlock(&waiter_lock);
+            waitid(P_PID, only_tid, &info, WEXITED | WNOWAIT | __WALL);
+            pthread_mutex_lock(&waiter_lock);
+            waiters_blocked--;
+            if (waiters - waiters_blocked > 1) break;  // that one is waiting for everything already
+            continue;
+        }
+        pthread_mutex_unlock(&waiter_lock);
+        usleep(1000);
+        pthread_mutex_lock(&waiter_lock);
+    }
+    waiters--;
+    pthread_mutex_unlock(&waiter_lock);
+}
+
+// Like add_watched, and starts a waiter thread if none is waiting for every thread. The caller holds waiter_lock.
+static void add_watched_thread(pid_t tid, TinyDbg *handle, bool is_child) {
+    add_watched(tid, handle, is_child);
+    watch_generation++;
+    pthread_cond_signal(&waiter_watching);
+    if (waiters == waiters_blocked) {
+        pthread_t waiter_thread;
+        pthread_create(&waiter_thread, NULL, (void * (*)(void *))&waitpid_thread, NULL);
+        pthread_detach(waiter_thread);
+        waiters++;
+    }
+}
+
+// Starts handing the statuses of this debugger's process to it. The caller holds waiter_lock since before the process
+// could stop, otherwise the waiter thread could take its first stop without knowing whose it is.
+static void watch_process(TinyDbg *handle) {
+    add_watched_thread(handle->pid, handle, false);
+}
+
+// A thread or child process we were told of with PTRACE_GETEVENTMSG, whose first stop may not be taken yet
+static void watch_thread(TinyDbg *handle, pid_t tid, bool is_child) {
+    pthread_mutex_lock(&waiter_lock);
+    if (find_watched(tid) == NULL) add_watched_thread(tid, handle, is_child);
+    pthread_mutex_unlock(&waiter_lock);
+}
+
+// Lets go of the debugger's threads. The ones that are still reported to us (its process, unless it was detached, and
+// the copies of checkpoints) are reaped until they're gone.
+static void unwatch_process(TinyDbg *handle) {
+    pthread_mutex_lock(&waiter_lock);
+    for (size_t i = 0; i < watched_threads_len; i++) {
+        if (watched_threads[i].handle == handle) watched_threads[i].handle = NULL;
+    }
+    reap_all_watched(true);
+    watch_generation++;
+    pthread_cond_signal(&waiter_watching);
+    pthread_mutex_unlock(&waiter_lock);
+}
+
+// A child that's followed, which waits in a loop at where fork returned until its own process manager seizes it
+struct forked_child {
+    pid_t tid;                  // the thread of the parent that forked it
+    pid_t pid;                  // 0 if there's none
+    uintptr_t loop_at;
+    char original[2];           // what the loop replaced
+    bool is_vfork;
+};
+
+// Everything the process manager keeps for itself
+struct procman {
+    TinyDbg *handle;
+    struct syscall_tracing syscall_tracing;
+    bool coverage_mode;
+    bool non_stop;              // TINYDBG_FLAG_NON_STOP
+    bool seized;                // TINYDBG_FLAG_SEIZE, our stops are PTRACE_EVENT_STOP instead of SIGSTOP
+    pid_t current_tid;          // thread of the last event, for requests that don't say which thread
+    uintptr_t tracepoint_shared;        // where the mapping shared with us is in the process, 0 until the first tracepoint
+    TinyDbg_ScratchArea *scratch;
+    size_t scratch_len;
+    size_t tracepoint_counters;         // hit counters handed out so far
+    pid_t *early_children;              // forked children that stopped before their parent's PTRACE_EVENT_FORK was handled
+    size_t early_children_len;
+    unsigned int vforks;                // vforked children using the memory right now, the breakpoints are out of it meanwhile
+    struct forked_child forked;         // the child the last stop forked, if it's followed
+    uint64_t event_sent_ns;             // when the last event was sent, 0 once a continue ran after it
+    TinyDbg_Checkpoint **checkpoints;   // the ones that weren't freed, their copies are killed along with us
+    size_t checkpoints_len;
+};
+
+// A thread we didn't know about, created by a thread of the process
+static TinyDbg_Thread *new_thread(struct procman *pm, pid_t tid) {
+    // it runs along with the others, unless all of them were stopped for the client
+    bool resumed = pm->non_stop;
+    for (size_t i = 0; i < pm->handle->threads_len; i++) {
+        if (pm->handle->threads[i].resumed) resumed = true;
+    }
+    TinyDbg_Thread *thread = add_thread(pm->handle, tid);
+    thread->is_new = true;
+    thread->resumed = resumed;
+    return thread;
+}
+
+// Continue or single step, after which nothing that was read is valid anymore
+static void resume_thread(struct procman *pm, TinyDbg_Thread *thread, enum __ptrace_request request) {
+    if (pm->handle->page_cache.slots != NULL) TinyDbg_PageCache_invalidate(&pm->handle->page_cache);
+    set_maps_unwatched(pm->handle, thread, !maps_watched(&pm->syscall_tracing, request));
+    if (request == PTRACE_LISTEN) {
+        ptrace(request, thread->tid, NULL, NULL);  // the signal waits until it really runs
+    } else {
+        ptrace(request, thread->tid, NULL, (void *)(long)thread->pending_signal);
+        thread->pending_signal = 0;
+    }
+    thread->is_stopped = false;
+}
+
+static void continue_thread(struct procman *pm, TinyDbg_Thread *thread) {
+    // a thread in a group-stop stays stopped until the process gets a SIGCONT, but we still hear about it
+    resume_thread(pm, thread, thread->group_stopped ? PTRACE_LISTEN : continue_request(&pm->syscall_tracing, thread));
+}
+
+// Whether a stop is the one we asked for with stop_threads, or the first stop of a new thread.
+// With PTRACE_SEIZE that's a PTRACE_EVENT_STOP - which is a group-stop if the process was being stopped anyway.
+static bool is_stop_trap(struct procman *pm, int wstatus) {
+    if (pm->seized) return wstatus >> 16 == PTRACE_EVENT_STOP;
+    return WSTOPSIG(wstatus) == SIGSTOP;
+}
+
+static void thread_stopped(struct procman *pm, TinyDbg_Thread *thread, int wstatus) {
+    thread->is_stopped = true;
+    set_maps_unwatched(pm->handle, thread, false);
+    // the stop signal of a PTRACE_EVENT_STOP is SIGTRAP unless the process is stopped by job control
+    if (pm->seized && wstatus >> 16 == PTRACE_EVENT_STOP) thread->group_stopped = WSTOPSIG(wstatus) != SIGTRAP;
+}
+
+// Continues the threads which are supposed to be running, except for those with a stop that wasn't handled yet
+static void resume_threads(struct procman *pm) {
+    for (size_t i = 0; i < pm->handle->threads_len; i++) {
+        TinyDbg_Thread *thread = &pm->handle->threads[i];
+        if (thread->is_stopped && thread->resumed && !thread->has_pending_status) continue_thread(pm, thread);
+    }
+}
+
+static bool stops_pending(TinyDbg *handle) {
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        TinyDbg_Thread *thread = &handle->threads[i];
+        if (!thread->is_stopped && (thread->stop_requested || thread->is_new)) return true;
+    }
+    return false;
+}
+
+// Waits for this thread to stop and returns its wait status, or with tid 0, until every thread that was sent a stop
+// stops. Anything else that happens meanwhile is put aside, and handled like any other stop after the current request -
+// with a tid that's our stops of the other threads too, since the others may be running and nothing resumes them after.
+static int wait_for_stop(struct procman *pm, pid_t tid) {
+    TinyDbg *handle = pm->handle;
+    TinyDbg_wait_status *deferred = NULL;
+    size_t deferred_len = 0;
+    int result = 0;
+    while (tid != 0 || stops_pending(handle)) {
+        TinyDbg_wait_status status;
+        if (!wait_status(handle, &status)) break;  // no children left
+
+        TinyDbg_Thread *thread = find_thread(handle, status.tid);
+        bool done = false;
+        bool put_aside = true;
+        if (status.is_child) {
+            done = status.tid == tid;
+            put_aside = !done;
+        } else if (WIFEXITED(status.wstatus) || WIFSIGNALED(status.wstatus)) {
+            remove_thread(handle, status.tid);  // the exit event is sent later
+            done = status.tid == tid;
+        } else if (WIFSTOPPED(status.wstatus)) {
+            if (thread == NULL) thread = new_thread(pm, status.tid);  // reported before its PTRACE_EVENT_CLONE
+            thread_stopped(pm, thread, status.wstatus);
+            bool is_stop = is_stop_trap(pm, status.wstatus);
+            // it may have been marked by mark_pending_statuses while the stop waited in the list
+            if (status.tid == tid) {
+                if (is_stop) thread->stop_requested = false;
+                thread->has_pending_status = false;
+                done = true;
+                put_aside = false;
+            } else if (tid == 0 && is_stop && (thread->stop_requested || thread->is_new)) {
+                if (thread->is_new && any_watchpoints(handle)) write_debug_registers(handle, thread->tid);
+                thread->stop_requested = false;
+                thread->is_new = false;
+                thread->has_pending_status = false;
+                put_aside = false;
+            } else {
+                thread->has_pending_status = true;
+            }
+        }
+
+        if (put_aside) {
+            deferred = realloc(deferred, (deferred_len + 1) * sizeof(TinyDbg_wait_status));
+            deferred[deferred_len++] = status;
+        }
+        if (done) {
+            result = status.wstatus;
+            break;
+        }
+    }
+
+    put_back_statuses(handle, deferred, deferred_len);
+    free(deferred);
+    return result;
+}
+
+// Stops every running thread (or only one of them) and waits for them to stop
+static void stop_threads(struct procman *pm, pid_t only) {
+    TinyDbg *handle = pm->handle;
+    uint64_t begin = monotonic_ns();
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        TinyDbg_Thread *thread = &handle->threads[i];
+        if ((only != 0 && thread->tid != only) || thread->is_stopped || thread->is_new || thread->stop_requested) continue;
+        if (pm->seized) {
+            ptrace(PTRACE_INTERRUPT, thread->tid, NULL, NULL);
+        } else {
+            tgkill(handle->pid, thread->tid, SIGSTOP);
+        }
+        thread->stop_requested = true;
+    }
+    if (stops_pending(handle)) {
+        wait_for_stop(pm, 0);
+        TinyDbg_Histogram_record(&handle->stats->stop, monotonic_ns() - begin);
+    }
+}
+
+// Single steps a stopped thread, and returns the wait status of the step
+static int step_thread(struct procman *pm, pid_t tid) {
+    while (true) {
+        TinyDbg_Thread *thread = find_thread(pm->handle, tid);
+        if (thread == NULL) return 0;
+        bool stop_pending = thread->stop_requested;
+        resume_thread(pm, thread, PTRACE_SINGLESTEP);
+        int wstatus = wait_for_stop(pm, tid);
+        // a stop we asked for before came instead of the step - step again
+        if (!(stop_pending && WIFSTOPPED(wstatus) && is_stop_trap(pm, wstatus))) return wstatus;
+    }
+}
+
+// Single steps a thread over the instruction under a breakpoint with its \xcc taken out, and puts the \xcc back.
+// The thread isn't stepped if the \xcc can't be taken out. If it can't be put back the breakpoint is removed, so the
+// index has no breakpoints that aren't in memory, and this returns false.
+static bool step_over_in_place(struct procman *pm, pid_t tid, uintptr_t position, char original) {
+    TinyDbg *handle = pm->handle;
+    if (write_mem(handle, &original, position, 1) != 1) return true;
+    step_thread(pm, tid);
+    if (write_mem(handle, "\xcc", position, 1) == 1) return true;
+    TinyDbg_Breakpoint removed;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    if (TinyDbg_BreakpointIndex_remove(&handle->breakpoints, position, &removed)) TinyDbg_Condition_free(removed.condition);
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return false;
+}
+
+// Whether the process is stopped for the client in all-stop mode, so nothing else should be reported yet
+static bool held_for_client(struct procman *pm) {
+    if (pm->non_stop || pm->handle->threads_len == 0) return false;  // the threads exited while a request waited, there's only the exit left
+    for (size_t i = 0; i < pm->handle->threads_len; i++) {
+        if (pm->handle->threads[i].resumed) return false;
+    }
+    return true;
+}
+
+// Threads with a stop that wasn't handled yet shouldn't be continued before it is
+static void mark_pending_statuses(TinyDbg *handle) {
+    pthread_mutex_lock(&handle->status_lock);
+    for (size_t i = 0; i < handle->statuses_len; i++) {
+        TinyDbg_Thread *thread = find_thread(handle, handle->statuses[i].tid);
+        if (thread != NULL && WIFSTOPPED(handle->statuses[i].wstatus)) thread->has_pending_status = true;
+    }
+    pthread_mutex_unlock(&handle->status_lock);
+}
+
+// Stops the process for the client - every thread, or in non-stop mode only this one
+static void stop_for_client(struct procman *pm, pid_t tid) {
+    if (pm->non_stop) {
+        TinyDbg_Thread *thread = find_thread(pm->handle, tid);
+        if (thread != NULL) thread->resumed = false;
+        stop_threads(pm, tid);
+    } else {
+        for (size_t i = 0; i < pm->handle->threads_len; i++) pm->handle->threads[i].resumed = false;
+        stop_threads(pm, 0);
+    }
+}
+
+// Into the event ring if there is one, otherwise a copy that the consumer frees goes to the event queue
+static void send_event(TinyDbg *handle, TinyDbg_Event *event) {
+    event->pid = handle->pid;
+    if (handle->event_ring != NULL) {
+        TinyDbg_EventRing_push(handle->event_ring, event);
+    } else {
+        TinyDbg_Event *copy = malloc(sizeof(TinyDbg_Event));
+        *copy = *event;
+        EventQueue_add(handle->eq_debugger_events, copy);
+    }
+}
+
+static void report_event(struct procman *pm, pid_t tid, TinyDbg_Event *event) {
+    stop_for_client(pm, tid);
+    pm->current_tid = tid;
+    event->tid = tid;
+    send_event(pm->handle, event);
+    pm->event_sent_ns = monotonic_ns();
+}
+
+// Waits for the first stop of a child the process forked, which may have come before the parent's. False if it's gone.
+static bool take_child_stop(struct procman *pm, pid_t child) {
+    for (size_t i = 0; i < pm->early_children_len; i++) {
+        if (pm->early_children[i] == child) {
+            pm->early_children[i] = pm->early_children[--pm->early_children_len];
+            return true;
+        }
+    }
+    return WIFSTOPPED(wait_for_stop(pm, child));
+}
+
+// A child starts stopped and traced by us, with the \xcc of every breakpoint and the jumps of the tracepoints in its copy
+// of the memory. Unless it's followed it goes on by itself without them, otherwise it's left in a loop for its own process
+// manager to seize - a thread can only trace what it attached to. Returns whether it's followed.
+static bool handle_fork(struct procman *pm, pid_t tid, pid_t child, bool is_vfork, bool follow) {
+    TinyDbg *handle = pm->handle;
+    if (!take_child_stop(pm, child)) return false;  // killed already
+    int mem_fd = TinyDbg_memory_open(child);
+
+    if (is_vfork) {
+        // it runs in our memory until it execs or exits, the tracepoints can stay since it has their mappings too
+        if (pm->vforks++ == 0) write_breakpoint_bytes(handle, handle->pid, handle->mem_fd, false);
+    } else {
+        // a followed child keeps the breakpoints, its debugger gets a copy of them
+        if (!follow) write_breakpoint_bytes(handle, child, mem_fd, false);
+        pthread_mutex_lock(&handle->breakpoint_lock);
+        for (size_t i = 0; i < handle->tracepoints_len; i++) {
+            TinyDbg_Tracepoint *tracepoint = &handle->tracepoints[i];
+            TinyDbg_memory_write(TinyDbg_memory_backend_any, child, mem_fd, tracepoint->original, tracepoint->position, tracepoint->len);
+        }
+        pthread_mutex_unlock(&handle->breakpoint_lock);
+    }
+
+    struct user_regs_struct regs;
+    struct forked_child *forked = &pm->forked;
+    follow = follow && ptrace(PTRACE_GETREGS, child, 0, &regs) == 0
+             && TinyDbg_memory_read(TinyDbg_memory_backend_any, child, mem_fd, forked->original, regs.rip, 2) == 2
+             && TinyDbg_memory_write(TinyDbg_memory_backend_any, child, mem_fd, "\xeb\xfe", regs.rip, 2) == 2;  // jmp to itself
+    if (follow) {
+        forked->tid = tid;
+        forked->pid = child;
+        forked->loop_at = regs.rip;
+        forked->is_vfork = is_vfork;
+    }
+    if (mem_fd != -1) close(mem_fd);
+    ptrace(PTRACE_DETACH, child, NULL, NULL);
+    pthread_mutex_lock(&waiter_lock);
+    remove_watched(handle, child);
+    pthread_mutex_unlock(&waiter_lock);
+    return follow;
+}
+
+// Nothing that was read from the memory of the process is valid after an execve, or a checkpoint is restored
+static void memory_replaced(TinyDbg *handle) {
+    // /proc/pid/mem is of the memory that was there when it was opened
+    if (handle->mem_fd != -1) close(handle->mem_fd);
+    handle->mem_fd = TinyDbg_memory_open(handle->pid);
+    if (handle->page_cache.slots != NULL) TinyDbg_PageCache_invalidate(&handle->page_cache);
+    TinyDbg_MapTable_invalidate(&handle->maps);
+    pthread_mutex_lock(&handle->symbol_lock);
+    handle->modules_len = 0;  // made again from the new maps on the next lookup
+    pthread_mutex_unlock(&handle->symbol_lock);
+}
+
+// After an execve the memory is new, with none of our breakpoints, tracepoints or scratch areas in it, and only the
+// thread that called it is left - as the main thread
+static void forget_program(struct procman *pm, pid_t former_tid) {
+    TinyDbg *handle = pm->handle;
+    pthread_mutex_lock(&handle->thread_lock);
+    for (size_t i = 0; i < handle->threads_len; i++) set_maps_unwatched(handle, &handle->threads[i], false);
+    TinyDbg_Thread *execing = find_thread(handle, former_tid);
+    TinyDbg_Thread thread = *(execing != NULL ? execing : find_thread(handle, handle->pid));
+    thread.tid = handle->pid;
+    thread.is_stopped = true;
+    thread.has_pending_status = false;
+    thread.group_stopped = false;
+    handle->threads[0] = thread;
+    handle->threads_len = 1;
+    pthread_mutex_unlock(&handle->thread_lock);
+
+    // the other threads are gone, a stop they had doesn't matter anymore
+    pthread_mutex_lock(&handle->status_lock);
+    size_t kept = 0;
+    for (size_t i = 0; i < handle->statuses_len; i++) {
+        TinyDbg_wait_status *status = &handle->statuses[i];
+        if (WIFSTOPPED(status->wstatus) && !status->is_child && status->tid != handle->pid) continue;
+        handle->statuses[kept++] = *status;
+    }
+    handle->statuses_len = kept;
+    pthread_mutex_unlock(&handle->status_lock);
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_BreakpointIndex_destroy(&handle->breakpoints);
+    TinyDbg_BreakpointIndex_init(&handle->breakpoints);
+    handle->tracepoints_len = 0;
+    if (handle->tracepoint_shared != NULL) munmap(handle->tracepoint_shared, sizeof(TinyDbg_TracepointShared));
+    handle->tracepoint_shared = NULL;
+    handle->tracepoint_tail = 0;
+    memset(handle->watchpoints, 0, sizeof(handle->watchpoints));  // the kernel clears the debug registers
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    pm->tracepoint_shared = 0;
+    free(pm->scratch);
+    pm->scratch = NULL;
+    pm->scratch_len = 0;
+    pm->tracepoint_counters = 0;
+    pm->vforks = 0;
+    memory_replaced(handle);
+
+    // the checkpoints are of the old program, they can only be freed now
+    for (size_t i = 0; i < pm->checkpoints_len; i++) {
+        if (pm->checkpoints[i]->pid != 0) kill(pm->checkpoints[i]->pid, SIGKILL);
+        pm->checkpoints[i]->pid = 0;
+    }
+}
+
+// Runs a syscall in a stopped thread as if it was its next instruction, and puts everything back the way it was.
+// Returns what the syscall returned (-errno on failure).
+static long inject_syscall(struct procman *pm, pid_t tid, long number, long arg0, long arg1, long arg2, long arg3, long arg4, long arg5) {
+    TinyDbg *handle = pm->handle;
+    struct user_regs_struct saved;
+    if (ptrace(PTRACE_GETREGS, tid, 0, &saved) == -1) return -ESRCH;
+    char original[2];
+    if (read_mem(handle, original, saved.rip, 2) != 2 || write_mem(handle, "\x0f\x05", saved.rip, 2) != 2) return -EFAULT;
+
+    // rax isn't a restart code, so a syscall it was stopped in is restarted only once the saved registers are back
+    struct user_regs_struct regs = saved;
+    regs.rax = number;
+    regs.rdi = arg0;
+    regs.rsi = arg1;
+    regs.rdx = arg2;
+    regs.r10 = arg3;
+    regs.r8 = arg4;
+    regs.r9 = arg5;
+    ptrace(PTRACE_SETREGS, tid, 0, &regs);
+
+    // a signal it has to get waits until it really runs again
+    TinyDbg_Thread *thread = find_thread(handle, tid);
+    int pending_signal = thread->pending_signal;
+    thread->pending_signal = 0;
+    int wstatus = step_thread(pm, tid);
+    // the seccomp filter may trap it, and a fork stops it before it returns - it goes on with the next step
+    while (WIFSTOPPED(wstatus) && (wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))
+                                   || wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_FORK << 8)))) {
+        wstatus = step_thread(pm, tid);
+    }
+
+    long result = -ESRCH;
+    if (WIFSTOPPED(wstatus)) {
+        ptrace(PTRACE_GETREGS, tid, 0, &regs);
+        result = regs.rax;
+        ptrace(PTRACE_SETREGS, tid, 0, &saved);
+        write_mem(handle, original, saved.rip, 2);
+    }
+    thread = find_thread(handle, tid);
+    if (thread != NULL) thread->pending_signal = pending_signal;
+    return result;
+}
+
+// A stopped thread that isn't in the middle of a syscall, which syscalls can be injected into. 0 if there isn't one.
+static pid_t injectable_thread(TinyDbg *handle, pid_t preferred) {
+    TinyDbg_Thread *thread = find_thread(handle, preferred);
+    if (thread != NULL && thread->is_stopped && !thread->in_syscall) return preferred;
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        if (handle->threads[i].is_stopped && !handle->threads[i].in_syscall) return handle->threads[i].tid;
+    }
+    return 0;
+}
+
+// Trampolines and copies of instructions go in mappings of their own near the code, so that a 5 byte jump reaches them
+#define SCRATCH_SIZE (64 * 1024)
+#define JUMP_REACH (0x7fffffffl - SCRATCH_SIZE)
+#define USER_SPACE_END 0x7ffffffff000ul
+
+static bool within_reach(uintptr_t a, uintptr_t b) {
+    return (a > b ? a - b : b - a) < (uintptr_t)JUMP_REACH;
+}
+
+// A free range near position that a scratch area fits in, from the gaps between the mappings of the process. 0 if there isn't one.
+static uintptr_t find_scratch_gap(TinyDbg *handle, uintptr_t position) {
+    pthread_mutex_lock(&handle->maps.lock);
+    if (!TinyDbg_MapTable_update(&handle->maps, handle->pid)) {
+        pthread_mutex_unlock(&handle->maps.lock);
+        return 0;
+    }
+    uintptr_t best = 0;
+    uintptr_t gap_begin = 0x10000;  // below mmap_min_addr nothing can be mapped
+    for (size_t i = 0; i <= handle->maps.len && gap_begin < USER_SPACE_END; i++) {
+        uintptr_t begin = i < handle->maps.len ? handle->maps.maps[i].begin : USER_SPACE_END;
+        uintptr_t end = i < handle->maps.len ? handle->maps.maps[i].end : USER_SPACE_END;
+        if (begin > USER_SPACE_END) begin = USER_SPACE_END;
+        if (begin >= gap_begin + SCRATCH_SIZE) {
+            // the end of the gap nearest to position
+            uintptr_t candidate = begin <= position ? begin - SCRATCH_SIZE : gap_begin;
+            if (within_reach(candidate, position)
+                    && (best == 0 || (candidate > position ? candidate - position : position - candidate)
+                                     < (best > position ? best - position : position - best))) {
+                best = candidate;
+            }
+        }
+        if (end > gap_begin) gap_begin = end;
+    }
+    pthread_mutex_unlock(&handle->maps.lock);
+    return best;
+}
+
+// Room for size bytes of code near position in a scratch area that's already there, 0 if there isn't any
+static uintptr_t take_scratch(struct procman *pm, uintptr_t position, size_t size) {
+    for (size_t i = 0; i < pm->scratch_len; i++) {
+        TinyDbg_ScratchArea *area = &pm->scratch[i];
+        if (area->used + size <= SCRATCH_SIZE && within_reach(area->begin, position)) {
+            area->used += size;
+            return area->begin + area->used - size;
+        }
+    }
+    return 0;
+}
+
+// Room for size bytes of code near position, in a new scratch area if it has to be. 0 if there isn't any.
+// Every thread has to be stopped, the syscall that maps it runs where tid is.
+static uintptr_t alloc_scratch(struct procman *pm, pid_t tid, uintptr_t position, size_t size) {
+    uintptr_t taken = take_scratch(pm, position, size);
+    if (taken != 0) return taken;
+
+    uintptr_t gap = find_scratch_gap(pm->handle, position);
+    if (gap == 0) return 0;
+    // the code is written through /proc/pid/mem, so the process itself never needs to write to it
+    long begin = inject_syscall(pm, tid, SYS_mmap, gap, SCRATCH_SIZE, PROT_READ | PROT_EXEC,
+                                MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if ((uintptr_t)begin != gap) {
+        if (begin >= 0 || begin <= -4096) inject_syscall(pm, tid, SYS_munmap, begin, SCRATCH_SIZE, 0, 0, 0, 0);  // an old kernel took it as a hint
+        return 0;
+    }
+    pm->scratch = realloc(pm->scratch, (pm->scratch_len + 1) * sizeof(TinyDbg_ScratchArea));
+    pm->scratch[pm->scratch_len++] = (TinyDbg_ScratchArea){ gap, size };
+    return gap;
+}
+
+// How a breakpoint at position that stays in is stepped over, which is found out (and its copy of the instruction
+// written) the first time it's needed
+static TinyDbg_Displaced displace_breakpoint(struct procman *pm, pid_t tid, uintptr_t position) {
+    TinyDbg *handle = pm->handle;
+    TinyDbg_Displaced displaced = { TinyDbg_displaced_none };
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_Breakpoint *breakpoint = TinyDbg_BreakpointIndex_find(&handle->breakpoints, position);
+    if (breakpoint != NULL) displaced = breakpoint->displaced;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    if (displaced.kind != TinyDbg_displaced_unknown) return displaced;
+
+    unsigned char code[15];  // the longest an instruction can be
+    ssize_t read = read_client_mem(handle, (char *)code, position, sizeof(code));
+    displaced.kind = TinyDbg_displaced_none;
+    if (read > 0) TinyDbg_Displaced_decode(code, read, position, &displaced);
+    if (displaced.kind == TinyDbg_displaced_copy || displaced.kind == TinyDbg_displaced_indirect_call) {
+        displaced.at = take_scratch(pm, position, TINYDBG_DISPLACED_MAX);
+        if (displaced.at == 0) {
+            // the other threads can't run while the syscall that maps a new area is where this one is, but it stays stopped
+            TinyDbg_Thread *thread = find_thread(handle, tid);
+            bool resumed = thread->resumed;
+            thread->resumed = false;
+            stop_threads(pm, 0);
+            displaced.at = alloc_scratch(pm, tid, position, TINYDBG_DISPLACED_MAX);
+            resume_threads(pm);
+            thread = find_thread(handle, tid);
+            if (thread != NULL) thread->resumed = resumed;
+        }
+        unsigned char copy[TINYDBG_DISPLACED_MAX];
+        size_t copy_len = displaced.at != 0 ? TinyDbg_Displaced_copy(code, position, &displaced, copy) : 0;
+        if (copy_len == 0 || write_mem(handle, copy, displaced.at, copy_len) != (ssize_t)copy_len) {
+            displaced.kind = TinyDbg_displaced_none;
+        }
+    }
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    breakpoint = TinyDbg_BreakpointIndex_find(&handle->breakpoints, position);
+    if (breakpoint != NULL) breakpoint->displaced = displaced;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return displaced;
+}
+
+// Runs the instruction under a breakpoint from where displaced says instead, so the breakpoint stays in and the other
+// threads can go on. A call is done right away, and a copy runs once the thread is continued - unless finish is set, or
+// it's a call whose return address has to be fixed, then it's stepped. regs are the thread's, at the breakpoint.
+// False if it can only be stepped over in place.
+static bool step_over_displaced(struct procman *pm, pid_t tid, struct user_regs_struct *regs, const TinyDbg_Displaced *displaced, bool finish) {
+    uintptr_t position = regs->rip;
+    uint64_t return_address = position + displaced->len;
+    if (displaced->kind == TinyDbg_displaced_call) {
+        if (write_mem(pm->handle, &return_address, regs->rsp - 8, 8) != 8) return false;
+        regs->rsp -= 8;
+        regs->rip = displaced->at;
+        ptrace(PTRACE_SETREGS, tid, 0, regs);
+        return true;
+    }
+    if (displaced->kind != TinyDbg_displaced_copy && displaced->kind != TinyDbg_displaced_indirect_call) return false;
+    regs->rip = displaced->at;
+    ptrace(PTRACE_SETREGS, tid, 0, regs);
+    if (!finish && displaced->kind == TinyDbg_displaced_copy) return true;
+
+    if (!WIFSTOPPED(step_thread(pm, tid))) return true;
+    ptrace(PTRACE_GETREGS, tid, 0, regs);
+    if (regs->rip == displaced->at) {
+        regs->rip = position;  // something else stopped it before it ran
+    } else if (regs->rip == displaced->at + displaced->copy_len) {
+        regs->rip = position + displaced->len;  // instead of the jump back
+    } else if (displaced->kind == TinyDbg_displaced_indirect_call) {
+        uint64_t pushed = 0;
+        read_mem(pm->handle, &pushed, regs->rsp, 8);
+        if (pushed == displaced->at + displaced->copy_len) write_mem(pm->handle, &return_address, regs->rsp, 8);
+    }
+    ptrace(PTRACE_SETREGS, tid, 0, regs);
+    return true;
+}
+
+static bool read_for_condition(void *arg, void *local, uintptr_t remote, size_t len) {
+    return read_client_mem(arg, local, remote, len) == (ssize_t)len;
+}
+
+// Handles a waitpid result of a thread in the process
+static void handle_status(struct procman *pm, TinyDbg_wait_status status) {
+    TinyDbg *handle = pm->handle;
+    int wstatus = status.wstatus;
+    TinyDbg_Thread *thread = find_thread(handle, status.tid);
+
+    if (status.is_child) {
+        // it's taken care of once the parent's PTRACE_EVENT_FORK is
+        if (WIFSTOPPED(wstatus)) {
+            pm->early_children = realloc(pm->early_children, (pm->early_children_len + 1) * sizeof(pid_t));
+            pm->early_children[pm->early_children_len++] = status.tid;
+        }
+        return;
+    }
+
+    if (WIFEXITED(wstatus) || WIFSIGNALED(wstatus)) {
+        remove_thread(handle, status.tid);
+        if (status.tid == handle->pid) {
+            // process is done, the main thread is always the last to be reported
+            TinyDbg_Event dbg_event;
+            dbg_event.type = TinyDbg_event_type_exit;
+            dbg_event.tid = status.tid;
+            dbg_event.content.stop_code = WIFEXITED(wstatus) ? WEXITSTATUS(wstatus) : 128 + WTERMSIG(wstatus);
+            send_event(handle, &dbg_event);
+        }
+        return;
+    }
+    if (!WIFSTOPPED(wstatus)) return;
+
+    if (thread == NULL) thread = new_thread(pm, status.tid);  // reported before its PTRACE_EVENT_CLONE
+    thread_stopped(pm, thread, wstatus);
+    thread->has_pending_status = false;
+
+    if (is_stop_trap(pm, wstatus) && (thread->is_new || thread->stop_requested)) {
+        // first stop of a new thread, or a stop that we asked for and came after some other stop
+        if (thread->is_new && any_watchpoints(handle)) write_debug_registers(handle, thread->tid);  // they aren't inherited
+        thread->is_new = false;
+        thread->stop_requested = false;
+        if (thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+
+    if (pm->seized && wstatus >> 16 == PTRACE_EVENT_STOP) {
+        // the process was stopped by job control (the signal that did it was reported already), or got a SIGCONT
+        if (thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+
+    if (wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_CLONE << 8))) {
+        unsigned long new_tid;
+        ptrace(PTRACE_GETEVENTMSG, status.tid, NULL, &new_tid);
+        watch_thread(handle, new_tid, false);
+        if (find_thread(handle, new_tid) == NULL) new_thread(pm, new_tid);
+        thread = find_thread(handle, status.tid);  // adding a thread moves them
+        if (thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+
+    int ptrace_event = wstatus >> 16;
+    if (ptrace_event == PTRACE_EVENT_FORK || ptrace_event == PTRACE_EVENT_VFORK) {
+        unsigned long child;
+        ptrace(PTRACE_GETEVENTMSG, status.tid, NULL, &child);
+        watch_thread(handle, child, true);
+        // a followed child is reported by the process manager loop once its debugger is up
+        if (handle_fork(pm, status.tid, child, ptrace_event == PTRACE_EVENT_VFORK, handle->flags & TINYDBG_FLAG_FOLLOW_FORK)) return;
+        thread = find_thread(handle, status.tid);
+        if (thread != NULL && thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+    if (ptrace_event == PTRACE_EVENT_VFORK_DONE) {
+        // the child exec'd or exited, so the memory is only ours again
+        if (pm->vforks != 0 && --pm->vforks == 0) write_breakpoint_bytes(handle, handle->pid, handle->mem_fd, true);
+        if (thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+    if (ptrace_event == PTRACE_EVENT_EXEC) {
+        unsigned long former_tid;
+        ptrace(PTRACE_GETEVENTMSG, status.tid, NULL, &former_tid);
+        forget_program(pm, former_tid);
+        TinyDbg_Event dbg_event;
+        dbg_event.type = TinyDbg_event_type_exec;
+        report_event(pm, status.tid, &dbg_event);
+        return;
+    }
+
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, thread->tid, 0, &regs);
+
+    if (WSTOPSIG(wstatus) == (SIGTRAP | 0x80) || wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))) {
+        // syscall stop, either from PTRACE_SYSCALL or trapped by the seccomp filter before the syscall runs
+        bool is_exit = false;
+        bool report = pm->syscall_tracing.enabled
+                      && (pm->syscall_tracing.set == NULL || syscall_set_has(pm->syscall_tracing.set, regs.orig_rax));
+        if (WSTOPSIG(wstatus) == SIGTRAP) {
+            // with PTRACE_SYSCALL the entry was already reported before the seccomp stop
+            if (thread->in_syscall) report = false;
+            thread->in_syscall = true;
+        } else {
+            is_exit = thread->in_syscall;
+            thread->in_syscall = !thread->in_syscall;
+        }
+        if (is_exit && changes_maps(regs.orig_rax)) TinyDbg_MapTable_invalidate(&handle->maps);
+
+        if (!report) {
+            if (thread->resumed) continue_thread(pm, thread);
+        } else {
+            TinyDbg_Event dbg_event;
+            dbg_event.type = TinyDbg_event_type_syscall;
+            dbg_event.content.syscall.id = regs.orig_rax;
+            dbg_event.content.syscall.is_exit = is_exit;
+            report_event(pm, status.tid, &dbg_event);
+        }
+        return;
+    }
+
+    TinyDbg_Watchpoint watchpoint;
+    if (wstatus >> 8 == SIGTRAP && watchpoint_hit(handle, thread->tid, &watchpoint)) {
+        TinyDbg_Event dbg_event;
+        dbg_event.type = TinyDbg_event_type_watchpoint;
+        dbg_event.content.watchpoint = watchpoint;
+        report_event(pm, status.tid, &dbg_event);
+        return;
+    }
+
+    // check whether this was a breakpoint
+    regs.rip--;
+
+    // only we replace conditions, and reading memory for one takes the lock - so it's evaluated without it
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_Breakpoint *found = TinyDbg_BreakpointIndex_find(&handle->breakpoints, regs.rip);
+    TinyDbg_Condition *condition = found != NULL ? found->condition : NULL;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    bool condition_true = condition == NULL || TinyDbg_Condition_eval(condition, &regs, read_for_condition, handle) != 0;
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    bool found_breakpoint = false;
+    bool ignored = !condition_true;
+    TinyDbg_Breakpoint breakpoint;
+    found = TinyDbg_BreakpointIndex_find(&handle->breakpoints, regs.rip);
+    if (found != NULL) {
+        found_breakpoint = true;
+        if (condition_true) {
+            found->hits++;
+            if (found->ignore_count != 0) {
+                found->ignore_count--;
+                ignored = true;
+            }
+        }
+        breakpoint = *found;
+        // if the breakpoint is set to be once, delete it from the list
+        if (breakpoint.is_once && !ignored) {
+            TinyDbg_BreakpointIndex_remove(&handle->breakpoints, regs.rip, NULL);
+            breakpoint.condition = NULL;
+            if (pm->coverage_mode) {
+                if (handle->coverage_len == handle->coverage_capacity) {
+                    handle->coverage_capacity = handle->coverage_capacity == 0 ? 64 : handle->coverage_capacity * 2;
+                    handle->coverage = realloc(handle->coverage, handle->coverage_capacity * sizeof(uintptr_t));
+                }
+                handle->coverage[handle->coverage_len++] = regs.rip;
+            }
+        }
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+
+    TinyDbg_Displaced displaced = { TinyDbg_displaced_none };
+    if (found_breakpoint && (ignored || !breakpoint.is_once)) displaced = displace_breakpoint(pm, status.tid, regs.rip);
+    thread = find_thread(handle, status.tid);
+
+    if (found_breakpoint && ignored) {
+        // not for the client - the instruction under it runs from elsewhere and the thread goes on
+        if (step_over_displaced(pm, status.tid, &regs, &displaced, false)) {
+            thread = find_thread(handle, status.tid);
+            if (thread != NULL && thread->is_stopped && thread->resumed) continue_thread(pm, thread);
+            return;
+        }
+        // or in place, with the other threads stopped so they can't run past it while it's removed. In non-stop mode
+        // too, since this happens on every hit.
+        stop_threads(pm, 0);
+        ptrace(PTRACE_SETREGS, status.tid, 0, &regs);
+        step_over_in_place(pm, status.tid, regs.rip, breakpoint.original);
+        resume_threads(pm);
+        return;
+    }
+
+    if (found_breakpoint && breakpoint.is_once && pm->coverage_mode) {
+        // coverage hit - it's recorded, so put back the instruction and keep going without an event
+        ptrace(PTRACE_SETREGS, thread->tid, 0, &regs);
+        poke_byte(handle, regs.rip, breakpoint.original, NULL);
+        if (thread->resumed) continue_thread(pm, thread);
+        return;
+    }
+
+    TinyDbg_Event dbg_event;
+    if (found_breakpoint) {
+        // we stopped on a breakpoint!!!
+        stop_for_client(pm, status.tid);
+        dbg_event.type = TinyDbg_event_type_breakpoint;
+        dbg_event.content.breakpoint = breakpoint;
+        // change the rip so it's just before the breakpoint
+        ptrace(PTRACE_SETREGS, status.tid, 0, &regs);
+        if (breakpoint.is_once) {
+            // revert the first instruction
+            write_mem(handle, &breakpoint.original, regs.rip, 1);
+        } else if (!step_over_displaced(pm, status.tid, &regs, &displaced, true)) {
+            // single step with the breakpoint taken out, which other threads could run past in non-stop mode
+            if (!step_over_in_place(pm, status.tid, regs.rip, breakpoint.original)) {
+                dbg_event.content.breakpoint.condition = NULL;  // freed along with it
+            }
+            // TODO what if the instruction that was there caused a different stop code?
+        }
+    } else {
+        dbg_event.type = TinyDbg_event_type_stop;
+        dbg_event.content.stop_code = WSTOPSIG(wstatus);
+        // a signal is passed on to the process, without PTRACE_SEIZE it may be our own SIGSTOP
+        if (pm->seized && wstatus >> 16 == 0 && WSTOPSIG(wstatus) != SIGTRAP) thread->pending_signal = WSTOPSIG(wstatus);
+    }
+    report_event(pm, status.tid, &dbg_event);
+    if (found_breakpoint && status.waited_ns != 0) TinyDbg_Histogram_record(&handle->stats->hit_to_event, pm->event_sent_ns - status.waited_ns);
+}
+
+// Maps the ring and the hit counters in the process, as a memfd it opens through our /proc/pid/fd
+static bool map_tracepoint_shared(struct procman *pm, pid_t tid) {
+    TinyDbg *handle = pm->handle;
+    size_t size = sizeof(TinyDbg_TracepointShared);
+    int fd = memfd_create("tinydbg-tracepoints", MFD_CLOEXEC);
+    if (fd == -1) return false;
+    void *local = MAP_FAILED;
+    if (ftruncate(fd, size) == 0) local = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (local == MAP_FAILED) {
+        close(fd);
+        return false;
+    }
+
+    // the path goes on its stack, past the red zone
+    char path[64];
+    size_t path_len = sprintf(path, "/proc/%d/fd/%d", getpid(), fd) + 1;
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, tid, 0, &regs);
+    uintptr_t path_address = (regs.rsp - 128 - sizeof(path)) & ~15ul;
+    long remote = -EFAULT;
+    if (write_mem(handle, path, path_address, path_len) == (ssize_t)path_len) {
+        long remote_fd = inject_syscall(pm, tid, SYS_openat, AT_FDCWD, path_address, O_RDWR | O_CLOEXEC, 0, 0, 0);
+        if (remote_fd >= 0) {
+            remote = inject_syscall(pm, tid, SYS_mmap, 0, size, PROT_READ | PROT_WRITE, MAP_SHARED, remote_fd, 0);
+            inject_syscall(pm, tid, SYS_close, remote_fd, 0, 0, 0, 0, 0);
+        }
+    }
+    close(fd);
+    if (remote < 0 && remote > -4096) {
+        munmap(local, size);
+        return false;
+    }
+    pm->tracepoint_shared = remote;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    handle->tracepoint_shared = local;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return true;
+}
+
+static TinyDbg_Tracepoint *find_tracepoint(TinyDbg *handle, uintptr_t position) {
+    for (size_t i = 0; i < handle->tracepoints_len; i++) {
+        if (handle->tracepoints[i].position == position) return &handle->tracepoints[i];
+    }
+    return NULL;
+}
+
+// Whether [begin, end) has a breakpoint or a part of a tracepoint in it
+static bool code_patched(TinyDbg *handle, uintptr_t begin, uintptr_t end) {
+    for (uintptr_t position = begin; position < end; position++) {
+        if (TinyDbg_BreakpointIndex_find(&handle->breakpoints, position) != NULL) return true;
+    }
+    for (size_t i = 0; i < handle->tracepoints_len; i++) {
+        TinyDbg_Tracepoint *tracepoint = &handle->tracepoints[i];
+        if (tracepoint->position < end && tracepoint->position + tracepoint->len > begin) return true;
+    }
+    return false;
+}
+
+// Puts a tracepoint's jump in the process. Every thread has to be stopped.
+static bool set_tracepoint(struct procman *pm, pid_t tid, uintptr_t position, bool record_hits) {
+    TinyDbg *handle = pm->handle;
+    tid = injectable_thread(handle, tid);
+    if (tid == 0 || pm->tracepoint_counters == TINYDBG_TRACEPOINTS_MAX) return false;
+    if (pm->tracepoint_shared == 0 && !map_tracepoint_shared(pm, tid)) return false;
+
+    TinyDbg_Tracepoint tracepoint = { 0 };
+    tracepoint.position = position;
+    tracepoint.record_hits = record_hits;
+    ssize_t read = read_mem(handle, tracepoint.original, position, TINYDBG_TRACEPOINT_DISPLACED_MAX);
+    if (read <= 0) return false;
+    tracepoint.len = TinyDbg_tracepoint_displaced_len((unsigned char *)tracepoint.original, read);
+    if (tracepoint.len == 0) return false;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    bool patched = code_patched(handle, position, position + tracepoint.len);
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    if (patched) return false;
+
+    tracepoint.trampoline = alloc_scratch(pm, tid, position, TINYDBG_TRAMPOLINE_MAX);
+    if (tracepoint.trampoline == 0) return false;
+    tracepoint.counter = pm->tracepoint_counters;
+    unsigned char code[TINYDBG_TRAMPOLINE_MAX];
+    size_t relocated_at;
+    size_t code_len = TinyDbg_tracepoint_trampoline(&tracepoint, pm->tracepoint_shared, code, &relocated_at);
+    if (code_len == 0 || write_mem(handle, code, tracepoint.trampoline, code_len) != (ssize_t)code_len) return false;
+    pm->tracepoint_counters++;
+
+    // a thread that's in the middle of the instructions goes on from the same place in their copy
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        struct user_regs_struct regs;
+        if (ptrace(PTRACE_GETREGS, handle->threads[i].tid, 0, &regs) == -1) continue;
+        if (regs.rip <= position || regs.rip >= position + tracepoint.len) continue;
+        regs.rip = tracepoint.trampoline + relocated_at + (regs.rip - position);
+        ptrace(PTRACE_SETREGS, handle->threads[i].tid, 0, &regs);
+    }
+
+    char jump[TINYDBG_TRACEPOINT_DISPLACED_MAX];
+    memset(jump, '\xcc', tracepoint.len);  // anything that jumps past the start traps instead of running half an instruction
+    jump[0] = '\xe9';
+    int32_t rel32 = tracepoint.trampoline - (position + 5);
+    memcpy(jump + 1, &rel32, sizeof(rel32));
+    write_mem(handle, jump, position, tracepoint.len);
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    if (handle->tracepoints_len == handle->tracepoints_capacity) {
+        handle->tracepoints_capacity = handle->tracepoints_capacity == 0 ? 8 : handle->tracepoints_capacity * 2;
+        handle->tracepoints = realloc(handle->tracepoints, handle->tracepoints_capacity * sizeof(TinyDbg_Tracepoint));
+    }
+    handle->tracepoints[handle->tracepoints_len++] = tracepoint;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return true;
+}
+
+// Puts back the instructions. The trampoline stays, a thread may be in it and it jumps back to them anyway.
+static void unset_tracepoint(TinyDbg *handle, uintptr_t position) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_Tracepoint *tracepoint = find_tracepoint(handle, position);
+    if (tracepoint != NULL) {
+        write_mem(handle, tracepoint->original, tracepoint->position, tracepoint->len);
+        *tracepoint = handle->tracepoints[--handle->tracepoints_len];
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+}
+
+// Forks a stopped thread into a copy of the process with only that thread, stopped where it is. The copy's parent is the
+// parent of the process (CLONE_PARENT), so the process never gets its SIGCHLD or sees it in a wait. The thread is in the
+// process, or it's the copy of a checkpoint whose memory is pid's mem_fd. Returns the copy's pid, or 0.
+static pid_t inject_fork(struct procman *pm, pid_t tid, pid_t pid, int mem_fd) {
+    struct user_regs_struct saved;
+    char original[2];
+    if (ptrace(PTRACE_GETREGS, tid, 0, &saved) == -1
+            || TinyDbg_memory_read(TinyDbg_memory_backend_any, pid, mem_fd, original, saved.rip, 2) != 2) {
+        return 0;
+    }
+    long child = -ESRCH;
+    if (find_thread(pm->handle, tid) != NULL) {
+        child = inject_syscall(pm, tid, SYS_clone, CLONE_PARENT | SIGCHLD, 0, 0, 0, 0, 0);
+    } else if (TinyDbg_memory_write(TinyDbg_memory_backend_any, pid, mem_fd, "\x0f\x05", saved.rip, 2) == 2) {
+        // a checkpoint's copy never runs anything else, so there's nothing to wait for or put aside
+        struct user_regs_struct regs = saved;
+        regs.rax = SYS_clone;
+        regs.rdi = CLONE_PARENT | SIGCHLD;
+        regs.rsi = 0;
+        regs.rdx = 0;
+        regs.r10 = 0;
+        regs.r8 = 0;
+        ptrace(PTRACE_SETREGS, tid, 0, &regs);
+        int wstatus;
+        do {
+            ptrace(PTRACE_SINGLESTEP, tid, NULL, NULL);
+            wstatus = wait_for_stop(pm, tid);
+        } while (WIFSTOPPED(wstatus) && (wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_SECCOMP << 8))
+                                         || wstatus >> 8 == (SIGTRAP | (PTRACE_EVENT_FORK << 8))));
+        if (WIFSTOPPED(wstatus)) {
+            ptrace(PTRACE_GETREGS, tid, 0, &regs);
+            child = regs.rax;
+            ptrace(PTRACE_SETREGS, tid, 0, &saved);
+            TinyDbg_memory_write(TinyDbg_memory_backend_any, pid, mem_fd, original, saved.rip, 2);
+        }
+    }
+    if (child <= 0) return 0;
+    watch_thread(pm->handle, child, true);
+    if (!take_child_stop(pm, child)) return 0;
+
+    // it's where the syscall returned, with the syscall in its memory
+    int child_fd = TinyDbg_memory_open(child);
+    bool restored = ptrace(PTRACE_SETREGS, child, 0, &saved) == 0
+                    && TinyDbg_memory_write(TinyDbg_memory_backend_any, child, child_fd, original, saved.rip, 2) == 2;
+    if (child_fd != -1) close(child_fd);
+    if (!restored) {
+        kill(child, SIGKILL);
+        return 0;
+    }
+    return child;
+}
+
+// Forks the process into a checkpoint from this thread, or another one that can run a syscall. NULL if none can.
+static TinyDbg_Checkpoint *make_checkpoint(struct procman *pm, pid_t tid) {
+    TinyDbg *handle = pm->handle;
+    tid = injectable_thread(handle, tid);
+    // a vforked child uses the memory, which doesn't have the breakpoints meanwhile
+    if (tid == 0 || pm->vforks != 0) return NULL;
+    pid_t pid = inject_fork(pm, tid, handle->pid, handle->mem_fd);
+    if (pid == 0) return NULL;
+
+    TinyDbg_Checkpoint *checkpoint = calloc(1, sizeof(TinyDbg_Checkpoint));
+    checkpoint->pid = pid;
+    checkpoint->tid = tid;
+    TinyDbg_BreakpointIndex_init(&checkpoint->breakpoints);
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (size_t i = 0; i < handle->breakpoints.len; i++) {
+        TinyDbg_Breakpoint breakpoint = handle->breakpoints.breakpoints[i];
+        breakpoint.condition = NULL;  // the current ones are used when it's restored
+        TinyDbg_BreakpointIndex_insert(&checkpoint->breakpoints, breakpoint);
+    }
+    checkpoint->tracepoints = malloc((handle->tracepoints_len + 1) * sizeof(TinyDbg_Tracepoint));
+    memcpy(checkpoint->tracepoints, handle->tracepoints, handle->tracepoints_len * sizeof(TinyDbg_Tracepoint));
+    checkpoint->tracepoints_len = handle->tracepoints_len;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    checkpoint->tracepoint_shared = pm->tracepoint_shared;
+    checkpoint->scratch = malloc((pm->scratch_len + 1) * sizeof(TinyDbg_ScratchArea));
+    memcpy(checkpoint->scratch, pm->scratch, pm->scratch_len * sizeof(TinyDbg_ScratchArea));
+    checkpoint->scratch_len = pm->scratch_len;
+
+    pm->checkpoints = realloc(pm->checkpoints, (pm->checkpoints_len + 1) * sizeof(TinyDbg_Checkpoint *));
+    pm->checkpoints[pm->checkpoints_len++] = checkpoint;
+    return checkpoint;
+}
+
+// Makes pid, which was forked from a checkpoint, the debugged process - with its only thread stopped for the client
+static void become_process(struct procman *pm, pid_t pid) {
+    TinyDbg *handle = pm->handle;
+    pthread_mutex_lock(&waiter_lock);
+    remove_watched_process(handle);
+    struct watched_thread *watched = find_watched(pid);
+    if (watched != NULL) {
+        watched->is_child = false;
+    } else {
+        add_watched_thread(pid, handle, false);
+    }
+    handle->pid = pid;
+    pthread_mutex_unlock(&waiter_lock);
+
+    pthread_mutex_lock(&handle->thread_lock);
+    for (size_t i = 0; i < handle->threads_len; i++) set_maps_unwatched(handle, &handle->threads[i], false);
+    handle->threads_len = 0;
+    pthread_mutex_unlock(&handle->thread_lock);
+    add_thread(handle, pid)->is_stopped = true;
+
+    // the stops of the old threads don't matter anymore
+    pthread_mutex_lock(&handle->status_lock);
+    size_t kept = 0;
+    for (size_t i = 0; i < handle->statuses_len; i++) {
+        TinyDbg_wait_status *status = &handle->statuses[i];
+        if (!status->is_child || status->tid == pid) continue;
+        handle->statuses[kept++] = *status;
+    }
+    handle->statuses_len = kept;
+    handle->process_gone = false;
+    pthread_mutex_unlock(&handle->status_lock);
+
+    pm->current_tid = pid;
+    pm->vforks = 0;
+    memory_replaced(handle);
+}
+
+// Kills the process (if it didn't exit) and forks the checkpoint's copy in its place. Its memory has the breakpoints
+// there were when the checkpoint was made, which are changed to the ones there are now.
+static bool restore_checkpoint(struct procman *pm, TinyDbg_Checkpoint *checkpoint) {
+    TinyDbg *handle = pm->handle;
+    if (checkpoint->pid == 0) return false;  // from before an execve
+
+    // there may be nothing left of the process to wait for, but there's the fork. The waiter thread says so after it
+    // hands over the exit, which we may have reported already.
+    pthread_mutex_lock(&waiter_lock);
+    pthread_mutex_lock(&handle->status_lock);
+    bool gone = handle->process_gone;
+    handle->process_gone = false;
+    pthread_mutex_unlock(&handle->status_lock);
+    pthread_mutex_unlock(&waiter_lock);
+    int mem_fd = TinyDbg_memory_open(checkpoint->pid);
+    pid_t pid = inject_fork(pm, checkpoint->pid, checkpoint->pid, mem_fd);
+    if (mem_fd != -1) close(mem_fd);
+    if (pid == 0) {
+        if (gone) process_gone(handle);
+        return false;
+    }
+
+    pid_t old_pid = handle->threads_len != 0 ? handle->pid : 0;
+    become_process(pm, pid);
+    if (old_pid != 0) kill(old_pid, SIGKILL);  // nobody waits for it anymore
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    if (handle->tracepoints_capacity < checkpoint->tracepoints_len) {
+        handle->tracepoints_capacity = checkpoint->tracepoints_len;
+        handle->tracepoints = realloc(handle->tracepoints, handle->tracepoints_capacity * sizeof(TinyDbg_Tracepoint));
+    }
+    memcpy(handle->tracepoints, checkpoint->tracepoints, checkpoint->tracepoints_len * sizeof(TinyDbg_Tracepoint));
+    handle->tracepoints_len = checkpoint->tracepoints_len;
+    if (checkpoint->tracepoint_shared == 0 && handle->tracepoint_shared != NULL) {
+        // the copy doesn't have it, a new one is mapped with the next tracepoint
+        munmap(handle->tracepoint_shared, sizeof(TinyDbg_TracepointShared));
+        handle->tracepoint_shared = NULL;
+        handle->tracepoint_tail = 0;
+    }
+
+    for (size_t i = 0; i < checkpoint->breakpoints.len; i++) {
+        TinyDbg_Breakpoint *then = &checkpoint->breakpoints.breakpoints[i];
+        TinyDbg_Breakpoint *now = TinyDbg_BreakpointIndex_find(&handle->breakpoints, then->position);
+        if (now == NULL) {
+            write_mem(handle, &then->original, then->position, 1);
+        } else {
+            // the byte may have been written to since, and the copy of the instruction is in the scratch areas it has
+            now->original = then->original;
+            now->displaced = then->displaced;
+        }
+    }
+    // backwards, since removing one moves the last one in its place
+    for (size_t i = handle->breakpoints.len; i-- > 0;) {
+        TinyDbg_Breakpoint *now = &handle->breakpoints.breakpoints[i];
+        if (TinyDbg_BreakpointIndex_find(&checkpoint->breakpoints, now->position) != NULL) continue;
+        bool in_tracepoint = false;
+        for (size_t j = 0; j < handle->tracepoints_len; j++) {
+            TinyDbg_Tracepoint *tracepoint = &handle->tracepoints[j];
+            if (now->position >= tracepoint->position && now->position < tracepoint->position + tracepoint->len) in_tracepoint = true;
+        }
+        if (in_tracepoint) {
+            // it was set after the tracepoint was unset, which is back
+            TinyDbg_BreakpointIndex_remove(&handle->breakpoints, now->position, NULL);
+            continue;
+        }
+        if (!poke_byte(handle, now->position, '\xcc', &now->original)) {
+            // not mapped in the copy
+            TinyDbg_BreakpointIndex_remove(&handle->breakpoints, now->position, NULL);
+            continue;
+        }
+        now->displaced = (TinyDbg_Displaced){ TinyDbg_displaced_unknown };
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+
+    pm->tracepoint_shared = checkpoint->tracepoint_shared;
+    pm->scratch = realloc(pm->scratch, (checkpoint->scratch_len + 1) * sizeof(TinyDbg_ScratchArea));
+    memcpy(pm->scratch, checkpoint->scratch, checkpoint->scratch_len * sizeof(TinyDbg_ScratchArea));
+    pm->scratch_len = checkpoint->scratch_len;
+    // the hit counters of tracepoints that are gone aren't handed out again
+    if (any_watchpoints(handle)) write_debug_registers(handle, pid);
+    return true;
+}
+
+static void free_checkpoint(struct procman *pm, TinyDbg_Checkpoint *checkpoint) {
+    for (size_t i = 0; i < pm->checkpoints_len; i++) {
+        if (pm->checkpoints[i] == checkpoint) pm->checkpoints[i] = pm->checkpoints[--pm->checkpoints_len];
+    }
+    if (checkpoint->pid != 0) kill(checkpoint->pid, SIGKILL);
+    TinyDbg_BreakpointIndex_destroy(&checkpoint->breakpoints);
+    free(checkpoint->tracepoints);
+    free(checkpoint->scratch);
+    free(checkpoint);
+}
+
+// Puts a thread that stopped on a breakpoint back on it, so that it runs the original instruction once it's removed
+static void rewind_breakpoint(TinyDbg *handle, pid_t tid) {
+    TinyDbg_Watchpoint watchpoint;
+    if (watchpoint_hit(handle, tid, &watchpoint)) return;  // the SIGTRAP wasn't from a breakpoint
+    struct user_regs_struct regs;
+    ptrace(PTRACE_GETREGS, tid, 0, &regs);
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    if (TinyDbg_BreakpointIndex_find(&handle->breakpoints, regs.rip - 1) != NULL) {
+        regs.rip--;
+        ptrace(PTRACE_SETREGS, tid, 0, &regs);
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+}
+
+// Whether a thread has a SIGTRAP it didn't get yet - PTRACE_INTERRUPT can stop it right after a breakpoint, before the signal
+static bool has_pending_sigtrap(pid_t tid) {
+    siginfo_t siginfo[16];
+    struct __ptrace_peeksiginfo_args args = { 0, 0, 16 };
+    int len = ptrace(PTRACE_PEEKSIGINFO, tid, &args, siginfo);
+    for (int i = 0; i < len; i++) {
+        if (siginfo[i].si_signo == SIGTRAP) return true;
+    }
+    return false;
+}
+
+// Leaves a process we attached to the way it was - every thread stopped first, then the breakpoints and watchpoints removed and
+// every thread detached, with the signals it didn't get yet
+static void detach(struct procman *pm) {
+    TinyDbg *handle = pm->handle;
+    stop_threads(pm, 0);
+
+    // a SIGTRAP would kill the process once it's not traced, so let the thread take it now
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        pid_t tid = handle->threads[i].tid;
+        if (!has_pending_sigtrap(tid)) continue;
+        ptrace(PTRACE_CONT, tid, NULL, NULL);
+        handle->threads[i].is_stopped = false;
+        int wstatus = wait_for_stop(pm, tid);
+        if (WIFSTOPPED(wstatus) && WSTOPSIG(wstatus) == SIGTRAP) rewind_breakpoint(handle, tid);
+    }
+
+    // children that were forked but not handled yet are let go like any other
+    pthread_mutex_lock(&handle->status_lock);
+    TinyDbg_wait_status *forks = malloc(handle->statuses_len * sizeof(TinyDbg_wait_status));
+    size_t forks_len = 0;
+    for (size_t i = 0; i < handle->statuses_len; i++) {
+        int event = handle->statuses[i].wstatus >> 16;
+        if (event == PTRACE_EVENT_FORK || event == PTRACE_EVENT_VFORK) forks[forks_len++] = handle->statuses[i];
+    }
+    pthread_mutex_unlock(&handle->status_lock);
+    for (size_t i = 0; i < forks_len; i++) {
+        unsigned long child;
+        ptrace(PTRACE_GETEVENTMSG, forks[i].tid, NULL, &child);
+        watch_thread(handle, child, true);
+        handle_fork(pm, forks[i].tid, child, forks[i].wstatus >> 16 == PTRACE_EVENT_VFORK, false);
+    }
+    free(forks);
+
+    // stops that weren't handled yet - a breakpoint has to run again without the \xcc, and a signal has to be delivered
+    pthread_mutex_lock(&handle->status_lock);
+    for (size_t i = 0; i < handle->statuses_len; i++) {
+        TinyDbg_Thread *thread = find_thread(handle, handle->statuses[i].tid);
+        int wstatus = handle->statuses[i].wstatus;
+        if (thread == NULL || !WIFSTOPPED(wstatus) || wstatus >> 16 != 0) continue;
+        if (WSTOPSIG(wstatus) == SIGTRAP) {
+            rewind_breakpoint(handle, thread->tid);
+        } else {
+            thread->pending_signal = WSTOPSIG(wstatus);
+        }
+    }
+    handle->statuses_len = 0;
+    handle->process_gone = true;  // nothing comes from it after this
+    pthread_mutex_unlock(&handle->status_lock);
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    size_t positions_len = handle->breakpoints.len;
+    uintptr_t *positions = malloc(positions_len * sizeof(uintptr_t));
+    for (size_t i = 0; i < positions_len; i++) positions[i] = handle->breakpoints.breakpoints[i].position;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    patch_breakpoints(handle, positions, positions_len, false, false, NULL);
+    free(positions);
+    // the trampolines and the shared mapping stay in the process, but nothing jumps to them anymore
+    while (handle->tracepoints_len != 0) unset_tracepoint(handle, handle->tracepoints[0].position);
+
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    memset(handle->watchpoints, 0, sizeof(handle->watchpoints));
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+
+    pthread_mutex_lock(&handle->thread_lock);
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        write_debug_registers(handle, handle->threads[i].tid);
+        // a thread in a group-stop stays stopped, like the rest of the process
+        ptrace(PTRACE_DETACH, handle->threads[i].tid, NULL, (void *)(long)handle->threads[i].pending_signal);
+    }
+    handle->threads_len = 0;
+    pthread_mutex_unlock(&handle->thread_lock);
+}
+
+struct process_manager_thread_args {
+    TinyDbg *handle;
+    const char *filename;
+    char *const *argv;
+    char *const *envp;
+    unsigned int flags;
+    uint64_t *syscall_filter;  // NULL if there's no seccomp filter
+    pid_t attach_pid;          // 0 to start the program
+    struct procman *parent;    // of the process that forked attach_pid, if it's followed
+};
+
+// Runs the program, and returns once it's stopped right after execve
+static void launch(struct procman *pm, const char *filename, char *const argv[], char *const envp[], unsigned int flags) {
+    TinyDbg *handle = pm->handle;
+    // the filter has to be built before forking, the child can't allocate
+    struct sock_fprog *seccomp_filter = pm->syscall_tracing.filter != NULL ? seccomp_filter_new(pm->syscall_tracing.filter) : NULL;
+    unsigned long options = PTRACE_O_EXITKILL  // don't let the traced process run after i'm done
+                            | PTRACE_O_TRACESYSGOOD  // syscall stops are SIGTRAP | 0x80
+                            | PTRACE_O_TRACECLONE  // new threads are traced too
+                            | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEVFORKDONE  // and so are children, for a while at least
+                            | (seccomp_filter != NULL ? PTRACE_O_TRACESECCOMP : 0);
+    int seize_pipe[2];
+    if (pm->seized) pipe2(seize_pipe, O_CLOEXEC);
+
+    // the child waits for the tracer before installing a seccomp filter or running, which a vfork parent can't do
+    pthread_mutex_lock(&waiter_lock);
+    pid_t child_pid = seccomp_filter != NULL || pm->seized ? fork() : vfork();
+    if (child_pid == 0) {
+        // am child
+        if (pm->seized) {
+            // the tracer writes a byte once it has seized me
+            char byte;
+            read(seize_pipe[0], &byte, 1);
+        } else {
+            // the real ptrace, a vforked child would time it into the stats of our thread, whose memory it shares
+            (ptrace)(PTRACE_TRACEME, 0, 0, 0);
+            // let the tracer set PTRACE_O_TRACESECCOMP first, the trapped syscalls fail with ENOSYS without it
+            if (seccomp_filter != NULL) raise(SIGSTOP);
+        }
+        if (seccomp_filter != NULL) {
+            prctl(PR_SET_NO_NEW_PRIVS, 1, 0, 0, 0);
+            prctl(PR_SET_SECCOMP, SECCOMP_MODE_FILTER, seccomp_filter);
+        }
+        if (flags & TINYDBG_FLAG_NO_ASLR) {
+            personality(ADDR_NO_RANDOMIZE);
+        }
+        execve(filename, argv, envp);
+        _exit(127);
+    }
+
+    handle->pid = child_pid;
+    pm->current_tid = child_pid;
+    watch_process(handle);  // from now on the waiter thread takes its statuses
+    pthread_mutex_unlock(&waiter_lock);
+
+    TinyDbg_wait_status status;
+    int exec_stop = SIGTRAP;
+    if (pm->seized) {
+        // the options go along with PTRACE_SEIZE, and execve is a PTRACE_EVENT_EXEC instead of a SIGTRAP
+        ptrace(PTRACE_SEIZE, child_pid, NULL, options | PTRACE_O_TRACEEXEC);
+        write(seize_pipe[1], "", 1);
+        close(seize_pipe[0]);
+        close(seize_pipe[1]);
+        exec_stop = SIGTRAP | (PTRACE_EVENT_EXEC << 8);
+        wait_status(handle, &status);
+    } else {
+        wait_status(handle, &status);  // stopped by the SIGTRAP of execve, or by the SIGSTOP before the seccomp filter
+        ptrace(PTRACE_SETOPTIONS, child_pid, NULL, options);
+    }
+    while (WIFSTOPPED(status.wstatus) && status.wstatus >> 8 != exec_stop) {
+        // skip the SIGSTOP and any seccomp stop until execve
+        ptrace(PTRACE_CONT, child_pid, NULL, NULL);
+        wait_status(handle, &status);
+    }
+    if (pm->seized && WIFSTOPPED(status.wstatus)) {
+        // PTRACE_EVENT_EXEC is inside execve, go on to where it returns like the SIGTRAP does
+        ptrace(PTRACE_SYSCALL, child_pid, NULL, NULL);
+        wait_status(handle, &status);
+    }
+    // the next execve is a PTRACE_EVENT_EXEC too
+    if (!pm->seized) ptrace(PTRACE_SETOPTIONS, child_pid, NULL, options | PTRACE_O_TRACEEXEC);
+    if (seccomp_filter != NULL) {
+        free(seccomp_filter->filter);
+        free(seccomp_filter);
+    }
+    add_thread(handle, child_pid)->is_stopped = true;
+}
+
+// Seizes every thread of a running process, and returns once they're stopped. There are no threads if it can't be traced.
+static void attach(struct procman *pm, pid_t pid) {
+    TinyDbg *handle = pm->handle;
+    // unlike a process we started (or a child of one) it's left running when we're gone, and a followed child may have
+    // inherited a seccomp filter
+    unsigned long options = PTRACE_O_TRACESYSGOOD | PTRACE_O_TRACECLONE | PTRACE_O_TRACEEXEC
+                            | PTRACE_O_TRACEFORK | PTRACE_O_TRACEVFORK | PTRACE_O_TRACEVFORKDONE
+                            | (handle->attached ? 0 : PTRACE_O_EXITKILL)
+                            | (pm->syscall_tracing.filter != NULL ? PTRACE_O_TRACESECCOMP : 0);
+    pthread_mutex_lock(&waiter_lock);
+    if (ptrace(PTRACE_SEIZE, pid, NULL, options) == -1) {
+        pthread_mutex_unlock(&waiter_lock);
+        return;
+    }
+    handle->pid = pid;
+    pm->current_tid = pid;
+    watch_process(handle);
+    pthread_mutex_unlock(&waiter_lock);
+    ptrace(PTRACE_INTERRUPT, pid, NULL, NULL);
+    add_thread(handle, pid)->stop_requested = true;
+
+    // threads that aren't seized yet can create more of them, once they all are the new ones are traced from the start
+    char path_str[32];
+    sprintf(path_str, "/proc/%d/task", pid);
+    bool seized_any = true;
+    while (seized_any) {
+        seized_any = false;
+        DIR *dir = opendir(path_str);
+        if (dir == NULL) break;
+        struct dirent *entry;
+        while ((entry = readdir(dir)) != NULL) {
+            pid_t tid = atoi(entry->d_name);
+            if (tid == 0 || find_thread(handle, tid) != NULL) continue;
+            // fails if it exited, or if it was traced from its creation
+            if (ptrace(PTRACE_SEIZE, tid, NULL, options) == -1) continue;
+            ptrace(PTRACE_INTERRUPT, tid, NULL, NULL);
+            add_thread(handle, tid)->stop_requested = true;
+            seized_any = true;
+        }
+        closedir(dir);
+    }
+    wait_for_stop(pm, 0);
+}
+
+// Requests that need threads stopped first, the rest don't touch the process
+static bool needs_stopping(TinyDbg_procman_request_type type) {
+    return type != TinyDbg_procman_request_type_continue
+        && type != TinyDbg_procman_request_type_coverage_mode
+        && type != TinyDbg_procman_request_type_batch
+        && type != TinyDbg_procman_request_type_free_checkpoint
+        && type != TinyDbg_procman_request_type_reset_stats
+        && type != TinyDbg_INTERNAL_procman_request_type_waitpid
+        && type != TinyDbg_INTERNAL_procman_request_type_detach;
+}
+
+// The thread a request is about
+static pid_t request_tid(struct procman *pm, TinyDbg_procman_request *data) {
+    pid_t tid = data->tid != 0 ? data->tid : pm->current_tid;
+    if (find_thread(pm->handle, tid) == NULL && pm->handle->threads_len != 0) tid = pm->handle->threads[0].tid;  // it exited
+    return tid;
+}
+
+// Which thread a request needs stopped, or 0 for all of them
+static pid_t stop_scope(struct procman *pm, TinyDbg_procman_request *data, pid_t tid) {
+    if (data->type == TinyDbg_procman_request_type_stop) return 0;
+    if (data->type == TinyDbg_procman_request_type_set_watchp || data->type == TinyDbg_procman_request_type_unset_watchp) {
+        return 0;  // every thread has its own debug registers
+    }
+    if (data->type == TinyDbg_procman_request_type_set_tracep || data->type == TinyDbg_procman_request_type_unset_tracep) {
+        return 0;  // no thread may run the instructions while they're replaced
+    }
+    if (data->type == TinyDbg_procman_request_type_checkpoint || data->type == TinyDbg_procman_request_type_restore) {
+        return 0;  // the memory is copied as it is, and the process is replaced as a whole
+    }
+    // in non-stop mode only the thread the request is about is stopped
+    return pm->non_stop ? tid : 0;
+}
 
-    while (true) {
-        pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);  // only cancel when waitpiding
-        pthread_mutex_lock(&handle->process_continued);  // wait for process to be continued, which is when the lock is unlocked
+// Does what a request asks for once the threads it needs are stopped, and frees its content
+static void run_request(struct procman *pm, TinyDbg_procman_request *data, pid_t tid) {
+    TinyDbg *handle = pm->handle;
+    if (data->type == TinyDbg_procman_request_type_continue) {
+        for (size_t i = 0; i < handle->threads_len; i++) {
+            if (data->tid == 0 || handle->threads[i].tid == data->tid) handle->threads[i].resumed = true;
+        }
+        if (pm->event_sent_ns != 0) TinyDbg_Histogram_record(&handle->stats->event_to_continue, monotonic_ns() - pm->event_sent_ns);
+        pm->event_sent_ns = 0;
+    } else if (data->type == TinyDbg_procman_request_type_coverage_mode) {
+        pm->coverage_mode = (bool)(size_t)data->content;
+    } else if (data->type == TinyDbg_procman_request_type_stop) {
+        for (size_t i = 0; i < handle->threads_len; i++) handle->threads[i].resumed = false;
+    } else if (data->type == TinyDbg_procman_request_type_get_regs) {
+        ptrace(PTRACE_GETREGS, tid, 0, data->content);
+    } else if (data->type == TinyDbg_procman_request_type_set_regs) {
+        ptrace(PTRACE_SETREGS, tid, 0, data->content);
+    } else if (data->type == TinyDbg_procman_request_type_get_mem) {
+        TinyDbg_procman_request_get_mem *x = data->content;
+        read_client_mem(handle, x->local_iov.iov_base, (uintptr_t)x->remote_iov.iov_base,
+                        x->local_iov.iov_len < x->remote_iov.iov_len ? x->local_iov.iov_len : x->remote_iov.iov_len);
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_set_mem) {
+        TinyDbg_procman_request_set_mem *x = data->content;
+        write_client_mem(handle, x->local_iov.iov_base, (uintptr_t)x->remote_iov.iov_base,
+                         x->local_iov.iov_len < x->remote_iov.iov_len ? x->local_iov.iov_len : x->remote_iov.iov_len);
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_set_breakp) {
+        // set a breakpoint
+        TinyDbg_procman_request_set_breakp *x = data->content;
+        TinyDbg_Breakpoint my_breakpoint;
+        my_breakpoint.is_once = x->is_once;
+        my_breakpoint.position = x->position;
+        my_breakpoint.condition = x->condition;
+        my_breakpoint.hits = 0;
+        my_breakpoint.ignore_count = x->ignore_count;
+        my_breakpoint.displaced = (TinyDbg_Displaced){ TinyDbg_displaced_unknown };
 
-        int wstatus;
-        waitpid(my_pid, &wstatus, 0);
-        pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+        pthread_mutex_lock(&handle->breakpoint_lock);
+        TinyDbg_Breakpoint *existing = TinyDbg_BreakpointIndex_find(&handle->breakpoints, x->position);
+        if (existing != NULL) {
+            // already there, don't read our own \xcc as the original
+            existing->is_once = x->is_once;
+            if (x->has_condition) {
+                TinyDbg_Condition_free(existing->condition);
+                existing->condition = x->condition;
+                existing->ignore_count = x->ignore_count;
+            }
+        } else if (poke_byte(handle, x->position, '\xcc', &my_breakpoint.original)) {
+            // write this breakpoint
+            TinyDbg_BreakpointIndex_insert(&handle->breakpoints, my_breakpoint);
+        } else {
+            // nothing to put it in, e.g. a library that isn't loaded yet
+            TinyDbg_Condition_free(my_breakpoint.condition);
+        }
+        pthread_mutex_unlock(&handle->breakpoint_lock);
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_unset_breakp) {
+        pthread_mutex_lock(&handle->breakpoint_lock);
+        TinyDbg_Breakpoint deleted_breakpoint;
+        bool was_set = TinyDbg_BreakpointIndex_remove(&handle->breakpoints, (uintptr_t)data->content, &deleted_breakpoint);
+        pthread_mutex_unlock(&handle->breakpoint_lock);
 
-        pthread_mutex_unlock(&handle->process_continued);
-        TinyDbg_procman_request *event = malloc(sizeof(TinyDbg_procman_request));
-        event->type = TinyDbg_INTERNAL_procman_request_type_waitpid;
-        event->content = (void *)(size_t)wstatus;
-        EventQueue_join(EventQueue_add_joinable(handle->eq_process_manager, event));  // let the manager lock now
+        if (was_set) {
+            // remove the \xcc
+            poke_byte(handle, deleted_breakpoint.position, deleted_breakpoint.original, NULL);
+            TinyDbg_Condition_free(deleted_breakpoint.condition);
+        }
+    } else if (data->type == TinyDbg_procman_request_type_set_breakps
+            || data->type == TinyDbg_procman_request_type_unset_breakps) {
+        TinyDbg_procman_request_set_breakps *x = data->content;
+        patch_breakpoints(handle, x->positions, x->len, data->type == TinyDbg_procman_request_type_set_breakps, x->is_once, x->set);
+        free(x->positions);
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_singlestep) {
+        step_thread(pm, tid);
+    } else if (data->type == TinyDbg_procman_request_type_stop_on_syscall) {
+        set_syscall_tracing(&pm->syscall_tracing, true, data->content);
+    } else if (data->type == TinyDbg_procman_request_type_no_stop_on_syscall) {
+        set_syscall_tracing(&pm->syscall_tracing, false, NULL);
+    } else if (data->type == TinyDbg_procman_request_type_set_watchp
+            || data->type == TinyDbg_procman_request_type_unset_watchp) {
+        // the client already changed handle->watchpoints
+        for (size_t i = 0; i < handle->threads_len; i++) write_debug_registers(handle, handle->threads[i].tid);
+    } else if (data->type == TinyDbg_procman_request_type_set_tracep) {
+        TinyDbg_procman_request_set_tracep *x = data->content;
+        bool placed = find_tracepoint(handle, x->position) == NULL && set_tracepoint(pm, tid, x->position, x->record_hits);
+        if (x->placed != NULL) *x->placed = placed;
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_unset_tracep) {
+        unset_tracepoint(handle, (uintptr_t)data->content);
+    } else if (data->type == TinyDbg_procman_request_type_checkpoint) {
+        *(TinyDbg_Checkpoint **)data->content = make_checkpoint(pm, tid);
+    } else if (data->type == TinyDbg_procman_request_type_restore) {
+        TinyDbg_procman_request_restore *x = data->content;
+        bool restored = restore_checkpoint(pm, x->checkpoint);
+        if (x->restored != NULL) *x->restored = restored;
+        free(x);
+    } else if (data->type == TinyDbg_procman_request_type_free_checkpoint) {
+        free_checkpoint(pm, data->content);
+    } else if (data->type == TinyDbg_procman_request_type_reset_stats) {
+        uint64_t *words = (uint64_t *)handle->stats;
+        for (size_t i = 0; i < sizeof(TinyDbg_Stats) / sizeof(uint64_t); i++) __atomic_store_n(&words[i], 0, __ATOMIC_RELAXED);
+    }
+}
+
+// The threads are stopped once for all the requests in the batch, and resumed once after the last of them
+static void run_batch(struct procman *pm, TinyDbg_procman_request_batch *batch) {
+    bool stopping = false;
+    pid_t only = 0;
+    for (size_t i = 0; i < batch->len; i++) {
+        TinyDbg_procman_request *data = &batch->requests[i];
+        if (!needs_stopping(data->type)) continue;
+        pid_t scope = stop_scope(pm, data, request_tid(pm, data));
+        only = !stopping || only == scope ? scope : 0;
+        stopping = true;
     }
+    if (stopping) stop_threads(pm, only);
 
-    pthread_cleanup_pop(0);
+    for (size_t i = 0; i < batch->len; i++) {
+        TinyDbg_procman_request *data = &batch->requests[i];
+        thread_request = data->type;
+        stats_add(&pm->handle->stats->requests[data->type], 1);
+        run_request(pm, data, request_tid(pm, data));
+    }
+    thread_request = TinyDbg_procman_request_type_batch;
+    // a continue in the batch takes effect here, so the requests after it still see the threads stopped
+    resume_threads(pm);
+    free(batch->requests);
+    free(batch);
 }
 
-struct process_manager_thread_args {
-    TinyDbg *handle;
-    const char *filename;
-    char *const *argv;
-    char *const *envp;
-    unsigned int flags;
-};
+// Opens a mapped file through map_files, which works even if it was replaced or deleted since, or its path is in another
+// mount namespace. The handle keeps one reference to each file. Called with symbol_lock.
+static TinyDbg_ElfFile *module_file(TinyDbg *handle, const TinyDbg_memory_map *map) {
+    char path_str[64];
+    sprintf(path_str, "/proc/%d/map_files/%lx-%lx", handle->pid, map->begin, map->end);
+    TinyDbg_ElfFile *file = TinyDbg_ElfFile_open(path_str);
+    if (file == NULL) file = TinyDbg_ElfFile_open(map->pathname);
+    if (file == NULL) return NULL;
 
-static void process_manager_thread(struct process_manager_thread_args *args) {
-    TinyDbg *handle = args->handle;
-    const char *filename = args->filename;
-    char *const *argv = args->argv;
-    char *const *envp = args->envp;
-    free(args);
+    for (size_t i = 0; i < handle->module_files_len; i++) {
+        if (handle->module_files[i] == file) {
+            TinyDbg_ElfFile_release(file);
+            return file;
+        }
+    }
+    handle->module_files = realloc(handle->module_files, (handle->module_files_len + 1) * sizeof(TinyDbg_ElfFile *));
+    handle->module_files[handle->module_files_len++] = file;
+    return file;
+}
 
-    pid_t child_pid = vfork();
-    if (child_pid == 0) {
-        // am child
-        ptrace(PTRACE_TRACEME, 0, 0, 0);
-        if (args->flags & TINYDBG_FLAG_NO_ASLR) {
-            personality(ADDR_NO_RANDOMIZE);
+// Makes the modules again if the maps were read again since. Called with symbol_lock.
+static void update_modules(TinyDbg *handle) {
+    TinyDbg_MapTable *table = &handle->maps;
+    pthread_mutex_lock(&table->lock);
+    if (!TinyDbg_MapTable_update(table, handle->pid)) table->len = 0;
+    if (table->reads == handle->modules_reads) {
+        pthread_mutex_unlock(&table->lock);
+        return;
+    }
+    handle->modules = realloc(handle->modules, table->len * sizeof(TinyDbg_Module));
+    handle->modules_len = table->len;
+    handle->modules_reads = table->reads;
+
+    TinyDbg_ElfFile *file = NULL;
+    for (size_t i = 0; i < table->len; i++) {
+        const TinyDbg_memory_map *map = &table->maps[i];
+        TinyDbg_Module *module = &handle->modules[i];
+        *module = (TinyDbg_Module){ map->begin, map->end, 0, NULL };
+        if (map->pathname[0] != '/') continue;
+        // the mappings of a file are next to each other, so it's opened once - the pathnames are interned
+        if (i == 0 || map->pathname != table->maps[i - 1].pathname) file = module_file(handle, map);
+        if (file != NULL && TinyDbg_ElfFile_bias(file, map->page_offset, map->begin, &module->bias)) module->file = file;
+    }
+    pthread_mutex_unlock(&table->lock);
+}
+
+static TinyDbg_Module *find_module(TinyDbg *handle, uintptr_t address) {
+    size_t low = 0, high = handle->modules_len;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (handle->modules[middle].end <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
         }
-        execve(filename, argv, envp);
-    } else {
-        bool is_stopped = true;
-        bool syscall_stop = false;
-        pthread_mutex_lock(&handle->process_continued);  // process is currently stopped
-        handle->pid = child_pid;
-        waitpid(child_pid, NULL, 0);
-        ptrace(PTRACE_SETOPTIONS, child_pid, NULL, PTRACE_O_EXITKILL);  // don't let the traced process run after i'm done
-
-        EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_process_manager);
-        void *data; EventQueue_consume(consumer, &data);  // i'm ready now, the creator should push an empty event
-
-        while (true) {
-            TinyDbg_procman_request *data;
-            if (EventQueue_consume(consumer, (void **)(&data)) == 'K') return EventQueue_destroy_consumer(consumer);
-            if (data->type == TinyDbg_procman_request_type_continue) {
-                // check wheter this was at a breakpoint, if so delete it
-                ptrace(syscall_stop ? PTRACE_SYSCALL : PTRACE_CONT, handle->pid, 0, 0);
-                is_stopped = false;
-                pthread_mutex_unlock(&handle->process_continued);  // process is currently continued
-            } else if (data->type == TinyDbg_INTERNAL_procman_request_type_waitpid) {
-                // got a stop code
-                int wstatus = (int)(size_t)data->content;
-                if (WIFEXITED(wstatus)) {
-                    // process is done
-                    TinyDbg_Event *dbg_event = malloc(sizeof(TinyDbg_Event));
-                    dbg_event->type = TinyDbg_event_type_exit;
-                    dbg_event->content.stop_code = WEXITSTATUS(wstatus);
-                    EventQueue_add(handle->eq_debugger_events, dbg_event);
-                } else if (WIFSTOPPED(wstatus)) {
-                    // process has stopped
-                    is_stopped = true;
-                    pthread_mutex_lock(&handle->process_continued);  // process is currently supposed to be stopped
-
-                    // check whether this was a breakpoint
-                    struct user_regs_struct regs;
-                    ptrace(PTRACE_GETREGS, handle->pid, 0, &regs);
-                    regs.rip--;
-
-                    pthread_mutex_lock(&handle->breakpoint_lock);
-                    bool found_breakpoint = false;
-                    TinyDbg_Breakpoint breakpoint;
-                    for (size_t i = 0; i < handle->breakpoints_len; i++) {
-                        if (handle->breakpoint_positions[i] == regs.rip) {
-                            // found!
-                            found_breakpoint = true;
-                            breakpoint = handle->breakpoints[i];
-                            // if the breakpoint is set to be once, delete it from the list
-                            if (breakpoint.is_once) {
-                                for (int j = i; j < handle->breakpoints_len - 1; j++) {
-                                    handle->breakpoint_positions[j] = handle->breakpoint_positions[j + 1];
-                                }
-                                for (int j = i; j < handle->breakpoints_len - 1; j++) {
-                                    handle->breakpoints[j] = handle->breakpoints[j + 1];
-                                }
-                                handle->breakpoints_len--;
-                            }
-                            break;
-                        }
-                    }
-                    pthread_mutex_unlock(&handle->breakpoint_lock);
-
-                    TinyDbg_Event *dbg_event = malloc(sizeof(TinyDbg_Event));
-                    if (found_breakpoint) {
-                        // we stopped on a breakpoint!!!
-                        dbg_event->type = TinyDbg_event_type_breakpoint;
-                        dbg_event->content.breakpoint = breakpoint;
-                        EventQueue_add(handle->eq_debugger_events, dbg_event);
-                        // change the rip so it's just before the breakpoint
-                        ptrace(PTRACE_SETREGS, handle->pid, 0, &regs);
-                        // revert the first instruction
-                        unsigned long mem = ptrace(PTRACE_PEEKTEXT, handle->pid, regs.rip, NULL);
-                        unsigned long original_mem = mem;
-                        ((char *)(&mem))[0] = breakpoint.original;
-                        ptrace(PTRACE_POKETEXT, handle->pid, regs.rip, mem);
-                        if (!breakpoint.is_once) {
-                            // single step, then return the breakpoint
-                            ptrace(PTRACE_SINGLESTEP, handle->pid, NULL, NULL);
-                            waitpid(handle->pid, NULL, 0);
-                            ptrace(PTRACE_POKETEXT, handle->pid, regs.rip, original_mem);
-                            // TODO what if the instruction that was there caused a different stop code?
-                        }
-                    } else {
-                        unsigned long mem = ptrace(PTRACE_PEEKTEXT, handle->pid, regs.rip - 1, NULL);  // look 2 bytes back
-                        // check for a syscall
-                        if (syscall_stop && WSTOPSIG(wstatus) == SIGTRAP && ((char *)(&mem))[0] == '\x0f' && ((char *)(&mem))[1] == '\x05') {
-                            // syscall!
-                            dbg_event->type = TinyDbg_event_type_syscall;
-                            dbg_event->content.syscall_id = regs.orig_rax;
-                            EventQueue_add(handle->eq_debugger_events, dbg_event);
-                        } else {
-                            // not a syscall
-                            dbg_event->type = TinyDbg_event_type_stop;
-                            dbg_event->content.stop_code = WSTOPSIG(wstatus);
-                            EventQueue_add(handle->eq_debugger_events, dbg_event);
-                        }
-                    }
-                }
-            } else if (data->type == TinyDbg_procman_request_type_stop
-                    || data->type == TinyDbg_procman_request_type_get_regs
-                    || data->type == TinyDbg_procman_request_type_set_regs
-                    || data->type == TinyDbg_procman_request_type_get_mem
-                    || data->type == TinyDbg_procman_request_type_set_mem
-                    || data->type == TinyDbg_procman_request_type_set_breakp
-                    || data->type == TinyDbg_procman_request_type_unset_breakp
-                    || data->type == TinyDbg_procman_request_type_singlestep
-                    || data->type == TinyDbg_procman_request_type_stop_on_syscall
-                    || data->type == TinyDbg_procman_request_type_no_stop_on_syscall) {  // stuff which needs stopping first
-                
-                if (!is_stopped) {
-                    pthread_cancel(handle->waiter_thread); pthread_join(handle->waiter_thread, NULL);  // stop the waitpiding
-                    pthread_mutex_lock(&handle->process_continued);  // process is currently supposed to be stopped
-                    kill(handle->pid, SIGSTOP);
-                    waitpid(handle->pid, NULL, 0);  // wait for it to stop
-                }
+    }
+    if (low == handle->modules_len || handle->modules[low].begin > address) return NULL;
+    return &handle->modules[low];
+}
 
-                if (data->type == TinyDbg_procman_request_type_get_regs) {
-                    ptrace(PTRACE_GETREGS, handle->pid, 0, data->content);
-                } else if (data->type == TinyDbg_procman_request_type_set_regs) {
-                    ptrace(PTRACE_SETREGS, handle->pid, 0, data->content);
-                } else if (data->type == TinyDbg_procman_request_type_get_mem) {
-                    TinyDbg_procman_request_get_mem *x = data->content;
-                    process_vm_readv(handle->pid, &x->local_iov, 1, &x->remote_iov, 1, 0);
-                    free(x);
-                } else if (data->type == TinyDbg_procman_request_type_set_mem) {
-                    TinyDbg_procman_request_set_mem *x = data->content;
-                    process_vm_writev(handle->pid, &x->local_iov, 1, &x->remote_iov, 1, 0);
-                    free(x);
-                } else if (data->type == TinyDbg_procman_request_type_set_breakp) {
-                    // set a breakpoint
-                    TinyDbg_procman_request_set_breakp *x = data->content;
-                    TinyDbg_Breakpoint my_breakpoint;
-                    my_breakpoint.is_once = x->is_once;
-                    my_breakpoint.position = x->position;
-
-                    unsigned long data_at_position = ptrace(PTRACE_PEEKTEXT, handle->pid, x->position, NULL);
-                    my_breakpoint.original = ((char *)(&data_at_position))[0];
-                    ((char *)(&data_at_position))[0] = '\xcc';
-                    ptrace(PTRACE_POKETEXT, handle->pid, x->position, data_at_position);  // write this with the \xcc in there
-
-                    // write this breakpoint
-                    pthread_mutex_lock(&handle->breakpoint_lock);
-                    handle->breakpoints_len++;
-
-                    handle->breakpoint_positions = realloc(handle->breakpoint_positions, sizeof(uintptr_t) * handle->breakpoints_len);
-                    handle->breakpoint_positions[handle->breakpoints_len - 1] = x->position;
-
-                    handle->breakpoints = realloc(handle->breakpoints, sizeof(TinyDbg_Breakpoint) * handle->breakpoints_len);
-                    handle->breakpoints[handle->breakpoints_len - 1] = my_breakpoint;
-
-                    pthread_mutex_unlock(&handle->breakpoint_lock);
-                    free(x);
-                } else if (data->type == TinyDbg_procman_request_type_unset_breakp) {
-                    pthread_mutex_lock(&handle->breakpoint_lock);
-                    // search for the breakpoint at this position
-                    size_t breakpoint_index = 0;
-                    for (; breakpoint_index < handle->breakpoints_len; breakpoint_index++) {
-                        if (handle->breakpoint_positions[breakpoint_index] == (uintptr_t)data->content) {
-                            break;
-                        }
-                    }
-                    TinyDbg_Breakpoint deleted_breakpoint = handle->breakpoints[breakpoint_index];
-
-                    // remove from the list
-                    for (int j = breakpoint_index; j < handle->breakpoints_len - 1; j++) {
-                        handle->breakpoint_positions[j] = handle->breakpoint_positions[j + 1];
-                    }
-                    for (int j = breakpoint_index; j < handle->breakpoints_len - 1; j++) {
-                        handle->breakpoints[j] = handle->breakpoints[j + 1];
-                    }
-                    handle->breakpoints_len--;
-                    pthread_mutex_unlock(&handle->breakpoint_lock);
-
-                    // remove the \xcc
-                    unsigned long data_at_position = ptrace(PTRACE_PEEKTEXT, handle->pid, deleted_breakpoint.position, NULL);
-                    ((char *)(&data_at_position))[0] = deleted_breakpoint.original;
-                    ptrace(PTRACE_POKETEXT, handle->pid, deleted_breakpoint.position, data_at_position);
-                } else if (data->type == TinyDbg_procman_request_type_singlestep) {
-                    ptrace(PTRACE_SINGLESTEP, handle->pid, NULL, NULL);
-                    waitpid(handle->pid, NULL, 0);
-                } else if (data->type == TinyDbg_procman_request_type_stop_on_syscall) {
-                    syscall_stop = true;
-                } else if (data->type == TinyDbg_procman_request_type_no_stop_on_syscall) {
-                    syscall_stop = false;
-                }
+// Where a stopped thread is and the return addresses up its frame pointers, within the part of the stack that was read.
+// Returns how many there are.
+static size_t walk_stack(const struct user_regs_struct *regs, const char *stack, uintptr_t stack_begin, size_t stack_len,
+                         uintptr_t *pcs) {
+    size_t depth = 0;
+    pcs[depth++] = regs->rip;
+    uintptr_t frame = regs->rbp;
+    while (depth < TINYDBG_PROFILE_DEPTH) {
+        // a frame is the caller's frame pointer and then the return address, and the callers' frames are further up
+        if (frame < stack_begin || frame + 16 > stack_begin + stack_len || frame % 8 != 0) break;
+        uintptr_t next, return_address;
+        memcpy(&next, stack + (frame - stack_begin), 8);
+        memcpy(&return_address, stack + (frame - stack_begin) + 8, 8);
+        if (return_address == 0) break;
+        pcs[depth++] = return_address - 1;  // in the call, a call at the end of a function returns to the next one
+        if (next <= frame) break;
+        frame = next;
+    }
+    return depth;
+}
 
-                if (!is_stopped) {
-                    pthread_create(&handle->waiter_thread, NULL, (void * (*)(void *))&waitpid_thread, handle);  // restart the waitpiding
-                    if (data->type != TinyDbg_procman_request_type_stop) {
-                        ptrace(syscall_stop ? PTRACE_SYSCALL : PTRACE_CONT, handle->pid, 0, 0);
-                    } else {
-                        is_stopped = true;
-                    }
-                }
-                // TODO what if this causes a race condition where the process continues before the thread is waitpid-ing?
-                pthread_mutex_unlock(&handle->process_continued);
-            }
+// Stops the running threads, records where each of them is, and continues them. Their stacks are read together.
+static void take_sample(struct procman *pm) {
+    TinyDbg *handle = pm->handle;
+    TinyDbg_Profile *profile = &handle->profile;
+    pthread_mutex_lock(&profile->lock);
+    profile->sample_pending = false;
+    bool running = profile->running;
+    pthread_mutex_unlock(&profile->lock);
+
+    // the threads that are stopped aren't doing anything
+    pid_t *tids = malloc(handle->threads_len * sizeof(pid_t));
+    size_t len = 0;
+    for (size_t i = 0; i < handle->threads_len; i++) {
+        if (!handle->threads[i].is_stopped && !handle->threads[i].is_new) tids[len++] = handle->threads[i].tid;
+    }
+    if (!running || len == 0) {
+        free(tids);
+        return;
+    }
 
-            free(data);
+    uint64_t begin = monotonic_ns();
+    stop_threads(pm, 0);
+    struct user_regs_struct *regs = malloc(len * sizeof(struct user_regs_struct));
+    struct iovec *local = malloc(len * sizeof(struct iovec));
+    struct iovec *remote = malloc(len * sizeof(struct iovec));
+    size_t *transferred = malloc(len * sizeof(size_t));
+    char *stacks = malloc(len * TINYDBG_PROFILE_STACK_BYTES);
+    size_t sampled = 0;
+    for (size_t i = 0; i < len; i++) {
+        TinyDbg_Thread *thread = find_thread(handle, tids[i]);
+        if (thread == NULL || !thread->is_stopped || ptrace(PTRACE_GETREGS, tids[i], 0, &regs[sampled]) == -1) continue;
+        local[sampled] = (struct iovec){ stacks + sampled * TINYDBG_PROFILE_STACK_BYTES, TINYDBG_PROFILE_STACK_BYTES };
+        remote[sampled] = (struct iovec){ (void *)(regs[sampled].rsp & ~7ull), TINYDBG_PROFILE_STACK_BYTES };
+        sampled++;
+    }
+    // the stack may end before the part that's read, then that segment is shorter
+    if (TinyDbg_memory_transfer_v(handle->pid, local, remote, sampled, transferred, false) == -1) {
+        memset(transferred, 0, sampled * sizeof(size_t));
+    }
+    resume_threads(pm);
+    uint64_t pause = monotonic_ns() - begin;
+
+    uintptr_t (*pcs)[TINYDBG_PROFILE_DEPTH] = malloc(len * sizeof(*pcs));
+    size_t *depths = malloc(len * sizeof(size_t));
+    size_t new_stacks = 0;  // moved to the front
+    pthread_mutex_lock(&profile->lock);
+    for (size_t i = 0; i < sampled; i++) {
+        depths[new_stacks] = walk_stack(&regs[i], local[i].iov_base, (uintptr_t)remote[i].iov_base, transferred[i], pcs[new_stacks]);
+        if (TinyDbg_Profile_add(profile, pcs[new_stacks], depths[new_stacks])) new_stacks++;
+    }
+    profile->stats.samples++;
+    profile->stats.stacks += sampled;
+    profile->stats.pause_total_ns += pause;
+    if (pause > profile->stats.pause_max_ns) profile->stats.pause_max_ns = pause;
+    pthread_mutex_unlock(&profile->lock);
+
+    // the names are looked up later, maybe once the process is gone, so the modules have to know these addresses by then
+    pthread_mutex_lock(&handle->symbol_lock);
+    bool known = true;
+    for (size_t i = 0; i < new_stacks && known; i++) {
+        for (size_t j = 0; j < depths[i] && known; j++) known = find_module(handle, pcs[i][j]) != NULL;
+    }
+    if (!known) update_modules(handle);
+    pthread_mutex_unlock(&handle->symbol_lock);
+
+    free(tids);
+    free(regs);
+    free(local);
+    free(remote);
+    free(transferred);
+    free(stacks);
+    free(pcs);
+    free(depths);
+}
+
+// A followed child's debugger starts out like its parent's - with the breakpoints it inherited and the same syscall stops -
+// and then the child is let out of the loop it waited in
+static void inherit_from_parent(struct procman *pm, struct procman *parent) {
+    TinyDbg *handle = pm->handle;
+    struct forked_child *forked = &parent->forked;
+    uint64_t *set = NULL;
+    if (parent->syscall_tracing.set != NULL) {
+        set = malloc(SYSCALL_SET_WORDS * sizeof(uint64_t));
+        memcpy(set, parent->syscall_tracing.set, SYSCALL_SET_WORDS * sizeof(uint64_t));
+    }
+    set_syscall_tracing(&pm->syscall_tracing, parent->syscall_tracing.enabled, set);
+    pm->coverage_mode = parent->coverage_mode;
+
+    // a vforked child has none, they're out of the memory it shares with its parent
+    if (!forked->is_vfork) {
+        pthread_mutex_lock(&parent->handle->breakpoint_lock);
+        for (size_t i = 0; i < parent->handle->breakpoints.len; i++) {
+            TinyDbg_Breakpoint breakpoint = parent->handle->breakpoints.breakpoints[i];
+            breakpoint.condition = TinyDbg_Condition_copy(breakpoint.condition);
+            TinyDbg_BreakpointIndex_insert(&handle->breakpoints, breakpoint);
         }
+        pthread_mutex_unlock(&parent->handle->breakpoint_lock);
     }
+    write_mem(handle, forked->original, forked->loop_at, 2);
 }
 
-TinyDbg *TinyDbg_start_advanced(const char *filename, char *const argv[], char *const envp[], unsigned int flags) {
-    // create the object
+// The child's debugger is up, so the fork is reported - the parent is stopped at it and the child where it returned
+static void report_fork(struct procman *pm, TinyDbg *child) {
+    TinyDbg *handle = pm->handle;
+    pthread_mutex_lock(&handle->thread_lock);
+    if (handle->children_len == handle->children_capacity) {
+        handle->children_capacity = handle->children_capacity == 0 ? 8 : handle->children_capacity * 2;
+        handle->children = realloc(handle->children, handle->children_capacity * sizeof(TinyDbg *));
+    }
+    handle->children[handle->children_len++] = child;
+    pthread_mutex_unlock(&handle->thread_lock);
+
+    TinyDbg_Event dbg_event;
+    dbg_event.type = TinyDbg_event_type_fork;
+    dbg_event.content.fork.pid = pm->forked.pid;
+    dbg_event.content.fork.handle = child;
+    pm->forked.pid = 0;
+    report_event(pm, pm->forked.tid, &dbg_event);
+}
+
+// A handle without a process yet. A child's sends its events along with its parent's.
+static TinyDbg *new_handle(unsigned int flags, TinyDbg *parent) {
     TinyDbg *result = calloc(1, sizeof(TinyDbg));
+    result->flags = flags;
+    result->parent = parent;
+    result->attached = parent != NULL && parent->attached;
+    result->mem_fd = -1;
+    result->stats = calloc(1, sizeof(TinyDbg_Stats));
+    if (flags & TINYDBG_FLAG_MEMORY_CACHE) TinyDbg_PageCache_init(&result->page_cache);
 
-    result->breakpoint_positions = malloc(0);
-    result->breakpoints = malloc(0);
-    result->breakpoints_len = 0;
+    TinyDbg_BreakpointIndex_init(&result->breakpoints);
     pthread_mutex_init(&result->breakpoint_lock, NULL);
+    pthread_mutex_init(&result->thread_lock, NULL);
+    pthread_mutex_init(&result->symbol_lock, NULL);
+    TinyDbg_MapTable_init(&result->maps);
+    TinyDbg_Profile_init(&result->profile);
+    pthread_mutex_init(&result->status_lock, NULL);
+    pthread_cond_init(&result->status_added, NULL);
 
-    pthread_mutex_init(&result->process_continued, NULL);
     result->eq_process_manager = EventQueue_new();
-    result->eq_debugger_events = EventQueue_new();
+    if (parent != NULL) {
+        result->eq_debugger_events = parent->eq_debugger_events;
+        result->event_ring = parent->event_ring;
+    } else {
+        result->eq_debugger_events = EventQueue_new();
+        if (flags & TINYDBG_FLAG_EVENT_RING) {
+            result->event_ring = malloc(sizeof(TinyDbg_EventRing));
+            TinyDbg_EventRing_init(result->event_ring, TINYDBG_EVENT_RING_LEN);
+        }
+    }
+    return result;
+}
+
+static void process_manager_thread(struct process_manager_thread_args *args) {
+    TinyDbg *handle = args->handle;
+    unsigned int flags = args->flags;
+    struct procman pm = { handle, { false, NULL, args->syscall_filter, false }, false,
+                          flags & TINYDBG_FLAG_NON_STOP, flags & TINYDBG_FLAG_SEIZE, 0 };
+    handle->tracer_tid = gettid();
+    thread_stats = handle->stats;
+    if (args->attach_pid != 0) {
+        attach(&pm, args->attach_pid);
+    } else {
+        launch(&pm, args->filename, args->argv, args->envp, flags);
+    }
+    handle->mem_fd = TinyDbg_memory_open(handle->pid);
+    if (args->parent != NULL && handle->threads_len != 0) inherit_from_parent(&pm, args->parent);
+    free(args);
+
+    TinyDbg_wait_status status;
+    EventQueue_Consumer *consumer = EventQueue_new_consumer(handle->eq_process_manager);
+    // i'm ready now, the creator should push an empty event - wakeups from the waiter thread can come before it
+    TinyDbg_procman_request *ready;
+    while (EventQueue_consume(consumer, (void **)&ready) != 'K' && ready != NULL) free(ready);
+
+    while (true) {
+        // in all-stop mode, stops that come while the client has the process stopped wait until it's continued
+        while (!held_for_client(&pm) && take_status(handle, &status)) {
+            handle_status(&pm, status);
+            if (pm.forked.pid == 0) continue;
+
+            // a followed child gets a process manager of its own, which seizes it - so each one waits and ptraces by
+            // itself, and only the waitpid results of all of them go through the waiter thread
+            TinyDbg *child = new_handle(flags | TINYDBG_FLAG_SEIZE, handle);
+            struct process_manager_thread_args *child_args = calloc(1, sizeof(struct process_manager_thread_args));
+            child_args->handle = child;
+            child_args->flags = child->flags;
+            if (pm.syscall_tracing.filter != NULL) {
+                child_args->syscall_filter = malloc(SYSCALL_SET_WORDS * sizeof(uint64_t));
+                memcpy(child_args->syscall_filter, pm.syscall_tracing.filter, SYSCALL_SET_WORDS * sizeof(uint64_t));
+            }
+            child_args->attach_pid = pm.forked.pid;
+            child_args->parent = &pm;
+            pthread_create(&child->process_manager_thread, NULL, (void * (*)(void *))&process_manager_thread, child_args);
+            EventQueue_join(EventQueue_add_joinable(child->eq_process_manager, NULL));
+            report_fork(&pm, child);
+        }
+        if (held_for_client(&pm)) mark_pending_statuses(handle);
+
+        TinyDbg_procman_request *data;
+        if (EventQueue_consume(consumer, (void **)(&data)) == 'K') {
+            free(pm.syscall_tracing.set);
+            free(pm.syscall_tracing.filter);
+            free(pm.scratch);
+            free(pm.early_children);
+            // an attached process has no PTRACE_O_EXITKILL, and the copies would be left stopped forever
+            while (pm.checkpoints_len != 0) free_checkpoint(&pm, pm.checkpoints[0]);
+            free(pm.checkpoints);
+            return EventQueue_destroy_consumer(consumer);
+        }
+        if (data->sent_ns != 0) TinyDbg_Histogram_record(&handle->stats->queue_wait, monotonic_ns() - data->sent_ns);
+        stats_add(&handle->stats->requests[data->type], 1);
+        thread_request = data->type;
+
+        if (data->type == TinyDbg_INTERNAL_procman_request_type_waitpid) {
+            // the waiter thread got a stop code, it's handled with the others at the top
+        } else if (data->type == TinyDbg_INTERNAL_procman_request_type_detach) {
+            detach(&pm);
+        } else if (data->type == TinyDbg_INTERNAL_procman_request_type_sample) {
+            take_sample(&pm);
+        } else if (data->type == TinyDbg_procman_request_type_batch) {
+            run_batch(&pm, data->content);
+        } else {
+            pid_t tid = request_tid(&pm, data);
+            bool stopping = needs_stopping(data->type);
+            if (stopping) stop_threads(&pm, stop_scope(&pm, data, tid));
+            run_request(&pm, data, tid);
+            // whatever was running before goes on running
+            if (stopping || data->type == TinyDbg_procman_request_type_continue) resume_threads(&pm);
+        }
+
+        thread_request = TINYDBG_REQUEST_TYPES;
+        free(data);
+    }
+}
+
+static TinyDbg *start(const char *filename, char *const argv[], char *const envp[], unsigned int flags, uint64_t *syscall_filter,
+                      pid_t attach_pid) {
+    // create the object
+    TinyDbg *result = new_handle(flags, NULL);
+    result->attached = attach_pid != 0;
 
-    struct process_manager_thread_args *procman_args = malloc(sizeof(struct process_manager_thread_args));
+    struct process_manager_thread_args *procman_args = calloc(1, sizeof(struct process_manager_thread_args));
     procman_args->handle = result;
     procman_args->filename = filename;
     procman_args->argv = argv;
     procman_args->envp = envp;
     procman_args->flags = flags;
+    procman_args->syscall_filter = syscall_filter;
+    procman_args->attach_pid = attach_pid;
 
     pthread_create(&result->process_manager_thread, NULL, (void * (*)(void *))&process_manager_thread, procman_args);
     // send empty join to process_manager_thread, it will return only once it's done ptracing
     EventQueue_join(EventQueue_add_joinable(result->eq_process_manager, NULL));
 
-    // create the waiter thread, now that the pid is defined
-    pthread_create(&result->waiter_thread, NULL, (void * (*)(void *))&waitpid_thread, result);
-
     return result;
 }
 
+TinyDbg *TinyDbg_start_advanced(const char *filename, char *const argv[], char *const envp[], unsigned int flags) {
+    return start(filename, argv, envp, flags, NULL, 0);
+}
+
+TinyDbg *TinyDbg_start_syscall_filtered(const char *filename, char *const argv[], char *const envp[], unsigned int flags,
+                                        const int *syscalls, size_t syscalls_len) {
+    return start(filename, argv, envp, flags, syscall_set_new(syscalls, syscalls_len), 0);
+}
+
 TinyDbg *TinyDbg_start(const char *filename, char *const argv[], char *const envp[]) {
     return TinyDbg_start_advanced(filename, argv, envp, 0);
 }
 
-void TinyDbg_free(TinyDbg *handle) {
-    free(handle->breakpoint_positions);
-    free(handle->breakpoints);
-    pthread_mutex_destroy(&handle->breakpoint_lock);
-
-    pthread_cancel(handle->waiter_thread);
-    pthread_join(handle->waiter_thread, NULL);
+TinyDbg *TinyDbg_attach(pid_t pid, unsigned int flags) {
+    TinyDbg *handle = start(NULL, NULL, NULL, flags | TINYDBG_FLAG_SEIZE, NULL, pid);
+    if (handle->threads_len == 0) {
+        // it couldn't be seized, or it exited meanwhile
+        TinyDbg_free(handle);
+        return NULL;
+    }
+    return handle;
+}
 
-    EventQueue_free(handle->eq_debugger_events);
+void TinyDbg_free(TinyDbg *handle) {
+    TinyDbg_profile_stop(handle);  // the timer thread sends requests
+    if (handle->attached) {
+        // the process goes on without us, so it's left as it was before
+        TinyDbg_procman_request *detach_request = calloc(1, sizeof(TinyDbg_procman_request));
+        detach_request->type = TinyDbg_INTERNAL_procman_request_type_detach;
+        EventQueue_join(EventQueue_add_joinable(handle->eq_process_manager, detach_request));
+    }
+    // nothing touches the rest once the waiter thread forgets about it and the process manager is done. A sample that was
+    // asked for before the timer stopped may be waiting for stops that won't be handed to it anymore.
+    unwatch_process(handle);
+    process_gone(handle);
+    if (handle->parent == NULL && handle->event_ring != NULL) TinyDbg_EventRing_close(handle->event_ring);
     EventQueue_free(handle->eq_process_manager);
-
     pthread_join(handle->process_manager_thread, NULL);
-    pthread_mutex_destroy(&handle->process_continued);
+
+    // the process manager added the children, and they send their events to our queue
+    while (handle->children_len != 0) TinyDbg_free(handle->children[handle->children_len - 1]);
+    free(handle->children);
+    if (handle->parent != NULL) {
+        TinyDbg *parent = handle->parent;
+        pthread_mutex_lock(&parent->thread_lock);
+        for (size_t i = 0; i < parent->children_len; i++) {
+            if (parent->children[i] == handle) parent->children[i] = parent->children[--parent->children_len];
+        }
+        pthread_mutex_unlock(&parent->thread_lock);
+    } else {
+        EventQueue_free(handle->eq_debugger_events);
+        if (handle->event_ring != NULL) {
+            TinyDbg_EventRing_destroy(handle->event_ring);
+            free(handle->event_ring);
+        }
+    }
+
+    TinyDbg_BreakpointIndex_destroy(&handle->breakpoints);
+    free(handle->tracepoints);
+    if (handle->tracepoint_shared != NULL) munmap(handle->tracepoint_shared, sizeof(TinyDbg_TracepointShared));
+    free(handle->coverage);
+    TinyDbg_MapTable_destroy(&handle->maps);
+    TinyDbg_Profile_destroy(&handle->profile);
+    free(handle->stats);
+    free(handle->modules);
+    for (size_t i = 0; i < handle->module_files_len; i++) TinyDbg_ElfFile_release(handle->module_files[i]);
+    free(handle->module_files);
+    if (handle->mem_fd != -1) close(handle->mem_fd);
+    TinyDbg_PageCache_destroy(&handle->page_cache);
+    free(handle->threads);
+    free(handle->statuses);
+    pthread_mutex_destroy(&handle->breakpoint_lock);
+    pthread_mutex_destroy(&handle->thread_lock);
+    pthread_mutex_destroy(&handle->symbol_lock);
+    pthread_mutex_destroy(&handle->status_lock);
+    pthread_cond_destroy(&handle->status_added);
 
     free(handle);
 }
 
-static EventQueue_JoinHandle *TinyDbg_send_procman_request(TinyDbg *handle, TinyDbg_procman_request_type type, void *content) {
+// The requests this thread collects between TinyDbg_batch_begin and TinyDbg_batch_submit
+static __thread struct {
+    TinyDbg *handle;
+    TinyDbg_procman_request *requests;
+    size_t len;
+    size_t capacity;
+} batch;
+
+static EventQueue_JoinHandle *send_thread_request(TinyDbg *handle, TinyDbg_procman_request_type type, pid_t tid, void *content) {
+    if (batch.handle == handle) {
+        if (batch.len == batch.capacity) {
+            batch.capacity = batch.capacity == 0 ? 16 : batch.capacity * 2;
+            batch.requests = realloc(batch.requests, batch.capacity * sizeof(TinyDbg_procman_request));
+        }
+        batch.requests[batch.len++] = (TinyDbg_procman_request){ type, tid, content };
+        return NULL;
+    }
     TinyDbg_procman_request *data = calloc(1, sizeof(TinyDbg_procman_request));
     data->type = type;
+    data->tid = tid;
     data->content = content;
+    data->sent_ns = monotonic_ns();
     return EventQueue_add_joinable(handle->eq_process_manager, data);
 }
 
+static EventQueue_JoinHandle *TinyDbg_send_procman_request(TinyDbg *handle, TinyDbg_procman_request_type type, void *content) {
+    return send_thread_request(handle, type, 0, content);
+}
+
 // Wrappers for the previous function
 EventQueue_JoinHandle *TinyDbg_stop(TinyDbg *handle) {
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_stop, NULL);
@@ -327,13 +2763,32 @@ EventQueue_JoinHandle *TinyDbg_get_registers(TinyDbg *handle, struct user_regs_s
 EventQueue_JoinHandle *TinyDbg_set_registers(TinyDbg *handle, struct user_regs_struct *take_from) {
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_regs, take_from);
 }
+EventQueue_JoinHandle *TinyDbg_thread_continue(TinyDbg *handle, pid_t tid) {
+    return send_thread_request(handle, TinyDbg_procman_request_type_continue, tid, NULL);
+}
+EventQueue_JoinHandle *TinyDbg_thread_singlestep(TinyDbg *handle, pid_t tid) {
+    return send_thread_request(handle, TinyDbg_procman_request_type_singlestep, tid, NULL);
+}
+EventQueue_JoinHandle *TinyDbg_thread_get_registers(TinyDbg *handle, pid_t tid, struct user_regs_struct *save_to) {
+    return send_thread_request(handle, TinyDbg_procman_request_type_get_regs, tid, save_to);
+}
+EventQueue_JoinHandle *TinyDbg_thread_set_registers(TinyDbg *handle, pid_t tid, struct user_regs_struct *take_from) {
+    return send_thread_request(handle, TinyDbg_procman_request_type_set_regs, tid, take_from);
+}
 EventQueue_JoinHandle *TinyDbg_stop_on_syscall(TinyDbg *handle) {
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_stop_on_syscall, NULL);
 }
+EventQueue_JoinHandle *TinyDbg_stop_on_syscalls(TinyDbg *handle, const int *syscalls, size_t syscalls_len) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_stop_on_syscall, syscall_set_new(syscalls, syscalls_len));
+}
 EventQueue_JoinHandle *TinyDbg_no_stop_on_syscall(TinyDbg *handle) {
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_no_stop_on_syscall, NULL);
 }
 
+EventQueue_JoinHandle *TinyDbg_coverage_mode(TinyDbg *handle, bool enabled) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_coverage_mode, (void *)(size_t)enabled);
+}
+
 EventQueue_JoinHandle *TinyDbg_get_memory(TinyDbg *handle, struct iovec local_iov, struct iovec remote_iov) {
     TinyDbg_procman_request_get_mem *x = malloc(sizeof(TinyDbg_procman_request_get_mem));
     x->local_iov = local_iov;
@@ -346,60 +2801,470 @@ EventQueue_JoinHandle *TinyDbg_set_memory(TinyDbg *handle, struct iovec local_io
     x->remote_iov = remote_iov;
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_mem, x);
 }
+ssize_t TinyDbg_get_memory_v(TinyDbg *handle, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred) {
+    ssize_t result = TinyDbg_memory_transfer_v(handle->pid, local_iov, remote_iov, iov_len, transferred, false);
+    for (size_t i = 0; i < iov_len; i++) {
+        if (transferred[i] != 0) hide_breakpoints(handle, local_iov[i].iov_base, (uintptr_t)remote_iov[i].iov_base, transferred[i]);
+    }
+    return result;
+}
+ssize_t TinyDbg_set_memory_v(TinyDbg *handle, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred) {
+    // like write_client_mem, with a copy of each segment that has breakpoints in it
+    struct iovec *writes = malloc((iov_len + 1) * sizeof(struct iovec));
+    char **copies = calloc(iov_len + 1, sizeof(char *));
+    TinyDbg_Breakpoint ***found = calloc(iov_len + 1, sizeof(TinyDbg_Breakpoint **));
+    size_t *found_lens = calloc(iov_len + 1, sizeof(size_t));
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (size_t i = 0; i < iov_len; i++) {
+        found[i] = cover_breakpoints(handle, local_iov[i].iov_base, &copies[i], (uintptr_t)remote_iov[i].iov_base,
+                                     remote_iov[i].iov_len, &found_lens[i]);
+        writes[i] = (struct iovec){ copies[i] != NULL ? copies[i] : local_iov[i].iov_base, local_iov[i].iov_len };
+    }
+    ssize_t result = TinyDbg_memory_transfer_v(handle->pid, writes, remote_iov, iov_len, transferred, true);
+    for (size_t i = 0; i < iov_len; i++) {
+        commit_originals(found[i], found_lens[i], local_iov[i].iov_base, (uintptr_t)remote_iov[i].iov_base, transferred[i]);
+        free(found[i]);
+        free(copies[i]);
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    // the process manager drops its cached pages before it uses them next
+    __atomic_store_n(&handle->page_cache_stale, true, __ATOMIC_RELEASE);
+    free(writes);
+    free(copies);
+    free(found);
+    free(found_lens);
+    return result;
+}
 EventQueue_JoinHandle *TinyDbg_set_breakpoint(TinyDbg *handle, uintptr_t position, bool is_once) {
     TinyDbg_procman_request_set_breakp *x = malloc(sizeof(TinyDbg_procman_request_set_breakp));
     x->position = position;
     x->is_once = is_once;
+    x->has_condition = false;
+    x->condition = NULL;
+    x->ignore_count = 0;
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_breakp, x);
+}
+EventQueue_JoinHandle *TinyDbg_set_conditional_breakpoint(TinyDbg *handle, uintptr_t position, bool is_once,
+                                                          TinyDbg_Condition *condition, uint64_t ignore_count) {
+    if (condition != NULL && !TinyDbg_Condition_verify(condition)) {
+        TinyDbg_Condition_free(condition);
+        return NULL;
+    }
+    TinyDbg_procman_request_set_breakp *x = malloc(sizeof(TinyDbg_procman_request_set_breakp));
+    x->position = position;
+    x->is_once = is_once;
+    x->has_condition = true;
+    x->condition = condition;
+    x->ignore_count = ignore_count;
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_breakp, x);
 }
 EventQueue_JoinHandle *TinyDbg_unset_breakpoint(TinyDbg *handle, uintptr_t position) {
     return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_unset_breakp, (void *)position);
 }
 
+static EventQueue_JoinHandle *send_breakpoints_request(TinyDbg *handle, TinyDbg_procman_request_type type, const uintptr_t *positions, size_t len, bool is_once, bool *set) {
+    TinyDbg_procman_request_set_breakps *x = malloc(sizeof(TinyDbg_procman_request_set_breakps));
+    x->positions = malloc(len * sizeof(uintptr_t));
+    memcpy(x->positions, positions, len * sizeof(uintptr_t));
+    x->len = len;
+    x->is_once = is_once;
+    x->set = set;
+    return TinyDbg_send_procman_request(handle, type, x);
+}
+EventQueue_JoinHandle *TinyDbg_set_breakpoints(TinyDbg *handle, const uintptr_t *positions, size_t len, bool is_once, bool *set) {
+    return send_breakpoints_request(handle, TinyDbg_procman_request_type_set_breakps, positions, len, is_once, set);
+}
+EventQueue_JoinHandle *TinyDbg_unset_breakpoints(TinyDbg *handle, const uintptr_t *positions, size_t len) {
+    return send_breakpoints_request(handle, TinyDbg_procman_request_type_unset_breakps, positions, len, false, NULL);
+}
+
+EventQueue_JoinHandle *TinyDbg_set_watchpoint(TinyDbg *handle, uintptr_t address, size_t len, TinyDbg_watchpoint_kind kind) {
+    if (len != 1 && len != 2 && len != 4 && len != 8) return NULL;
+    if (address % len != 0 || (kind == TinyDbg_watchpoint_kind_execute && len != 1)) return NULL;
+
+    // the slot is taken right away, so that running out of them can be told
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    int slot = -1;
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX; i++) {
+        if (handle->watchpoints[i].len != 0 && handle->watchpoints[i].address == address) slot = i;
+    }
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX && slot == -1; i++) {
+        if (handle->watchpoints[i].len == 0) slot = i;
+    }
+    if (slot != -1) handle->watchpoints[slot] = (TinyDbg_Watchpoint){ address, len, kind };
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+
+    if (slot == -1) return NULL;
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_watchp, NULL);
+}
+EventQueue_JoinHandle *TinyDbg_unset_watchpoint(TinyDbg *handle, uintptr_t address) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX; i++) {
+        if (handle->watchpoints[i].len != 0 && handle->watchpoints[i].address == address) handle->watchpoints[i].len = 0;
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_unset_watchp, NULL);
+}
+
+TinyDbg_Watchpoint *TinyDbg_list_watchpoints(TinyDbg *handle, size_t *watchpoints_len) {
+    TinyDbg_Watchpoint *clone = malloc(TINYDBG_WATCHPOINTS_MAX * sizeof(TinyDbg_Watchpoint));
+    *watchpoints_len = 0;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    for (int i = 0; i < TINYDBG_WATCHPOINTS_MAX; i++) {
+        if (handle->watchpoints[i].len != 0) clone[(*watchpoints_len)++] = handle->watchpoints[i];
+    }
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return clone;
+}
+
+EventQueue_JoinHandle *TinyDbg_set_tracepoint(TinyDbg *handle, uintptr_t position, bool record_hits, bool *placed) {
+    TinyDbg_procman_request_set_tracep *x = malloc(sizeof(TinyDbg_procman_request_set_tracep));
+    x->position = position;
+    x->record_hits = record_hits;
+    x->placed = placed;
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_set_tracep, x);
+}
+EventQueue_JoinHandle *TinyDbg_unset_tracepoint(TinyDbg *handle, uintptr_t position) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_unset_tracep, (void *)position);
+}
+
+TinyDbg_Tracepoint *TinyDbg_list_tracepoints(TinyDbg *handle, size_t *tracepoints_len) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    *tracepoints_len = handle->tracepoints_len;
+    size_t total_size = (*tracepoints_len) * sizeof(TinyDbg_Tracepoint);
+    TinyDbg_Tracepoint *clone = malloc(total_size);
+    memcpy(clone, handle->tracepoints, total_size);
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return clone;
+}
+
+EventQueue_JoinHandle *TinyDbg_checkpoint(TinyDbg *handle, TinyDbg_Checkpoint **checkpoint) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_checkpoint, checkpoint);
+}
+EventQueue_JoinHandle *TinyDbg_restore(TinyDbg *handle, TinyDbg_Checkpoint *checkpoint, bool *restored) {
+    TinyDbg_procman_request_restore *content = malloc(sizeof(TinyDbg_procman_request_restore));
+    content->checkpoint = checkpoint;
+    content->restored = restored;
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_restore, content);
+}
+EventQueue_JoinHandle *TinyDbg_free_checkpoint(TinyDbg *handle, TinyDbg_Checkpoint *checkpoint) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_free_checkpoint, checkpoint);
+}
+uint64_t TinyDbg_tracepoint_hit_count(TinyDbg *handle, uintptr_t position) {
+    uint64_t count = 0;
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_Tracepoint *tracepoint = find_tracepoint(handle, position);
+    if (tracepoint != NULL) count = __atomic_load_n(&handle->tracepoint_shared->hit_counts[tracepoint->counter].count, __ATOMIC_RELAXED);
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return count;
+}
+
+// The trampolines clear a hit's sequence before writing it and set it after, so a hit is copied whole if its sequence
+// is the one we expect both before and after copying it
+size_t TinyDbg_read_tracepoint_hits(TinyDbg *handle, TinyDbg_TracepointHit *hits, size_t max, uint64_t *lost) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    TinyDbg_TracepointShared *shared = handle->tracepoint_shared;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    if (shared == NULL) return 0;
+
+    uint64_t tail = handle->tracepoint_tail;
+    uint64_t head = __atomic_load_n(&shared->head, __ATOMIC_ACQUIRE);
+    if (head - tail > TINYDBG_TRACEPOINT_RING_LEN) {
+        *lost += head - tail - TINYDBG_TRACEPOINT_RING_LEN;
+        tail = head - TINYDBG_TRACEPOINT_RING_LEN;
+    }
+    size_t len = 0;
+    while (len < max && tail < head) {
+        TinyDbg_TracepointHit *slot = &shared->ring[tail % TINYDBG_TRACEPOINT_RING_LEN];
+        uint64_t sequence = __atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE);
+        if (sequence == 0 || sequence < tail + 1) {
+            // being written - by the hit we want, unless the ring went around since
+            if (__atomic_load_n(&shared->head, __ATOMIC_ACQUIRE) - tail <= TINYDBG_TRACEPOINT_RING_LEN) break;
+            (*lost)++;
+            tail++;
+            continue;
+        }
+        hits[len] = *slot;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (sequence == tail + 1 && __atomic_load_n(&slot->sequence, __ATOMIC_RELAXED) == sequence) {
+            len++;
+        } else {
+            (*lost)++;  // overwritten by a later hit
+        }
+        tail++;
+    }
+    handle->tracepoint_tail = tail;
+    return len;
+}
+
+void TinyDbg_batch_begin(TinyDbg *handle) {
+    batch.handle = handle;
+    batch.requests = NULL;
+    batch.len = 0;
+    batch.capacity = 0;
+}
+
+EventQueue_JoinHandle *TinyDbg_batch_submit(TinyDbg *handle) {
+    if (batch.handle != handle) return NULL;
+    TinyDbg_procman_request_batch *x = malloc(sizeof(TinyDbg_procman_request_batch));
+    x->requests = batch.requests;
+    x->len = batch.len;
+    batch.handle = NULL;
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_batch, x);
+}
+
 TinyDbg_Breakpoint *TinyDbg_list_breakpoints(TinyDbg *handle, size_t *breakpoints_len) {
     pthread_mutex_lock(&handle->breakpoint_lock);
 
-    *breakpoints_len = handle->breakpoints_len;
+    *breakpoints_len = handle->breakpoints.len;
     size_t total_size = (*breakpoints_len) * sizeof(TinyDbg_Breakpoint);
     TinyDbg_Breakpoint *clone = malloc(total_size);
-    memcpy(clone, handle->breakpoints, total_size);
+    memcpy(clone, handle->breakpoints.breakpoints, total_size);
+
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+    return clone;
+}
+
+TinyDbg_Thread *TinyDbg_list_threads(TinyDbg *handle, size_t *threads_len) {
+    pthread_mutex_lock(&handle->thread_lock);
+
+    *threads_len = handle->threads_len;
+    size_t total_size = (*threads_len) * sizeof(TinyDbg_Thread);
+    TinyDbg_Thread *clone = malloc(total_size);
+    memcpy(clone, handle->threads, total_size);
+
+    pthread_mutex_unlock(&handle->thread_lock);
+    return clone;
+}
+
+uintptr_t *TinyDbg_get_coverage(TinyDbg *handle, size_t *coverage_len) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+
+    *coverage_len = handle->coverage_len;
+    size_t total_size = (*coverage_len) * sizeof(uintptr_t);
+    uintptr_t *clone = malloc(total_size);
+    memcpy(clone, handle->coverage, total_size);
 
     pthread_mutex_unlock(&handle->breakpoint_lock);
     return clone;
 }
 
+void TinyDbg_clear_coverage(TinyDbg *handle) {
+    pthread_mutex_lock(&handle->breakpoint_lock);
+    handle->coverage_len = 0;
+    pthread_mutex_unlock(&handle->breakpoint_lock);
+}
+
 TinyDbg_memory_map *TinyDbg_get_memory_maps(TinyDbg *handle, size_t *maps_len) {
-    TinyDbg_memory_map *mem_maps;
-    *maps_len = 0;
+    TinyDbg_memory_map *mem_maps = NULL;
+    pthread_mutex_lock(&handle->maps.lock);
+    *maps_len = TinyDbg_MapTable_update(&handle->maps, handle->pid) ? handle->maps.len : 0;
+    if (*maps_len != 0) {
+        mem_maps = malloc(*maps_len * sizeof(TinyDbg_memory_map));
+        memcpy(mem_maps, handle->maps.maps, *maps_len * sizeof(TinyDbg_memory_map));
+    }
+    pthread_mutex_unlock(&handle->maps.lock);
+    return mem_maps;
+}
 
-    char path_str[22];
-    sprintf(path_str, "/proc/%d/maps", handle->pid);
-    FILE *fp = fopen(path_str, "r");
+bool TinyDbg_find_map(TinyDbg *handle, uintptr_t address, TinyDbg_memory_map *map) {
+    pthread_mutex_lock(&handle->maps.lock);
+    const TinyDbg_memory_map *found = NULL;
+    if (TinyDbg_MapTable_update(&handle->maps, handle->pid)) found = TinyDbg_MapTable_find(&handle->maps, address);
+    if (found != NULL) *map = *found;
+    pthread_mutex_unlock(&handle->maps.lock);
+    return found != NULL;
+}
+
+bool TinyDbg_symbolize(TinyDbg *handle, uintptr_t address, TinyDbg_Symbol *symbol) {
+    pthread_mutex_lock(&handle->symbol_lock);
+    TinyDbg_Module *module = find_module(handle, address);
+    if (module == NULL) {
+        // it may have been mapped since we last looked
+        update_modules(handle);
+        module = find_module(handle, address);
+    }
+    TinyDbg_ElfFile *file = module != NULL ? module->file : NULL;
+    uintptr_t bias = module != NULL ? module->bias : 0;
+    pthread_mutex_unlock(&handle->symbol_lock);
+    if (file == NULL) return false;
+
+    const TinyDbg_ElfSymbol *found = TinyDbg_ElfFile_find(file, address - bias);
+    if (found == NULL) return false;
+    *symbol = (TinyDbg_Symbol){ found->name, found->address + bias, found->size, bias, file };
+    return true;
+}
+
+uintptr_t TinyDbg_lookup_symbol(TinyDbg *handle, const char *name) {
+    uintptr_t address = 0;
+    pthread_mutex_lock(&handle->symbol_lock);
+    // a second time with the mappings as they are now, for a library that was loaded since
+    for (int attempt = 0; attempt < 2 && address == 0; attempt++) {
+        unsigned long reads = handle->modules_reads;
+        if (attempt == 1 || handle->modules_len == 0) update_modules(handle);
+        if (attempt == 1 && handle->modules_reads == reads) break;  // nothing changed
+        TinyDbg_ElfFile *last = NULL;
+        for (size_t i = 0; i < handle->modules_len && address == 0; i++) {
+            TinyDbg_Module *module = &handle->modules[i];
+            if (module->file == NULL || module->file == last) continue;
+            last = module->file;
+            const TinyDbg_ElfSymbol *found = TinyDbg_ElfFile_lookup(module->file, name);
+            if (found != NULL) address = found->address + module->bias;
+        }
+    }
+    pthread_mutex_unlock(&handle->symbol_lock);
+    return address;
+}
+
+// Asks the process manager for a sample at every tick. A tick that comes before the last sample was taken is skipped,
+// and one that's more than a period late isn't made up for.
+static void *profile_timer(void *arg) {
+    TinyDbg *handle = arg;
+    TinyDbg_Profile *profile = &handle->profile;
+    uint64_t period = 1000000000ull / profile->hz;
+    uint64_t next = monotonic_ns();
+    pthread_mutex_lock(&profile->lock);
+    while (true) {
+        next += period;
+        struct timespec deadline = { next / 1000000000ull, next % 1000000000ull };
+        int result = 0;
+        while (profile->running && result != ETIMEDOUT) result = pthread_cond_timedwait(&profile->changed, &profile->lock, &deadline);
+        if (!profile->running) break;
+
+        if (profile->sample_pending) {
+            profile->stats.missed++;
+        } else {
+            profile->sample_pending = true;
+            TinyDbg_procman_request *request = calloc(1, sizeof(TinyDbg_procman_request));
+            request->type = TinyDbg_INTERNAL_procman_request_type_sample;
+            EventQueue_add(handle->eq_process_manager, request);
+        }
+        uint64_t now = monotonic_ns();
+        if (now > next + period) {
+            profile->stats.missed += (now - next) / period;
+            next = now;
+        }
+    }
+    pthread_mutex_unlock(&profile->lock);
+    return NULL;
+}
+
+void TinyDbg_profile_start(TinyDbg *handle, unsigned int hz) {
+    TinyDbg_profile_stop(handle);
+    if (hz == 0) return;
+    TinyDbg_Profile *profile = &handle->profile;
+    pthread_mutex_lock(&profile->lock);
+    TinyDbg_Profile_clear(profile);
+    profile->hz = hz;
+    profile->running = true;
+    profile->started_ns = monotonic_ns();
+    pthread_mutex_unlock(&profile->lock);
+    pthread_create(&profile->timer, NULL, profile_timer, handle);
+}
+
+void TinyDbg_profile_stop(TinyDbg *handle) {
+    TinyDbg_Profile *profile = &handle->profile;
+    pthread_mutex_lock(&profile->lock);
+    bool running = profile->running;
+    if (running) {
+        profile->running = false;
+        profile->stats.elapsed_ns += monotonic_ns() - profile->started_ns;
+        pthread_cond_broadcast(&profile->changed);
+    }
+    pthread_mutex_unlock(&profile->lock);
+    if (running) pthread_join(profile->timer, NULL);
+}
+
+void TinyDbg_get_stats(TinyDbg *handle, TinyDbg_Stats *stats) {
+    // word by word, each of them may be changing
+    const uint64_t *from = (const uint64_t *)handle->stats;
+    uint64_t *to = (uint64_t *)stats;
+    for (size_t i = 0; i < sizeof(TinyDbg_Stats) / sizeof(uint64_t); i++) to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
+}
+
+EventQueue_JoinHandle *TinyDbg_reset_stats(TinyDbg *handle) {
+    return TinyDbg_send_procman_request(handle, TinyDbg_procman_request_type_reset_stats, NULL);
+}
+
+void TinyDbg_profile_stats(TinyDbg *handle, TinyDbg_ProfileStats *stats) {
+    pthread_mutex_lock(&handle->profile.lock);
+    *stats = handle->profile.stats;
+    if (handle->profile.running) stats->elapsed_ns += monotonic_ns() - handle->profile.started_ns;
+    pthread_mutex_unlock(&handle->profile.lock);
+}
+
+struct folded_line {
+    char *text;                 // the frames, without the count
+    uint64_t count;
+};
+
+static int compare_folded(const void *a, const void *b) {
+    return strcmp(((const struct folded_line *)a)->text, ((const struct folded_line *)b)->text);
+}
+
+char *TinyDbg_profile_folded(TinyDbg *handle) {
+    // a copy, the names are looked up without holding the lock
+    TinyDbg_Profile *profile = &handle->profile;
+    pthread_mutex_lock(&profile->lock);
+    size_t len = 0;
+    TinyDbg_ProfileStack *stacks = malloc((profile->stacks_len + 1) * sizeof(TinyDbg_ProfileStack));
+    for (size_t i = 0; i <= profile->stacks_mask; i++) {
+        TinyDbg_ProfileStack *stack = &profile->stacks[i];
+        if (stack->count == 0) continue;
+        stacks[len] = *stack;
+        stacks[len].pcs = malloc(stack->depth * sizeof(uintptr_t));
+        memcpy(stacks[len++].pcs, stack->pcs, stack->depth * sizeof(uintptr_t));
+    }
+    pthread_mutex_unlock(&profile->lock);
 
-    // read line by line
-    char *line = NULL;
-    ssize_t line_len;
-    size_t _ = 0;
-    while ((line_len = getline(&line, &_, fp)) != -1) {
-        TinyDbg_memory_map map;
-        map.pathname = malloc(line_len);  // it can't be any bigger
-        char perm[5];
-        char dev[5];
-        long inode;
-        sscanf(line, "%lx-%lx%c%c%c%c%c %lx %5s %ld %s", &map.begin, &map.end, &perm[0], &perm[1], &perm[2], &perm[3], &perm[4], &map.page_offset, dev, &inode, map.pathname);
-        map.perm_read = (perm[1] == 'r');
-        map.perm_write = (perm[2] == 'w');
-        map.perm_execute = (perm[3] == 'x');
-        map.perm_mayshare = (perm[4] == 'p');
-
-        mem_maps = realloc(mem_maps, (++(*maps_len)) * sizeof(TinyDbg_memory_map));
-        mem_maps[*maps_len - 1] = map;
+    // stacks in the same functions become the same line
+    struct folded_line *lines = malloc((len + 1) * sizeof(struct folded_line));
+    for (size_t i = 0; i < len; i++) {
+        char *text = NULL;
+        size_t text_len = 0;
+        FILE *fp = open_memstream(&text, &text_len);
+        for (size_t j = stacks[i].depth; j-- > 0;) {
+            TinyDbg_Symbol symbol;
+            if (TinyDbg_symbolize(handle, stacks[i].pcs[j], &symbol)) {
+                fprintf(fp, "%s%s", symbol.name, j != 0 ? ";" : "");
+            } else {
+                fprintf(fp, "0x%lx%s", stacks[i].pcs[j], j != 0 ? ";" : "");
+            }
+        }
+        fclose(fp);
+        lines[i] = (struct folded_line){ text, stacks[i].count };
+        free(stacks[i].pcs);
     }
+    free(stacks);
+    qsort(lines, len, sizeof(struct folded_line), compare_folded);
 
+    char *folded = NULL;
+    size_t folded_len = 0;
+    FILE *fp = open_memstream(&folded, &folded_len);
+    for (size_t i = 0; i < len; i++) {
+        uint64_t count = lines[i].count;
+        while (i + 1 < len && strcmp(lines[i].text, lines[i + 1].text) == 0) {
+            free(lines[i].text);
+            count += lines[++i].count;
+        }
+        fprintf(fp, "%s %lu\n", lines[i].text, count);
+        free(lines[i].text);
+    }
     fclose(fp);
-    return mem_maps;
+    free(lines);
+    return folded;
 }
 
 void TinyDbg_Event_free(TinyDbg_Event *event) {
     free(event);
 }
+
+size_t TinyDbg_poll_events(TinyDbg *handle, TinyDbg_Event *events, size_t max) {
+    if (handle->event_ring == NULL) return 0;
+    return TinyDbg_EventRing_poll(handle->event_ring, events, max);
+}
+
+size_t TinyDbg_wait_events(TinyDbg *handle, TinyDbg_Event *events, size_t max, int timeout_ms) {
+    if (handle->event_ring == NULL) return 0;
+    return TinyDbg_EventRing_wait(handle->event_ring, events, max, timeout_ms);
+}
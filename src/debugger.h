@@ -8,46 +8,555 @@
 #include <unistd.h>
 #include <stdint.h>
 #include <string.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stddef.h>
+#include <signal.h>
+#include <dirent.h>
+#include <elf.h>
+#include <lzma.h>
 #include <pthread.h>
 #include <sys/uio.h>
 #include <sys/wait.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
 #include <sys/user.h>
 #include <sys/ptrace.h>
+#include <sys/prctl.h>
 #include <sys/personality.h>
+#include <linux/audit.h>
+#include <linux/filter.h>
+#include <linux/seccomp.h>
 #include "../event_queue_c/event_queue.h"
 
+typedef enum {
+    TinyDbg_condition_op_const,         // pushes the operand
+    TinyDbg_condition_op_reg,           // pushes the register at byte offset operand of struct user_regs_struct
+    TinyDbg_condition_op_load,          // pops an address and pushes the operand (1, 2, 4 or 8) bytes there, zero-extended
+    TinyDbg_condition_op_sext,          // sign-extends the top from operand bits
+    TinyDbg_condition_op_add,           // the binary ones pop b and then a, and push a op b
+    TinyDbg_condition_op_sub,
+    TinyDbg_condition_op_mul,
+    TinyDbg_condition_op_and,
+    TinyDbg_condition_op_or,
+    TinyDbg_condition_op_xor,
+    TinyDbg_condition_op_shl,           // by b & 63
+    TinyDbg_condition_op_shr,
+    TinyDbg_condition_op_eq,            // the comparisons push 0 or 1, and are signed
+    TinyDbg_condition_op_ne,
+    TinyDbg_condition_op_lt,
+    TinyDbg_condition_op_le,
+    TinyDbg_condition_op_gt,
+    TinyDbg_condition_op_ge,
+    TinyDbg_condition_op_not,           // 1 if the top is 0, otherwise 0
+    TinyDbg_condition_op_neg,
+    TinyDbg_condition_op_bit_not,
+    TinyDbg_condition_op_jump_if_zero,  // if the top is 0 skips operand instructions and keeps it, otherwise pops it
+    TinyDbg_condition_op_jump_if_not_zero,
+} TinyDbg_condition_op;
+
+#define TINYDBG_CONDITION_MAX_CODE 256  // instructions
+#define TINYDBG_CONDITION_MAX_STACK 32
+
+typedef struct {
+    uint64_t operand;
+    TinyDbg_condition_op op;
+} TinyDbg_ConditionInstruction;
+
+// A condition of a breakpoint, which the process manager evaluates when it's hit. It's bytecode for a stack of 64 bit
+// values, and jumps only go forward - so it runs at most len instructions, and reads at most 8 bytes for each of them.
+typedef struct {
+    size_t len;
+    TinyDbg_ConditionInstruction code[];
+} TinyDbg_Condition;
+
+// Compiles a C-like expression over the registers and the memory, e.g. "rdi == 42 && u32[rsi + 8] > 3":
+// - the registers of struct user_regs_struct by name, and the low 32 bits of the general purpose ones (eax, r8d, ...)
+// - numbers in decimal, hex (0x) or octal (0)
+// - u8[a], u16[a], u32[a], u64[a] read memory, s8[a], s16[a], s32[a] read it sign-extended
+// - s8(x), s16(x), s32(x) sign-extend the low bits of x
+// - the C operators || && | ^ & == != < <= > >= << >> + - * ! ~ and unary -, with the precedence they have in C,
+//   except that comparisons are always signed
+// Returns NULL if it's not valid or too big, and then *error_at (if it's not NULL) is where in the source it went wrong.
+TinyDbg_Condition *TinyDbg_Condition_compile(const char *source, size_t *error_at);
+// Checks that the stack neither overflows nor runs out, and that the jumps stay in the code. Every condition has to pass
+// this before it's evaluated, which the compiled ones do.
+bool TinyDbg_Condition_verify(const TinyDbg_Condition *condition);
+TinyDbg_Condition *TinyDbg_Condition_copy(const TinyDbg_Condition *condition);
+void TinyDbg_Condition_free(TinyDbg_Condition *condition);
+// Reads len bytes of the memory of the process, false if it couldn't read all of them
+typedef bool (*TinyDbg_Condition_reader)(void *arg, void *local, uintptr_t remote, size_t len);
+// 1 if it's true, 0 if it's false, -1 if it read memory that couldn't be read
+int TinyDbg_Condition_eval(const TinyDbg_Condition *condition, const struct user_regs_struct *regs,
+                           TinyDbg_Condition_reader read, void *arg);
+
+// A breakpoint that stays in runs the instruction under it somewhere else, so no other thread can run past it while
+// it's taken out to be stepped over. Which way it's done depends on the instruction.
+typedef enum {
+    TinyDbg_displaced_unknown,          // it wasn't looked at yet
+    TinyDbg_displaced_copy,             // a copy at `at` runs it and jumps to the instruction after it
+    TinyDbg_displaced_indirect_call,    // a copy too, but the return address it pushes has to be fixed
+    TinyDbg_displaced_call,             // a relative call, done by pushing the return address and going to `at`
+    TinyDbg_displaced_none,             // it's stepped over in place, with the breakpoint taken out
+} TinyDbg_displaced_kind;
+
+#define TINYDBG_DISPLACED_MAX 32        // the copy of the instruction, which may grow when it's a jump, and the jump back
+
+typedef struct {
+    TinyDbg_displaced_kind kind;
+    uintptr_t at;
+    uint8_t len;                        // of the instruction
+    uint8_t copy_len;                   // of its copy, up to the jump back
+} TinyDbg_Displaced;
+
+// Decodes the instruction at position (code is len bytes of it, without breakpoints) and sets the kind and len of
+// displaced, and `at` for a call. The copies still need a place.
+void TinyDbg_Displaced_decode(const unsigned char *code, size_t len, uintptr_t position, TinyDbg_Displaced *displaced);
+// Writes the copy that runs at displaced->at, up to TINYDBG_DISPLACED_MAX bytes, and sets copy_len.
+// Returns its length, or 0 if it can't reach what it points to from there.
+size_t TinyDbg_Displaced_copy(const unsigned char *code, uintptr_t position, TinyDbg_Displaced *displaced, unsigned char *copy);
+
 // Breakpoints are stored in pointers.
-// They are freed with free() because they don't store any more pointers
+// They are freed with free() because they don't store any more pointers - the condition belongs to the breakpoint.
 typedef struct {
     uintptr_t position;   // where is the breakpoint
     bool is_once;         // whether or not to delete this breakpoint immediately after use
     char original;        // what was there before the breakpoint
+    TinyDbg_Condition *condition;   // only stop when it's true, NULL to always stop
+    uint64_t hits;        // times it was hit with the condition true, the ignored ones too
+    uint64_t ignore_count;          // how many more of those hits are ignored
+    TinyDbg_Displaced displaced;    // set up the first time it's stepped over
 } TinyDbg_Breakpoint;
 
+typedef enum {
+    TinyDbg_watchpoint_kind_execute,        // a hardware breakpoint, reported before the instruction runs
+    TinyDbg_watchpoint_kind_write,          // reported after the instruction that wrote
+    TinyDbg_watchpoint_kind_read_write,     // x86 can't watch only reads
+} TinyDbg_watchpoint_kind;
+
+// Watchpoints live in the debug registers of every thread, so there can only be a few of them.
+// Nothing is slowed down until one is hit.
+#define TINYDBG_WATCHPOINTS_MAX 4
+typedef struct {
+    uintptr_t address;
+    size_t len;                     // 1, 2, 4 or 8 and the address is aligned to it (1 for execute), 0 when the slot is empty
+    TinyDbg_watchpoint_kind kind;
+} TinyDbg_Watchpoint;
+
+typedef struct {
+    uintptr_t position;   // 0 when the slot is empty
+    size_t index;         // index of the breakpoint in the dense array
+} TinyDbg_BreakpointIndex_slot;
+
+// Breakpoints by position - an open addressing hash table (linear probing) pointing into a dense array.
+// The dense array makes listing a memcpy, and the table makes the lookup on every stop O(1).
+typedef struct {
+    TinyDbg_Breakpoint *breakpoints;        // dense array of breakpoints, removal moves the last one into the hole
+    size_t len;                             // how many breakpoints are there
+    size_t capacity;                        // allocated length of breakpoints
+    TinyDbg_BreakpointIndex_slot *slots;    // the hash table, its length is a power of two
+    size_t slots_mask;                      // length of slots minus one
+} TinyDbg_BreakpointIndex;
+
+void TinyDbg_BreakpointIndex_init(TinyDbg_BreakpointIndex *index);
+void TinyDbg_BreakpointIndex_destroy(TinyDbg_BreakpointIndex *index);
+// Returns NULL if there is no breakpoint at this position. The pointer is valid until the next insert or remove.
+TinyDbg_Breakpoint *TinyDbg_BreakpointIndex_find(TinyDbg_BreakpointIndex *index, uintptr_t position);
+// Adds a breakpoint, or overwrites the one that's already at the same position. The index owns the conditions.
+void TinyDbg_BreakpointIndex_insert(TinyDbg_BreakpointIndex *index, TinyDbg_Breakpoint breakpoint);
+// Returns false if there was no breakpoint at this position, otherwise copies it to removed (if it's not NULL), whose
+// condition is then the caller's to free
+bool TinyDbg_BreakpointIndex_remove(TinyDbg_BreakpointIndex *index, uintptr_t position, TinyDbg_Breakpoint *removed);
+
+typedef enum {
+    TinyDbg_memory_backend_any,         // /proc/pid/mem, falling back to the others when it fails
+    TinyDbg_memory_backend_proc_mem,    // pread/pwrite on /proc/pid/mem, any length and can write to read-only text
+    TinyDbg_memory_backend_process_vm,  // process_vm_readv/writev, can't write to read-only pages
+    TinyDbg_memory_backend_ptrace,      // PEEKDATA/POKEDATA, a syscall per word
+} TinyDbg_memory_backend;
+
+// Opens /proc/pid/mem for the memory backends, returns -1 on failure
+int TinyDbg_memory_open(pid_t pid);
+// Read or write the memory of a stopped process, the ptrace backend only works from the tracing thread.
+// Returns how many bytes were copied (less than len if it reached an unmapped page), or -1.
+ssize_t TinyDbg_memory_read(TinyDbg_memory_backend backend, pid_t pid, int mem_fd, void *local, uintptr_t remote, size_t len);
+ssize_t TinyDbg_memory_write(TinyDbg_memory_backend backend, pid_t pid, int mem_fd, const void *local, uintptr_t remote, size_t len);
+// Copies each local_iov[i] from/to remote_iov[i] with process_vm_readv/writev, IOV_MAX segments per syscall.
+// local_iov[i].iov_len must be remote_iov[i].iov_len - the syscall fills the local buffers as one stream, and the counts
+// are split by the remote lengths. transferred[i] is how many bytes of segment i were copied (0 for every segment after
+// an error that isn't about one segment), and the return value is the total.
+ssize_t TinyDbg_memory_transfer_v(pid_t pid, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred, bool write);
+
+typedef struct {
+    uintptr_t page;
+    unsigned long generation;           // the slot is empty unless this is the cache's generation
+    char *data;                         // PAGE_SIZE bytes, as the client should see them (without breakpoints)
+} TinyDbg_PageCache_slot;
+
+// Pages read from the process while it's stopped. Invalidating just moves to the next generation.
+typedef struct {
+    TinyDbg_PageCache_slot *slots;      // linear probing, NULL if the cache isn't enabled
+    size_t slots_mask;
+    size_t len;                         // how many pages are in the current generation
+    unsigned long generation;
+} TinyDbg_PageCache;
+
+void TinyDbg_PageCache_init(TinyDbg_PageCache *cache);
+void TinyDbg_PageCache_destroy(TinyDbg_PageCache *cache);
+void TinyDbg_PageCache_invalidate(TinyDbg_PageCache *cache);
+// Returns the cached page, or NULL
+char *TinyDbg_PageCache_find(TinyDbg_PageCache *cache, uintptr_t page);
+// Caches PAGE_SIZE bytes of data for this page and returns the cached copy
+char *TinyDbg_PageCache_insert(TinyDbg_PageCache *cache, uintptr_t page, const char *data);
+
+// Tracepoints are breakpoints that don't stop the process. The instructions at the position are replaced with a jump
+// to a trampoline in a mapping we add to the process, which counts the hit, records it in a ring buffer that's shared
+// with the debugger, runs the instructions it replaced and jumps back.
 typedef struct {
+    uint64_t sequence;      // index of the hit plus one once it's written, 0 while it's being written
+    uintptr_t position;     // the tracepoint that was hit
+    uint64_t args[6];       // rdi, rsi, rdx, rcx, r8 and r9 - the arguments, when it's at the start of a function
+} TinyDbg_TracepointHit;
+
+#define TINYDBG_TRACEPOINT_RING_LEN 65536   // hits kept until they're read, a power of two - older ones are overwritten
+#define TINYDBG_TRACEPOINTS_MAX 1024        // over the life of the process, a thread may still run an old trampoline
+#define TINYDBG_TRACEPOINT_DISPLACED_MAX 20 // the jump is 5 bytes, and the last instruction it cuts may be up to 15
+#define TINYDBG_TRAMPOLINE_MAX 192
+
+// Mapped in both processes. The hit counters have a cache line each so that different tracepoints don't share one.
+typedef struct {
+    uint64_t head;                          // hits recorded so far, the next one goes to ring[head % TINYDBG_TRACEPOINT_RING_LEN]
+    char head_padding[56];
+    struct {
+        uint64_t count;
+        char padding[56];
+    } hit_counts[TINYDBG_TRACEPOINTS_MAX];
+    TinyDbg_TracepointHit ring[TINYDBG_TRACEPOINT_RING_LEN];
+} TinyDbg_TracepointShared;
+
+typedef struct {
+    uintptr_t position;
+    uintptr_t trampoline;       // where its code is in the process
+    size_t len;                 // how many bytes of instructions the jump replaced, 5 or more
+    char original[TINYDBG_TRACEPOINT_DISPLACED_MAX];  // what was there before the jump
+    bool record_hits;           // otherwise the hits are only counted
+    size_t counter;             // index in hit_counts
+} TinyDbg_Tracepoint;
+
+// How many bytes of whole instructions at code have to be moved for a 5 byte jump, or 0 if one of them can't run
+// from somewhere else (a relative jump, or an instruction that isn't known)
+size_t TinyDbg_tracepoint_displaced_len(const unsigned char *code, size_t len);
+// Writes the code of a trampoline, which runs at tracepoint->trampoline, given where the shared mapping is in the process.
+// relocated_at is where the displaced instructions are in it. Returns the length, or 0 if they can't be moved that far.
+size_t TinyDbg_tracepoint_trampoline(const TinyDbg_Tracepoint *tracepoint, uintptr_t shared, unsigned char *code, size_t *relocated_at);
+
+// A mapping we added to the process for trampolines and copies of instructions
+typedef struct {
+    uintptr_t begin;
+    size_t used;
+} TinyDbg_ScratchArea;
+
+// A frozen copy of the process, from TinyDbg_checkpoint. It's forked from one thread of the process, which is the only
+// one it has, and it stays stopped under the debugger - so its memory is kept copy-on-write until it's freed.
+typedef struct {
+    pid_t pid;                          // of the copy
+    pid_t tid;                          // the thread it was forked from
+    TinyDbg_BreakpointIndex breakpoints;    // the ones in its memory, without their conditions
+    TinyDbg_Tracepoint *tracepoints;    // the ones in its memory
+    size_t tracepoints_len;
+    uintptr_t tracepoint_shared;        // where the mapping shared with us is in it, 0 if there's none
+    TinyDbg_ScratchArea *scratch;       // the ones in it
+    size_t scratch_len;
+} TinyDbg_Checkpoint;
+
+// A function or variable of an ELF file, at its address in the file (before it's relocated)
+typedef struct {
+    uintptr_t address;
+    size_t size;                // 0 if it isn't known
+    const char *name;           // in the file, which stays mapped as long as it's used
+    bool is_global;             // global or weak, rather than local to its object file
+} TinyDbg_ElfSymbol;
+
+typedef struct {
+    uint64_t offset;            // of a PT_LOAD segment in the file
+    uint64_t vaddr;             // where it's loaded before it's relocated
+    uint64_t filesz;
+} TinyDbg_ElfSegment;
+
+#define TINYDBG_BUILD_ID_MAX 20 // bytes, a SHA-1
+
+// The symbols of an ELF file, from .symtab, .dynsym and the .symtab of the compressed ELF file in .gnu_debugdata
+// (MiniDebugInfo). Every handle shares one per build ID, and the file is only mapped until they're needed.
+typedef struct {
+    char build_id[TINYDBG_BUILD_ID_MAX * 2 + 1];  // in hex, empty if it has none
+    dev_t device;               // tell that it's the same file before it's read, also when there's no build ID
+    ino_t inode;
+    struct timespec mtime;
+    unsigned int references;    // handles using it, it's freed by the last one
+    const unsigned char *image; // the whole file, mapped
+    size_t image_len;
+    TinyDbg_ElfSegment *segments;
+    size_t segments_len;
+
+    pthread_mutex_t lock;       // for reading the symbols the first time
+    bool loaded;                // whether the symbols were read
+    unsigned char *debugdata;   // the decompressed .gnu_debugdata, NULL if there's none
+    TinyDbg_ElfSymbol *symbols; // by address, and the one that names an address best comes first
+    size_t symbols_len;
+    uint32_t *by_name;          // indexes of symbols sorted by name, made on the first lookup by name
+} TinyDbg_ElfFile;
+
+// Opens an ELF file, or gets the one that's open already. Returns NULL if it isn't a 64 bit ELF file.
+TinyDbg_ElfFile *TinyDbg_ElfFile_open(const char *path);
+void TinyDbg_ElfFile_release(TinyDbg_ElfFile *file);
+// How much its addresses move when the page at page_offset in the file is mapped at begin.
+// False if that page isn't in a segment.
+bool TinyDbg_ElfFile_bias(const TinyDbg_ElfFile *file, uint64_t page_offset, uintptr_t begin, uintptr_t *bias);
+// The symbol an address in the file is in, or NULL. O(log n) once the symbols are read.
+const TinyDbg_ElfSymbol *TinyDbg_ElfFile_find(TinyDbg_ElfFile *file, uintptr_t address);
+// The symbol with this name, or NULL
+const TinyDbg_ElfSymbol *TinyDbg_ElfFile_lookup(TinyDbg_ElfFile *file, const char *name);
+
+// A mapping of the process, and the ELF file in it
+typedef struct {
+    uintptr_t begin;
+    uintptr_t end;
+    uintptr_t bias;             // added to the addresses in the file
+    TinyDbg_ElfFile *file;      // NULL if it isn't part of an ELF file
+} TinyDbg_Module;
+
+typedef struct {
+    unsigned long begin;
+    unsigned long end;
+    unsigned long page_offset;
+    bool perm_read;
+    bool perm_write;
+    bool perm_execute;
+    bool perm_mayshare;
+    char *pathname;             // empty for anonymous mappings
+} TinyDbg_memory_map;
+
+// The mappings of the process, parsed from /proc/pid/maps into memory that's reused every time it's read again. It's
+// read only after something may have changed them: a syscall stop of mmap, munmap, mprotect, brk (and the like), or a
+// thread that runs without those syscalls stopping it.
+typedef struct {
+    int fd;                             // /proc/pid/maps, -1 until it's first read
+    char *buffer;                       // the whole file
+    size_t buffer_capacity;
+    TinyDbg_memory_map *maps;           // by address
+    size_t len;
+    size_t capacity;
+
+    char **path_blocks;                 // the pathnames, each one once - never moved or freed until the table is
+    size_t path_blocks_len;
+    size_t path_block_used;             // of the last block
+    char **paths;                       // open addressing, into the blocks
+    size_t paths_mask;
+    size_t paths_len;
+
+    unsigned long generation;           // moved on when the mappings may have changed
+    unsigned long read_generation;      // of the maps that were read, if read_settled
+    bool read_settled;                  // no thread was running unwatched when they were read
+    unsigned int unwatched_threads;     // running threads that could change the mappings without us seeing it
+    unsigned long reads;                // how many times the maps were read, to tell when they're new
+    pthread_mutex_t lock;               // guards everything but generation and unwatched_threads
+} TinyDbg_MapTable;
+
+void TinyDbg_MapTable_init(TinyDbg_MapTable *table);
+void TinyDbg_MapTable_destroy(TinyDbg_MapTable *table);
+// Can be called by any thread, without the lock
+void TinyDbg_MapTable_invalidate(TinyDbg_MapTable *table);
+// Reads the maps of the process again if they may have changed. Called with the lock, false if the process is gone.
+bool TinyDbg_MapTable_update(TinyDbg_MapTable *table, pid_t pid);
+// The mapping an address is in, or NULL. Called with the lock.
+const TinyDbg_memory_map *TinyDbg_MapTable_find(const TinyDbg_MapTable *table, uintptr_t address);
+
+#define TINYDBG_PROFILE_DEPTH 128        // frames kept of a sampled stack
+#define TINYDBG_PROFILE_STACK_BYTES 16384 // read from the stack pointer up, the frame pointers are followed only in it
+
+// A stack the profiler saw, and how many times
+typedef struct {
+    uint64_t hash;
+    uint64_t count;             // 0 if the slot is empty
+    size_t depth;
+    uintptr_t *pcs;             // the innermost first. The callers' return addresses are moved back into the call.
+} TinyDbg_ProfileStack;
+
+typedef struct {
+    uint64_t samples;           // times the process was stopped for a sample
+    uint64_t stacks;            // stacks recorded, one for each thread that was running
+    uint64_t missed;            // ticks that came before the last sample was taken
+    uint64_t pause_total_ns;    // the process was stopped for the samples this long, out of elapsed_ns
+    uint64_t pause_max_ns;
+    uint64_t elapsed_ns;        // of profiling
+} TinyDbg_ProfileStats;
+
+// Samples of where the threads are. A timer thread asks the process manager for one at every tick, which stops the
+// process, reads the registers and the stacks, and continues it right away.
+typedef struct {
+    TinyDbg_ProfileStack *stacks;       // open addressing by hash
+    size_t stacks_mask;
+    size_t stacks_len;
+    TinyDbg_ProfileStats stats;
+
+    unsigned int hz;
+    bool running;                       // the timer thread stops once this is false
+    bool sample_pending;                // asked for a sample that wasn't taken yet
+    uint64_t started_ns;                // CLOCK_MONOTONIC, when it was started
+    pthread_t timer;
+    pthread_mutex_t lock;               // guards everything, the process manager adds samples and any thread reads them
+    pthread_cond_t changed;             // signalled when it's stopped
+} TinyDbg_Profile;
+
+void TinyDbg_Profile_init(TinyDbg_Profile *profile);
+void TinyDbg_Profile_destroy(TinyDbg_Profile *profile);
+// Forgets the stacks and the stats. Called with the lock.
+void TinyDbg_Profile_clear(TinyDbg_Profile *profile);
+// Counts a stack once more, and returns whether it wasn't seen before. Called with the lock.
+bool TinyDbg_Profile_add(TinyDbg_Profile *profile, const uintptr_t *pcs, size_t depth);
+
+#define TINYDBG_HISTOGRAM_SUB_BITS 4
+#define TINYDBG_HISTOGRAM_SUB_BUCKETS (1 << TINYDBG_HISTOGRAM_SUB_BITS)
+#define TINYDBG_HISTOGRAM_BUCKETS ((65 - TINYDBG_HISTOGRAM_SUB_BITS) * TINYDBG_HISTOGRAM_SUB_BUCKETS)
+
+// Latencies in nanoseconds, HDR-style - every power of two is split into TINYDBG_HISTOGRAM_SUB_BUCKETS buckets, so a
+// value is known to within 1/16 of it at any magnitude, and recording one is a few adds
+typedef struct {
+    uint64_t count;
+    uint64_t sum;
+    uint64_t max;
+    uint64_t buckets[TINYDBG_HISTOGRAM_BUCKETS];
+} TinyDbg_Histogram;
+
+// Only one thread records into a histogram, any thread can read it meanwhile
+void TinyDbg_Histogram_record(TinyDbg_Histogram *histogram, uint64_t value);
+// The value that percentile percent of the recorded ones are at or below, rounded up to the end of its bucket
+uint64_t TinyDbg_Histogram_percentile(const TinyDbg_Histogram *histogram, double percentile);
+
+// A thread of the debugged process, as the process manager sees it
+typedef struct {
+    pid_t tid;
+    bool is_stopped;            // in a ptrace stop
+    bool resumed;               // supposed to be running - stops nobody asked for continue it right away
+    bool stop_requested;        // was sent a SIGSTOP (or PTRACE_INTERRUPT) that it didn't report yet
+    bool is_new;                // just created, and its first stop wasn't seen yet
+    bool has_pending_status;    // a stop was put aside while waiting for another thread, and wasn't handled yet
+    bool in_syscall;            // between the entry and the exit of a syscall
+    bool group_stopped;         // in a group-stop (only known with PTRACE_SEIZE), so it's restarted with PTRACE_LISTEN
+    int pending_signal;         // delivered when it's resumed - only with PTRACE_SEIZE, where our stops aren't signals
+    bool maps_unwatched;        // running, and could change the mappings without a syscall stop that tells us
+} TinyDbg_Thread;
+
+typedef struct {
+    pid_t tid;
+    int wstatus;
+    bool is_child;              // a process that the debugged one forked, rather than one of its threads
+    uint64_t waited_ns;         // CLOCK_MONOTONIC, when waitpid returned it
+} TinyDbg_wait_status;
+
+typedef struct TinyDbg_EventRing TinyDbg_EventRing;
+typedef struct TinyDbg_Stats TinyDbg_Stats;
+
+typedef struct TinyDbg TinyDbg;
+struct TinyDbg {
     pid_t pid;                          // debugged process pid
+    unsigned int flags;                 // TINYDBG_FLAG_* given when starting
+    bool attached;                      // started with TinyDbg_attach, so it's detached rather than killed
+    TinyDbg *parent;                    // the debugger of the process that forked this one, with TINYDBG_FLAG_FOLLOW_FORK
+    TinyDbg **children;                 // the debuggers of the children it followed, guarded by thread_lock
+    size_t children_len;
+    size_t children_capacity;
+    int mem_fd;                         // /proc/pid/mem, kept open by the process manager
+    TinyDbg_PageCache page_cache;       // only used by the process manager, with TINYDBG_FLAG_MEMORY_CACHE
+    bool page_cache_stale;              // set by TinyDbg_set_memory_v, so the process manager drops the cached pages
 
-    uintptr_t *breakpoint_positions;    // array of breakpoint positions
-    TinyDbg_Breakpoint *breakpoints;    // array of breakpoint data, with the same indexes, this is for locality (cpu caching)
-    size_t breakpoints_len;             // how many breakpoints are there
+    TinyDbg_BreakpointIndex breakpoints;    // all of the breakpoints, by position
     pthread_mutex_t breakpoint_lock;    // accessing breakpoints may not require reading memory from the process - so you don't have to wait for the process manager
+    TinyDbg_Watchpoint watchpoints[TINYDBG_WATCHPOINTS_MAX];  // by debug register, guarded by breakpoint_lock
 
-    pthread_t waiter_thread;            // this thread is used for waitpid-ing in the background
-    pthread_t process_manager_thread;   // this thread manages the process - ptraces and reads/writes to memory
+    TinyDbg_Tracepoint *tracepoints;    // guarded by breakpoint_lock
+    size_t tracepoints_len;
+    size_t tracepoints_capacity;
+    TinyDbg_TracepointShared *tracepoint_shared;  // our side of the mapping the trampolines write to, NULL until there's one
+    uint64_t tracepoint_tail;           // the next hit to read
+
+    uintptr_t *coverage;                // positions of one-shot breakpoints hit in coverage mode, in hit order - guarded by breakpoint_lock
+    size_t coverage_len;
+    size_t coverage_capacity;
+
+    TinyDbg_MapTable maps;              // the mappings of the process, which any thread can look up
+
+    TinyDbg_Module *modules;            // every mapping of the process by address, made again when the maps are read again
+    size_t modules_len;
+    unsigned long modules_reads;        // the reads of the maps they were made from
+    TinyDbg_ElfFile **module_files;     // every file that was in a module, held until the handle is freed so names stay valid
+    size_t module_files_len;
+    pthread_mutex_t symbol_lock;        // guards the modules, which any thread can look up
+
+    TinyDbg_Profile profile;
+
+    TinyDbg_Thread *threads;            // every thread of the process, only changed by the process manager
+    size_t threads_len;
+    size_t threads_capacity;
+    pthread_mutex_t thread_lock;        // taken for adding or removing threads, and for listing them from other threads
 
-    pthread_mutex_t process_continued;  // locked/unlocked by manager when the process is continued
+    TinyDbg_wait_status *statuses;      // waitpid results that the process manager didn't handle yet
+    size_t statuses_len;
+    size_t statuses_capacity;
+    pthread_mutex_t status_lock;
+    pthread_cond_t status_added;        // signalled by the waiter thread for every status, and once the process is gone
+    bool process_gone;                  // the main thread exited, so there is nothing left to wait for
+    bool procman_waiting;               // the process manager waits on status_added, so it doesn't need a request to wake up
+
+    pthread_t process_manager_thread;   // this thread manages the process - ptraces and reads/writes to memory
+    pid_t tracer_tid;                   // its tid, which is the tracer of everything it traces
+    TinyDbg_Stats *stats;               // recorded by the process manager, read by anyone with TinyDbg_get_stats
 
     EventQueue *eq_process_manager;     // event queue for the process manager - send your ptrace/memory/breakpoint requests here
-    EventQueue *eq_debugger_events;     // event queue for events e.g. breakpoint hit or process stopped
-} TinyDbg;
+    EventQueue *eq_debugger_events;     // event queue for events e.g. breakpoint hit or process stopped, the parent's one for a child
+    TinyDbg_EventRing *event_ring;      // the events go here instead with TINYDBG_FLAG_EVENT_RING, NULL otherwise
+};
 
 // Start the debugger
 TinyDbg *TinyDbg_start(const char *filename, char *const argv[], char *const envp[]);
 
 #define TINYDBG_FLAG_NO_ASLR (0b1)
+// Cache the pages read with TinyDbg_get_memory until the process is continued or single stepped
+#define TINYDBG_FLAG_MEMORY_CACHE (0b10)
+// Non-stop mode - an event stops only the thread it happened in, and a request stops only the thread it's about.
+// By default (all-stop) an event stops every thread, and TinyDbg_continue continues all of them.
+#define TINYDBG_FLAG_NON_STOP (0b100)
+// Trace with PTRACE_SEIZE and stop threads with PTRACE_INTERRUPT instead of sending them SIGSTOP. The process never sees
+// a signal from the debugger, so the signals it does get are reported as they are and delivered when it's continued,
+// and job control keeps working - a thread in a group-stop is continued with PTRACE_LISTEN and waits for SIGCONT.
+#define TINYDBG_FLAG_SEIZE (0b1000)
+// Send events through a preallocated ring instead of eq_debugger_events - read them with TinyDbg_poll_events or
+// TinyDbg_wait_events, which copy them out, so nothing is allocated or freed for an event
+#define TINYDBG_FLAG_EVENT_RING (0b10000)
+// Follow the processes it forks - each one gets a debugger of its own (a TinyDbg_event_type_fork event has it), with a copy
+// of the breakpoints and the same flags plus TINYDBG_FLAG_SEIZE, which sends its events along with this one's. They're
+// freed with this one, or with TinyDbg_free once you're done with them. Without the flag a child is let go right away,
+// with the breakpoints and tracepoints taken out of its copy of the memory. A vforked child uses the memory of its parent
+// until it execs or exits, so the breakpoints are taken out of it meanwhile, and the parent's other threads don't stop on them.
+// With TinyDbg_start_syscall_filtered a child that isn't followed gets ENOSYS from the filtered syscalls, since it has no tracer.
+#define TINYDBG_FLAG_FOLLOW_FORK (0b100000)
 TinyDbg *TinyDbg_start_advanced(const char *filename, char *const argv[], char *const envp[], unsigned int flags);
+// Debug a process that's already running, as with TINYDBG_FLAG_SEIZE. Every thread is stopped once it returns.
+// TinyDbg_free removes the breakpoints and detaches, so the process goes on without the debugger.
+// Returns NULL if the process can't be traced.
+TinyDbg *TinyDbg_attach(pid_t pid, unsigned int flags);
 
-// Free a TinyDbg instance once it's done - delete the mutex, stop the thread, etc.
+// Syscall numbers go up to this, for sets of syscalls
+#define TINYDBG_SYSCALLS_MAX 512
+// Like TinyDbg_start_advanced, but the child installs a seccomp filter before execve, so that when stopping on
+// a subset of these syscalls the rest of them never stop the process - they're filtered in the kernel.
+// This sets no_new_privs in the child, so setuid binaries won't gain privileges.
+TinyDbg *TinyDbg_start_syscall_filtered(const char *filename, char *const argv[], char *const envp[], unsigned int flags,
+                                        const int *syscalls, size_t syscalls_len);
+
+// Free a TinyDbg instance once it's done - delete the mutex, stop the thread, etc. The debuggers of the children it followed
+// are freed first.
 void TinyDbg_free(TinyDbg *handle);
 
 // TODO define the event structs and the union and enum for them
@@ -61,10 +570,38 @@ typedef enum {
     TinyDbg_procman_request_type_set_mem,
     TinyDbg_procman_request_type_set_breakp,
     TinyDbg_procman_request_type_unset_breakp,
+    TinyDbg_procman_request_type_set_breakps,
+    TinyDbg_procman_request_type_unset_breakps,
     TinyDbg_procman_request_type_stop_on_syscall,
     TinyDbg_procman_request_type_no_stop_on_syscall,
+    TinyDbg_procman_request_type_coverage_mode,
+    TinyDbg_procman_request_type_set_watchp,
+    TinyDbg_procman_request_type_unset_watchp,
+    TinyDbg_procman_request_type_set_tracep,
+    TinyDbg_procman_request_type_unset_tracep,
+    TinyDbg_procman_request_type_batch,
+    TinyDbg_procman_request_type_checkpoint,
+    TinyDbg_procman_request_type_restore,
+    TinyDbg_procman_request_type_free_checkpoint,
+    TinyDbg_procman_request_type_reset_stats,
     TinyDbg_INTERNAL_procman_request_type_waitpid,
+    TinyDbg_INTERNAL_procman_request_type_detach,
+    TinyDbg_INTERNAL_procman_request_type_sample,
 } TinyDbg_procman_request_type;
+#define TINYDBG_REQUEST_TYPES (TinyDbg_INTERNAL_procman_request_type_sample + 1)
+
+// Where the debugger's time goes, in nanoseconds. It's always recorded - a clock read is a vDSO call of about 20ns,
+// next to the microseconds that a ptrace call or a context switch takes.
+struct TinyDbg_Stats {
+    TinyDbg_Histogram queue_wait;           // from sending a request until the process manager takes it
+    TinyDbg_Histogram stop;                 // stopping running threads - interrupting them and waiting for their stops
+    TinyDbg_Histogram ptrace_call;          // every ptrace call of the process manager
+    TinyDbg_Histogram hit_to_event;         // from waitpid returning the SIGTRAP of a breakpoint until its event is sent
+    TinyDbg_Histogram event_to_continue;    // from sending an event until a continue request runs after it
+    uint64_t requests[TINYDBG_REQUEST_TYPES];           // by type, the ones in a batch are counted too
+    uint64_t ptrace_calls[TINYDBG_REQUEST_TYPES + 1];   // by the type of the request they were made for, the last one
+                                                        // counts the ones made while handling stops
+};
 
 typedef struct {
     struct iovec local_iov;
@@ -75,53 +612,224 @@ typedef TinyDbg_procman_request_get_mem TinyDbg_procman_request_set_mem;
 typedef struct {
     uintptr_t position;
     bool is_once;
+    bool has_condition;             // replace the condition and the ignore count, otherwise an existing breakpoint keeps them
+    TinyDbg_Condition *condition;
+    uint64_t ignore_count;
 } TinyDbg_procman_request_set_breakp;
 
+typedef struct {
+    uintptr_t *positions;   // a copy owned by the request
+    size_t len;
+    bool is_once;           // ignored when unsetting
+    bool *set;              // set by the process manager for each position, can be NULL
+} TinyDbg_procman_request_set_breakps;
+typedef TinyDbg_procman_request_set_breakps TinyDbg_procman_request_unset_breakps;
+
+typedef struct {
+    uintptr_t position;
+    bool record_hits;
+    bool *placed;           // set by the process manager, can be NULL
+} TinyDbg_procman_request_set_tracep;
+
+typedef struct {
+    TinyDbg_Checkpoint *checkpoint;
+    bool *restored;         // set by the process manager, can be NULL
+} TinyDbg_procman_request_restore;
+
 typedef struct {
     TinyDbg_procman_request_type type;
+    pid_t tid;              // which thread the request is about, 0 for the thread of the last event
     void *content;
+    uint64_t sent_ns;       // CLOCK_MONOTONIC, when the client sent it - 0 for the ones the debugger makes itself
 } TinyDbg_procman_request;
 
+typedef struct {
+    TinyDbg_procman_request *requests;  // run in order, none of them is a batch
+    size_t len;
+} TinyDbg_procman_request_batch;
+
 typedef enum {
     TinyDbg_event_type_exit,
     TinyDbg_event_type_stop,
     TinyDbg_event_type_syscall,
     TinyDbg_event_type_breakpoint,
+    TinyDbg_event_type_watchpoint,
+    TinyDbg_event_type_fork,        // with TINYDBG_FLAG_FOLLOW_FORK, the parent and the child are both stopped
+    TinyDbg_event_type_exec,        // the breakpoints, tracepoints and watchpoints are gone with the old program
 } TinyDbg_Event_type;
 
 typedef struct {
     TinyDbg_Event_type type;
+    pid_t tid;                  // the thread that stopped, or the process for exit
+    pid_t pid;                  // the process, children that are followed send their events along with their parent's
     union TinyDbg_Event_content {
         int stop_code;
-        int syscall_id;
+        int syscall_id;         // same as syscall.id
+        struct {
+            int id;
+            bool is_exit;       // every syscall has an entry event, and then an exit event
+        } syscall;
         TinyDbg_Breakpoint breakpoint;
+        TinyDbg_Watchpoint watchpoint;  // the one that was hit, it may have been any byte of it
+        struct {
+            pid_t pid;
+            TinyDbg *handle;    // continue the child through this, the parent's requests are only about the parent
+        } fork;
     } content;
 } TinyDbg_Event;
 
 void TinyDbg_Event_free(TinyDbg_Event *event);
 
+#define TINYDBG_EVENT_RING_LEN 1024  // a power of two - every event stops a thread, so there are rarely more than the threads
+
+typedef struct {
+    uint64_t sequence;      // its index plus one once the event is in it, and plus the length of the ring once it's taken
+    TinyDbg_Event event;
+} TinyDbg_EventRing_slot;
+
+// Events from the process manager to any number of consumers, without locks unless someone has to wait.
+// Each slot says whether it has an event, consumers take runs of them by moving tail forward with a compare-and-swap.
+struct TinyDbg_EventRing {
+    TinyDbg_EventRing_slot *slots;
+    size_t slots_mask;
+    uint64_t head;              // events pushed so far, only changed by the producer
+    char head_padding[56];
+    uint64_t tail;              // events taken so far
+    char tail_padding[56];
+    unsigned int waiters;       // threads waiting on changed, the producer for room or consumers for events
+    bool closed;                // nobody waits anymore, and events that don't fit are dropped
+    int spin_polls;             // how many times a consumer polls before it waits
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+};
+
+void TinyDbg_EventRing_init(TinyDbg_EventRing *ring, size_t len);
+void TinyDbg_EventRing_destroy(TinyDbg_EventRing *ring);
+// Wakes up everyone who waits, so the producer can't be stuck on a full ring when the handle is freed
+void TinyDbg_EventRing_close(TinyDbg_EventRing *ring);
+// Waits for room if every slot has an event that wasn't taken yet
+void TinyDbg_EventRing_push(TinyDbg_EventRing *ring, const TinyDbg_Event *event);
+// Copies up to max events, and returns how many
+size_t TinyDbg_EventRing_poll(TinyDbg_EventRing *ring, TinyDbg_Event *events, size_t max);
+// Like TinyDbg_EventRing_poll, but waits up to timeout_ms (forever if it's negative) until there's at least one,
+// or until the ring is closed
+size_t TinyDbg_EventRing_wait(TinyDbg_EventRing *ring, TinyDbg_Event *events, size_t max, int timeout_ms);
+
+// With TINYDBG_FLAG_EVENT_RING - copy up to max events and return how many, without waiting or with a timeout in ms
+// (negative waits forever). Any number of threads can read events, each one goes to one of them. Without the flag
+// the events are in eq_debugger_events as always, and these return 0.
+size_t TinyDbg_poll_events(TinyDbg *handle, TinyDbg_Event *events, size_t max);
+size_t TinyDbg_wait_events(TinyDbg *handle, TinyDbg_Event *events, size_t max, int timeout_ms);
+
 EventQueue_JoinHandle *TinyDbg_stop(TinyDbg *handle);
 EventQueue_JoinHandle *TinyDbg_continue(TinyDbg *handle);
 EventQueue_JoinHandle *TinyDbg_singlestep(TinyDbg *handle);
 EventQueue_JoinHandle *TinyDbg_get_registers(TinyDbg *handle, struct user_regs_struct *save_to);
 EventQueue_JoinHandle *TinyDbg_set_registers(TinyDbg *handle, struct user_regs_struct *save_to);
+// The same for a specific thread. The ones above are about the thread of the last event (or the main thread),
+// except for TinyDbg_continue which continues every thread.
+EventQueue_JoinHandle *TinyDbg_thread_continue(TinyDbg *handle, pid_t tid);
+EventQueue_JoinHandle *TinyDbg_thread_singlestep(TinyDbg *handle, pid_t tid);
+EventQueue_JoinHandle *TinyDbg_thread_get_registers(TinyDbg *handle, pid_t tid, struct user_regs_struct *save_to);
+EventQueue_JoinHandle *TinyDbg_thread_set_registers(TinyDbg *handle, pid_t tid, struct user_regs_struct *take_from);
+// Copy of the threads the process has right now, free it with free()
+TinyDbg_Thread *TinyDbg_list_threads(TinyDbg *handle, size_t *threads_len);
+// The memory is seen without breakpoints - you get the original bytes where there's a breakpoint,
+// and writing over a breakpoint changes the byte it restores instead of removing it.
 EventQueue_JoinHandle *TinyDbg_get_memory(TinyDbg *handle, struct iovec local_iov, struct iovec remote_iov);
 EventQueue_JoinHandle *TinyDbg_set_memory(TinyDbg *handle, struct iovec local_iov, struct iovec remote_iov);
+// Vectored memory access, done right away in the calling thread instead of through the process manager.
+// The process isn't stopped for it - stop it first if you need a consistent view. Breakpoints are seen and written
+// over like with TinyDbg_get_memory and TinyDbg_set_memory, but like process_vm_writev, writing fails on read-only
+// pages (where the code and its breakpoints usually are). See TinyDbg_memory_transfer_v for the arguments.
+ssize_t TinyDbg_get_memory_v(TinyDbg *handle, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred);
+ssize_t TinyDbg_set_memory_v(TinyDbg *handle, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred);
+// A breakpoint isn't set where its byte can't be read and written, e.g. in a library that isn't loaded yet
 EventQueue_JoinHandle *TinyDbg_set_breakpoint(TinyDbg *handle, uintptr_t position, bool is_once);
 EventQueue_JoinHandle *TinyDbg_unset_breakpoint(TinyDbg *handle, uintptr_t position);
-
+// A breakpoint that's only reported when the condition is true (always if it's NULL), after ignore_count of those hits
+// are ignored. The process manager evaluates it and steps over the breakpoint by itself otherwise, so the process is
+// only stopped for as long as that takes. The breakpoint takes the condition, and replaces the one it had. A condition
+// that reads memory that can't be read is true. TinyDbg_set_breakpoint(s) on it keep the condition.
+// Returns NULL (and frees the condition) if it doesn't pass TinyDbg_Condition_verify.
+EventQueue_JoinHandle *TinyDbg_set_conditional_breakpoint(TinyDbg *handle, uintptr_t position, bool is_once,
+                                                          TinyDbg_Condition *condition, uint64_t ignore_count);
+// Set or unset many breakpoints at once - the process is stopped only once,
+// and every run of neighbouring pages is read and written back in a single operation.
+// set[i] is whether positions[i] has a breakpoint once it's joined, it can be NULL.
+EventQueue_JoinHandle *TinyDbg_set_breakpoints(TinyDbg *handle, const uintptr_t *positions, size_t len, bool is_once, bool *set);
+EventQueue_JoinHandle *TinyDbg_unset_breakpoints(TinyDbg *handle, const uintptr_t *positions, size_t len);
+// Set a watchpoint in a debug register, or change the one at the same address. Every thread is stopped to set it.
+// Returns NULL if every debug register is taken, or if the length or the alignment can't be watched.
+EventQueue_JoinHandle *TinyDbg_set_watchpoint(TinyDbg *handle, uintptr_t address, size_t len, TinyDbg_watchpoint_kind kind);
+EventQueue_JoinHandle *TinyDbg_unset_watchpoint(TinyDbg *handle, uintptr_t address);
+TinyDbg_Watchpoint *TinyDbg_list_watchpoints(TinyDbg *handle, size_t *watchpoints_len);
+// Set a tracepoint - every hit is counted, and recorded with its arguments if record_hits, without stopping the process.
+// The first one makes the process map memory for the trampolines and the hits. *placed is false if it couldn't be set:
+// when the instructions there can't be moved, there's a breakpoint or another tracepoint in them, or it can't map memory
+// near enough. Something that jumps into the middle of the instructions the jump replaced would break, and so would a
+// breakpoint set on them.
+EventQueue_JoinHandle *TinyDbg_set_tracepoint(TinyDbg *handle, uintptr_t position, bool record_hits, bool *placed);
+EventQueue_JoinHandle *TinyDbg_unset_tracepoint(TinyDbg *handle, uintptr_t position);
+TinyDbg_Tracepoint *TinyDbg_list_tracepoints(TinyDbg *handle, size_t *tracepoints_len);
+uint64_t TinyDbg_tracepoint_hit_count(TinyDbg *handle, uintptr_t position);
+// Copies up to max hits that weren't read yet, oldest first, and returns how many. Hits that were overwritten before
+// they were read are added to *lost. Read from one thread at a time.
+size_t TinyDbg_read_tracepoint_hits(TinyDbg *handle, TinyDbg_TracepointHit *hits, size_t max, uint64_t *lost);
+// Fork the process into a frozen copy to go back to with TinyDbg_restore, from the thread of the last event (or another
+// one that isn't in a syscall). The copy's parent is the parent of the process, so the process never sees it.
+// *checkpoint is NULL if it couldn't be made - no thread could fork, or a vforked child is using the memory.
+EventQueue_JoinHandle *TinyDbg_checkpoint(TinyDbg *handle, TinyDbg_Checkpoint **checkpoint);
+// Kill the process, and make a fork of the checkpoint the debugged process in its place (handle->pid is its pid). It's
+// stopped where the checkpoint was made, with the breakpoints and watchpoints there are now, and the tracepoints there
+// were then. A checkpoint can be restored any number of times, also after the process exited, but not after an execve.
+// *restored is false if it couldn't be, and then the process is left as it was.
+EventQueue_JoinHandle *TinyDbg_restore(TinyDbg *handle, TinyDbg_Checkpoint *checkpoint, bool *restored);
+// Kill the copy and free the checkpoint. The ones that are left are freed with the handle.
+EventQueue_JoinHandle *TinyDbg_free_checkpoint(TinyDbg *handle, TinyDbg_Checkpoint *checkpoint);
 typedef struct {
-    unsigned long begin;
-    unsigned long end;
-    unsigned long page_offset;
-    bool perm_read;
-    bool perm_write;
-    bool perm_execute;
-    bool perm_mayshare;
-    char *pathname;
-} TinyDbg_memory_map;
+    const char *name;           // valid until the handle is freed
+    uintptr_t address;          // where it starts in the process
+    size_t size;                // 0 if it isn't known
+    uintptr_t bias;             // how much the file it's in was moved from its addresses
+    TinyDbg_ElfFile *file;
+} TinyDbg_Symbol;
+// The function or variable an address in the process is in, from the ELF files that are mapped. Returns false if there's
+// none. The files are found in the maps, which are looked at again only when an address isn't in any mapping we know.
+bool TinyDbg_symbolize(TinyDbg *handle, uintptr_t address, TinyDbg_Symbol *symbol);
+// The address of a symbol in the process, looking in the files from the lowest address up - usually the executable first.
+// Returns 0 if there's none, after looking at the maps again in case a library that has it was loaded since.
+// A breakpoint on a function by name is TinyDbg_set_breakpoint(handle, TinyDbg_lookup_symbol(handle, name), false).
+uintptr_t TinyDbg_lookup_symbol(TinyDbg *handle, const char *name);
+// Samples where every running thread is hz times a second, without perf - each sample stops the process, reads the
+// registers and follows the frame pointers on the stacks, and continues it. Starts a new profile, and samples until
+// TinyDbg_profile_stop. A function that doesn't set up a frame pointer (a leaf, or code built without them) hides its
+// caller, and the stack ends there if the frame pointer register holds something else.
+void TinyDbg_profile_start(TinyDbg *handle, unsigned int hz);
+void TinyDbg_profile_stop(TinyDbg *handle);
+// The stacks that were sampled as folded stacks for flame graphs, a line of "outer;...;inner count" for each.
+// Free it with free().
+char *TinyDbg_profile_folded(TinyDbg *handle);
+// How long the samples kept the process stopped - pause_total_ns / elapsed_ns is the overhead
+void TinyDbg_profile_stats(TinyDbg *handle, TinyDbg_ProfileStats *stats);
+// A copy of the stats, which any thread can take while they're recorded. Percentiles of the latencies are
+// TinyDbg_Histogram_percentile(&stats->ptrace_call, 99) and so on.
+void TinyDbg_get_stats(TinyDbg *handle, TinyDbg_Stats *stats);
+// Start the stats over
+EventQueue_JoinHandle *TinyDbg_reset_stats(TinyDbg *handle);
+// Collect the requests this thread makes until TinyDbg_batch_submit, which sends all of them together - the process is
+// stopped once, they're done in order, and it's resumed once after the last one, so a continue in the batch takes
+// effect only then. Meanwhile the functions above return NULL instead of a handle, join the one from the submit instead.
+// A thread builds one batch at a time, and other threads' requests are sent right away as always.
+void TinyDbg_batch_begin(TinyDbg *handle);
+EventQueue_JoinHandle *TinyDbg_batch_submit(TinyDbg *handle);
+
+// Every mapping of the process, by address. The pathnames belong to the handle and stay valid until it's freed, only
+// the array is freed by the caller.
 TinyDbg_memory_map *TinyDbg_get_memory_maps(TinyDbg *handle, size_t *len);
-// Set a memory breakpoint, which breaks when memory is accessed
+// The mapping an address is in, in O(log n). False if nothing is mapped there.
+bool TinyDbg_find_map(TinyDbg *handle, uintptr_t address, TinyDbg_memory_map *map);
+// Set a memory breakpoint, which breaks when memory is accessed - for ranges too big for TinyDbg_set_watchpoint.
 // The way it works is it uses mprotect to set the page the address is in to be no-read or no-write or no-execute,
 // and then whenever that happens we get a pagefault. When there's a pagefault, we check if it's in a memory breakpoint,
 // in which case we enable the permission for a second, single-step, and disable it again, and send an event only if it's in range.
@@ -129,8 +837,20 @@ TinyDbg_memory_map *TinyDbg_get_memory_maps(TinyDbg *handle, size_t *len);
 EventQueue_JoinHandle *TinyDbg_memory_breakpoint(TinyDbg *handle, TinyDbg_memory_map mem_map);
 
 EventQueue_JoinHandle *TinyDbg_stop_on_syscall(TinyDbg *handle);
+// Stop only on these syscalls. The others still stop the process unless it was started with
+// TinyDbg_start_syscall_filtered with all of these, but the process manager continues it by itself.
+EventQueue_JoinHandle *TinyDbg_stop_on_syscalls(TinyDbg *handle, const int *syscalls, size_t syscalls_len);
 EventQueue_JoinHandle *TinyDbg_no_stop_on_syscall(TinyDbg *handle);
 
+// Copy of the breakpoints, free it with free(). The conditions aren't copied - they're only valid until they're replaced
+// or the breakpoint is unset.
 TinyDbg_Breakpoint *TinyDbg_list_breakpoints(TinyDbg *handle, size_t *breakpoints_len);
 
+// In coverage mode, hitting a one-shot breakpoint doesn't send an event - the process manager records the position,
+// puts back the original instruction and continues the process by itself.
+EventQueue_JoinHandle *TinyDbg_coverage_mode(TinyDbg *handle, bool enabled);
+// Copy of the positions hit so far in coverage mode, free it with free()
+uintptr_t *TinyDbg_get_coverage(TinyDbg *handle, size_t *coverage_len);
+void TinyDbg_clear_coverage(TinyDbg *handle);
+
 #endif
@@ -0,0 +1,125 @@
+#include "debugger.h"
+
+void TinyDbg_EventRing_init(TinyDbg_EventRing *ring, size_t len) {
+    ring->slots = calloc(len, sizeof(TinyDbg_EventRing_slot));
+    ring->slots_mask = len - 1;
+    for (size_t i = 0; i < len; i++) ring->slots[i].sequence = i;  // empty, waiting for event i
+    ring->head = 0;
+    ring->tail = 0;
+    ring->waiters = 0;
+    ring->closed = false;
+    // with one CPU the producer can't push anything while we spin
+    ring->spin_polls = sysconf(_SC_NPROCESSORS_ONLN) > 1 ? 1000 : 0;
+    pthread_mutex_init(&ring->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&ring->changed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void TinyDbg_EventRing_destroy(TinyDbg_EventRing *ring) {
+    free(ring->slots);
+    pthread_mutex_destroy(&ring->lock);
+    pthread_cond_destroy(&ring->changed);
+}
+
+// The lock is only taken if someone waits. A waiter counts itself before checking again under the lock,
+// so either it sees the change or we see it.
+void TinyDbg_EventRing_close(TinyDbg_EventRing *ring) {
+    pthread_mutex_lock(&ring->lock);
+    __atomic_store_n(&ring->closed, true, __ATOMIC_SEQ_CST);
+    pthread_cond_broadcast(&ring->changed);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+static void wake(TinyDbg_EventRing *ring) {
+    if (__atomic_load_n(&ring->waiters, __ATOMIC_SEQ_CST) == 0) return;
+    pthread_mutex_lock(&ring->lock);
+    pthread_cond_broadcast(&ring->changed);
+    pthread_mutex_unlock(&ring->lock);
+}
+
+void TinyDbg_EventRing_push(TinyDbg_EventRing *ring, const TinyDbg_Event *event) {
+    uint64_t head = ring->head;
+    TinyDbg_EventRing_slot *slot = &ring->slots[head & ring->slots_mask];
+    if (__atomic_load_n(&slot->sequence, __ATOMIC_ACQUIRE) != head) {
+        // full, the event from the last time around wasn't taken yet
+        pthread_mutex_lock(&ring->lock);
+        __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+        while (__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) != head && !ring->closed) {
+            pthread_cond_wait(&ring->changed, &ring->lock);
+        }
+        __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+        pthread_mutex_unlock(&ring->lock);
+        if (__atomic_load_n(&slot->sequence, __ATOMIC_SEQ_CST) != head) return;  // closed, nobody would read it anyway
+    }
+    slot->event = *event;
+    __atomic_store_n(&slot->sequence, head + 1, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_SEQ_CST);
+    wake(ring);
+}
+
+// Takes events without waking anyone up, the caller does that once it doesn't hold the lock
+static size_t take(TinyDbg_EventRing *ring, TinyDbg_Event *events, size_t max) {
+    while (true) {
+        // the run of events from tail, which is ours once tail is moved past it
+        uint64_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        size_t len = 0;
+        while (len < max && __atomic_load_n(&ring->slots[(tail + len) & ring->slots_mask].sequence, __ATOMIC_ACQUIRE) == tail + len + 1) {
+            len++;
+        }
+        if (len == 0) return 0;
+        if (!__atomic_compare_exchange_n(&ring->tail, &tail, tail + len, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) continue;
+
+        for (size_t i = 0; i < len; i++) {
+            TinyDbg_EventRing_slot *slot = &ring->slots[(tail + i) & ring->slots_mask];
+            events[i] = slot->event;
+            // empty again, for the event that comes a whole ring later
+            __atomic_store_n(&slot->sequence, tail + i + ring->slots_mask + 1, __ATOMIC_SEQ_CST);
+        }
+        return len;
+    }
+}
+
+size_t TinyDbg_EventRing_poll(TinyDbg_EventRing *ring, TinyDbg_Event *events, size_t max) {
+    size_t len = take(ring, events, max);
+    if (len != 0) wake(ring);  // the producer may be waiting for room
+    return len;
+}
+
+size_t TinyDbg_EventRing_wait(TinyDbg_EventRing *ring, TinyDbg_Event *events, size_t max, int timeout_ms) {
+    size_t len = TinyDbg_EventRing_poll(ring, events, max);
+    if (len != 0 || timeout_ms == 0) return len;
+    // spin a little first, a consumer that sleeps makes every push take the lock to wake it up
+    for (int i = 0; i < ring->spin_polls; i++) {
+        __builtin_ia32_pause();
+        len = TinyDbg_EventRing_poll(ring, events, max);
+        if (len != 0) return len;
+    }
+
+    struct timespec deadline;
+    clock_gettime(CLOCK_MONOTONIC, &deadline);
+    deadline.tv_sec += timeout_ms / 1000;
+    deadline.tv_nsec += (timeout_ms % 1000) * 1000000l;
+    if (deadline.tv_nsec >= 1000000000l) {
+        deadline.tv_sec++;
+        deadline.tv_nsec -= 1000000000l;
+    }
+
+    pthread_mutex_lock(&ring->lock);
+    __atomic_add_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+    while (true) {
+        len = take(ring, events, max);  // another consumer may take them first
+        if (len != 0 || ring->closed) break;
+        if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST)) {
+            int result = timeout_ms < 0 ? pthread_cond_wait(&ring->changed, &ring->lock)
+                                        : pthread_cond_timedwait(&ring->changed, &ring->lock, &deadline);
+            if (result == ETIMEDOUT) break;
+        }
+    }
+    __atomic_sub_fetch(&ring->waiters, 1, __ATOMIC_SEQ_CST);
+    pthread_mutex_unlock(&ring->lock);
+    if (len != 0) wake(ring);
+    return len;
+}
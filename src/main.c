@@ -30,7 +30,6 @@ int main(int argc, char *argv[], char *argp[]) {
     for (int i = 0; i < memory_maps_len; i++) {
         if (memory_maps[i].pathname[0] != '\0') {
             printf("Pathname %s at %lx\n", memory_maps[i].pathname, memory_maps[i].begin);
-            free(memory_maps[i].pathname);
         }
     }
     free(memory_maps);
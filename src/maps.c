@@ -0,0 +1,192 @@
+#include "debugger.h"
+
+#define MIN_BUFFER (64 * 1024)
+#define MIN_MAPS 64
+#define MIN_PATHS 64
+#define PATH_BLOCK_SIZE (16 * 1024)
+
+static char no_pathname[] = "";
+
+void TinyDbg_MapTable_init(TinyDbg_MapTable *table) {
+    memset(table, 0, sizeof(TinyDbg_MapTable));
+    table->fd = -1;
+    table->paths = calloc(MIN_PATHS, sizeof(char *));
+    table->paths_mask = MIN_PATHS - 1;
+    pthread_mutex_init(&table->lock, NULL);
+}
+
+void TinyDbg_MapTable_destroy(TinyDbg_MapTable *table) {
+    if (table->fd != -1) close(table->fd);
+    free(table->buffer);
+    free(table->maps);
+    for (size_t i = 0; i < table->path_blocks_len; i++) free(table->path_blocks[i]);
+    free(table->path_blocks);
+    free(table->paths);
+    pthread_mutex_destroy(&table->lock);
+}
+
+void TinyDbg_MapTable_invalidate(TinyDbg_MapTable *table) {
+    __atomic_add_fetch(&table->generation, 1, __ATOMIC_SEQ_CST);
+}
+
+static size_t hash_path(const char *path, size_t len) {
+    uint64_t hash = 0xcbf29ce484222325ull;  // FNV-1a
+    for (size_t i = 0; i < len; i++) hash = (hash ^ (unsigned char)path[i]) * 0x100000001b3ull;
+    return hash;
+}
+
+static void grow_paths(TinyDbg_MapTable *table) {
+    size_t old_len = table->paths_mask + 1;
+    char **old = table->paths;
+    table->paths = calloc(old_len * 2, sizeof(char *));
+    table->paths_mask = old_len * 2 - 1;
+    for (size_t i = 0; i < old_len; i++) {
+        if (old[i] == NULL) continue;
+        size_t slot = hash_path(old[i], strlen(old[i])) & table->paths_mask;
+        while (table->paths[slot] != NULL) slot = (slot + 1) & table->paths_mask;
+        table->paths[slot] = old[i];
+    }
+    free(old);
+}
+
+// The stored copy of a pathname, which is the same one every time the maps are read
+static char *intern_path(TinyDbg_MapTable *table, const char *path, size_t len) {
+    if (len == 0) return no_pathname;
+    size_t slot = hash_path(path, len) & table->paths_mask;
+    while (table->paths[slot] != NULL) {
+        if (strncmp(table->paths[slot], path, len) == 0 && table->paths[slot][len] == '\0') return table->paths[slot];
+        slot = (slot + 1) & table->paths_mask;
+    }
+
+    // a block that's too big for a path of its own is full right away, so the next path starts another
+    if (table->path_blocks_len == 0 || table->path_block_used + len + 1 > PATH_BLOCK_SIZE) {
+        table->path_blocks = realloc(table->path_blocks, (table->path_blocks_len + 1) * sizeof(char *));
+        table->path_blocks[table->path_blocks_len++] = malloc(len + 1 > PATH_BLOCK_SIZE ? len + 1 : PATH_BLOCK_SIZE);
+        table->path_block_used = 0;
+    }
+    char *stored = table->path_blocks[table->path_blocks_len - 1] + table->path_block_used;
+    table->path_block_used += len + 1;
+    memcpy(stored, path, len);
+    stored[len] = '\0';
+
+    table->paths[slot] = stored;
+    if (++table->paths_len * 2 > table->paths_mask + 1) grow_paths(table);
+    return stored;
+}
+
+// The whole file into the buffer. The kernel fills about a page per read, however big the buffer is.
+static bool read_file(TinyDbg_MapTable *table, size_t *len) {
+    *len = 0;
+    while (true) {
+        if (*len == table->buffer_capacity) {
+            table->buffer_capacity = table->buffer_capacity == 0 ? MIN_BUFFER : table->buffer_capacity * 2;
+            table->buffer = realloc(table->buffer, table->buffer_capacity);
+        }
+        ssize_t result = pread(table->fd, table->buffer + *len, table->buffer_capacity - *len, *len);
+        if (result == -1 && errno == EINTR) continue;
+        if (result == -1) return false;
+        if (result == 0) return true;
+        *len += result;
+    }
+}
+
+static const char *parse_hex(const char *p, unsigned long *value) {
+    unsigned long result = 0;
+    while (true) {
+        if (*p >= '0' && *p <= '9') {
+            result = result << 4 | (*p - '0');
+        } else if (*p >= 'a' && *p <= 'f') {
+            result = result << 4 | (*p - 'a' + 10);
+        } else {
+            break;
+        }
+        p++;
+    }
+    *value = result;
+    return p;
+}
+
+// Past the field at p and the spaces after it
+static const char *next_field(const char *p, const char *line_end) {
+    while (p < line_end && *p != ' ') p++;
+    while (p < line_end && *p == ' ') p++;
+    return p;
+}
+
+// Every line is "begin-end perms offset dev inode pathname", and the pathname (which may have spaces) is missing for
+// anonymous mappings. The line ends with a newline, which stops every field.
+static void parse(TinyDbg_MapTable *table, size_t len) {
+    const char *p = table->buffer;
+    const char *end = table->buffer + len;
+    table->len = 0;
+    while (p < end) {
+        const char *line_end = memchr(p, '\n', end - p);
+        if (line_end == NULL) line_end = end;
+        if (table->len == table->capacity) {
+            table->capacity = table->capacity == 0 ? MIN_MAPS : table->capacity * 2;
+            table->maps = realloc(table->maps, table->capacity * sizeof(TinyDbg_memory_map));
+        }
+        TinyDbg_memory_map *map = &table->maps[table->len++];
+
+        p = parse_hex(p, &map->begin);
+        if (p < line_end) p++;  // the -
+        p = parse_hex(p, &map->end);
+        p = next_field(p, line_end);
+        bool has_perms = line_end - p >= 4;
+        map->perm_read = has_perms && p[0] == 'r';
+        map->perm_write = has_perms && p[1] == 'w';
+        map->perm_execute = has_perms && p[2] == 'x';
+        map->perm_mayshare = has_perms && p[3] == 's';
+        p = next_field(p, line_end);
+        p = parse_hex(p, &map->page_offset);
+        p = next_field(p, line_end);  // the device
+        p = next_field(p, line_end);  // the inode
+        p = next_field(p, line_end);
+        map->pathname = intern_path(table, p, line_end - p);
+        p = line_end + 1;
+    }
+}
+
+bool TinyDbg_MapTable_update(TinyDbg_MapTable *table, pid_t pid) {
+    // whatever changes after these are loaded makes the next update read them again
+    unsigned long generation = __atomic_load_n(&table->generation, __ATOMIC_SEQ_CST);
+    bool settled = __atomic_load_n(&table->unwatched_threads, __ATOMIC_SEQ_CST) == 0;
+    if (settled && table->read_settled && table->read_generation == generation) return true;
+
+    // the file shows the memory of the program that had it open, so it's empty after an execve until it's opened again
+    for (int attempt = 0; attempt < 2; attempt++) {
+        if (table->fd == -1) {
+            char path_str[32];
+            sprintf(path_str, "/proc/%d/maps", pid);
+            table->fd = open(path_str, O_RDONLY | O_CLOEXEC);
+            if (table->fd == -1) break;  // it exited
+        }
+        size_t len;
+        if (read_file(table, &len) && len != 0) {
+            parse(table, len);
+            table->read_generation = generation;
+            table->read_settled = settled;
+            table->reads++;
+            return true;
+        }
+        close(table->fd);
+        table->fd = -1;
+    }
+    table->len = 0;
+    table->read_settled = false;
+    return false;
+}
+
+const TinyDbg_memory_map *TinyDbg_MapTable_find(const TinyDbg_MapTable *table, uintptr_t address) {
+    size_t low = 0, high = table->len;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (table->maps[middle].end <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == table->len || table->maps[low].begin > address) return NULL;
+    return &table->maps[low];
+}
@@ -0,0 +1,155 @@
+#include "debugger.h"
+
+int TinyDbg_memory_open(pid_t pid) {
+    char path_str[22];
+    sprintf(path_str, "/proc/%d/mem", pid);
+    return open(path_str, O_RDWR | O_CLOEXEC);
+}
+
+static ssize_t proc_mem_read(int mem_fd, void *local, uintptr_t remote, size_t len) {
+    if (mem_fd == -1) return -1;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t result = pread(mem_fd, (char *)local + done, len - done, remote + done);
+        if (result <= 0) break;  // EIO or 0 when reaching an unmapped page
+        done += result;
+    }
+    return done == 0 && len != 0 ? -1 : (ssize_t)done;
+}
+
+static ssize_t proc_mem_write(int mem_fd, const void *local, uintptr_t remote, size_t len) {
+    if (mem_fd == -1) return -1;
+    size_t done = 0;
+    while (done < len) {
+        ssize_t result = pwrite(mem_fd, (const char *)local + done, len - done, remote + done);
+        if (result <= 0) break;
+        done += result;
+    }
+    return done == 0 && len != 0 ? -1 : (ssize_t)done;
+}
+
+static ssize_t process_vm_read(pid_t pid, void *local, uintptr_t remote, size_t len) {
+    struct iovec local_iov = { local, len };
+    struct iovec remote_iov = { (void *)remote, len };
+    return process_vm_readv(pid, &local_iov, 1, &remote_iov, 1, 0);
+}
+
+static ssize_t process_vm_write(pid_t pid, const void *local, uintptr_t remote, size_t len) {
+    struct iovec local_iov = { (void *)local, len };
+    struct iovec remote_iov = { (void *)remote, len };
+    return process_vm_writev(pid, &local_iov, 1, &remote_iov, 1, 0);
+}
+
+static ssize_t ptrace_read(pid_t pid, void *local, uintptr_t remote, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        // read the aligned word that contains this byte
+        uintptr_t word_position = (remote + done) & ~(uintptr_t)(sizeof(long) - 1);
+        size_t offset = remote + done - word_position;
+        errno = 0;
+        long word = ptrace(PTRACE_PEEKDATA, pid, word_position, NULL);
+        if (errno != 0) break;
+
+        size_t size = sizeof(long) - offset;
+        if (size > len - done) size = len - done;
+        memcpy((char *)local + done, (char *)&word + offset, size);
+        done += size;
+    }
+    return done == 0 && len != 0 ? -1 : (ssize_t)done;
+}
+
+static ssize_t ptrace_write(pid_t pid, const void *local, uintptr_t remote, size_t len) {
+    size_t done = 0;
+    while (done < len) {
+        uintptr_t word_position = (remote + done) & ~(uintptr_t)(sizeof(long) - 1);
+        size_t offset = remote + done - word_position;
+        size_t size = sizeof(long) - offset;
+        if (size > len - done) size = len - done;
+
+        long word;
+        if (size != sizeof(long)) {
+            // only part of the word changes, keep the rest of it
+            errno = 0;
+            word = ptrace(PTRACE_PEEKDATA, pid, word_position, NULL);
+            if (errno != 0) break;
+        }
+        memcpy((char *)&word + offset, (const char *)local + done, size);
+        if (ptrace(PTRACE_POKEDATA, pid, word_position, word) == -1) break;
+        done += size;
+    }
+    return done == 0 && len != 0 ? -1 : (ssize_t)done;
+}
+
+ssize_t TinyDbg_memory_transfer_v(pid_t pid, const struct iovec *local_iov, const struct iovec *remote_iov, size_t iov_len, size_t *transferred, bool write) {
+    ssize_t total = 0;
+    size_t i = 0;
+    while (i < iov_len) {
+        size_t batch_len = iov_len - i < IOV_MAX ? iov_len - i : IOV_MAX;
+        ssize_t result = write ? process_vm_writev(pid, &local_iov[i], batch_len, &remote_iov[i], batch_len, 0)
+                               : process_vm_readv(pid, &local_iov[i], batch_len, &remote_iov[i], batch_len, 0);
+        if (result == -1) {
+            if (errno != EFAULT) {
+                // not about this segment, the rest will fail too
+                memset(&transferred[i], 0, (iov_len - i) * sizeof(size_t));
+                return total == 0 ? -1 : total;
+            }
+            // the first segment of the batch can't be accessed, skip it
+            transferred[i++] = 0;
+            continue;
+        }
+        total += result;
+
+        // the syscall stops at the first segment it can't access, count what each segment got
+        size_t batch_end = i + batch_len;
+        while (i < batch_end) {
+            size_t segment_len = remote_iov[i].iov_len;
+            if ((size_t)result < segment_len) {
+                // this is where it stopped - retry from the one after it
+                transferred[i++] = result;
+                break;
+            }
+            transferred[i++] = segment_len;
+            result -= segment_len;
+        }
+    }
+    return total;
+}
+
+ssize_t TinyDbg_memory_read(TinyDbg_memory_backend backend, pid_t pid, int mem_fd, void *local, uintptr_t remote, size_t len) {
+    switch (backend) {
+        case TinyDbg_memory_backend_proc_mem:
+            return proc_mem_read(mem_fd, local, remote, len);
+        case TinyDbg_memory_backend_process_vm:
+            return process_vm_read(pid, local, remote, len);
+        case TinyDbg_memory_backend_ptrace:
+            return ptrace_read(pid, local, remote, len);
+        default: {
+            ssize_t result = proc_mem_read(mem_fd, local, remote, len);
+            if (result == -1) result = process_vm_read(pid, local, remote, len);
+            if (result == -1) result = ptrace_read(pid, local, remote, len);
+            return result;
+        }
+    }
+}
+
+ssize_t TinyDbg_memory_write(TinyDbg_memory_backend backend, pid_t pid, int mem_fd, const void *local, uintptr_t remote, size_t len) {
+    switch (backend) {
+        case TinyDbg_memory_backend_proc_mem:
+            return proc_mem_write(mem_fd, local, remote, len);
+        case TinyDbg_memory_backend_process_vm:
+            return process_vm_write(pid, local, remote, len);
+        case TinyDbg_memory_backend_ptrace:
+            return ptrace_write(pid, local, remote, len);
+        default: {
+            // process_vm_writev fails on read-only pages, so ptrace comes right after /proc/pid/mem
+            ssize_t result = proc_mem_write(mem_fd, local, remote, len);
+            if (result == -1) return ptrace_write(pid, local, remote, len);
+            if ((size_t)result < len) {
+                // ptrace may still write the rest
+                ssize_t rest = ptrace_write(pid, (const char *)local + result, remote + result, len - result);
+                if (rest > 0) result += rest;
+            }
+            return result;
+        }
+    }
+}
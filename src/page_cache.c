@@ -0,0 +1,60 @@
+#include "debugger.h"
+
+#define CACHE_SLOTS 1024
+#define MAX_CACHED_PAGES (CACHE_SLOTS / 2)
+
+static size_t home_slot(TinyDbg_PageCache *cache, uintptr_t page) {
+    return (size_t)(((uint64_t)page * 0x9E3779B97F4A7C15ull) >> 32) & cache->slots_mask;
+}
+
+// a slot from an older generation counts as empty - everything is invalidated at once, so no chain is broken
+static TinyDbg_PageCache_slot *find_slot(TinyDbg_PageCache *cache, uintptr_t page) {
+    size_t i = home_slot(cache, page);
+    while (cache->slots[i].generation == cache->generation && cache->slots[i].page != page) {
+        i = (i + 1) & cache->slots_mask;
+    }
+    return &cache->slots[i];
+}
+
+void TinyDbg_PageCache_init(TinyDbg_PageCache *cache) {
+    cache->slots = calloc(CACHE_SLOTS, sizeof(TinyDbg_PageCache_slot));
+    cache->slots_mask = CACHE_SLOTS - 1;
+    cache->len = 0;
+    cache->generation = 1;  // slots start at generation 0, which is empty
+}
+
+void TinyDbg_PageCache_destroy(TinyDbg_PageCache *cache) {
+    if (cache->slots == NULL) return;
+    for (size_t i = 0; i <= cache->slots_mask; i++) {
+        free(cache->slots[i].data);
+    }
+    free(cache->slots);
+}
+
+void TinyDbg_PageCache_invalidate(TinyDbg_PageCache *cache) {
+    cache->generation++;
+    cache->len = 0;
+}
+
+char *TinyDbg_PageCache_find(TinyDbg_PageCache *cache, uintptr_t page) {
+    TinyDbg_PageCache_slot *slot = find_slot(cache, page);
+    if (slot->generation != cache->generation) return NULL;
+    return slot->data;
+}
+
+char *TinyDbg_PageCache_insert(TinyDbg_PageCache *cache, uintptr_t page, const char *data) {
+    TinyDbg_PageCache_slot *slot = find_slot(cache, page);
+    if (slot->generation != cache->generation) {
+        if (cache->len == MAX_CACHED_PAGES) {
+            // full, start over instead of keeping track of what was used last
+            TinyDbg_PageCache_invalidate(cache);
+            slot = find_slot(cache, page);
+        }
+        if (slot->data == NULL) slot->data = malloc(PAGE_SIZE);  // page buffers are reused between generations
+        slot->page = page;
+        slot->generation = cache->generation;
+        cache->len++;
+    }
+    memcpy(slot->data, data, PAGE_SIZE);
+    return slot->data;
+}
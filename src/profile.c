@@ -0,0 +1,73 @@
+#include "debugger.h"
+
+#define MIN_STACKS 256
+
+void TinyDbg_Profile_init(TinyDbg_Profile *profile) {
+    memset(profile, 0, sizeof(TinyDbg_Profile));
+    profile->stacks = calloc(MIN_STACKS, sizeof(TinyDbg_ProfileStack));
+    profile->stacks_mask = MIN_STACKS - 1;
+    pthread_mutex_init(&profile->lock, NULL);
+    pthread_condattr_t attr;
+    pthread_condattr_init(&attr);
+    pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+    pthread_cond_init(&profile->changed, &attr);
+    pthread_condattr_destroy(&attr);
+}
+
+void TinyDbg_Profile_destroy(TinyDbg_Profile *profile) {
+    TinyDbg_Profile_clear(profile);
+    free(profile->stacks);
+    pthread_mutex_destroy(&profile->lock);
+    pthread_cond_destroy(&profile->changed);
+}
+
+void TinyDbg_Profile_clear(TinyDbg_Profile *profile) {
+    for (size_t i = 0; i <= profile->stacks_mask; i++) free(profile->stacks[i].pcs);
+    memset(profile->stacks, 0, (profile->stacks_mask + 1) * sizeof(TinyDbg_ProfileStack));
+    profile->stacks_len = 0;
+    memset(&profile->stats, 0, sizeof(TinyDbg_ProfileStats));
+}
+
+static uint64_t hash_stack(const uintptr_t *pcs, size_t depth) {
+    uint64_t hash = depth;
+    for (size_t i = 0; i < depth; i++) hash = (hash ^ pcs[i]) * 0x9E3779B97F4A7C15ull;
+    return hash ^ hash >> 29;
+}
+
+static TinyDbg_ProfileStack *find_slot(TinyDbg_Profile *profile, uint64_t hash, const uintptr_t *pcs, size_t depth) {
+    size_t i = hash & profile->stacks_mask;
+    while (true) {
+        TinyDbg_ProfileStack *stack = &profile->stacks[i];
+        if (stack->count == 0) return stack;
+        if (stack->hash == hash && stack->depth == depth && memcmp(stack->pcs, pcs, depth * sizeof(uintptr_t)) == 0) return stack;
+        i = (i + 1) & profile->stacks_mask;
+    }
+}
+
+static void grow(TinyDbg_Profile *profile) {
+    TinyDbg_ProfileStack *old = profile->stacks;
+    size_t old_len = profile->stacks_mask + 1;
+    profile->stacks = calloc(old_len * 2, sizeof(TinyDbg_ProfileStack));
+    profile->stacks_mask = old_len * 2 - 1;
+    for (size_t i = 0; i < old_len; i++) {
+        if (old[i].count != 0) *find_slot(profile, old[i].hash, old[i].pcs, old[i].depth) = old[i];
+    }
+    free(old);
+}
+
+bool TinyDbg_Profile_add(TinyDbg_Profile *profile, const uintptr_t *pcs, size_t depth) {
+    uint64_t hash = hash_stack(pcs, depth);
+    TinyDbg_ProfileStack *stack = find_slot(profile, hash, pcs, depth);
+    if (stack->count == 0) {
+        // seen for the first time, only then is it copied
+        stack->hash = hash;
+        stack->depth = depth;
+        stack->pcs = malloc(depth * sizeof(uintptr_t));
+        memcpy(stack->pcs, pcs, depth * sizeof(uintptr_t));
+        stack->count = 1;
+        if (++profile->stacks_len * 2 > profile->stacks_mask + 1) grow(profile);
+        return true;
+    }
+    stack->count++;
+    return false;
+}
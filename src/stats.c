@@ -0,0 +1,43 @@
+#include "debugger.h"
+
+// Values below 2 * TINYDBG_HISTOGRAM_SUB_BUCKETS have a bucket each, and every power of two above them is split into
+// TINYDBG_HISTOGRAM_SUB_BUCKETS buckets
+static size_t bucket_of(uint64_t value) {
+    if (value < 2 * TINYDBG_HISTOGRAM_SUB_BUCKETS) return value;
+    int exponent = 63 - __builtin_clzll(value);
+    return (exponent - TINYDBG_HISTOGRAM_SUB_BITS) * TINYDBG_HISTOGRAM_SUB_BUCKETS + (value >> (exponent - TINYDBG_HISTOGRAM_SUB_BITS));
+}
+
+// The lowest value that goes in a bucket
+static uint64_t bucket_low(size_t bucket) {
+    if (bucket < 2 * TINYDBG_HISTOGRAM_SUB_BUCKETS) return bucket;
+    int exponent = bucket / TINYDBG_HISTOGRAM_SUB_BUCKETS + TINYDBG_HISTOGRAM_SUB_BITS - 1;
+    uint64_t top = bucket % TINYDBG_HISTOGRAM_SUB_BUCKETS + TINYDBG_HISTOGRAM_SUB_BUCKETS;
+    return top << (exponent - TINYDBG_HISTOGRAM_SUB_BITS);
+}
+
+void TinyDbg_Histogram_record(TinyDbg_Histogram *histogram, uint64_t value) {
+    // there's one writer, so nothing has to be locked - the stores are only atomic for the readers
+    size_t bucket = bucket_of(value);
+    __atomic_store_n(&histogram->buckets[bucket], histogram->buckets[bucket] + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->count, histogram->count + 1, __ATOMIC_RELAXED);
+    __atomic_store_n(&histogram->sum, histogram->sum + value, __ATOMIC_RELAXED);
+    if (value > histogram->max) __atomic_store_n(&histogram->max, value, __ATOMIC_RELAXED);
+}
+
+uint64_t TinyDbg_Histogram_percentile(const TinyDbg_Histogram *histogram, double percentile) {
+    if (histogram->count == 0) return 0;
+    uint64_t rank = percentile / 100 * histogram->count;
+    if (rank == 0) rank = 1;
+    if (rank > histogram->count) rank = histogram->count;
+
+    uint64_t seen = 0;
+    for (size_t i = 0; i < TINYDBG_HISTOGRAM_BUCKETS; i++) {
+        seen += histogram->buckets[i];
+        if (seen < rank) continue;
+        // the highest value of the bucket, which can't be more than the highest one recorded
+        uint64_t high = i + 1 < TINYDBG_HISTOGRAM_BUCKETS ? bucket_low(i + 1) - 1 : UINT64_MAX;
+        return high < histogram->max ? high : histogram->max;
+    }
+    return histogram->max;
+}
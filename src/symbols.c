@@ -0,0 +1,385 @@
+#include "debugger.h"
+
+// Every file that's open, so that each one is read once however many processes and handles use it
+static struct {
+    TinyDbg_ElfFile **files;
+    size_t len;
+    size_t capacity;
+    pthread_mutex_t lock;
+} cache = { NULL, 0, 0, PTHREAD_MUTEX_INITIALIZER };
+
+// An ELF file in memory, either the mapped file or the one in its .gnu_debugdata
+struct image {
+    const unsigned char *data;
+    size_t len;
+};
+
+static bool within(const struct image *image, uint64_t offset, uint64_t len) {
+    return offset <= image->len && len <= image->len - offset;
+}
+
+static const Elf64_Ehdr *elf_header(const struct image *image) {
+    if (!within(image, 0, sizeof(Elf64_Ehdr))) return NULL;
+    const Elf64_Ehdr *header = (const Elf64_Ehdr *)image->data;
+    if (memcmp(header->e_ident, ELFMAG, SELFMAG) != 0 || header->e_ident[EI_CLASS] != ELFCLASS64) return NULL;
+    return header;
+}
+
+static const Elf64_Shdr *section_headers(const struct image *image, size_t *len) {
+    const Elf64_Ehdr *header = elf_header(image);
+    *len = 0;
+    if (header == NULL || header->e_shnum == 0 || header->e_shentsize != sizeof(Elf64_Shdr)) return NULL;
+    if (!within(image, header->e_shoff, (uint64_t)header->e_shnum * sizeof(Elf64_Shdr))) return NULL;
+    *len = header->e_shnum;
+    return (const Elf64_Shdr *)(image->data + header->e_shoff);
+}
+
+// The contents of the section with this name, NULL if there's none
+static const unsigned char *find_section(const struct image *image, const char *name, size_t *len) {
+    size_t sections_len;
+    const Elf64_Shdr *sections = section_headers(image, &sections_len);
+    const Elf64_Ehdr *header = elf_header(image);
+    if (sections == NULL || header->e_shstrndx >= sections_len) return NULL;
+    const Elf64_Shdr *names = &sections[header->e_shstrndx];
+    if (!within(image, names->sh_offset, names->sh_size)) return NULL;
+
+    size_t name_len = strlen(name);
+    for (size_t i = 0; i < sections_len; i++) {
+        const Elf64_Shdr *section = &sections[i];
+        if (section->sh_type == SHT_NOBITS || section->sh_name >= names->sh_size
+            || names->sh_size - section->sh_name <= name_len) continue;
+        const char *section_name = (const char *)image->data + names->sh_offset + section->sh_name;
+        if (memcmp(section_name, name, name_len + 1) != 0 || !within(image, section->sh_offset, section->sh_size)) continue;
+        *len = section->sh_size;
+        return image->data + section->sh_offset;
+    }
+    return NULL;
+}
+
+// The GNU build ID note, in hex
+static void read_build_id(TinyDbg_ElfFile *file, const struct image *image, const Elf64_Ehdr *header) {
+    file->build_id[0] = '\0';
+    if (header->e_phentsize != sizeof(Elf64_Phdr)) return;
+    if (!within(image, header->e_phoff, (uint64_t)header->e_phnum * sizeof(Elf64_Phdr))) return;
+    const Elf64_Phdr *segments = (const Elf64_Phdr *)(image->data + header->e_phoff);
+    for (size_t i = 0; i < header->e_phnum; i++) {
+        if (segments[i].p_type != PT_NOTE || !within(image, segments[i].p_offset, segments[i].p_filesz)) continue;
+        const unsigned char *note = image->data + segments[i].p_offset;
+        const unsigned char *end = note + segments[i].p_filesz;
+        while ((size_t)(end - note) >= sizeof(Elf64_Nhdr)) {
+            const Elf64_Nhdr *note_header = (const Elf64_Nhdr *)note;
+            size_t name_size = (note_header->n_namesz + 3) & ~3ul;
+            size_t desc_size = (note_header->n_descsz + 3) & ~3ul;
+            if (name_size + desc_size > (size_t)(end - note) - sizeof(Elf64_Nhdr)) break;
+            const unsigned char *name = note + sizeof(Elf64_Nhdr);
+            const unsigned char *desc = name + name_size;
+            if (note_header->n_type == NT_GNU_BUILD_ID && note_header->n_namesz == 4 && memcmp(name, "GNU", 4) == 0) {
+                size_t len = note_header->n_descsz < TINYDBG_BUILD_ID_MAX ? note_header->n_descsz : TINYDBG_BUILD_ID_MAX;
+                for (size_t j = 0; j < len; j++) sprintf(&file->build_id[j * 2], "%02x", desc[j]);
+                return;
+            }
+            note = desc + desc_size;
+        }
+    }
+}
+
+static void read_segments(TinyDbg_ElfFile *file, const struct image *image, const Elf64_Ehdr *header) {
+    file->segments = NULL;
+    file->segments_len = 0;
+    if (header->e_phentsize != sizeof(Elf64_Phdr)) return;
+    if (!within(image, header->e_phoff, (uint64_t)header->e_phnum * sizeof(Elf64_Phdr))) return;
+    const Elf64_Phdr *segments = (const Elf64_Phdr *)(image->data + header->e_phoff);
+    file->segments = malloc(header->e_phnum * sizeof(TinyDbg_ElfSegment));
+    for (size_t i = 0; i < header->e_phnum; i++) {
+        if (segments[i].p_type != PT_LOAD) continue;
+        file->segments[file->segments_len++] = (TinyDbg_ElfSegment){ segments[i].p_offset, segments[i].p_vaddr, segments[i].p_filesz };
+    }
+}
+
+static unsigned char *decompress_xz(const unsigned char *data, size_t len, size_t *decompressed_len) {
+    lzma_stream stream = LZMA_STREAM_INIT;
+    if (lzma_stream_decoder(&stream, UINT64_MAX, 0) != LZMA_OK) return NULL;
+    size_t capacity = len * 4;
+    unsigned char *decompressed = malloc(capacity);
+    stream.next_in = data;
+    stream.avail_in = len;
+    lzma_ret result = LZMA_OK;
+    while (result == LZMA_OK) {
+        if (stream.total_out == capacity) {
+            capacity *= 2;
+            decompressed = realloc(decompressed, capacity);
+        }
+        stream.next_out = decompressed + stream.total_out;
+        stream.avail_out = capacity - stream.total_out;
+        result = lzma_code(&stream, LZMA_FINISH);
+    }
+    *decompressed_len = stream.total_out;
+    lzma_end(&stream);
+    if (result != LZMA_STREAM_END) {
+        free(decompressed);
+        return NULL;
+    }
+    return decompressed;
+}
+
+// Adds the functions and variables of the symbol tables in an image
+static void add_symbols(TinyDbg_ElfFile *file, const struct image *image, size_t *capacity) {
+    size_t sections_len;
+    const Elf64_Shdr *sections = section_headers(image, &sections_len);
+    for (size_t i = 0; i < sections_len; i++) {
+        const Elf64_Shdr *table = &sections[i];
+        if ((table->sh_type != SHT_SYMTAB && table->sh_type != SHT_DYNSYM) || table->sh_entsize != sizeof(Elf64_Sym)) continue;
+        if (table->sh_link >= sections_len || !within(image, table->sh_offset, table->sh_size)) continue;
+        const Elf64_Shdr *strings = &sections[table->sh_link];
+        if (strings->sh_size == 0 || !within(image, strings->sh_offset, strings->sh_size)) continue;
+        const char *names = (const char *)image->data + strings->sh_offset;
+        if (names[strings->sh_size - 1] != '\0') continue;  // so that every name ends inside it
+
+        const Elf64_Sym *entries = (const Elf64_Sym *)(image->data + table->sh_offset);
+        size_t entries_len = table->sh_size / sizeof(Elf64_Sym);
+        for (size_t j = 0; j < entries_len; j++) {
+            const Elf64_Sym *entry = &entries[j];
+            int type = ELF64_ST_TYPE(entry->st_info);
+            if (type != STT_FUNC && type != STT_GNU_IFUNC && type != STT_OBJECT && type != STT_NOTYPE) continue;
+            // undefined, absolute and common symbols aren't at an address in the file
+            if (entry->st_shndx == SHN_UNDEF || entry->st_shndx >= SHN_LORESERVE || entry->st_value == 0) continue;
+            if (entry->st_name == 0 || entry->st_name >= strings->sh_size) continue;
+
+            if (file->symbols_len == *capacity) {
+                *capacity = *capacity == 0 ? 1024 : *capacity * 2;
+                file->symbols = realloc(file->symbols, *capacity * sizeof(TinyDbg_ElfSymbol));
+            }
+            TinyDbg_ElfSymbol *symbol = &file->symbols[file->symbols_len++];
+            symbol->address = entry->st_value;
+            symbol->size = entry->st_size;
+            symbol->name = names + entry->st_name;
+            symbol->is_global = ELF64_ST_BIND(entry->st_info) != STB_LOCAL;
+        }
+    }
+}
+
+static size_t leading_underscores(const char *name) {
+    size_t len = 0;
+    while (name[len] == '_') len++;
+    return len;
+}
+
+// By address, and at the same address the one that names it best comes first - global, with a size, and with the fewest
+// leading underscores, so it's write rather than __write and printf rather than _IO_printf
+static int compare_symbols(const void *a, const void *b) {
+    const TinyDbg_ElfSymbol *x = a;
+    const TinyDbg_ElfSymbol *y = b;
+    if (x->address != y->address) return x->address < y->address ? -1 : 1;
+    if (x->is_global != y->is_global) return x->is_global ? -1 : 1;
+    if ((x->size != 0) != (y->size != 0)) return x->size != 0 ? -1 : 1;
+    size_t x_underscores = leading_underscores(x->name);
+    size_t y_underscores = leading_underscores(y->name);
+    if (x_underscores != y_underscores) return x_underscores < y_underscores ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static void load(TinyDbg_ElfFile *file) {
+    struct image image = { file->image, file->image_len };
+    size_t capacity = 0;
+    add_symbols(file, &image, &capacity);
+
+    // MiniDebugInfo - an xz compressed ELF file with the symbols that were stripped
+    size_t compressed_len;
+    const unsigned char *compressed = find_section(&image, ".gnu_debugdata", &compressed_len);
+    if (compressed != NULL && compressed_len != 0) {
+        size_t debugdata_len;
+        file->debugdata = decompress_xz(compressed, compressed_len, &debugdata_len);
+        if (file->debugdata != NULL) {
+            struct image debugdata = { file->debugdata, debugdata_len };
+            add_symbols(file, &debugdata, &capacity);
+        }
+    }
+
+    qsort(file->symbols, file->symbols_len, sizeof(TinyDbg_ElfSymbol), compare_symbols);
+    // the dynamic symbols are usually in .symtab too
+    size_t len = 0;
+    for (size_t i = 0; i < file->symbols_len; i++) {
+        if (len != 0 && compare_symbols(&file->symbols[len - 1], &file->symbols[i]) == 0) continue;
+        file->symbols[len++] = file->symbols[i];
+    }
+    file->symbols_len = len;
+}
+
+// The symbols are read the first time they're needed, so a big file that's mapped costs nothing until then
+static void ensure_loaded(TinyDbg_ElfFile *file) {
+    if (__atomic_load_n(&file->loaded, __ATOMIC_ACQUIRE)) return;
+    pthread_mutex_lock(&file->lock);
+    if (!file->loaded) {
+        load(file);
+        __atomic_store_n(&file->loaded, true, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&file->lock);
+}
+
+// By name, and with the same name the global one first, then the one with the lowest address
+static int compare_by_name(const void *a, const void *b, void *arg) {
+    const TinyDbg_ElfFile *file = arg;
+    uint32_t i = *(const uint32_t *)a;
+    uint32_t j = *(const uint32_t *)b;
+    int result = strcmp(file->symbols[i].name, file->symbols[j].name);
+    if (result != 0) return result;
+    if (file->symbols[i].is_global != file->symbols[j].is_global) return file->symbols[i].is_global ? -1 : 1;
+    return (i > j) - (i < j);
+}
+
+static void ensure_by_name(TinyDbg_ElfFile *file) {
+    ensure_loaded(file);
+    if (__atomic_load_n(&file->by_name, __ATOMIC_ACQUIRE) != NULL) return;
+    pthread_mutex_lock(&file->lock);
+    if (file->by_name == NULL) {
+        uint32_t *by_name = malloc(file->symbols_len * sizeof(uint32_t) + 1);  // not NULL even without symbols
+        for (size_t i = 0; i < file->symbols_len; i++) by_name[i] = i;
+        qsort_r(by_name, file->symbols_len, sizeof(uint32_t), compare_by_name, file);
+        __atomic_store_n(&file->by_name, by_name, __ATOMIC_RELEASE);
+    }
+    pthread_mutex_unlock(&file->lock);
+}
+
+static bool same_file(const TinyDbg_ElfFile *file, const struct stat *st) {
+    return file->device == st->st_dev && file->inode == st->st_ino && file->image_len == (size_t)st->st_size
+        && file->mtime.tv_sec == st->st_mtim.tv_sec && file->mtime.tv_nsec == st->st_mtim.tv_nsec;
+}
+
+static TinyDbg_ElfFile *find_cached(const struct stat *st, const char *build_id) {
+    for (size_t i = 0; i < cache.len; i++) {
+        TinyDbg_ElfFile *file = cache.files[i];
+        if (same_file(file, st) || (build_id != NULL && build_id[0] != '\0' && strcmp(file->build_id, build_id) == 0)) {
+            file->references++;
+            return file;
+        }
+    }
+    return NULL;
+}
+
+static void free_file(TinyDbg_ElfFile *file) {
+    munmap((void *)file->image, file->image_len);
+    free(file->segments);
+    free(file->debugdata);
+    free(file->symbols);
+    free(file->by_name);
+    pthread_mutex_destroy(&file->lock);
+    free(file);
+}
+
+TinyDbg_ElfFile *TinyDbg_ElfFile_open(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd == -1) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) == -1 || !S_ISREG(st.st_mode) || (size_t)st.st_size < sizeof(Elf64_Ehdr)) {
+        close(fd);
+        return NULL;
+    }
+
+    // it's the same file as one that's open already
+    pthread_mutex_lock(&cache.lock);
+    TinyDbg_ElfFile *cached = find_cached(&st, NULL);
+    pthread_mutex_unlock(&cache.lock);
+    if (cached != NULL) {
+        close(fd);
+        return cached;
+    }
+
+    void *image = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (image == MAP_FAILED) return NULL;
+    struct image whole = { image, st.st_size };
+    const Elf64_Ehdr *header = elf_header(&whole);
+    if (header == NULL) {
+        munmap(image, st.st_size);
+        return NULL;
+    }
+
+    TinyDbg_ElfFile *file = calloc(1, sizeof(TinyDbg_ElfFile));
+    file->device = st.st_dev;
+    file->inode = st.st_ino;
+    file->mtime = st.st_mtim;
+    file->references = 1;
+    file->image = image;
+    file->image_len = st.st_size;
+    pthread_mutex_init(&file->lock, NULL);
+    read_build_id(file, &whole, header);
+    read_segments(file, &whole, header);
+
+    // a copy of one that's open already has the same build ID, or another thread opened it meanwhile
+    pthread_mutex_lock(&cache.lock);
+    cached = find_cached(&st, file->build_id);
+    if (cached == NULL) {
+        if (cache.len == cache.capacity) {
+            cache.capacity = cache.capacity == 0 ? 16 : cache.capacity * 2;
+            cache.files = realloc(cache.files, cache.capacity * sizeof(TinyDbg_ElfFile *));
+        }
+        cache.files[cache.len++] = file;
+    }
+    pthread_mutex_unlock(&cache.lock);
+    if (cached != NULL) {
+        free_file(file);
+        return cached;
+    }
+    return file;
+}
+
+void TinyDbg_ElfFile_release(TinyDbg_ElfFile *file) {
+    pthread_mutex_lock(&cache.lock);
+    bool last = --file->references == 0;
+    if (last) {
+        for (size_t i = 0; i < cache.len; i++) {
+            if (cache.files[i] == file) cache.files[i] = cache.files[--cache.len];
+        }
+    }
+    pthread_mutex_unlock(&cache.lock);
+    if (last) free_file(file);
+}
+
+bool TinyDbg_ElfFile_bias(const TinyDbg_ElfFile *file, uint64_t page_offset, uintptr_t begin, uintptr_t *bias) {
+    for (size_t i = 0; i < file->segments_len; i++) {
+        const TinyDbg_ElfSegment *segment = &file->segments[i];
+        // the segment's first page is mapped from the page its offset is in
+        if (page_offset < (segment->offset & PAGE_MASK) || page_offset >= segment->offset + segment->filesz) continue;
+        *bias = begin - (segment->vaddr - (segment->offset - page_offset));
+        return true;
+    }
+    return false;
+}
+
+const TinyDbg_ElfSymbol *TinyDbg_ElfFile_find(TinyDbg_ElfFile *file, uintptr_t address) {
+    ensure_loaded(file);
+    // the first symbol after the address, and the ones before it are candidates from the closest one back
+    size_t low = 0, high = file->symbols_len;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (file->symbols[middle].address <= address) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == 0) return NULL;
+    uintptr_t closest = file->symbols[low - 1].address;
+    size_t first = low - 1;
+    while (first > 0 && file->symbols[first - 1].address == closest) first--;
+    for (size_t i = first; i < low; i++) {
+        const TinyDbg_ElfSymbol *symbol = &file->symbols[i];
+        if (symbol->size == 0 || address < symbol->address + symbol->size) return symbol;
+    }
+    return NULL;
+}
+
+const TinyDbg_ElfSymbol *TinyDbg_ElfFile_lookup(TinyDbg_ElfFile *file, const char *name) {
+    ensure_by_name(file);
+    size_t low = 0, high = file->symbols_len;
+    while (low < high) {
+        size_t middle = low + (high - low) / 2;
+        if (strcmp(file->symbols[file->by_name[middle]].name, name) < 0) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+    if (low == file->symbols_len || strcmp(file->symbols[file->by_name[low]].name, name) != 0) return NULL;
+    return &file->symbols[file->by_name[low]];
+}
@@ -0,0 +1,374 @@
+#include "debugger.h"
+
+// Only as much of x86-64 as it takes to move instructions - their length, and whether they depend on where they are
+struct instruction {
+    size_t len;
+    size_t rip_displacement;    // offset of the disp32 of an operand relative to rip, 0 if there is none
+    bool ends_block;            // it never goes on to the next instruction
+    bool is_call;               // a call to a register or memory, which pushes where it is
+};
+
+// ModRM and immediate of the one byte opcodes, false for the ones that are relative, invalid in 64-bit mode or prefixes
+static bool one_byte_opcode(unsigned char op, bool rex_w, bool addr32, size_t imm_z, bool *modrm, size_t *imm, bool *ends_block) {
+    if (op < 0x40) {
+        switch (op & 7) {
+            case 4: *imm = 1; return true;
+            case 5: *imm = imm_z; return true;
+            case 6: case 7: return false;
+            default: *modrm = true; return true;
+        }
+    }
+    if (op >= 0x50 && op < 0x60) return true;  // push and pop
+    if (op >= 0x70 && op < 0x80) return false;  // jcc rel8
+    if (op >= 0x84 && op < 0x90) {
+        *modrm = true;
+        return true;
+    }
+    if (op >= 0x90 && op < 0xa0) return op != 0x9a;
+    if (op >= 0xa0 && op < 0xa4) {
+        *imm = addr32 ? 4 : 8;  // mov with a full address
+        return true;
+    }
+    if (op >= 0xa4 && op < 0xb0) {
+        if (op == 0xa8) *imm = 1;
+        if (op == 0xa9) *imm = imm_z;
+        return true;
+    }
+    if (op >= 0xb0 && op < 0xb8) {
+        *imm = 1;
+        return true;
+    }
+    if (op >= 0xb8 && op < 0xc0) {
+        *imm = rex_w ? 8 : imm_z;
+        return true;
+    }
+    if (op >= 0xd8 && op < 0xe0) {
+        *modrm = true;  // x87
+        return true;
+    }
+    switch (op) {
+        case 0x63: case 0xd0: case 0xd1: case 0xd2: case 0xd3: case 0xfe:
+            *modrm = true;
+            return true;
+        case 0xff:
+            *modrm = true;  // and call or jmp to a register or memory, which ends_block is set for by the caller
+            return true;
+        case 0x80: case 0x83: case 0x6b: case 0xc0: case 0xc1: case 0xc6:
+            *modrm = true;
+            *imm = 1;
+            return true;
+        case 0x81: case 0x69: case 0xc7:
+            *modrm = true;
+            *imm = imm_z;
+            return true;
+        case 0xf6: case 0xf7:
+            *modrm = true;  // test has an immediate, which the caller adds
+            return true;
+        case 0x68: *imm = imm_z; return true;
+        case 0x6a: case 0xcd: case 0xe4: case 0xe5: case 0xe6: case 0xe7: *imm = 1; return true;
+        case 0xc8: *imm = 3; return true;
+        case 0xc2: case 0xca: *imm = 2; *ends_block = true; return true;
+        case 0xc3: case 0xcb: case 0xcf: case 0xf4: *ends_block = true; return true;
+        case 0x6c: case 0x6d: case 0x6e: case 0x6f: case 0xc9: case 0xd7: case 0xec: case 0xed: case 0xee: case 0xef:
+        case 0xf1: case 0xf5: case 0xf8: case 0xf9: case 0xfa: case 0xfb: case 0xfc: case 0xfd:
+            return true;
+        default:
+            return false;  // int3 is a breakpoint of someone else, and e8, e9, eb and e0-e3 are relative
+    }
+}
+
+// ModRM and immediate of the 0f opcodes, the same for their VEX forms
+static bool two_byte_opcode(unsigned char op, bool *modrm, size_t *imm, bool *ends_block) {
+    if (op >= 0x80 && op < 0x90) return false;  // jcc rel32
+    if ((op >= 0x30 && op < 0x38) || (op >= 0xc8 && op < 0xd0)) return true;  // rdtsc and such, bswap
+    switch (op) {
+        case 0x05: case 0x06: case 0x07: case 0x08: case 0x09: case 0x0e: case 0x77: case 0xa0: case 0xa1:
+        case 0xa2: case 0xa8: case 0xa9: case 0xaa:
+            return true;
+        case 0x0b:
+            *ends_block = true;  // ud2
+            return true;
+        case 0x0f: case 0x70: case 0x71: case 0x72: case 0x73: case 0xa4: case 0xac: case 0xba: case 0xc2: case 0xc4:
+        case 0xc5: case 0xc6:
+            *modrm = true;
+            *imm = 1;
+            return true;
+        default:
+            *modrm = true;
+            return true;
+    }
+}
+
+static bool decode(const unsigned char *code, size_t len, struct instruction *instruction) {
+    size_t i = 0;
+    bool operand16 = false;
+    bool addr32 = false;
+    bool rex_w = false;
+    while (i < len && (code[i] == 0x66 || code[i] == 0x67 || code[i] == 0xf0 || code[i] == 0xf2 || code[i] == 0xf3
+                       || code[i] == 0x26 || code[i] == 0x2e || code[i] == 0x36 || code[i] == 0x3e || code[i] == 0x64 || code[i] == 0x65)) {
+        if (code[i] == 0x66) operand16 = true;
+        if (code[i] == 0x67) addr32 = true;
+        i++;
+    }
+    if (i < len && (code[i] & 0xf0) == 0x40) rex_w = code[i++] & 8;
+    if (i >= len) return false;
+
+    unsigned char op = code[i++];
+    size_t imm_z = operand16 ? 2 : 4;
+    bool modrm = false;
+    size_t imm = 0;
+    instruction->ends_block = false;
+    instruction->is_call = false;
+    bool known;
+    if (op == 0xc4 || op == 0xc5) {
+        // VEX, which says which opcode map it is
+        int map = 1;
+        if (op == 0xc4) {
+            if (i >= len) return false;
+            map = code[i] & 0x1f;
+            i++;
+        }
+        i++;
+        if (i >= len) return false;
+        op = code[i++];
+        if (map == 1) {
+            known = two_byte_opcode(op, &modrm, &imm, &instruction->ends_block);
+            if (op == 0x77) modrm = false;  // vzeroupper
+        } else {
+            known = map == 2 || map == 3;
+            modrm = true;
+            imm = map == 3 ? 1 : 0;
+        }
+    } else if (op == 0x0f) {
+        if (i >= len) return false;
+        op = code[i++];
+        if (op == 0x38 || op == 0x3a) {
+            if (i >= len) return false;
+            i++;
+            known = true;
+            modrm = true;
+            imm = op == 0x3a ? 1 : 0;
+        } else {
+            known = two_byte_opcode(op, &modrm, &imm, &instruction->ends_block);
+        }
+    } else {
+        known = one_byte_opcode(op, rex_w, addr32, imm_z, &modrm, &imm, &instruction->ends_block);
+        if (known && modrm && i < len) {
+            int reg = (code[i] >> 3) & 7;
+            if ((op == 0xf6 || op == 0xf7) && reg < 2) imm = op == 0xf6 ? 1 : imm_z;
+            if (op == 0xff && (reg == 4 || reg == 5)) instruction->ends_block = true;
+            if (op == 0xff && reg == 2) instruction->is_call = true;
+            if (op == 0xc7 && code[i] == 0xf8) known = false;  // xbegin rel32
+        }
+    }
+    if (!known) return false;
+
+    instruction->rip_displacement = 0;
+    if (modrm) {
+        if (i >= len) return false;
+        unsigned char m = code[i++];
+        int mod = m >> 6;
+        int rm = m & 7;
+        if (mod != 3) {
+            size_t displacement = mod == 1 ? 1 : mod == 2 ? 4 : 0;
+            if (rm == 4) {
+                if (i >= len) return false;
+                if (mod == 0 && (code[i] & 7) == 5) displacement = 4;  // no base
+                i++;
+            } else if (mod == 0 && rm == 5) {
+                instruction->rip_displacement = i;
+                displacement = 4;
+            }
+            i += displacement;
+        }
+    }
+    i += imm;
+    if (i > len) return false;
+    instruction->len = i;
+    return true;
+}
+
+size_t TinyDbg_tracepoint_displaced_len(const unsigned char *code, size_t len) {
+    size_t total = 0;
+    while (total < 5) {
+        struct instruction instruction;
+        if (!decode(code + total, len - total, &instruction)) return 0;
+        total += instruction.len;
+        // the bytes after a ret or a jmp may be the start of something else, they can't be overwritten
+        if (instruction.ends_block && total < 5) return 0;
+    }
+    return total;
+}
+
+static void emit(unsigned char *code, size_t *len, const char *bytes, size_t bytes_len) {
+    memcpy(code + *len, bytes, bytes_len);
+    *len += bytes_len;
+}
+
+static void emit_u64(unsigned char *code, size_t *len, uint64_t value) {
+    memcpy(code + *len, &value, sizeof(value));
+    *len += sizeof(value);
+}
+
+// rel32 to target, written at from as the last thing in its instruction
+static bool emit_rel32(unsigned char *code, size_t *len, uintptr_t from, uintptr_t target) {
+    int64_t rel = (int64_t)(target - (from + 4));
+    if (rel != (int32_t)rel) return false;
+    int32_t rel32 = rel;
+    memcpy(code + *len, &rel32, sizeof(rel32));
+    *len += sizeof(rel32);
+    return true;
+}
+
+// Copies an instruction from position to the end of code, which runs at code_at, with its rip relative operand pointing
+// at the same place. False if that's too far from there.
+static bool relocate(const unsigned char *original, const struct instruction *instruction, uintptr_t position,
+                     unsigned char *code, size_t *len, uintptr_t code_at) {
+    size_t at = *len;
+    emit(code, len, (const char *)original, instruction->len);
+    if (instruction->rip_displacement != 0) {
+        int32_t displacement;
+        memcpy(&displacement, code + at + instruction->rip_displacement, sizeof(displacement));
+        uintptr_t target = position + instruction->len + displacement;
+        int64_t moved = (int64_t)(target - (code_at + at + instruction->len));
+        if (moved != (int32_t)moved) return false;
+        displacement = moved;
+        memcpy(code + at + instruction->rip_displacement, &displacement, sizeof(displacement));
+    }
+    return true;
+}
+
+size_t TinyDbg_tracepoint_trampoline(const TinyDbg_Tracepoint *tracepoint, uintptr_t shared, unsigned char *code, size_t *relocated_at) {
+    size_t len = 0;
+    emit(code, &len, "\x48\x8d\x64\x24\x80", 5);  // lea rsp, [rsp-0x80] - past the red zone
+    emit(code, &len, "\x9c\x50\x51\x52", 4);  // pushfq, push rax, push rcx, push rdx
+
+    emit(code, &len, "\x48\xb9", 2);  // movabs rcx, &hit_counts[counter].count
+    emit_u64(code, &len, shared + offsetof(TinyDbg_TracepointShared, hit_counts) + tracepoint->counter * 64);
+    emit(code, &len, "\xf0\x48\xff\x01", 4);  // lock inc qword [rcx]
+
+    if (tracepoint->record_hits) {
+        // take the next index in the ring, clear its sequence, write the hit and then the sequence - x86 keeps stores in order
+        emit(code, &len, "\x48\xb9", 2);  // movabs rcx, &head
+        emit_u64(code, &len, shared + offsetof(TinyDbg_TracepointShared, head));
+        emit(code, &len, "\xb8\x01\x00\x00\x00", 5);  // mov eax, 1
+        emit(code, &len, "\xf0\x48\x0f\xc1\x01", 5);  // lock xadd [rcx], rax
+        emit(code, &len, "\x48\x89\xc2", 3);  // mov rdx, rax
+        emit(code, &len, "\x48\x25", 2);  // and rax, TINYDBG_TRACEPOINT_RING_LEN - 1
+        uint32_t mask = TINYDBG_TRACEPOINT_RING_LEN - 1;
+        memcpy(code + len, &mask, sizeof(mask));
+        len += sizeof(mask);
+        emit(code, &len, "\x48\xc1\xe0\x06", 4);  // shl rax, 6 - the size of a hit
+        emit(code, &len, "\x48\xb9", 2);  // movabs rcx, &ring
+        emit_u64(code, &len, shared + offsetof(TinyDbg_TracepointShared, ring));
+        emit(code, &len, "\x48\x01\xc8", 3);  // add rax, rcx
+        emit(code, &len, "\x48\xc7\x00\x00\x00\x00\x00", 7);  // mov qword [rax], 0
+        emit(code, &len, "\x48\x89\x78\x10", 4);  // mov [rax+16], rdi
+        emit(code, &len, "\x48\x89\x70\x18", 4);  // mov [rax+24], rsi
+        emit(code, &len, "\x48\x8b\x0c\x24", 4);  // mov rcx, [rsp] - the pushed rdx
+        emit(code, &len, "\x48\x89\x48\x20", 4);  // mov [rax+32], rcx
+        emit(code, &len, "\x48\x8b\x4c\x24\x08", 5);  // mov rcx, [rsp+8] - the pushed rcx
+        emit(code, &len, "\x48\x89\x48\x28", 4);  // mov [rax+40], rcx
+        emit(code, &len, "\x4c\x89\x40\x30", 4);  // mov [rax+48], r8
+        emit(code, &len, "\x4c\x89\x48\x38", 4);  // mov [rax+56], r9
+        emit(code, &len, "\x48\xb9", 2);  // movabs rcx, position
+        emit_u64(code, &len, tracepoint->position);
+        emit(code, &len, "\x48\x89\x48\x08", 4);  // mov [rax+8], rcx
+        emit(code, &len, "\x48\xff\xc2", 3);  // inc rdx
+        emit(code, &len, "\x48\x89\x10", 3);  // mov [rax], rdx
+    }
+
+    emit(code, &len, "\x5a\x59\x58\x9d", 4);  // pop rdx, pop rcx, pop rax, popfq
+    emit(code, &len, "\x48\x8d\xa4\x24\x80\x00\x00\x00", 8);  // lea rsp, [rsp+0x80]
+
+    // the instructions the jump replaced, with their rip relative operands pointing at the same place
+    *relocated_at = len;
+    size_t done = 0;
+    while (done < tracepoint->len) {
+        struct instruction instruction;
+        const unsigned char *original = (const unsigned char *)tracepoint->original + done;
+        if (!decode(original, tracepoint->len - done, &instruction)) return 0;
+        if (!relocate(original, &instruction, tracepoint->position + done, code, &len, tracepoint->trampoline)) return 0;
+        done += instruction.len;
+    }
+
+    emit(code, &len, "\xe9", 1);  // jmp back to the instruction after them
+    if (!emit_rel32(code, &len, tracepoint->trampoline + len, tracepoint->position + tracepoint->len)) return 0;
+    return len;
+}
+
+// A relative jmp, jcc or call - its length, where it goes and the condition of a jcc (-1 for the others).
+// False if it's something else.
+static bool decode_branch(const unsigned char *code, size_t len, uintptr_t position, size_t *branch_len, uintptr_t *target,
+                          int *condition, bool *is_call) {
+    size_t i = 0;
+    // branch hints and bnd, which don't change where it goes
+    while (i < len && (code[i] == 0x2e || code[i] == 0x3e || code[i] == 0xf2)) i++;
+    if (i >= len) return false;
+    unsigned char op = code[i++];
+    size_t rel_len = 4;
+    *condition = -1;
+    *is_call = op == 0xe8;
+    if (op == 0xeb || (op >= 0x70 && op < 0x80)) {
+        rel_len = 1;
+        if (op != 0xeb) *condition = op & 0xf;
+    } else if (op == 0x0f && i < len && code[i] >= 0x80 && code[i] < 0x90) {
+        *condition = code[i++] & 0xf;
+    } else if (op != 0xe8 && op != 0xe9) {
+        return false;  // loop and jrcxz don't have a rel32 form
+    }
+    if (i + rel_len > len) return false;
+
+    int32_t rel;
+    if (rel_len == 1) {
+        rel = (int8_t)code[i];
+    } else {
+        memcpy(&rel, code + i, sizeof(rel));
+    }
+    *branch_len = i + rel_len;
+    *target = position + *branch_len + rel;
+    return true;
+}
+
+void TinyDbg_Displaced_decode(const unsigned char *code, size_t len, uintptr_t position, TinyDbg_Displaced *displaced) {
+    size_t branch_len;
+    uintptr_t target;
+    int condition;
+    bool is_call;
+    struct instruction instruction;
+    displaced->kind = TinyDbg_displaced_none;
+    if (decode_branch(code, len, position, &branch_len, &target, &condition, &is_call)) {
+        displaced->len = branch_len;
+        displaced->kind = is_call ? TinyDbg_displaced_call : TinyDbg_displaced_copy;
+        if (is_call) displaced->at = target;
+    } else if (decode(code, len, &instruction)) {
+        displaced->len = instruction.len;
+        displaced->kind = instruction.is_call ? TinyDbg_displaced_indirect_call : TinyDbg_displaced_copy;
+    }
+}
+
+size_t TinyDbg_Displaced_copy(const unsigned char *code, uintptr_t position, TinyDbg_Displaced *displaced, unsigned char *copy) {
+    size_t len = 0;
+    size_t branch_len;
+    uintptr_t target;
+    int condition;
+    bool is_call;
+    struct instruction instruction;
+    if (decode_branch(code, displaced->len, position, &branch_len, &target, &condition, &is_call)) {
+        // the same jump with a rel32, which reaches further
+        if (condition == -1) {
+            emit(copy, &len, "\xe9", 1);
+        } else {
+            copy[len++] = 0x0f;
+            copy[len++] = 0x80 | condition;
+        }
+        if (!emit_rel32(copy, &len, displaced->at + len, target)) return 0;
+    } else if (!decode(code, displaced->len, &instruction) || !relocate(code, &instruction, position, copy, &len, displaced->at)) {
+        return 0;
+    }
+    displaced->copy_len = len;
+
+    emit(copy, &len, "\xe9", 1);  // jmp back to the instruction after it
+    if (!emit_rel32(copy, &len, displaced->at + len, position + displaced->len)) return 0;
+    return len;
+}
@@ -0,0 +1,56 @@
+// Inserts and removes at random in the breakpoint index, checked against an array of what should be in it. Removing
+// shifts the rest of a probe chain back, so everything has to be found after many removes in the same chains.
+#include "test.h"
+
+#define POSITIONS 2048  // few enough that each one is inserted and removed many times
+#define STEPS 200000
+
+static void check_all(TinyDbg_BreakpointIndex *index, const bool *present, const char *original) {
+    size_t len = 0;
+    for (size_t i = 0; i < POSITIONS; i++) {
+        TinyDbg_Breakpoint *breakpoint = TinyDbg_BreakpointIndex_find(index, 0x400000 + i * 16);
+        CHECK((breakpoint != NULL) == present[i]);
+        if (breakpoint != NULL) CHECK(breakpoint->original == original[i]);
+        len += present[i];
+    }
+    CHECK(index->len == len);
+    for (size_t i = 0; i < index->len; i++) {
+        // the dense array has each of them once
+        TinyDbg_Breakpoint *breakpoint = &index->breakpoints[i];
+        CHECK(TinyDbg_BreakpointIndex_find(index, breakpoint->position) == breakpoint);
+    }
+}
+
+int main(void) {
+    TinyDbg_BreakpointIndex index;
+    TinyDbg_BreakpointIndex_init(&index);
+    static bool present[POSITIONS];
+    static char original[POSITIONS];
+    CHECK(TinyDbg_BreakpointIndex_find(&index, 0x400000) == NULL);
+    CHECK(!TinyDbg_BreakpointIndex_remove(&index, 0x400000, NULL));
+
+    srand(1);
+    for (long step = 0; step < STEPS; step++) {
+        size_t i = rand() % POSITIONS;
+        uintptr_t position = 0x400000 + i * 16;
+        // more inserts than removes at first and the other way around later, so the table grows and empties again
+        if (rand() % 4 < (step < STEPS / 2 ? 3 : 1)) {
+            TinyDbg_Breakpoint breakpoint = { .position = position, .original = (char)step };
+            TinyDbg_BreakpointIndex_insert(&index, breakpoint);
+            present[i] = true;
+            original[i] = (char)step;
+        } else {
+            TinyDbg_Breakpoint removed;
+            bool was_present = TinyDbg_BreakpointIndex_remove(&index, position, &removed);
+            CHECK(was_present == present[i]);
+            if (was_present) CHECK(removed.position == position && removed.original == original[i]);
+            present[i] = false;
+        }
+        if (step % 1000 == 0) check_all(&index, present, original);
+    }
+    check_all(&index, present, original);
+
+    TinyDbg_BreakpointIndex_destroy(&index);
+    printf("breakpoint index: %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures != 0;
+}
@@ -0,0 +1,125 @@
+// The condition compiler, evaluator and verifier, without a process: the memory is a local array at MEMORY_AT, and
+// reading anything else fails
+#include "test.h"
+
+#define MEMORY_AT 0x1000
+
+static uint64_t memory[4] = { 7, 0xfffffffffffffffe, 0, 42 };
+
+static bool read_memory(void *arg, void *local, uintptr_t remote, size_t len) {
+    (void)arg;
+    if (remote < MEMORY_AT || remote + len > MEMORY_AT + sizeof(memory)) return false;
+    memcpy(local, (char *)memory + (remote - MEMORY_AT), len);
+    return true;
+}
+
+// What TinyDbg_Condition_eval returns, or -2 if it doesn't compile
+static int eval(const char *source, const struct user_regs_struct *regs) {
+    TinyDbg_Condition *condition = TinyDbg_Condition_compile(source, NULL);
+    if (condition == NULL) return -2;
+    CHECK(TinyDbg_Condition_verify(condition));
+    int result = TinyDbg_Condition_eval(condition, regs, read_memory, NULL);
+    TinyDbg_Condition_free(condition);
+    return result;
+}
+
+static bool verifies(const TinyDbg_ConditionInstruction *code, size_t len) {
+    TinyDbg_Condition *condition = malloc(sizeof(TinyDbg_Condition) + len * sizeof(TinyDbg_ConditionInstruction));
+    condition->len = len;
+    memcpy(condition->code, code, len * sizeof(TinyDbg_ConditionInstruction));
+    bool result = TinyDbg_Condition_verify(condition);
+    free(condition);
+    return result;
+}
+
+#define I(op, operand) { operand, TinyDbg_condition_op_##op }
+#define VERIFIES(...) ({ \
+        TinyDbg_ConditionInstruction code[] = { __VA_ARGS__ }; \
+        verifies(code, sizeof(code) / sizeof(code[0])); \
+    })
+
+int main(void) {
+    struct user_regs_struct regs = { 0 };
+    regs.rdi = 1;
+    regs.rsi = 2;
+    regs.rdx = 2;
+    regs.rax = 0xffffffff00000005;
+
+    // precedence and associativity are C's
+    CHECK(eval("1 + 2 * 3 == 7", &regs) == 1);
+    CHECK(eval("(1 + 2) * 3 == 9", &regs) == 1);
+    CHECK(eval("rdi & rsi == rdx", &regs) == 1);    // rdi & (rsi == rdx)
+    CHECK(eval("(rdi & rsi) == rdx", &regs) == 0);
+    CHECK(eval("10 - 4 - 3 == 3", &regs) == 1);
+    CHECK(eval("1 << 2 << 3 == 32", &regs) == 1);
+    CHECK(eval("1 | 6 ^ 3 & 5 == 7", &regs) == 1);
+    CHECK(eval("1 || 0 && 0", &regs) == 1);
+    CHECK(eval("!0 + -1 == 0", &regs) == 1);
+    CHECK(eval("-1 < 0", &regs) == 1);
+    CHECK(eval("eax == 5 && rax != 5", &regs) == 1);
+
+    // && and || give 0 or 1, and only run the right side when it matters
+    CHECK(eval("(3 && 5) == 1", &regs) == 1);
+    CHECK(eval("(0 || 9) == 1", &regs) == 1);
+    CHECK(eval("(3 && 0) + (0 || 0) == 0", &regs) == 1);
+    CHECK(eval("0 && u64[0]", &regs) == 0);
+    CHECK(eval("1 || u64[0]", &regs) == 1);
+    CHECK(eval("1 && u64[0]", &regs) == -1);
+    CHECK(eval("0 || u64[0]", &regs) == -1);
+    CHECK(eval("rdi != 0 && u64[rdi] == 7", &regs) == -1);
+    regs.rdi = MEMORY_AT;
+    CHECK(eval("rdi != 0 && u64[rdi] == 7", &regs) == 1);
+    regs.rdi = 0;
+    CHECK(eval("rdi != 0 && u64[rdi] == 7", &regs) == 0);
+
+    // memory and sign extension
+    CHECK(eval("u64[0x1008] == 0xfffffffffffffffe", &regs) == 1);
+    CHECK(eval("u8[0x1008] == 254 && s8[0x1008] == -2 && s16[0x1008] == -2", &regs) == 1);
+    CHECK(eval("u32[0x1018] + u64[0x1000] == 49", &regs) == 1);
+    CHECK(eval("s32(0xffffffff) == -1 && s8(0x17f) == 127", &regs) == 1);
+    CHECK(eval("u64[0x101c]", &regs) == -1);
+
+    // and what doesn't compile
+    size_t error_at = 0;
+    CHECK(TinyDbg_Condition_compile("rdi == ", &error_at) == NULL && error_at == 7);
+    CHECK(TinyDbg_Condition_compile("foo == 1", &error_at) == NULL && error_at == 0);
+    CHECK(eval("(1", &regs) == -2);
+    CHECK(eval("u64[1", &regs) == -2);
+    CHECK(eval("1 2", &regs) == -2);
+
+    // bytecode that isn't from the compiler
+    CHECK(VERIFIES(I(const, 1)));
+    CHECK(VERIFIES(I(const, 0), I(jump_if_zero, 1), I(const, 2), I(not, 0)));
+    CHECK(VERIFIES(I(const, 0), I(jump_if_zero, 2), I(const, 2), I(not, 0)));
+    CHECK(!VERIFIES(I(add, 0)));
+    CHECK(!VERIFIES(I(const, 1), I(add, 0)));
+    CHECK(!VERIFIES(I(const, 1), I(const, 2)));
+    CHECK(!VERIFIES(I(const, 1), I(jump_if_zero, 1)));
+    CHECK(!VERIFIES(I(const, 1), I(jump_if_zero, 2), I(const, 2), I(const, 3), I(add, 0)));
+    CHECK(!VERIFIES(I(reg, 3)));
+    CHECK(!VERIFIES(I(reg, sizeof(struct user_regs_struct))));
+    CHECK(!VERIFIES(I(const, MEMORY_AT), I(load, 3)));
+    CHECK(!VERIFIES(I(const, 1), I(sext, 0)));
+    CHECK(!VERIFIES(I(const, 1), I(sext, 64)));
+    CHECK(!VERIFIES(I(const, 1), I(const, 2), { 0, 99 }));
+    CHECK(!VERIFIES(I(not, 0)));
+
+    TinyDbg_ConditionInstruction deep[2 * TINYDBG_CONDITION_MAX_STACK + 1];
+    for (size_t i = 0; i <= TINYDBG_CONDITION_MAX_STACK; i++) deep[i] = (TinyDbg_ConditionInstruction)I(const, i);
+    for (size_t i = 1; i <= TINYDBG_CONDITION_MAX_STACK; i++) {
+        deep[TINYDBG_CONDITION_MAX_STACK + i] = (TinyDbg_ConditionInstruction)I(add, 0);
+    }
+    CHECK(!verifies(deep, 0));
+    CHECK(verifies(deep + 1, 2 * TINYDBG_CONDITION_MAX_STACK - 1));
+    CHECK(!verifies(deep, 2 * TINYDBG_CONDITION_MAX_STACK + 1));  // one too many on the stack
+
+    TinyDbg_ConditionInstruction *long_code = malloc((TINYDBG_CONDITION_MAX_CODE + 1) * sizeof(TinyDbg_ConditionInstruction));
+    long_code[0] = (TinyDbg_ConditionInstruction)I(const, 1);
+    for (size_t i = 1; i <= TINYDBG_CONDITION_MAX_CODE; i++) long_code[i] = (TinyDbg_ConditionInstruction)I(not, 0);
+    CHECK(verifies(long_code, TINYDBG_CONDITION_MAX_CODE));
+    CHECK(!verifies(long_code, TINYDBG_CONDITION_MAX_CODE + 1));
+    free(long_code);
+
+    printf("conditions: %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures != 0;
+}
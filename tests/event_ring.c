@@ -0,0 +1,77 @@
+// The sequence of each slot of the event ring, going around it a few times on one thread, and then one producer and a
+// few consumers: every event is taken exactly once, each consumer gets them in order, and closing wakes them up.
+#include "test.h"
+
+#define LEN 8
+#define EVENTS 200000
+#define CONSUMERS 4
+
+static TinyDbg_EventRing ring;
+static unsigned char taken[EVENTS];
+
+static void push(pid_t tid) {
+    TinyDbg_Event event = { 0 };
+    event.tid = tid;
+    TinyDbg_EventRing_push(&ring, &event);
+}
+
+static void *consume(void *arg) {
+    (void)arg;
+    TinyDbg_Event events[5];
+    pid_t last = -1;
+    while (true) {
+        size_t len = TinyDbg_EventRing_wait(&ring, events, 5, -1);
+        if (len == 0) break;  // closed, and there are none left
+        for (size_t i = 0; i < len; i++) {
+            CHECK(events[i].tid > last);
+            last = events[i].tid;
+            __atomic_add_fetch(&taken[last], 1, __ATOMIC_RELAXED);
+        }
+    }
+    return NULL;
+}
+
+int main(void) {
+    TinyDbg_EventRing_init(&ring, LEN);
+    TinyDbg_Event events[LEN + 1];
+    CHECK(TinyDbg_EventRing_poll(&ring, events, LEN) == 0);
+    CHECK(TinyDbg_EventRing_wait(&ring, events, LEN, 10) == 0);
+
+    // a slot waiting for event n has sequence n, n + 1 once it's in, and n + LEN once it's taken
+    pid_t next = 0;
+    pid_t expected = 0;
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < LEN; i++) {
+            CHECK(ring.slots[next % LEN].sequence == (uint64_t)next);
+            push(next);
+            CHECK(ring.slots[next % LEN].sequence == (uint64_t)next + 1);
+            next++;
+        }
+        // full, the next push would wait for the slot of the first one
+        CHECK(ring.slots[next % LEN].sequence == (uint64_t)next + 1 - LEN);
+        size_t len = TinyDbg_EventRing_poll(&ring, events, 3);
+        len += TinyDbg_EventRing_poll(&ring, events + len, LEN + 1 - len);
+        CHECK(len == LEN);
+        for (size_t i = 0; i < len; i++) {
+            CHECK(events[i].tid == expected);
+            CHECK(ring.slots[expected % LEN].sequence == (uint64_t)expected + LEN);
+            expected++;
+        }
+        CHECK(ring.head == ring.tail && ring.tail == (uint64_t)next);
+    }
+    TinyDbg_EventRing_destroy(&ring);
+
+    TinyDbg_EventRing_init(&ring, LEN);
+    pthread_t consumers[CONSUMERS];
+    for (int i = 0; i < CONSUMERS; i++) pthread_create(&consumers[i], NULL, consume, NULL);
+    for (pid_t tid = 0; tid < EVENTS; tid++) push(tid);  // waits for room most of the time
+    TinyDbg_EventRing_close(&ring);
+    for (int i = 0; i < CONSUMERS; i++) pthread_join(consumers[i], NULL);
+    size_t wrong = 0;
+    for (size_t i = 0; i < EVENTS; i++) wrong += taken[i] != 1;
+    CHECK(wrong == 0);
+    TinyDbg_EventRing_destroy(&ring);
+
+    printf("event ring: %s\n", failures == 0 ? "ok" : "FAILED");
+    return failures != 0;
+}
@@ -0,0 +1,15 @@
+// What the tests have in common: CHECK reports what failed and goes on, and main returns whether anything did
+#ifndef GUARD_TEST_H
+#define GUARD_TEST_H
+#include "../src/debugger.h"
+
+static int failures;
+
+#define CHECK(x) do { \
+        if (!(x)) { \
+            fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #x); \
+            failures++; \
+        } \
+    } while (0)
+
+#endif
@@ -0,0 +1,1661 @@
+// The native module behind tinydbg_py. Every function of debugger.h is a method of TinyDbg, and the requests return a
+// JoinHandle whose join() gives the result. The GIL is released while joining, consuming events and freeing, and
+// memory is read straight into bytes objects or any writable buffer, so a call costs about what the request does.
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+#include <structmember.h>
+#include "../src/debugger.h"
+
+typedef struct DebuggerObject DebuggerObject;
+typedef struct ConsumerObject ConsumerObject;
+typedef struct JoinHandleObject JoinHandleObject;
+
+struct DebuggerObject {
+    PyObject_HEAD
+    TinyDbg *handle;                // NULL once it's closed
+    DebuggerObject *parent;         // for a followed child, the first debugger - which frees it along with itself
+    ConsumerObject *consumers;      // destroyed before the handle is freed, the children's are the first debugger's
+    JoinHandleObject *batch;        // between batch_begin and batch_submit, when requests give no handle
+    PyObject *batched;              // the requests in it that use our memory, which batch_submit hands to the batch
+};
+
+struct ConsumerObject {
+    PyObject_HEAD
+    DebuggerObject *debugger;
+    EventQueue_Consumer *consumer;  // NULL once it's closed
+    ConsumerObject *next;
+};
+
+struct JoinHandleObject {
+    PyObject_HEAD
+    EventQueue_JoinHandle *join_handle;     // NULL once it's joined, and in a batch
+    PyObject *value;                // what join() returns, unless finish makes it
+    PyObject *(*finish)(JoinHandleObject *);
+    PyObject *keep;                 // the process manager uses it until the request is done
+    Py_buffer buffer;               // memory that the process manager reads or writes, if has_buffer
+    bool has_buffer;
+    bool flag;                      // set by the process manager, for the requests that say whether they worked
+    TinyDbg_Checkpoint *checkpoint;
+    JoinHandleObject *batch;        // the batch it's in until that's done, the request is done along with it
+    PyObject *batched;              // for a submitted batch, the requests it keeps until it's done
+};
+
+typedef struct {
+    PyObject_HEAD
+    struct user_regs_struct regs;
+} RegsObject;
+
+typedef struct {
+    PyObject_HEAD
+    DebuggerObject *debugger;
+    TinyDbg_Checkpoint *checkpoint; // NULL once it's freed
+} CheckpointObject;
+
+static PyTypeObject DebuggerType;
+static PyTypeObject ConsumerType;
+static PyTypeObject JoinHandleType;
+static PyTypeObject RegsType;
+static PyTypeObject CheckpointType;
+
+static PyTypeObject *ThreadType;
+static PyTypeObject *BreakpointType;
+static PyTypeObject *WatchpointType;
+static PyTypeObject *TracepointType;
+static PyTypeObject *TracepointHitType;
+static PyTypeObject *MemoryMapType;
+static PyTypeObject *SymbolType;
+static PyTypeObject *ProfileStatsType;
+static PyTypeObject *EventType;
+
+// The handle, or NULL with an exception set if it (or the first debugger, which frees the children) was closed
+static TinyDbg *get_handle(DebuggerObject *self) {
+    for (DebuggerObject *debugger = self; debugger != NULL; debugger = debugger->parent) {
+        if (debugger->handle == NULL) {
+            PyErr_SetString(PyExc_ValueError, "the debugger is closed");
+            return NULL;
+        }
+    }
+    return self->handle;
+}
+
+static DebuggerObject *root_debugger(DebuggerObject *self) {
+    while (self->parent != NULL) self = self->parent;
+    return self;
+}
+
+static DebuggerObject *new_child_debugger(DebuggerObject *parent, TinyDbg *handle) {
+    DebuggerObject *child = PyObject_New(DebuggerObject, &DebuggerType);
+    if (child == NULL) return NULL;
+    child->handle = handle;
+    Py_INCREF(parent);
+    child->parent = parent;
+    child->consumers = NULL;
+    child->batch = NULL;
+    child->batched = NULL;
+    return child;
+}
+
+/* JoinHandle */
+
+// Lets go of the requests of a batch once it's done, or once it won't be sent
+static void release_batched(PyObject *batched) {
+    for (Py_ssize_t i = 0; i < PyList_GET_SIZE(batched); i++) {
+        ((JoinHandleObject *)PyList_GET_ITEM(batched, i))->batch = NULL;
+    }
+    Py_DECREF(batched);
+}
+
+static void join_handle_wait(JoinHandleObject *self) {
+    if (self->batch != NULL) join_handle_wait(self->batch);
+    if (self->join_handle == NULL) return;
+    EventQueue_JoinHandle *join_handle = self->join_handle;
+    self->join_handle = NULL;
+    Py_BEGIN_ALLOW_THREADS
+    EventQueue_join(join_handle);
+    Py_END_ALLOW_THREADS
+    if (self->batched != NULL) {
+        PyObject *batched = self->batched;
+        self->batched = NULL;
+        release_batched(batched);
+    }
+}
+
+// Wraps what a request returned - a NULL handle in a batch is joined with the batch instead
+static PyObject *new_join_handle(EventQueue_JoinHandle *join_handle, PyObject *value, PyObject *keep) {
+    JoinHandleObject *self = PyObject_New(JoinHandleObject, &JoinHandleType);
+    if (self == NULL) {
+        if (join_handle != NULL) {
+            Py_BEGIN_ALLOW_THREADS
+            EventQueue_join(join_handle);
+            Py_END_ALLOW_THREADS
+        }
+        return NULL;
+    }
+    self->join_handle = join_handle;
+    Py_XINCREF(value);
+    self->value = value;
+    self->finish = NULL;
+    Py_XINCREF(keep);
+    self->keep = keep;
+    self->has_buffer = false;
+    self->flag = false;
+    self->checkpoint = NULL;
+    self->batch = NULL;
+    self->batched = NULL;
+    return (PyObject *)self;
+}
+
+// Sets the handle of a request that uses our memory. In a batch it has none, so the batch keeps it until it's done.
+static PyObject *request_sent(DebuggerObject *self, JoinHandleObject *result, EventQueue_JoinHandle *join_handle) {
+    result->join_handle = join_handle;
+    if (join_handle == NULL && self->batched != NULL) {
+        // it's leaked rather than freed if it can't be kept, since the batch will use its memory
+        if (PyList_Append(self->batched, (PyObject *)result) != 0) return NULL;
+        result->batch = self->batch;
+    }
+    return (PyObject *)result;
+}
+
+static void JoinHandle_dealloc(JoinHandleObject *self) {
+    // the process manager may still use the memory
+    join_handle_wait(self);
+    if (self->has_buffer) PyBuffer_Release(&self->buffer);
+    Py_XDECREF(self->value);
+    Py_XDECREF(self->keep);
+    PyObject_Free(self);
+}
+
+static PyObject *JoinHandle_join(JoinHandleObject *self, PyObject *unused) {
+    (void)unused;
+    if (self->batch != NULL && self->batch->batched == NULL) {
+        PyErr_SetString(PyExc_ValueError, "the request is in a batch that wasn't submitted");
+        return NULL;
+    }
+    join_handle_wait(self);
+    if (self->finish != NULL) {
+        PyObject *value = self->finish(self);
+        if (value == NULL) return NULL;
+        self->finish = NULL;
+        Py_XSETREF(self->value, value);
+    }
+    if (self->has_buffer) {
+        PyBuffer_Release(&self->buffer);
+        self->has_buffer = false;
+    }
+    if (self->value == NULL) Py_RETURN_NONE;
+    Py_INCREF(self->value);
+    return self->value;
+}
+
+static PyObject *JoinHandle_detach(JoinHandleObject *self, PyObject *unused) {
+    (void)unused;
+    if (self->has_buffer || self->keep != NULL || self->batched != NULL) {
+        // the memory it uses has to stay until it's done, so it's joined when this object goes away instead
+        Py_RETURN_NONE;
+    }
+    if (self->join_handle != NULL) EventQueue_detach(self->join_handle);
+    self->join_handle = NULL;
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef JoinHandle_methods[] = {
+    {"join", (PyCFunction)JoinHandle_join, METH_NOARGS, "Wait until the request is done, and return its result"},
+    {"detach", (PyCFunction)JoinHandle_detach, METH_NOARGS, "Don't wait for the request"},
+    {NULL}
+};
+
+static PyTypeObject JoinHandleType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tinydbg_py.JoinHandle",
+    .tp_basicsize = sizeof(JoinHandleObject),
+    .tp_dealloc = (destructor)JoinHandle_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A request sent to the process manager",
+    .tp_methods = JoinHandle_methods,
+};
+
+/* Regs */
+
+#define REG(name) {#name, T_ULONGLONG, offsetof(RegsObject, regs.name), 0, NULL}
+static PyMemberDef Regs_members[] = {
+    REG(r15), REG(r14), REG(r13), REG(r12), REG(rbp), REG(rbx), REG(r11), REG(r10), REG(r9), REG(r8), REG(rax), REG(rcx),
+    REG(rdx), REG(rsi), REG(rdi), REG(orig_rax), REG(rip), REG(cs), REG(eflags), REG(rsp), REG(ss), REG(fs_base),
+    REG(gs_base), REG(ds), REG(es), REG(fs), REG(gs),
+    {NULL}
+};
+#undef REG
+
+static PyObject *Regs_new(PyTypeObject *type, PyObject *args, PyObject *kwargs) {
+    (void)args;
+    (void)kwargs;
+    RegsObject *self = (RegsObject *)type->tp_alloc(type, 0);  // zeroed
+    return (PyObject *)self;
+}
+
+// The struct user_regs_struct itself, e.g. for memoryview(regs).cast("Q")
+static int Regs_getbuffer(RegsObject *self, Py_buffer *view, int flags) {
+    return PyBuffer_FillInfo(view, (PyObject *)self, &self->regs, sizeof(self->regs), 0, flags);
+}
+
+static PyBufferProcs Regs_as_buffer = {
+    .bf_getbuffer = (getbufferproc)Regs_getbuffer,
+};
+
+static PyTypeObject RegsType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tinydbg_py.Regs",
+    .tp_basicsize = sizeof(RegsObject),
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "struct user_regs_struct, which can be passed to get_regs again to be filled in place",
+    .tp_members = Regs_members,
+    .tp_new = Regs_new,
+    .tp_as_buffer = &Regs_as_buffer,
+};
+
+/* Checkpoint */
+
+static void Checkpoint_dealloc(CheckpointObject *self) {
+    // it's freed with the debugger, or with free_checkpoint
+    Py_XDECREF(self->debugger);
+    PyObject_Free(self);
+}
+
+static PyObject *Checkpoint_get_pid(CheckpointObject *self, void *closure) {
+    (void)closure;
+    if (self->checkpoint == NULL || get_handle(self->debugger) == NULL) Py_RETURN_NONE;
+    return PyLong_FromLong(self->checkpoint->pid);
+}
+
+static PyGetSetDef Checkpoint_getset[] = {
+    {"pid", (getter)Checkpoint_get_pid, NULL, "The frozen copy of the process, None once it's freed", NULL},
+    {NULL}
+};
+
+static PyTypeObject CheckpointType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tinydbg_py.Checkpoint",
+    .tp_basicsize = sizeof(CheckpointObject),
+    .tp_dealloc = (destructor)Checkpoint_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "A frozen copy of the process from TinyDbg.checkpoint",
+    .tp_getset = Checkpoint_getset,
+};
+
+/* struct sequences */
+
+static PyStructSequence_Field Thread_fields[] = {
+    {"tid", NULL}, {"is_stopped", NULL}, {"resumed", NULL}, {"in_syscall", NULL}, {"group_stopped", NULL}, {NULL}
+};
+static PyStructSequence_Field Breakpoint_fields[] = {
+    {"position", NULL}, {"is_once", NULL}, {"original", NULL}, {"has_condition", NULL}, {"hits", NULL},
+    {"ignore_count", NULL}, {NULL}
+};
+static PyStructSequence_Field Watchpoint_fields[] = {
+    {"address", NULL}, {"len", NULL}, {"kind", NULL}, {NULL}
+};
+static PyStructSequence_Field Tracepoint_fields[] = {
+    {"position", NULL}, {"trampoline", NULL}, {"len", NULL}, {"record_hits", NULL}, {NULL}
+};
+static PyStructSequence_Field TracepointHit_fields[] = {
+    {"position", NULL}, {"args", "rdi, rsi, rdx, rcx, r8 and r9"}, {NULL}
+};
+static PyStructSequence_Field MemoryMap_fields[] = {
+    {"begin", NULL}, {"end", NULL}, {"page_offset", NULL}, {"perm_read", NULL}, {"perm_write", NULL},
+    {"perm_execute", NULL}, {"perm_mayshare", NULL}, {"pathname", NULL}, {NULL}
+};
+static PyStructSequence_Field Symbol_fields[] = {
+    {"name", NULL}, {"address", NULL}, {"size", NULL}, {"bias", NULL}, {NULL}
+};
+static PyStructSequence_Field ProfileStats_fields[] = {
+    {"samples", NULL}, {"stacks", NULL}, {"missed", NULL}, {"pause_total_ns", NULL}, {"pause_max_ns", NULL},
+    {"elapsed_ns", NULL}, {NULL}
+};
+static PyStructSequence_Field Event_fields[] = {
+    {"type", "a TinyDbg_event_type_* constant"},
+    {"tid", NULL},
+    {"pid", NULL},
+    {"stop_code", "exit code or signal, for exit and stop events"},
+    {"syscall_id", NULL},
+    {"is_exit", "whether a syscall event is of its exit"},
+    {"breakpoint", "a Breakpoint, for breakpoint events"},
+    {"watchpoint", "a Watchpoint, for watchpoint events"},
+    {"child_pid", NULL},
+    {"child", "the TinyDbg of a followed child, for fork events"},
+    {NULL}
+};
+
+#define STRUCT_SEQUENCE(name, doc) \
+    { "tinydbg_py." #name, doc, name##_fields, sizeof(name##_fields) / sizeof(name##_fields[0]) - 1 }
+static PyStructSequence_Desc Thread_desc = STRUCT_SEQUENCE(Thread, "A thread of the process");
+static PyStructSequence_Desc Breakpoint_desc = STRUCT_SEQUENCE(Breakpoint, "A breakpoint");
+static PyStructSequence_Desc Watchpoint_desc = STRUCT_SEQUENCE(Watchpoint, "A watchpoint in a debug register");
+static PyStructSequence_Desc Tracepoint_desc = STRUCT_SEQUENCE(Tracepoint, "A tracepoint");
+static PyStructSequence_Desc TracepointHit_desc = STRUCT_SEQUENCE(TracepointHit, "A recorded hit of a tracepoint");
+static PyStructSequence_Desc MemoryMap_desc = STRUCT_SEQUENCE(MemoryMap, "A mapping of the process");
+static PyStructSequence_Desc Symbol_desc = STRUCT_SEQUENCE(Symbol, "A function or variable of an ELF file");
+static PyStructSequence_Desc ProfileStats_desc = STRUCT_SEQUENCE(ProfileStats, "How long the samples kept the process stopped");
+static PyStructSequence_Desc Event_desc = STRUCT_SEQUENCE(Event, "An event of the process, fields that aren't about it are None");
+#undef STRUCT_SEQUENCE
+
+// Builds a struct sequence from a Py_BuildValue format with an item for each field
+static PyObject *struct_sequence(PyTypeObject *type, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    PyObject *items = Py_VaBuildValue(format, args);
+    va_end(args);
+    if (items == NULL) return NULL;
+    PyObject *result = PyStructSequence_New(type);
+    if (result == NULL) {
+        Py_DECREF(items);
+        return NULL;
+    }
+    for (Py_ssize_t i = 0; i < PyTuple_GET_SIZE(items); i++) {
+        PyObject *item = PyTuple_GET_ITEM(items, i);
+        Py_INCREF(item);
+        PyStructSequence_SET_ITEM(result, i, item);
+    }
+    Py_DECREF(items);
+    return result;
+}
+
+static PyObject *breakpoint_object(const TinyDbg_Breakpoint *breakpoint) {
+    return struct_sequence(BreakpointType, "(kNiNKK)", (unsigned long)breakpoint->position,
+                           PyBool_FromLong(breakpoint->is_once), (int)(unsigned char)breakpoint->original,
+                           PyBool_FromLong(breakpoint->condition != NULL), (unsigned long long)breakpoint->hits,
+                           (unsigned long long)breakpoint->ignore_count);
+}
+
+static PyObject *watchpoint_object(const TinyDbg_Watchpoint *watchpoint) {
+    return struct_sequence(WatchpointType, "(kni)", (unsigned long)watchpoint->address, (Py_ssize_t)watchpoint->len,
+                           (int)watchpoint->kind);
+}
+
+static PyObject *event_object(DebuggerObject *debugger, const TinyDbg_Event *event) {
+    PyObject *stop_code = Py_None, *syscall_id = Py_None, *is_exit = Py_None, *breakpoint = Py_None;
+    PyObject *watchpoint = Py_None, *child_pid = Py_None, *child = Py_None;
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    Py_INCREF(Py_None);
+    switch (event->type) {
+        case TinyDbg_event_type_exit:
+        case TinyDbg_event_type_stop:
+            Py_SETREF(stop_code, PyLong_FromLong(event->content.stop_code));
+            break;
+        case TinyDbg_event_type_syscall:
+            Py_SETREF(syscall_id, PyLong_FromLong(event->content.syscall.id));
+            Py_SETREF(is_exit, PyBool_FromLong(event->content.syscall.is_exit));
+            break;
+        case TinyDbg_event_type_breakpoint:
+            Py_SETREF(breakpoint, breakpoint_object(&event->content.breakpoint));
+            break;
+        case TinyDbg_event_type_watchpoint:
+            Py_SETREF(watchpoint, watchpoint_object(&event->content.watchpoint));
+            break;
+        case TinyDbg_event_type_fork:
+            Py_SETREF(child_pid, PyLong_FromLong(event->content.fork.pid));
+            if (event->content.fork.handle != NULL) {
+                Py_SETREF(child, (PyObject *)new_child_debugger(root_debugger(debugger), event->content.fork.handle));
+            }
+            break;
+        default:
+            break;
+    }
+    if (stop_code == NULL || syscall_id == NULL || is_exit == NULL || breakpoint == NULL || watchpoint == NULL
+            || child_pid == NULL || child == NULL) {
+        Py_XDECREF(stop_code);
+        Py_XDECREF(syscall_id);
+        Py_XDECREF(is_exit);
+        Py_XDECREF(breakpoint);
+        Py_XDECREF(watchpoint);
+        Py_XDECREF(child_pid);
+        Py_XDECREF(child);
+        return NULL;
+    }
+    return struct_sequence(EventType, "(iiiNNNNNNN)", (int)event->type, (int)event->tid, (int)event->pid, stop_code,
+                           syscall_id, is_exit, breakpoint, watchpoint, child_pid, child);
+}
+
+/* Consumer */
+
+static void consumer_close(ConsumerObject *self) {
+    if (self->consumer == NULL) return;
+    EventQueue_destroy_consumer(self->consumer);
+    self->consumer = NULL;
+    ConsumerObject **link = &self->debugger->consumers;
+    while (*link != self) link = &(*link)->next;
+    *link = self->next;
+}
+
+static void Consumer_dealloc(ConsumerObject *self) {
+    consumer_close(self);
+    Py_XDECREF(self->debugger);
+    PyObject_Free(self);
+}
+
+static PyObject *Consumer_consume(ConsumerObject *self, PyObject *unused) {
+    (void)unused;
+    if (self->consumer == NULL || get_handle(self->debugger) == NULL) {
+        if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "the consumer is closed");
+        return NULL;
+    }
+    TinyDbg_Event *event = NULL;
+    char result;
+    Py_BEGIN_ALLOW_THREADS
+    result = EventQueue_consume(self->consumer, (void **)&event);
+    Py_END_ALLOW_THREADS
+    if (result == 'K' || event == NULL) Py_RETURN_NONE;  // the debugger was freed
+    PyObject *object = event_object(self->debugger, event);
+    TinyDbg_Event_free(event);
+    return object;
+}
+
+static PyObject *Consumer_close(ConsumerObject *self, PyObject *unused) {
+    (void)unused;
+    consumer_close(self);
+    Py_RETURN_NONE;
+}
+
+static PyMethodDef Consumer_methods[] = {
+    {"consume", (PyCFunction)Consumer_consume, METH_NOARGS, "Wait for the next event, None once the debugger is freed"},
+    {"close", (PyCFunction)Consumer_close, METH_NOARGS, "Stop consuming events"},
+    {NULL}
+};
+
+static PyTypeObject ConsumerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tinydbg_py.Consumer",
+    .tp_basicsize = sizeof(ConsumerObject),
+    .tp_dealloc = (destructor)Consumer_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT,
+    .tp_doc = "Takes events from eq_debugger_events",
+    .tp_methods = Consumer_methods,
+};
+
+/* TinyDbg */
+
+// A list of str (or bytes) as a NULL terminated array of copies, free it with free_strings
+static char **strings_from_sequence(PyObject *sequence) {
+    PyObject *fast = PySequence_Fast(sequence, "expected a sequence of strings");
+    if (fast == NULL) return NULL;
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(fast);
+    char **strings = calloc(len + 1, sizeof(char *));
+    for (Py_ssize_t i = 0; i < len; i++) {
+        PyObject *bytes;
+        if (!PyUnicode_FSConverter(PySequence_Fast_GET_ITEM(fast, i), &bytes)) {
+            for (Py_ssize_t j = 0; j < i; j++) free(strings[j]);
+            free(strings);
+            Py_DECREF(fast);
+            return NULL;
+        }
+        strings[i] = strdup(PyBytes_AS_STRING(bytes));
+        Py_DECREF(bytes);
+    }
+    Py_DECREF(fast);
+    return strings;
+}
+
+static void free_strings(char **strings) {
+    if (strings == NULL) return;
+    for (char **string = strings; *string != NULL; string++) free(*string);
+    free(strings);
+}
+
+// envp from a mapping like os.environ, a sequence of "NAME=value", or None for the environment of this process
+static char **environment(PyObject *envp) {
+    if (envp == Py_None) {
+        PyObject *os = PyImport_ImportModule("os");
+        if (os == NULL) return NULL;
+        PyObject *environ = PyObject_GetAttrString(os, "environ");
+        Py_DECREF(os);
+        if (environ == NULL) return NULL;
+        char **strings = environment(environ);
+        Py_DECREF(environ);
+        return strings;
+    }
+    if (!PyMapping_Check(envp) || PyUnicode_Check(envp) || PySequence_Check(envp)) return strings_from_sequence(envp);
+
+    PyObject *items = PyMapping_Items(envp);
+    if (items == NULL) return NULL;
+    Py_ssize_t len = PyList_GET_SIZE(items);
+    PyObject *assignments = PyList_New(len);
+    for (Py_ssize_t i = 0; assignments != NULL && i < len; i++) {
+        PyObject *item = PyList_GET_ITEM(items, i);
+        PyObject *assignment = PyUnicode_FromFormat("%S=%S", PyTuple_GET_ITEM(item, 0), PyTuple_GET_ITEM(item, 1));
+        if (assignment == NULL) Py_CLEAR(assignments);
+        else PyList_SET_ITEM(assignments, i, assignment);
+    }
+    Py_DECREF(items);
+    if (assignments == NULL) return NULL;
+    char **strings = strings_from_sequence(assignments);
+    Py_DECREF(assignments);
+    return strings;
+}
+
+// Syscall numbers (or None) as an array of ints, free it with free()
+static int *int_array(PyObject *sequence, size_t *len) {
+    PyObject *fast = PySequence_Fast(sequence, "expected a sequence of ints");
+    if (fast == NULL) return NULL;
+    *len = PySequence_Fast_GET_SIZE(fast);
+    int *values = malloc((*len + 1) * sizeof(int));
+    for (size_t i = 0; i < *len; i++) {
+        values[i] = PyLong_AsLong(PySequence_Fast_GET_ITEM(fast, i));
+        if (values[i] == -1 && PyErr_Occurred()) {
+            free(values);
+            Py_DECREF(fast);
+            return NULL;
+        }
+    }
+    Py_DECREF(fast);
+    return values;
+}
+
+static uintptr_t *address_array(PyObject *sequence, size_t *len) {
+    PyObject *fast = PySequence_Fast(sequence, "expected a sequence of addresses");
+    if (fast == NULL) return NULL;
+    *len = PySequence_Fast_GET_SIZE(fast);
+    uintptr_t *values = malloc((*len + 1) * sizeof(uintptr_t));
+    for (size_t i = 0; i < *len; i++) {
+        values[i] = PyLong_AsUnsignedLongMask(PySequence_Fast_GET_ITEM(fast, i));
+        if (PyErr_Occurred()) {
+            free(values);
+            Py_DECREF(fast);
+            return NULL;
+        }
+    }
+    Py_DECREF(fast);
+    return values;
+}
+
+static int Debugger_init(DebuggerObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"filename", "argv", "envp", "flags", "syscalls", NULL};
+    PyObject *filename_object, *argv_object, *envp_object = Py_None, *syscalls_object = Py_None;
+    unsigned int flags = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O&O|OIO", keywords, PyUnicode_FSConverter, &filename_object,
+                                     &argv_object, &envp_object, &flags, &syscalls_object)) {
+        return -1;
+    }
+    if (self->handle != NULL) {
+        Py_DECREF(filename_object);
+        PyErr_SetString(PyExc_RuntimeError, "the debugger was started already");
+        return -1;
+    }
+
+    char **argv = strings_from_sequence(argv_object);
+    char **envp = argv != NULL ? environment(envp_object) : NULL;
+    int *syscalls = NULL;
+    size_t syscalls_len = 0;
+    if (envp != NULL && syscalls_object != Py_None) syscalls = int_array(syscalls_object, &syscalls_len);
+    if (envp == NULL || (syscalls_object != Py_None && syscalls == NULL)) {
+        free_strings(argv);
+        free_strings(envp);
+        Py_DECREF(filename_object);
+        return -1;
+    }
+
+    const char *filename = PyBytes_AS_STRING(filename_object);
+    TinyDbg *handle;
+    Py_BEGIN_ALLOW_THREADS
+    if (syscalls != NULL) {
+        handle = TinyDbg_start_syscall_filtered(filename, argv, envp, flags, syscalls, syscalls_len);
+    } else {
+        handle = TinyDbg_start_advanced(filename, argv, envp, flags);
+    }
+    Py_END_ALLOW_THREADS
+    free(syscalls);
+    free_strings(argv);
+    free_strings(envp);
+    Py_DECREF(filename_object);
+    self->handle = handle;
+    return 0;
+}
+
+static PyObject *Debugger_attach(PyTypeObject *type, PyObject *args) {
+    int pid;
+    unsigned int flags = 0;
+    if (!PyArg_ParseTuple(args, "i|I", &pid, &flags)) return NULL;
+    TinyDbg *handle;
+    Py_BEGIN_ALLOW_THREADS
+    handle = TinyDbg_attach(pid, flags);
+    Py_END_ALLOW_THREADS
+    if (handle == NULL) return PyErr_Format(PyExc_OSError, "can't trace process %d", pid);
+    DebuggerObject *self = (DebuggerObject *)type->tp_alloc(type, 0);
+    if (self == NULL) {
+        TinyDbg_free(handle);
+        return NULL;
+    }
+    self->handle = handle;
+    return (PyObject *)self;
+}
+
+static void debugger_close(DebuggerObject *self) {
+    if (self->handle == NULL) return;
+    TinyDbg *handle = self->handle;
+    while (self->consumers != NULL) consumer_close(self->consumers);
+    if (self->batch != NULL) {
+        // it's never sent
+        release_batched(self->batched);
+        Py_CLEAR(self->batch);
+        self->batched = NULL;
+    }
+    self->handle = NULL;
+    // a followed child is gone already once the first debugger is closed
+    for (DebuggerObject *parent = self->parent; parent != NULL; parent = parent->parent) {
+        if (parent->handle == NULL) return;
+    }
+    Py_BEGIN_ALLOW_THREADS
+    TinyDbg_free(handle);
+    Py_END_ALLOW_THREADS
+}
+
+static void Debugger_dealloc(DebuggerObject *self) {
+    // a followed child is freed with the first debugger unless it's closed
+    if (self->parent == NULL) debugger_close(self);
+    Py_XDECREF(self->parent);
+    Py_TYPE(self)->tp_free((PyObject *)self);
+}
+
+static PyObject *Debugger_close(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    debugger_close(self);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Debugger_enter(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    Py_INCREF(self);
+    return (PyObject *)self;
+}
+
+static PyObject *Debugger_exit(DebuggerObject *self, PyObject *args) {
+    (void)args;
+    debugger_close(self);
+    Py_RETURN_FALSE;
+}
+
+static PyObject *Debugger_get_pid(DebuggerObject *self, void *closure) {
+    (void)closure;
+    TinyDbg *handle = get_handle(self);
+    if (handle == NULL) return NULL;
+    return PyLong_FromLong(handle->pid);  // a restored checkpoint changes it
+}
+
+static PyObject *Debugger_get_flags(DebuggerObject *self, void *closure) {
+    (void)closure;
+    TinyDbg *handle = get_handle(self);
+    if (handle == NULL) return NULL;
+    return PyLong_FromUnsignedLong(handle->flags);
+}
+
+// The requests that give only a handle to join
+
+#define HANDLE_OR_RETURN(self) \
+    TinyDbg *handle = get_handle(self); \
+    if (handle == NULL) return NULL;
+
+static PyObject *Debugger_stop(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_stop(handle), NULL, NULL);
+}
+
+static PyObject *Debugger_cont(DebuggerObject *self, PyObject *args) {
+    int tid = 0;
+    if (!PyArg_ParseTuple(args, "|i", &tid)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(tid == 0 ? TinyDbg_continue(handle) : TinyDbg_thread_continue(handle, tid), NULL, NULL);
+}
+
+static PyObject *Debugger_singlestep(DebuggerObject *self, PyObject *args) {
+    int tid = 0;
+    if (!PyArg_ParseTuple(args, "|i", &tid)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(tid == 0 ? TinyDbg_singlestep(handle) : TinyDbg_thread_singlestep(handle, tid), NULL, NULL);
+}
+
+static PyObject *Debugger_get_regs(DebuggerObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"tid", "regs", NULL};
+    int tid = 0;
+    PyObject *regs = NULL;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "|iO!", keywords, &tid, &RegsType, &regs)) return NULL;
+    HANDLE_OR_RETURN(self);
+    if (regs == NULL) regs = Regs_new(&RegsType, NULL, NULL);
+    else Py_INCREF(regs);
+    if (regs == NULL) return NULL;
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, regs, regs);
+    Py_DECREF(regs);
+    if (result == NULL) return NULL;
+    struct user_regs_struct *save_to = &((RegsObject *)regs)->regs;
+    return request_sent(self, result, tid == 0 ? TinyDbg_get_registers(handle, save_to)
+                                               : TinyDbg_thread_get_registers(handle, tid, save_to));
+}
+
+static PyObject *Debugger_set_regs(DebuggerObject *self, PyObject *args) {
+    PyObject *regs;
+    int tid = 0;
+    if (!PyArg_ParseTuple(args, "O!|i", &RegsType, &regs, &tid)) return NULL;
+    HANDLE_OR_RETURN(self);
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, NULL, regs);
+    if (result == NULL) return NULL;
+    struct user_regs_struct *take_from = &((RegsObject *)regs)->regs;
+    return request_sent(self, result, tid == 0 ? TinyDbg_set_registers(handle, take_from)
+                                               : TinyDbg_thread_set_registers(handle, tid, take_from));
+}
+
+static PyObject *Debugger_list_threads(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    TinyDbg_Thread *threads = TinyDbg_list_threads(handle, &len);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        TinyDbg_Thread *thread = &threads[i];
+        PyObject *item = struct_sequence(ThreadType, "(iNNNN)", (int)thread->tid, PyBool_FromLong(thread->is_stopped),
+                                         PyBool_FromLong(thread->resumed), PyBool_FromLong(thread->in_syscall),
+                                         PyBool_FromLong(thread->group_stopped));
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(threads);
+    return list;
+}
+
+// Memory - through the process manager, or right away with process_vm_readv/writev
+
+// out is a size, then the bytes are read into a new bytes object, or a writable buffer they're read into
+static bool memory_destination(PyObject *out, Py_buffer *buffer, PyObject **bytes) {
+    *bytes = NULL;
+    if (PyLong_Check(out)) {
+        Py_ssize_t size = PyLong_AsSsize_t(out);
+        if (size < 0) {
+            if (!PyErr_Occurred()) PyErr_SetString(PyExc_ValueError, "negative size");
+            return false;
+        }
+        *bytes = PyBytes_FromStringAndSize(NULL, size);
+        if (*bytes == NULL) return false;
+        buffer->buf = PyBytes_AS_STRING(*bytes);
+        buffer->len = size;
+        buffer->obj = NULL;
+        return true;
+    }
+    return PyObject_GetBuffer(out, buffer, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) == 0;
+}
+
+static PyObject *Debugger_get_mem(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    PyObject *out;
+    if (!PyArg_ParseTuple(args, "kO", &address, &out)) return NULL;
+    HANDLE_OR_RETURN(self);
+    Py_buffer buffer;
+    PyObject *bytes;
+    if (!memory_destination(out, &buffer, &bytes)) return NULL;
+
+    struct iovec local = { buffer.buf, buffer.len };
+    struct iovec remote = { (void *)address, buffer.len };
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, bytes != NULL ? bytes : out, bytes);
+    if (result == NULL) {
+        if (bytes != NULL) Py_DECREF(bytes);
+        else PyBuffer_Release(&buffer);
+        return NULL;
+    }
+    if (bytes == NULL) {
+        result->buffer = buffer;
+        result->has_buffer = true;
+    }
+    Py_XDECREF(bytes);
+    return request_sent(self, result, TinyDbg_get_memory(handle, local, remote));
+}
+
+static PyObject *Debugger_set_mem(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    PyObject *data;
+    if (!PyArg_ParseTuple(args, "kO", &address, &data)) return NULL;
+    HANDLE_OR_RETURN(self);
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, NULL, NULL);
+    if (result == NULL) return NULL;
+    if (PyObject_GetBuffer(data, &result->buffer, PyBUF_C_CONTIGUOUS) != 0) {
+        Py_DECREF(result);
+        return NULL;
+    }
+    result->has_buffer = true;
+    struct iovec local = { result->buffer.buf, result->buffer.len };
+    struct iovec remote = { (void *)address, result->buffer.len };
+    return request_sent(self, result, TinyDbg_set_memory(handle, local, remote));
+}
+
+static PyObject *Debugger_read_mem(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    PyObject *out;
+    if (!PyArg_ParseTuple(args, "kO", &address, &out)) return NULL;
+    HANDLE_OR_RETURN(self);
+    Py_buffer buffer;
+    PyObject *bytes;
+    if (!memory_destination(out, &buffer, &bytes)) return NULL;
+
+    struct iovec local = { buffer.buf, buffer.len };
+    struct iovec remote = { (void *)address, buffer.len };
+    size_t transferred = 0;
+    Py_BEGIN_ALLOW_THREADS
+    TinyDbg_get_memory_v(handle, &local, &remote, 1, &transferred);
+    Py_END_ALLOW_THREADS
+    if (bytes == NULL) {
+        PyBuffer_Release(&buffer);
+        return PyLong_FromSize_t(transferred);
+    }
+    if ((Py_ssize_t)transferred != buffer.len && _PyBytes_Resize(&bytes, transferred) != 0) return NULL;
+    return bytes;
+}
+
+static PyObject *Debugger_write_mem(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    Py_buffer buffer;
+    if (!PyArg_ParseTuple(args, "ky*", &address, &buffer)) return NULL;
+    TinyDbg *handle = get_handle(self);
+    if (handle == NULL) {
+        PyBuffer_Release(&buffer);
+        return NULL;
+    }
+    struct iovec local = { buffer.buf, buffer.len };
+    struct iovec remote = { (void *)address, buffer.len };
+    size_t transferred = 0;
+    Py_BEGIN_ALLOW_THREADS
+    TinyDbg_set_memory_v(handle, &local, &remote, 1, &transferred);
+    Py_END_ALLOW_THREADS
+    PyBuffer_Release(&buffer);
+    return PyLong_FromSize_t(transferred);
+}
+
+// Many ranges in as few process_vm_readv calls as there can be. Without a buffer, a list of bytes objects (shorter
+// where a range wasn't all readable). With one, the ranges are read into it one after the other and the list is of
+// how many bytes of each were read.
+static PyObject *Debugger_read_many(DebuggerObject *self, PyObject *args) {
+    PyObject *ranges, *out = Py_None;
+    if (!PyArg_ParseTuple(args, "O|O", &ranges, &out)) return NULL;
+    HANDLE_OR_RETURN(self);
+    PyObject *fast = PySequence_Fast(ranges, "expected a sequence of (address, size)");
+    if (fast == NULL) return NULL;
+    Py_ssize_t len = PySequence_Fast_GET_SIZE(fast);
+
+    Py_buffer buffer;
+    bool has_buffer = out != Py_None;
+    if (has_buffer && PyObject_GetBuffer(out, &buffer, PyBUF_WRITABLE | PyBUF_C_CONTIGUOUS) != 0) {
+        Py_DECREF(fast);
+        return NULL;
+    }
+    struct iovec *local = malloc((len + 1) * sizeof(struct iovec));
+    struct iovec *remote = malloc((len + 1) * sizeof(struct iovec));
+    size_t *transferred = calloc(len + 1, sizeof(size_t));
+    PyObject *result = PyList_New(len);
+    size_t offset = 0;
+    for (Py_ssize_t i = 0; result != NULL && i < len; i++) {
+        unsigned long address;
+        Py_ssize_t size;
+        if (!PyArg_ParseTuple(PySequence_Fast_GET_ITEM(fast, i), "kn", &address, &size)) {
+            Py_CLEAR(result);
+            break;
+        }
+        if (size < 0 || (has_buffer && offset + size > (size_t)buffer.len)) {
+            PyErr_SetString(PyExc_ValueError, size < 0 ? "negative size" : "the ranges don't fit in the buffer");
+            Py_CLEAR(result);
+            break;
+        }
+        remote[i] = (struct iovec){ (void *)address, size };
+        if (has_buffer) {
+            local[i] = (struct iovec){ (char *)buffer.buf + offset, size };
+            offset += size;
+        } else {
+            PyObject *bytes = PyBytes_FromStringAndSize(NULL, size);
+            if (bytes == NULL) {
+                Py_CLEAR(result);
+                break;
+            }
+            PyList_SET_ITEM(result, i, bytes);
+            local[i] = (struct iovec){ PyBytes_AS_STRING(bytes), size };
+        }
+    }
+    Py_DECREF(fast);
+
+    if (result != NULL) {
+        Py_BEGIN_ALLOW_THREADS
+        TinyDbg_get_memory_v(handle, local, remote, len, transferred);
+        Py_END_ALLOW_THREADS
+        for (Py_ssize_t i = 0; i < len; i++) {
+            PyObject *item;
+            if (has_buffer) {
+                item = PyLong_FromSize_t(transferred[i]);
+            } else if (transferred[i] != local[i].iov_len) {
+                // the list can't hold the old one while it's resized, and is left with NULL if that fails
+                item = PyList_GET_ITEM(result, i);
+                PyList_SET_ITEM(result, i, NULL);
+                if (_PyBytes_Resize(&item, transferred[i]) != 0) item = NULL;
+            } else {
+                continue;
+            }
+            if (item == NULL) {
+                Py_CLEAR(result);
+                break;
+            }
+            PyList_SET_ITEM(result, i, item);
+        }
+    }
+    free(local);
+    free(remote);
+    free(transferred);
+    if (has_buffer) PyBuffer_Release(&buffer);
+    return result;
+}
+
+// Breakpoints
+
+static PyObject *Debugger_set_breakpoint(DebuggerObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"position", "once", "condition", "ignore_count", NULL};
+    unsigned long position;
+    int once = 0;
+    const char *source = NULL;
+    unsigned long long ignore_count = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "k|pzK", keywords, &position, &once, &source, &ignore_count)) {
+        return NULL;
+    }
+    HANDLE_OR_RETURN(self);
+    if (source == NULL && ignore_count == 0) return new_join_handle(TinyDbg_set_breakpoint(handle, position, once), NULL, NULL);
+
+    TinyDbg_Condition *condition = NULL;
+    if (source != NULL) {
+        size_t error_at = 0;
+        condition = TinyDbg_Condition_compile(source, &error_at);
+        if (condition == NULL) return PyErr_Format(PyExc_ValueError, "invalid condition at %zu: %s", error_at, source);
+    }
+    return new_join_handle(TinyDbg_set_conditional_breakpoint(handle, position, once, condition, ignore_count), NULL, NULL);
+}
+
+static PyObject *Debugger_unset_breakpoint(DebuggerObject *self, PyObject *args) {
+    unsigned long position;
+    if (!PyArg_ParseTuple(args, "k", &position)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_unset_breakpoint(handle, position), NULL, NULL);
+}
+
+// The bools the process manager wrote into the bytearray it kept, as a list
+static PyObject *finish_set_breakpoints(JoinHandleObject *self) {
+    Py_ssize_t len = PyByteArray_GET_SIZE(self->keep);
+    const bool *set = (const bool *)PyByteArray_AS_STRING(self->keep);
+    PyObject *list = PyList_New(len);
+    for (Py_ssize_t i = 0; list != NULL && i < len; i++) PyList_SET_ITEM(list, i, PyBool_FromLong(set[i]));
+    return list;
+}
+
+static PyObject *Debugger_set_breakpoints(DebuggerObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"positions", "once", NULL};
+    PyObject *sequence;
+    int once = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "O|p", keywords, &sequence, &once)) return NULL;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    uintptr_t *positions = address_array(sequence, &len);
+    if (positions == NULL) return NULL;
+    PyObject *set = PyByteArray_FromStringAndSize(NULL, len);
+    JoinHandleObject *result = set != NULL ? (JoinHandleObject *)new_join_handle(NULL, NULL, set) : NULL;
+    Py_XDECREF(set);
+    if (result == NULL) {
+        free(positions);
+        return NULL;
+    }
+    result->finish = finish_set_breakpoints;
+    // it copies the positions
+    bool *set_at = (bool *)PyByteArray_AS_STRING(set);
+    EventQueue_JoinHandle *join_handle = TinyDbg_set_breakpoints(handle, positions, len, once, set_at);
+    free(positions);
+    return request_sent(self, result, join_handle);
+}
+
+static PyObject *Debugger_unset_breakpoints(DebuggerObject *self, PyObject *args) {
+    PyObject *sequence;
+    if (!PyArg_ParseTuple(args, "O", &sequence)) return NULL;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    uintptr_t *positions = address_array(sequence, &len);
+    if (positions == NULL) return NULL;
+    EventQueue_JoinHandle *join_handle = TinyDbg_unset_breakpoints(handle, positions, len);
+    free(positions);
+    return new_join_handle(join_handle, NULL, NULL);
+}
+
+static PyObject *Debugger_list_breakpoints(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    TinyDbg_Breakpoint *breakpoints = TinyDbg_list_breakpoints(handle, &len);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        PyObject *item = breakpoint_object(&breakpoints[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(breakpoints);
+    return list;
+}
+
+static PyObject *Debugger_set_watchpoint(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    Py_ssize_t len;
+    int kind;
+    if (!PyArg_ParseTuple(args, "kni", &address, &len, &kind)) return NULL;
+    HANDLE_OR_RETURN(self);
+    EventQueue_JoinHandle *join_handle = TinyDbg_set_watchpoint(handle, address, len, kind);
+    if (join_handle == NULL && self->batch == NULL) {
+        PyErr_SetString(PyExc_ValueError, "every debug register is taken, or the length or the alignment can't be watched");
+        return NULL;
+    }
+    return new_join_handle(join_handle, NULL, NULL);
+}
+
+static PyObject *Debugger_unset_watchpoint(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    if (!PyArg_ParseTuple(args, "k", &address)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_unset_watchpoint(handle, address), NULL, NULL);
+}
+
+static PyObject *Debugger_list_watchpoints(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    TinyDbg_Watchpoint *watchpoints = TinyDbg_list_watchpoints(handle, &len);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        PyObject *item = watchpoint_object(&watchpoints[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(watchpoints);
+    return list;
+}
+
+// Tracepoints
+
+static PyObject *finish_flag(JoinHandleObject *self) {
+    return PyBool_FromLong(self->flag);
+}
+
+static PyObject *Debugger_set_tracepoint(DebuggerObject *self, PyObject *args, PyObject *kwargs) {
+    static char *keywords[] = {"position", "record_hits", NULL};
+    unsigned long position;
+    int record_hits = 0;
+    if (!PyArg_ParseTupleAndKeywords(args, kwargs, "k|p", keywords, &position, &record_hits)) return NULL;
+    HANDLE_OR_RETURN(self);
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, NULL, (PyObject *)self);
+    if (result == NULL) return NULL;
+    result->finish = finish_flag;
+    return request_sent(self, result, TinyDbg_set_tracepoint(handle, position, record_hits, &result->flag));
+}
+
+static PyObject *Debugger_unset_tracepoint(DebuggerObject *self, PyObject *args) {
+    unsigned long position;
+    if (!PyArg_ParseTuple(args, "k", &position)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_unset_tracepoint(handle, position), NULL, NULL);
+}
+
+static PyObject *Debugger_list_tracepoints(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    TinyDbg_Tracepoint *tracepoints = TinyDbg_list_tracepoints(handle, &len);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        TinyDbg_Tracepoint *tracepoint = &tracepoints[i];
+        PyObject *item = struct_sequence(TracepointType, "(kknN)", (unsigned long)tracepoint->position,
+                                         (unsigned long)tracepoint->trampoline, (Py_ssize_t)tracepoint->len,
+                                         PyBool_FromLong(tracepoint->record_hits));
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(tracepoints);
+    return list;
+}
+
+static PyObject *Debugger_tracepoint_hit_count(DebuggerObject *self, PyObject *args) {
+    unsigned long position;
+    if (!PyArg_ParseTuple(args, "k", &position)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return PyLong_FromUnsignedLongLong(TinyDbg_tracepoint_hit_count(handle, position));
+}
+
+// Returns (hits, lost) - the hits that weren't read yet up to max, and how many were overwritten before they were read
+static PyObject *Debugger_read_tracepoint_hits(DebuggerObject *self, PyObject *args) {
+    Py_ssize_t max = 4096;
+    if (!PyArg_ParseTuple(args, "|n", &max)) return NULL;
+    HANDLE_OR_RETURN(self);
+    if (max < 0) max = 0;
+    TinyDbg_TracepointHit *hits = malloc((max + 1) * sizeof(TinyDbg_TracepointHit));
+    uint64_t lost = 0;
+    size_t len = TinyDbg_read_tracepoint_hits(handle, hits, max, &lost);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        const uint64_t *a = hits[i].args;
+        PyObject *item = struct_sequence(TracepointHitType, "(k(KKKKKK))", (unsigned long)hits[i].position,
+                                         (unsigned long long)a[0], (unsigned long long)a[1], (unsigned long long)a[2],
+                                         (unsigned long long)a[3], (unsigned long long)a[4], (unsigned long long)a[5]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(hits);
+    if (list == NULL) return NULL;
+    return Py_BuildValue("(NK)", list, (unsigned long long)lost);
+}
+
+// Checkpoints
+
+static PyObject *finish_checkpoint(JoinHandleObject *self) {
+    if (self->checkpoint == NULL) Py_RETURN_NONE;
+    CheckpointObject *checkpoint = PyObject_New(CheckpointObject, &CheckpointType);
+    if (checkpoint == NULL) return NULL;
+    Py_INCREF(self->keep);
+    checkpoint->debugger = (DebuggerObject *)self->keep;
+    checkpoint->checkpoint = self->checkpoint;
+    return (PyObject *)checkpoint;
+}
+
+static PyObject *Debugger_checkpoint(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, NULL, (PyObject *)self);
+    if (result == NULL) return NULL;
+    result->finish = finish_checkpoint;
+    return request_sent(self, result, TinyDbg_checkpoint(handle, &result->checkpoint));
+}
+
+static TinyDbg_Checkpoint *checkpoint_of(DebuggerObject *self, PyObject *object) {
+    CheckpointObject *checkpoint = (CheckpointObject *)object;
+    if (checkpoint->debugger != self || checkpoint->checkpoint == NULL) {
+        PyErr_SetString(PyExc_ValueError, "the checkpoint was freed, or it's of another debugger");
+        return NULL;
+    }
+    return checkpoint->checkpoint;
+}
+
+static PyObject *Debugger_restore(DebuggerObject *self, PyObject *args) {
+    PyObject *object;
+    if (!PyArg_ParseTuple(args, "O!", &CheckpointType, &object)) return NULL;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_Checkpoint *checkpoint = checkpoint_of(self, object);
+    if (checkpoint == NULL) return NULL;
+    JoinHandleObject *result = (JoinHandleObject *)new_join_handle(NULL, NULL, object);
+    if (result == NULL) return NULL;
+    result->finish = finish_flag;
+    return request_sent(self, result, TinyDbg_restore(handle, checkpoint, &result->flag));
+}
+
+static PyObject *Debugger_free_checkpoint(DebuggerObject *self, PyObject *args) {
+    PyObject *object;
+    if (!PyArg_ParseTuple(args, "O!", &CheckpointType, &object)) return NULL;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_Checkpoint *checkpoint = checkpoint_of(self, object);
+    if (checkpoint == NULL) return NULL;
+    ((CheckpointObject *)object)->checkpoint = NULL;  // the request owns it now
+    return new_join_handle(TinyDbg_free_checkpoint(handle, checkpoint), NULL, NULL);
+}
+
+// Symbols and mappings
+
+static PyObject *Debugger_symbolize(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    if (!PyArg_ParseTuple(args, "k", &address)) return NULL;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_Symbol symbol;
+    if (!TinyDbg_symbolize(handle, address, &symbol)) Py_RETURN_NONE;
+    return struct_sequence(SymbolType, "(sknk)", symbol.name, (unsigned long)symbol.address, (Py_ssize_t)symbol.size,
+                           (unsigned long)symbol.bias);
+}
+
+static PyObject *Debugger_lookup_symbol(DebuggerObject *self, PyObject *args) {
+    const char *name;
+    if (!PyArg_ParseTuple(args, "s", &name)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return PyLong_FromUnsignedLong(TinyDbg_lookup_symbol(handle, name));
+}
+
+static PyObject *memory_map_object(const TinyDbg_memory_map *map) {
+    return struct_sequence(MemoryMapType, "(kkkNNNNO&)", map->begin, map->end, map->page_offset,
+                           PyBool_FromLong(map->perm_read), PyBool_FromLong(map->perm_write),
+                           PyBool_FromLong(map->perm_execute), PyBool_FromLong(map->perm_mayshare),
+                           PyUnicode_DecodeFSDefault, map->pathname);
+}
+
+static PyObject *Debugger_get_memory_maps(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    TinyDbg_memory_map *maps = TinyDbg_get_memory_maps(handle, &len);
+    PyObject *list = PyList_New(maps != NULL ? len : 0);
+    for (size_t i = 0; list != NULL && maps != NULL && i < len; i++) {
+        PyObject *item = memory_map_object(&maps[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(maps);
+    return list;
+}
+
+static PyObject *Debugger_find_map(DebuggerObject *self, PyObject *args) {
+    unsigned long address;
+    if (!PyArg_ParseTuple(args, "k", &address)) return NULL;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_memory_map map;
+    if (!TinyDbg_find_map(handle, address, &map)) Py_RETURN_NONE;
+    return memory_map_object(&map);
+}
+
+// Profiling and stats
+
+static PyObject *Debugger_profile_start(DebuggerObject *self, PyObject *args) {
+    unsigned int hz;
+    if (!PyArg_ParseTuple(args, "I", &hz)) return NULL;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_profile_start(handle, hz);
+    Py_RETURN_NONE;
+}
+
+static PyObject *Debugger_profile_stop(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    Py_BEGIN_ALLOW_THREADS
+    TinyDbg_profile_stop(handle);
+    Py_END_ALLOW_THREADS
+    Py_RETURN_NONE;
+}
+
+static PyObject *Debugger_profile_folded(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    char *folded = TinyDbg_profile_folded(handle);
+    PyObject *result = PyUnicode_DecodeUTF8(folded, strlen(folded), "replace");
+    free(folded);
+    return result;
+}
+
+static PyObject *Debugger_profile_stats(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_ProfileStats stats;
+    TinyDbg_profile_stats(handle, &stats);
+    return struct_sequence(ProfileStatsType, "(KKKKKK)", (unsigned long long)stats.samples,
+                           (unsigned long long)stats.stacks, (unsigned long long)stats.missed,
+                           (unsigned long long)stats.pause_total_ns, (unsigned long long)stats.pause_max_ns,
+                           (unsigned long long)stats.elapsed_ns);
+}
+
+static PyObject *histogram_object(const TinyDbg_Histogram *histogram) {
+    return Py_BuildValue("{sKsKsKsKsKsKsK}", "count", (unsigned long long)histogram->count,
+                         "sum", (unsigned long long)histogram->sum, "max", (unsigned long long)histogram->max,
+                         "p50", (unsigned long long)TinyDbg_Histogram_percentile(histogram, 50),
+                         "p90", (unsigned long long)TinyDbg_Histogram_percentile(histogram, 90),
+                         "p99", (unsigned long long)TinyDbg_Histogram_percentile(histogram, 99),
+                         "p999", (unsigned long long)TinyDbg_Histogram_percentile(histogram, 99.9));
+}
+
+static PyObject *counts_object(const uint64_t *counts, size_t len) {
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        PyObject *item = PyLong_FromUnsignedLongLong(counts[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+// The histograms as dicts of their count, sum, max and percentiles in ns, and the counts as lists by request type
+static PyObject *Debugger_get_stats(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_Stats *stats = malloc(sizeof(TinyDbg_Stats));
+    TinyDbg_get_stats(handle, stats);
+    PyObject *result = Py_BuildValue("{sNsNsNsNsNsNsN}", "queue_wait", histogram_object(&stats->queue_wait),
+                                     "stop", histogram_object(&stats->stop),
+                                     "ptrace_call", histogram_object(&stats->ptrace_call),
+                                     "hit_to_event", histogram_object(&stats->hit_to_event),
+                                     "event_to_continue", histogram_object(&stats->event_to_continue),
+                                     "requests", counts_object(stats->requests, TINYDBG_REQUEST_TYPES),
+                                     "ptrace_calls", counts_object(stats->ptrace_calls, TINYDBG_REQUEST_TYPES + 1));
+    free(stats);
+    return result;
+}
+
+static PyObject *Debugger_reset_stats(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_reset_stats(handle), NULL, NULL);
+}
+
+// Batches, syscalls and coverage
+
+static PyObject *Debugger_batch_begin(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    if (self->batch != NULL) {
+        PyErr_SetString(PyExc_ValueError, "a batch was begun already");
+        return NULL;
+    }
+    JoinHandleObject *batch = (JoinHandleObject *)new_join_handle(NULL, NULL, NULL);
+    PyObject *batched = PyList_New(0);
+    if (batch == NULL || batched == NULL) {
+        Py_XDECREF(batch);
+        Py_XDECREF(batched);
+        return NULL;
+    }
+    TinyDbg_batch_begin(handle);
+    self->batch = batch;
+    self->batched = batched;
+    Py_RETURN_NONE;
+}
+
+// The requests in the batch that give a result are done once it's joined, joining them joins it
+static PyObject *Debugger_batch_submit(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    if (self->batch == NULL) return new_join_handle(TinyDbg_batch_submit(handle), NULL, NULL);
+    EventQueue_JoinHandle *join_handle = TinyDbg_batch_submit(handle);
+    if (join_handle == NULL) {
+        PyErr_SetString(PyExc_ValueError, "the batch was begun by another thread");
+        return NULL;
+    }
+    JoinHandleObject *batch = self->batch;
+    batch->join_handle = join_handle;
+    batch->batched = self->batched;
+    self->batch = NULL;
+    self->batched = NULL;
+    return (PyObject *)batch;
+}
+
+static PyObject *Debugger_stop_on_syscall(DebuggerObject *self, PyObject *args) {
+    PyObject *syscalls_object = Py_None;
+    if (!PyArg_ParseTuple(args, "|O", &syscalls_object)) return NULL;
+    HANDLE_OR_RETURN(self);
+    if (syscalls_object == Py_None) return new_join_handle(TinyDbg_stop_on_syscall(handle), NULL, NULL);
+    size_t len;
+    int *syscalls = int_array(syscalls_object, &len);
+    if (syscalls == NULL) return NULL;
+    EventQueue_JoinHandle *join_handle = TinyDbg_stop_on_syscalls(handle, syscalls, len);
+    free(syscalls);
+    return new_join_handle(join_handle, NULL, NULL);
+}
+
+static PyObject *Debugger_no_stop_on_syscall(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_no_stop_on_syscall(handle), NULL, NULL);
+}
+
+static PyObject *Debugger_coverage_mode(DebuggerObject *self, PyObject *args) {
+    int enabled;
+    if (!PyArg_ParseTuple(args, "p", &enabled)) return NULL;
+    HANDLE_OR_RETURN(self);
+    return new_join_handle(TinyDbg_coverage_mode(handle, enabled), NULL, NULL);
+}
+
+static PyObject *Debugger_get_coverage(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    size_t len;
+    uintptr_t *coverage = TinyDbg_get_coverage(handle, &len);
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        PyObject *item = PyLong_FromUnsignedLong(coverage[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    free(coverage);
+    return list;
+}
+
+static PyObject *Debugger_clear_coverage(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    TinyDbg_clear_coverage(handle);
+    Py_RETURN_NONE;
+}
+
+// Events
+
+// Children send their events to the queue of the first debugger, so their consumers are of it
+static PyObject *Debugger_consumer(DebuggerObject *self, PyObject *unused) {
+    (void)unused;
+    HANDLE_OR_RETURN(self);
+    DebuggerObject *root = root_debugger(self);
+    ConsumerObject *consumer = PyObject_New(ConsumerObject, &ConsumerType);
+    if (consumer == NULL) return NULL;
+    Py_INCREF(root);
+    consumer->debugger = root;
+    consumer->consumer = EventQueue_new_consumer(handle->eq_debugger_events);
+    consumer->next = root->consumers;
+    root->consumers = consumer;
+    return (PyObject *)consumer;
+}
+
+static PyObject *events_object(DebuggerObject *self, const TinyDbg_Event *events, size_t len) {
+    PyObject *list = PyList_New(len);
+    for (size_t i = 0; list != NULL && i < len; i++) {
+        PyObject *item = event_object(self, &events[i]);
+        if (item == NULL) Py_CLEAR(list);
+        else PyList_SET_ITEM(list, i, item);
+    }
+    return list;
+}
+
+static PyObject *Debugger_poll_events(DebuggerObject *self, PyObject *args) {
+    Py_ssize_t max = 64;
+    if (!PyArg_ParseTuple(args, "|n", &max)) return NULL;
+    HANDLE_OR_RETURN(self);
+    if (max < 0) max = 0;
+    TinyDbg_Event *events = malloc((max + 1) * sizeof(TinyDbg_Event));
+    size_t len = TinyDbg_poll_events(handle, events, max);
+    PyObject *list = events_object(self, events, len);
+    free(events);
+    return list;
+}
+
+static PyObject *Debugger_wait_events(DebuggerObject *self, PyObject *args) {
+    Py_ssize_t max = 64;
+    int timeout_ms = -1;
+    if (!PyArg_ParseTuple(args, "|ni", &max, &timeout_ms)) return NULL;
+    HANDLE_OR_RETURN(self);
+    if (max < 0) max = 0;
+    TinyDbg_Event *events = malloc((max + 1) * sizeof(TinyDbg_Event));
+    size_t len;
+    Py_BEGIN_ALLOW_THREADS
+    len = TinyDbg_wait_events(handle, events, max, timeout_ms);
+    Py_END_ALLOW_THREADS
+    PyObject *list = events_object(self, events, len);
+    free(events);
+    return list;
+}
+
+#undef HANDLE_OR_RETURN
+
+static PyMethodDef Debugger_methods[] = {
+    {"attach", (PyCFunction)Debugger_attach, METH_VARARGS | METH_CLASS, "attach(pid, flags=0) - debug a running process"},
+    {"close", (PyCFunction)Debugger_close, METH_NOARGS, "Free the debugger, which kills the process or detaches from it"},
+    {"__enter__", (PyCFunction)Debugger_enter, METH_NOARGS, NULL},
+    {"__exit__", (PyCFunction)Debugger_exit, METH_VARARGS, NULL},
+    {"stop", (PyCFunction)Debugger_stop, METH_NOARGS, NULL},
+    {"cont", (PyCFunction)Debugger_cont, METH_VARARGS, "cont(tid=0) - every thread, or only this one"},
+    {"singlestep", (PyCFunction)Debugger_singlestep, METH_VARARGS, "singlestep(tid=0)"},
+    {"get_regs", (PyCFunction)Debugger_get_regs, METH_VARARGS | METH_KEYWORDS,
+     "get_regs(tid=0, regs=None) - joins to the Regs, which are filled in place if they're given"},
+    {"set_regs", (PyCFunction)Debugger_set_regs, METH_VARARGS, "set_regs(regs, tid=0)"},
+    {"list_threads", (PyCFunction)Debugger_list_threads, METH_NOARGS, NULL},
+    {"get_mem", (PyCFunction)Debugger_get_mem, METH_VARARGS,
+     "get_mem(address, size_or_buffer) - through the process manager, without breakpoints. Joins to bytes, or the buffer."},
+    {"set_mem", (PyCFunction)Debugger_set_mem, METH_VARARGS, "set_mem(address, data)"},
+    {"read_mem", (PyCFunction)Debugger_read_mem, METH_VARARGS,
+     "read_mem(address, size_or_buffer) - right away with process_vm_readv, without breakpoints. Returns bytes, or how much went "
+     "into the buffer."},
+    {"write_mem", (PyCFunction)Debugger_write_mem, METH_VARARGS,
+     "write_mem(address, data) - right away, the breakpoints stay. Returns how much was written."},
+    {"read_many", (PyCFunction)Debugger_read_many, METH_VARARGS,
+     "read_many(ranges, buffer=None) - reads every (address, size) like read_mem, in as few syscalls as it can"},
+    {"set_breakpoint", (PyCFunction)Debugger_set_breakpoint, METH_VARARGS | METH_KEYWORDS,
+     "set_breakpoint(position, once=False, condition=None, ignore_count=0)"},
+    {"unset_breakpoint", (PyCFunction)Debugger_unset_breakpoint, METH_VARARGS, NULL},
+    {"set_breakpoints", (PyCFunction)Debugger_set_breakpoints, METH_VARARGS | METH_KEYWORDS,
+     "set_breakpoints(positions, once=False) - joins to whether each position has a breakpoint"},
+    {"unset_breakpoints", (PyCFunction)Debugger_unset_breakpoints, METH_VARARGS, NULL},
+    {"list_breakpoints", (PyCFunction)Debugger_list_breakpoints, METH_NOARGS, NULL},
+    {"set_watchpoint", (PyCFunction)Debugger_set_watchpoint, METH_VARARGS, "set_watchpoint(address, len, kind)"},
+    {"unset_watchpoint", (PyCFunction)Debugger_unset_watchpoint, METH_VARARGS, NULL},
+    {"list_watchpoints", (PyCFunction)Debugger_list_watchpoints, METH_NOARGS, NULL},
+    {"set_tracepoint", (PyCFunction)Debugger_set_tracepoint, METH_VARARGS | METH_KEYWORDS,
+     "set_tracepoint(position, record_hits=False) - joins to whether it was placed"},
+    {"unset_tracepoint", (PyCFunction)Debugger_unset_tracepoint, METH_VARARGS, NULL},
+    {"list_tracepoints", (PyCFunction)Debugger_list_tracepoints, METH_NOARGS, NULL},
+    {"tracepoint_hit_count", (PyCFunction)Debugger_tracepoint_hit_count, METH_VARARGS, NULL},
+    {"read_tracepoint_hits", (PyCFunction)Debugger_read_tracepoint_hits, METH_VARARGS,
+     "read_tracepoint_hits(max=4096) - returns (hits, lost)"},
+    {"checkpoint", (PyCFunction)Debugger_checkpoint, METH_NOARGS, "Joins to a Checkpoint, or None if it couldn't be made"},
+    {"restore", (PyCFunction)Debugger_restore, METH_VARARGS, "restore(checkpoint) - joins to whether it was restored"},
+    {"free_checkpoint", (PyCFunction)Debugger_free_checkpoint, METH_VARARGS, NULL},
+    {"symbolize", (PyCFunction)Debugger_symbolize, METH_VARARGS, "symbolize(address) - a Symbol, or None"},
+    {"lookup_symbol", (PyCFunction)Debugger_lookup_symbol, METH_VARARGS, "lookup_symbol(name) - its address, or 0"},
+    {"get_memory_maps", (PyCFunction)Debugger_get_memory_maps, METH_NOARGS, NULL},
+    {"find_map", (PyCFunction)Debugger_find_map, METH_VARARGS, "find_map(address) - a MemoryMap, or None"},
+    {"profile_start", (PyCFunction)Debugger_profile_start, METH_VARARGS, "profile_start(hz)"},
+    {"profile_stop", (PyCFunction)Debugger_profile_stop, METH_NOARGS, NULL},
+    {"profile_folded", (PyCFunction)Debugger_profile_folded, METH_NOARGS, NULL},
+    {"profile_stats", (PyCFunction)Debugger_profile_stats, METH_NOARGS, NULL},
+    {"get_stats", (PyCFunction)Debugger_get_stats, METH_NOARGS, NULL},
+    {"reset_stats", (PyCFunction)Debugger_reset_stats, METH_NOARGS, NULL},
+    {"batch_begin", (PyCFunction)Debugger_batch_begin, METH_NOARGS, NULL},
+    {"batch_submit", (PyCFunction)Debugger_batch_submit, METH_NOARGS, NULL},
+    {"stop_on_syscall", (PyCFunction)Debugger_stop_on_syscall, METH_VARARGS, "stop_on_syscall(syscalls=None) - every one, or only these"},
+    {"no_stop_on_syscall", (PyCFunction)Debugger_no_stop_on_syscall, METH_NOARGS, NULL},
+    {"coverage_mode", (PyCFunction)Debugger_coverage_mode, METH_VARARGS, "coverage_mode(enabled)"},
+    {"get_coverage", (PyCFunction)Debugger_get_coverage, METH_NOARGS, NULL},
+    {"clear_coverage", (PyCFunction)Debugger_clear_coverage, METH_NOARGS, NULL},
+    {"consumer", (PyCFunction)Debugger_consumer, METH_NOARGS, "A Consumer of eq_debugger_events"},
+    {"poll_events", (PyCFunction)Debugger_poll_events, METH_VARARGS, "poll_events(max=64) - with TINYDBG_FLAG_EVENT_RING"},
+    {"wait_events", (PyCFunction)Debugger_wait_events, METH_VARARGS,
+     "wait_events(max=64, timeout_ms=-1) - with TINYDBG_FLAG_EVENT_RING"},
+    {NULL}
+};
+
+static PyGetSetDef Debugger_getset[] = {
+    {"pid", (getter)Debugger_get_pid, NULL, "The debugged process", NULL},
+    {"flags", (getter)Debugger_get_flags, NULL, NULL, NULL},
+    {NULL}
+};
+
+static PyTypeObject DebuggerType = {
+    PyVarObject_HEAD_INIT(NULL, 0)
+    .tp_name = "tinydbg_py.TinyDbg",
+    .tp_basicsize = sizeof(DebuggerObject),
+    .tp_dealloc = (destructor)Debugger_dealloc,
+    .tp_flags = Py_TPFLAGS_DEFAULT | Py_TPFLAGS_BASETYPE,
+    .tp_doc = "TinyDbg(filename, argv, envp=None, flags=0, syscalls=None) - start a process under the debugger, with "
+              "TinyDbg_start_syscall_filtered if syscalls is given",
+    .tp_methods = Debugger_methods,
+    .tp_getset = Debugger_getset,
+    .tp_init = (initproc)Debugger_init,
+    .tp_new = PyType_GenericNew,
+};
+
+/* the module */
+
+static struct PyModuleDef tinydbg_module = {
+    PyModuleDef_HEAD_INIT,
+    .m_name = "tinydbg_py._tinydbg",
+    .m_doc = "Native bindings for TinyDbg",
+    .m_size = -1,
+};
+
+static PyTypeObject *new_struct_sequence(PyObject *module, PyStructSequence_Desc *desc) {
+    PyTypeObject *type = PyStructSequence_NewType(desc);
+    if (type == NULL) return NULL;
+    const char *name = strrchr(desc->name, '.') + 1;
+    if (PyModule_AddObject(module, name, (PyObject *)type) != 0) {
+        Py_DECREF(type);
+        return NULL;
+    }
+    Py_INCREF(type);  // the module's reference, we keep ours
+    return type;
+}
+
+PyMODINIT_FUNC PyInit__tinydbg(void) {
+    PyObject *module = PyModule_Create(&tinydbg_module);
+    if (module == NULL) return NULL;
+
+    PyTypeObject *types[] = { &DebuggerType, &ConsumerType, &JoinHandleType, &RegsType, &CheckpointType };
+    for (size_t i = 0; i < sizeof(types) / sizeof(types[0]); i++) {
+        if (PyType_Ready(types[i]) != 0) goto error;
+        Py_INCREF(types[i]);
+        if (PyModule_AddObject(module, strrchr(types[i]->tp_name, '.') + 1, (PyObject *)types[i]) != 0) {
+            Py_DECREF(types[i]);
+            goto error;
+        }
+    }
+    if ((ThreadType = new_struct_sequence(module, &Thread_desc)) == NULL
+            || (BreakpointType = new_struct_sequence(module, &Breakpoint_desc)) == NULL
+            || (WatchpointType = new_struct_sequence(module, &Watchpoint_desc)) == NULL
+            || (TracepointType = new_struct_sequence(module, &Tracepoint_desc)) == NULL
+            || (TracepointHitType = new_struct_sequence(module, &TracepointHit_desc)) == NULL
+            || (MemoryMapType = new_struct_sequence(module, &MemoryMap_desc)) == NULL
+            || (SymbolType = new_struct_sequence(module, &Symbol_desc)) == NULL
+            || (ProfileStatsType = new_struct_sequence(module, &ProfileStats_desc)) == NULL
+            || (EventType = new_struct_sequence(module, &Event_desc)) == NULL) {
+        goto error;
+    }
+
+    // the names are the ones in debugger.h
+#define CONSTANT(name) if (PyModule_AddIntConstant(module, #name, name) != 0) goto error;
+    CONSTANT(TINYDBG_FLAG_NO_ASLR);
+    CONSTANT(TINYDBG_FLAG_MEMORY_CACHE);
+    CONSTANT(TINYDBG_FLAG_NON_STOP);
+    CONSTANT(TINYDBG_FLAG_SEIZE);
+    CONSTANT(TINYDBG_FLAG_EVENT_RING);
+    CONSTANT(TINYDBG_FLAG_FOLLOW_FORK);
+    CONSTANT(TINYDBG_SYSCALLS_MAX);
+    CONSTANT(TINYDBG_WATCHPOINTS_MAX);
+    CONSTANT(TinyDbg_event_type_exit);
+    CONSTANT(TinyDbg_event_type_stop);
+    CONSTANT(TinyDbg_event_type_syscall);
+    CONSTANT(TinyDbg_event_type_breakpoint);
+    CONSTANT(TinyDbg_event_type_watchpoint);
+    CONSTANT(TinyDbg_event_type_fork);
+    CONSTANT(TinyDbg_event_type_exec);
+    CONSTANT(TinyDbg_watchpoint_kind_execute);
+    CONSTANT(TinyDbg_watchpoint_kind_write);
+    CONSTANT(TinyDbg_watchpoint_kind_read_write);
+    // indexes of the counts in get_stats
+    CONSTANT(TinyDbg_procman_request_type_stop);
+    CONSTANT(TinyDbg_procman_request_type_continue);
+    CONSTANT(TinyDbg_procman_request_type_singlestep);
+    CONSTANT(TinyDbg_procman_request_type_get_regs);
+    CONSTANT(TinyDbg_procman_request_type_set_regs);
+    CONSTANT(TinyDbg_procman_request_type_get_mem);
+    CONSTANT(TinyDbg_procman_request_type_set_mem);
+    CONSTANT(TinyDbg_procman_request_type_set_breakp);
+    CONSTANT(TinyDbg_procman_request_type_unset_breakp);
+    CONSTANT(TinyDbg_procman_request_type_set_breakps);
+    CONSTANT(TinyDbg_procman_request_type_unset_breakps);
+    CONSTANT(TinyDbg_procman_request_type_stop_on_syscall);
+    CONSTANT(TinyDbg_procman_request_type_no_stop_on_syscall);
+    CONSTANT(TinyDbg_procman_request_type_coverage_mode);
+    CONSTANT(TinyDbg_procman_request_type_set_watchp);
+    CONSTANT(TinyDbg_procman_request_type_unset_watchp);
+    CONSTANT(TinyDbg_procman_request_type_set_tracep);
+    CONSTANT(TinyDbg_procman_request_type_unset_tracep);
+    CONSTANT(TinyDbg_procman_request_type_batch);
+    CONSTANT(TinyDbg_procman_request_type_checkpoint);
+    CONSTANT(TinyDbg_procman_request_type_restore);
+    CONSTANT(TinyDbg_procman_request_type_free_checkpoint);
+    CONSTANT(TinyDbg_procman_request_type_reset_stats);
+    CONSTANT(TINYDBG_REQUEST_TYPES);
+#undef CONSTANT
+    return module;
+
+error:
+    Py_DECREF(module);
+    return NULL;
+}
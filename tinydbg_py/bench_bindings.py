@@ -0,0 +1,86 @@
+# The native module against the ctypes bindings, on a stopped /bin/sleep: pytest bench_bindings.py -s
+# The ctypes bindings need the tinydbg_lib from make (or TINYDBG_LIB). Each run is in a process of its own, since both
+# libraries would start their own waiter thread for waitpid(-1) in the same process.
+import json, os, subprocess, sys, time
+import pytest
+
+LIB = os.environ.get("TINYDBG_LIB", os.path.join(os.path.dirname(os.path.abspath(__file__)), "..", "tinydbg_lib"))
+ITERATIONS = 20000
+READ_SIZE = 4096
+RANGES = 64
+
+
+def timed(f, iterations=ITERATIONS):
+    f()
+    start = time.perf_counter_ns()
+    for _ in range(iterations):
+        f()
+    return (time.perf_counter_ns() - start) / iterations
+
+
+def run_native():
+    import tinydbg_py
+    with tinydbg_py.TinyDbg("/bin/sleep", ["/bin/sleep", "60"]) as d:
+        regs = d.get_regs().join()
+        buffer = bytearray(READ_SIZE)
+        ranges = [(regs.rsp + i * 8, 8) for i in range(RANGES)]
+        return {
+            "get_regs": timed(lambda: d.get_regs().join()),
+            "get_regs_in_place": timed(lambda: d.get_regs(regs=regs).join()),
+            "read": timed(lambda: d.read_mem(regs.rsp, READ_SIZE)),
+            "read_into": timed(lambda: d.read_mem(regs.rsp, buffer)),
+            "read_ranges": timed(lambda: d.read_many(ranges), ITERATIONS // 10),
+        }
+
+
+def run_ctypes():
+    os.environ["TINYDBG_LIB"] = LIB
+    from tinydbg_py import ctypes_api
+    d = ctypes_api.TinyDbg("/bin/sleep", ["/bin/sleep", "60"], os.environ)
+    regs = d.get_regs().join()
+    ranges = [(regs.rsp + i * 8, 8) for i in range(RANGES)]
+    result = {
+        "get_regs": timed(lambda: d.get_regs().join()),
+        "read": timed(lambda: d.get_mem(regs.rsp, READ_SIZE)),
+        "read_ranges": timed(lambda: [d.get_mem(address, size) for address, size in ranges], ITERATIONS // 10),
+    }
+    del d
+    return result
+
+
+def run(path):
+    process = subprocess.run([sys.executable, os.path.abspath(__file__), path], capture_output=True, text=True,
+                             timeout=300, env=dict(os.environ, PYTHONPATH=os.path.dirname(os.path.abspath(__file__))))
+    assert process.returncode == 0, process.stderr
+    return json.loads(process.stdout.splitlines()[-1])
+
+
+@pytest.fixture(scope="module")
+def results():
+    if not os.path.exists(LIB):
+        pytest.skip(f"no {LIB} for the ctypes bindings, build it with make tinydbg_lib")
+    native, ctypes = run("native"), run("ctypes")
+    print()
+    for name in native:
+        compared = f"  ctypes {ctypes[name]:10.0f} ns  x{ctypes[name] / native[name]:.2f}" if name in ctypes else ""
+        print(f"{name:20} native {native[name]:10.0f} ns{compared}")
+    return native, ctypes
+
+
+def test_get_regs(results):
+    native, ctypes = results
+    assert native["get_regs"] < ctypes["get_regs"]
+
+
+def test_read(results):
+    native, ctypes = results
+    assert native["read_into"] < ctypes["read"]
+
+
+def test_read_ranges(results):
+    native, ctypes = results
+    assert native["read_ranges"] < ctypes["read_ranges"]
+
+
+if __name__ == "__main__":
+    print(json.dumps(run_native() if sys.argv[1] == "native" else run_ctypes()))
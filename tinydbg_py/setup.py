@@ -1,4 +1,7 @@
-from setuptools import setup
+from setuptools import setup, Extension
+
+sources = ["breakpoint_index", "condition", "debugger", "memory", "page_cache", "tracepoint", "event_ring", "symbols",
+           "maps", "profile", "stats"]
 
 setup(name="tinydbg_py",
       version='0.1',
@@ -7,4 +10,9 @@ setup(name="tinydbg_py",
       author_email="misha@farberbrodsky.com",
       license="MIT",
       packages=["tinydbg_py"],
+      ext_modules=[Extension("tinydbg_py._tinydbg",
+                             sources=["_tinydbg.c"] + [f"../src/{x}.c" for x in sources] + ["../event_queue_c/event_queue.c"],
+                             libraries=["lzma"],
+                             extra_compile_args=["-pthread"],
+                             extra_link_args=["-pthread"])],
       zip_safe=False)
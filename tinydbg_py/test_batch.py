@@ -0,0 +1,37 @@
+# Requests made in a batch, which are done once the batch is, on a stopped /bin/sleep: pytest test_batch.py
+import pytest
+import tinydbg_py
+
+
+def test_batched_reads():
+    with tinydbg_py.TinyDbg("/bin/sleep", ["/bin/sleep", "60"]) as d:
+        regs = d.get_regs().join()
+        expected = d.read_mem(regs.rsp, 64)
+        into = bytearray(64)
+        d.batch_begin()
+        memory = d.get_mem(regs.rsp, 64)
+        batched_regs = d.get_regs()
+        d.get_mem(regs.rsp, into)
+        for _ in range(100):
+            # nothing holds them, the batch keeps their memory until it's done
+            d.get_mem(regs.rsp, 4096)
+            d.get_regs()
+        with pytest.raises(ValueError):
+            memory.join()
+        batch = d.batch_submit()
+        assert memory.join() == expected
+        assert batched_regs.join().rip == regs.rip
+        batch.join()
+        assert into == expected
+
+
+def test_batch_dropped():
+    with tinydbg_py.TinyDbg("/bin/sleep", ["/bin/sleep", "60"]) as d:
+        regs = d.get_regs().join()
+        d.batch_begin()
+        memory = d.get_mem(regs.rsp, 64)
+        d.batch_submit()
+        assert memory.join() == d.read_mem(regs.rsp, 64)
+        d.batch_begin()
+        d.get_mem(regs.rsp, 64)
+    # closed without submitting it
@@ -0,0 +1,167 @@
+import ctypes, os
+from dataclasses import dataclass
+
+TINYDBG_FLAG_NO_ASLR = 0b1
+
+# built by make tinydbg_lib
+lib = ctypes.CDLL(os.environ.get("TINYDBG_LIB", "./tinydbg_lib"))
+lib.TinyDbg_start_advanced.argtypes = [ctypes.c_char_p, ctypes.POINTER(ctypes.c_char_p), ctypes.POINTER(ctypes.c_char_p), ctypes.c_uint]
+lib.TinyDbg_start_advanced.restype = ctypes.c_void_p
+
+lib.TinyDbg_free.argtypes = [ctypes.c_void_p]
+
+# the requests return an EventQueue_JoinHandle *, which doesn't fit in the default int
+lib.TinyDbg_continue.argtypes = [ctypes.c_void_p]
+lib.TinyDbg_continue.restype = ctypes.c_void_p
+lib.TinyDbg_get_registers.argtypes = [ctypes.c_void_p, ctypes.c_void_p]
+lib.TinyDbg_get_registers.restype = ctypes.c_void_p
+lib.TinyDbg_get_memory_v.argtypes = [ctypes.c_void_p, ctypes.c_void_p, ctypes.c_void_p, ctypes.c_size_t, ctypes.c_void_p]
+lib.TinyDbg_get_memory_v.restype = ctypes.c_ssize_t
+lib.TinyDbg_Event_free.argtypes = [ctypes.c_void_p]
+
+lib.EventQueue_join.argtypes = [ctypes.c_void_p]
+lib.EventQueue_detach.argtypes = [ctypes.c_void_p]
+lib.EventQueue_new_consumer.argtypes = [ctypes.c_void_p]
+lib.EventQueue_new_consumer.restype = ctypes.c_void_p
+lib.EventQueue_destroy_consumer.argtypes = [ctypes.c_void_p]
+lib.EventQueue_consume.argtypes = [ctypes.c_void_p, ctypes.POINTER(ctypes.c_void_p)]
+lib.EventQueue_consume.restype = ctypes.c_char
+
+class EventQueue_JoinHandle:
+    def __init__(self, handle):
+        self.handle = handle
+
+    def join(self):
+        lib.EventQueue_join(self.handle)
+    def detach(self):
+        lib.EventQueue_detach(self.handle)
+
+class EventQueue_join_with_value:
+    def __init__(self, value, handle):
+        self.value = value
+        self.handle = handle
+
+    def join(self):
+        lib.EventQueue_join(self.handle)
+        return self.value
+
+class user_regs_struct(ctypes.Structure):
+    _fields_ = [
+        ("r15", ctypes.c_ulonglong),
+        ("r14", ctypes.c_ulonglong),
+        ("r13", ctypes.c_ulonglong),
+        ("r12", ctypes.c_ulonglong),
+        ("rbp", ctypes.c_ulonglong),
+        ("rbx", ctypes.c_ulonglong),
+        ("r11", ctypes.c_ulonglong),
+        ("r10", ctypes.c_ulonglong),
+        ("r9", ctypes.c_ulonglong),
+        ("r8", ctypes.c_ulonglong),
+        ("rax", ctypes.c_ulonglong),
+        ("rcx", ctypes.c_ulonglong),
+        ("rdx", ctypes.c_ulonglong),
+        ("rsi", ctypes.c_ulonglong),
+        ("rdi", ctypes.c_ulonglong),
+        ("orig_rax", ctypes.c_ulonglong),
+        ("rip", ctypes.c_ulonglong),
+        ("cs", ctypes.c_ulonglong),
+        ("eflags", ctypes.c_ulonglong),
+        ("rsp", ctypes.c_ulonglong),
+        ("ss", ctypes.c_ulonglong),
+        ("fs_base", ctypes.c_ulonglong),
+        ("gs_base", ctypes.c_ulonglong),
+        ("ds", ctypes.c_ulonglong),
+        ("es", ctypes.c_ulonglong),
+        ("fs", ctypes.c_ulonglong),
+        ("gs", ctypes.c_ulonglong),
+    ]
+
+class iovec(ctypes.Structure):
+    _fields_ = [("iov_base", ctypes.c_void_p), ("iov_len", ctypes.c_size_t)]
+
+class TinyDbg_Displaced_struct(ctypes.Structure):
+    _fields_ = [("kind", ctypes.c_int), ("at", ctypes.c_void_p), ("len", ctypes.c_uint8), ("copy_len", ctypes.c_uint8)]
+
+class TinyDbg_Breakpoint_struct(ctypes.Structure):
+    _fields_ = [
+        ("position", ctypes.c_void_p),
+        ("is_once", ctypes.c_bool),
+        ("original", ctypes.c_char),
+        ("condition", ctypes.c_void_p),
+        ("hits", ctypes.c_uint64),
+        ("ignore_count", ctypes.c_uint64),
+        ("displaced", TinyDbg_Displaced_struct),
+    ]
+
+class TinyDbg_Watchpoint_struct(ctypes.Structure):
+    _fields_ = [("address", ctypes.c_void_p), ("len", ctypes.c_size_t), ("kind", ctypes.c_int)]
+
+class TinyDbg_Event_syscall_struct(ctypes.Structure):
+    _fields_ = [("id", ctypes.c_int), ("is_exit", ctypes.c_bool)]
+
+class TinyDbg_Event_fork_struct(ctypes.Structure):
+    _fields_ = [("pid", ctypes.c_int), ("handle", ctypes.c_void_p)]
+
+class TinyDbg_Event_content_union(ctypes.Union):
+    _fields_ = [
+        ("stop_code", ctypes.c_int),
+        ("syscall_id", ctypes.c_int),
+        ("syscall", TinyDbg_Event_syscall_struct),
+        ("breakpoint", TinyDbg_Breakpoint_struct),
+        ("watchpoint", TinyDbg_Watchpoint_struct),
+        ("fork", TinyDbg_Event_fork_struct),
+    ]
+
+class TinyDbg_Event_struct(ctypes.Structure):
+    _fields_ = [("type", ctypes.c_int), ("tid", ctypes.c_int), ("pid", ctypes.c_int), ("content", TinyDbg_Event_content_union)]
+
+class EventQueue_Consumer:
+    def __init__(self, handle):
+        self.handle = handle
+
+    """Wait for the next event, None once the debugger is freed"""
+    def consume(self):
+        event = ctypes.c_void_p()
+        if lib.EventQueue_consume(self.handle, ctypes.byref(event)) == b"K" or not event:
+            return None
+        event_content = TinyDbg_Event_struct.from_buffer_copy(ctypes.cast(event, ctypes.POINTER(TinyDbg_Event_struct)).contents)
+        lib.TinyDbg_Event_free(event)
+        return event_content
+
+    def close(self):
+        lib.EventQueue_destroy_consumer(self.handle)
+
+@dataclass(init=False, eq=False)
+class TinyDbg:
+    pid: int
+    
+    """Wrapper for TinyDbg_start"""
+    def __init__(self, filename, argv, envp, flags=0):
+        new_argv = (ctypes.c_char_p * (len(argv) + 1))()
+        new_argv[:] = [x.encode("utf-8") for x in argv] + [ctypes.c_char_p(0)]
+
+        envp = [f"{x[0]}={x[1]}".encode("utf-8") for x in envp.items()]
+        new_envp = (ctypes.c_char_p * (len(envp) + 1))()
+        new_envp[:] = envp + [ctypes.c_char_p(0)]
+
+        self.handle = lib.TinyDbg_start_advanced(ctypes.create_string_buffer(filename.encode("utf-8")), ctypes.cast(new_argv, ctypes.POINTER(ctypes.c_char_p)), new_envp, flags)
+        self.pid = ctypes.cast(self.handle, ctypes.POINTER(ctypes.c_int))[0]
+
+    """Wrapper for TinyDbg_continue"""
+    def cont(self) -> EventQueue_JoinHandle:
+        return EventQueue_JoinHandle(lib.TinyDbg_continue(self.handle))
+
+    def get_regs(self) -> EventQueue_join_with_value:
+        regs = user_regs_struct()
+        return EventQueue_join_with_value(regs, lib.TinyDbg_get_registers(self.handle, ctypes.byref(regs)))
+
+    """Wrapper for TinyDbg_get_memory_v"""
+    def get_mem(self, address, size) -> bytes:
+        buffer = ctypes.create_string_buffer(size)
+        local, remote = iovec(ctypes.cast(buffer, ctypes.c_void_p), size), iovec(address, size)
+        transferred = ctypes.c_size_t()
+        lib.TinyDbg_get_memory_v(self.handle, ctypes.byref(local), ctypes.byref(remote), 1, ctypes.byref(transferred))
+        return buffer.raw[:transferred.value]
+
+    def __del__(self):
+        lib.TinyDbg_free(self.handle)